@@ -20,6 +20,8 @@
 #include <utils/Log.h>
 #include <utils/Errors.h>
 
+#include <string.h>
+
 #include <binder/Parcel.h>
 #include <camera/CameraMetadata.h>
 #include <camera_metadata_hidden.h>
@@ -33,21 +35,22 @@ typedef Parcel::WritableBlob WritableBlob;
 typedef Parcel::ReadableBlob ReadableBlob;
 
 CameraMetadata::CameraMetadata() :
-        mBuffer(NULL), mLocked(false) {
+        mBuffer(NULL), mLocked(false), mTagIndexEnabled(false), mTagIndexValid(false) {
 }
 
 CameraMetadata::CameraMetadata(size_t entryCapacity, size_t dataCapacity) :
-        mLocked(false)
+        mLocked(false), mTagIndexEnabled(false), mTagIndexValid(false)
 {
     mBuffer = allocate_camera_metadata(entryCapacity, dataCapacity);
 }
 
 CameraMetadata::CameraMetadata(const CameraMetadata &other) :
-        mLocked(false) {
+        mLocked(false), mTagIndexEnabled(false), mTagIndexValid(false) {
     mBuffer = clone_camera_metadata(other.mBuffer);
 }
 
-CameraMetadata::CameraMetadata(CameraMetadata &&other) :mBuffer(NULL),  mLocked(false) {
+CameraMetadata::CameraMetadata(CameraMetadata &&other) :mBuffer(NULL),  mLocked(false),
+        mTagIndexEnabled(false), mTagIndexValid(false) {
     acquire(other);
 }
 
@@ -57,7 +60,7 @@ CameraMetadata &CameraMetadata::operator=(CameraMetadata &&other) {
 }
 
 CameraMetadata::CameraMetadata(camera_metadata_t *buffer) :
-        mBuffer(NULL), mLocked(false) {
+        mBuffer(NULL), mLocked(false), mTagIndexEnabled(false), mTagIndexValid(false) {
     acquire(buffer);
 }
 
@@ -85,6 +88,8 @@ CameraMetadata::~CameraMetadata() {
 }
 
 const camera_metadata_t* CameraMetadata::getAndLock() const {
+    // The buffer may be edited through the returned pointer
+    invalidateTagIndex();
     mLocked = true;
     return mBuffer;
 }
@@ -110,6 +115,7 @@ camera_metadata_t* CameraMetadata::release() {
     }
     camera_metadata_t *released = mBuffer;
     mBuffer = NULL;
+    invalidateTagIndex();
     return released;
 }
 
@@ -122,6 +128,7 @@ void CameraMetadata::clear() {
         free_camera_metadata(mBuffer);
         mBuffer = NULL;
     }
+    invalidateTagIndex();
 }
 
 void CameraMetadata::acquire(camera_metadata_t *buffer) {
@@ -145,6 +152,56 @@ void CameraMetadata::acquire(CameraMetadata &other) {
     acquire(other.release());
 }
 
+status_t CameraMetadata::updateFrom(const camera_metadata_t* other, size_t* changedCount) {
+    if (mLocked) {
+        ALOGE("%s: CameraMetadata is locked", __FUNCTION__);
+        return INVALID_OPERATION;
+    }
+    if (other == NULL) {
+        if (changedCount != NULL) *changedCount = entryCount();
+        clear();
+        return OK;
+    }
+
+    size_t count = get_camera_metadata_entry_count(other);
+    bool sameLayout = mBuffer != NULL && get_camera_metadata_entry_count(mBuffer) == count &&
+            get_camera_metadata_vendor_id(mBuffer) == get_camera_metadata_vendor_id(other);
+    size_t changed = 0;
+    for (size_t i = 0; sameLayout && i < count; i++) {
+        camera_metadata_ro_entry_t entry, otherEntry;
+        get_camera_metadata_ro_entry(mBuffer, i, &entry);
+        get_camera_metadata_ro_entry(other, i, &otherEntry);
+        if (entry.tag != otherEntry.tag || entry.type != otherEntry.type) {
+            sameLayout = false;
+            break;
+        }
+        if (entry.count == otherEntry.count && memcmp(entry.data.u8, otherEntry.data.u8,
+                entry.count * camera_metadata_type_size[entry.type]) == 0) {
+            continue;
+        }
+        // Fails if the new value doesn't fit in the data left
+        if (update_camera_metadata_entry(mBuffer, i, otherEntry.data.u8, otherEntry.count,
+                NULL) != OK) {
+            sameLayout = false;
+            break;
+        }
+        changed++;
+    }
+
+    // The tag index stays valid as long as entries keep their positions
+    if (!sameLayout) {
+        camera_metadata_t *buffer = clone_camera_metadata(other);
+        if (buffer == NULL) {
+            ALOGE("%s: Failed to clone metadata buffer", __FUNCTION__);
+            return NO_MEMORY;
+        }
+        acquire(buffer);
+        changed = count;
+    }
+    if (changedCount != NULL) *changedCount = changed;
+    return OK;
+}
+
 status_t CameraMetadata::append(const CameraMetadata &other) {
     return append(other.mBuffer);
 }
@@ -158,6 +215,7 @@ status_t CameraMetadata::append(const camera_metadata_t* other) {
     size_t extraData = get_camera_metadata_data_count(other);
     resizeIfNeeded(extraEntries, extraData);
 
+    invalidateTagIndex();
     return append_camera_metadata(mBuffer, other);
 }
 
@@ -180,6 +238,7 @@ status_t CameraMetadata::sort() {
         ALOGE("%s: CameraMetadata is locked", __FUNCTION__);
         return INVALID_OPERATION;
     }
+    invalidateTagIndex();
     return sort_camera_metadata(mBuffer);
 }
 
@@ -333,14 +392,17 @@ status_t CameraMetadata::updateImpl(uint32_t tag, const void *data,
     res = resizeIfNeeded(1, data_size);
 
     if (res == OK) {
-        camera_metadata_entry_t entry;
-        res = find_camera_metadata_entry(mBuffer, tag, &entry);
+        size_t index;
+        res = indexOfTag(tag, &index);
         if (res == NAME_NOT_FOUND) {
             res = add_camera_metadata_entry(mBuffer,
                     tag, data, data_count);
+            if (res == OK) {
+                addToTagIndex(tag, get_camera_metadata_entry_count(mBuffer) - 1);
+            }
         } else if (res == OK) {
             res = update_camera_metadata_entry(mBuffer,
-                    entry.index, data, data_count, NULL);
+                    index, data, data_count, NULL);
         }
     }
 
@@ -363,8 +425,8 @@ status_t CameraMetadata::updateImpl(uint32_t tag, const void *data,
 }
 
 bool CameraMetadata::exists(uint32_t tag) const {
-    camera_metadata_ro_entry entry;
-    return find_camera_metadata_ro_entry(mBuffer, tag, &entry) == 0;
+    size_t index;
+    return indexOfTag(tag, &index) == OK;
 }
 
 camera_metadata_entry_t CameraMetadata::find(uint32_t tag) {
@@ -375,7 +437,11 @@ camera_metadata_entry_t CameraMetadata::find(uint32_t tag) {
         entry.count = 0;
         return entry;
     }
-    res = find_camera_metadata_entry(mBuffer, tag, &entry);
+    size_t index;
+    res = indexOfTag(tag, &index);
+    if (CC_LIKELY(res == OK)) {
+        res = get_camera_metadata_entry(mBuffer, index, &entry);
+    }
     if (CC_UNLIKELY( res != OK )) {
         entry.count = 0;
         entry.data.u8 = NULL;
@@ -386,7 +452,11 @@ camera_metadata_entry_t CameraMetadata::find(uint32_t tag) {
 camera_metadata_ro_entry_t CameraMetadata::find(uint32_t tag) const {
     status_t res;
     camera_metadata_ro_entry entry;
-    res = find_camera_metadata_ro_entry(mBuffer, tag, &entry);
+    size_t index;
+    res = indexOfTag(tag, &index);
+    if (CC_LIKELY(res == OK)) {
+        res = get_camera_metadata_ro_entry(mBuffer, index, &entry);
+    }
     if (CC_UNLIKELY( res != OK )) {
         entry.count = 0;
         entry.data.u8 = NULL;
@@ -395,13 +465,13 @@ camera_metadata_ro_entry_t CameraMetadata::find(uint32_t tag) const {
 }
 
 status_t CameraMetadata::erase(uint32_t tag) {
-    camera_metadata_entry_t entry;
+    size_t index;
     status_t res;
     if (mLocked) {
         ALOGE("%s: CameraMetadata is locked", __FUNCTION__);
         return INVALID_OPERATION;
     }
-    res = find_camera_metadata_entry(mBuffer, tag, &entry);
+    res = indexOfTag(tag, &index);
     if (res == NAME_NOT_FOUND) {
         return OK;
     } else if (res != OK) {
@@ -412,7 +482,9 @@ status_t CameraMetadata::erase(uint32_t tag) {
                 tag, strerror(-res), res);
         return res;
     }
-    res = delete_camera_metadata_entry(mBuffer, entry.index);
+    // Later entries move down
+    invalidateTagIndex();
+    res = delete_camera_metadata_entry(mBuffer, index);
     if (res != OK) {
         ALOGE("%s: Error deleting entry %s.%s (%x): %s %d",
                 __FUNCTION__,
@@ -423,6 +495,88 @@ status_t CameraMetadata::erase(uint32_t tag) {
     return res;
 }
 
+// Tag index slots not holding an entry
+static constexpr uint32_t kNoTagIndexEntry = UINT32_MAX;
+static constexpr size_t kMinTagIndexSize = 16;
+
+static inline size_t tagIndexSlot(uint32_t tag, size_t mask) {
+    // Multiplicative hash, spreads out the consecutive tags of a section
+    return ((tag * 0x9E3779B1u) >> 15) & mask;
+}
+
+void CameraMetadata::setTagIndexEnabled(bool enabled) {
+    mTagIndexEnabled = enabled;
+    invalidateTagIndex();
+    if (!enabled) {
+        std::vector<TagIndexSlot>().swap(mTagIndex);
+    }
+}
+
+status_t CameraMetadata::indexOfTag(uint32_t tag, size_t *index) const {
+    if (!mTagIndexEnabled || mBuffer == NULL) {
+        camera_metadata_ro_entry entry;
+        status_t res = find_camera_metadata_ro_entry(mBuffer, tag, &entry);
+        if (res == OK) {
+            *index = entry.index;
+        }
+        return res;
+    }
+
+    if (!mTagIndexValid) {
+        buildTagIndex();
+    }
+    size_t mask = mTagIndex.size() - 1;
+    for (size_t slot = tagIndexSlot(tag, mask); ; slot = (slot + 1) & mask) {
+        const TagIndexSlot &s = mTagIndex[slot];
+        if (s.entryIndex == kNoTagIndexEntry) {
+            return NAME_NOT_FOUND;
+        }
+        if (s.tag == tag) {
+            *index = s.entryIndex;
+            return OK;
+        }
+    }
+}
+
+void CameraMetadata::buildTagIndex() const {
+    size_t entryCount = get_camera_metadata_entry_count(mBuffer);
+    size_t size = kMinTagIndexSize;
+    while (size < entryCount * 2) {
+        size *= 2;
+    }
+    mTagIndex.assign(size, {0, kNoTagIndexEntry});
+    mTagIndexValid = true;
+
+    for (size_t i = 0; i < entryCount; i++) {
+        camera_metadata_ro_entry entry;
+        get_camera_metadata_ro_entry(mBuffer, i, &entry);
+        addToTagIndex(entry.tag, i);
+    }
+}
+
+void CameraMetadata::addToTagIndex(uint32_t tag, size_t entryIndex) const {
+    if (!mTagIndexEnabled || !mTagIndexValid) {
+        return;
+    }
+    // Keep the table at most half full; rebuild it larger on the next lookup
+    if ((entryIndex + 1) * 2 > mTagIndex.size()) {
+        invalidateTagIndex();
+        return;
+    }
+    size_t mask = mTagIndex.size() - 1;
+    for (size_t slot = tagIndexSlot(tag, mask); ; slot = (slot + 1) & mask) {
+        TagIndexSlot &s = mTagIndex[slot];
+        if (s.entryIndex == kNoTagIndexEntry) {
+            s = {tag, static_cast<uint32_t>(entryIndex)};
+            return;
+        }
+        if (s.tag == tag) {
+            // Duplicate tag, keep the first entry like the buffer search does
+            return;
+        }
+    }
+}
+
 status_t CameraMetadata::removePermissionEntries(metadata_vendor_id_t vendorId,
         std::vector<int32_t> *tagsRemoved) {
     uint32_t tagCount = 0;
@@ -784,6 +938,8 @@ void CameraMetadata::swap(CameraMetadata& other) {
 
     other.mBuffer = thisBuf;
     mBuffer = otherBuf;
+    invalidateTagIndex();
+    other.invalidateTagIndex();
 }
 
 status_t CameraMetadata::getTagFromName(const char *name,
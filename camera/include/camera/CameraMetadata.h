@@ -19,6 +19,8 @@
 
 #include "system/camera_metadata.h"
 
+#include <vector>
+
 #include <utils/String8.h>
 #include <utils/Vector.h>
 #include <binder/Parcelable.h>
@@ -107,6 +109,15 @@ class CameraMetadata: public Parcelable {
      */
     void acquire(CameraMetadata &other);
 
+    /**
+     * Make the metadata equal to a raw camera_metadata buffer. When both have
+     * the same tags in the same order, as successive settings of a repeating
+     * request do, only the entries whose values differ are copied, in place.
+     * Otherwise the whole buffer is copied. The number of entries copied is
+     * returned in changedCount, if not NULL.
+     */
+    status_t updateFrom(const camera_metadata_t* other, size_t* changedCount = NULL);
+
     /**
      * Append metadata from another CameraMetadata object.
      */
@@ -180,6 +191,17 @@ class CameraMetadata: public Parcelable {
      */
     camera_metadata_ro_entry find(uint32_t tag) const;
 
+    /**
+     * Keep a tag to entry index beside the metadata buffer, so that find(),
+     * exists(), update() and erase() do not search the entries. The index is
+     * rebuilt on the first lookup after entries are removed or reordered.
+     *
+     * Worth enabling for metadata looked up many times between such changes,
+     * like capture results. Lookups update the index, so an indexed object must
+     * not be accessed from several threads at once, even through const methods.
+     */
+    void setTagIndexEnabled(bool enabled);
+
     /**
      * Delete metadata entry by tag
      */
@@ -252,6 +274,15 @@ class CameraMetadata: public Parcelable {
     volatile char      mReserved[3] __attribute__ ((unused));
     mutable bool       mLocked;
 
+    // Open addressing hash table of entry indices, see setTagIndexEnabled()
+    struct TagIndexSlot {
+        uint32_t tag;
+        uint32_t entryIndex;
+    };
+    bool                              mTagIndexEnabled;
+    mutable bool                      mTagIndexValid;
+    mutable std::vector<TagIndexSlot> mTagIndex;
+
     /**
      * Check if tag has a given type
      */
@@ -267,6 +298,17 @@ class CameraMetadata: public Parcelable {
      */
     status_t resizeIfNeeded(size_t extraEntries, size_t extraData);
 
+    /**
+     * Find the index of the entry for tag in the metadata buffer. Searches the
+     * buffer unless the tag index is enabled.
+     */
+    status_t indexOfTag(uint32_t tag, size_t *index) const;
+
+    void buildTagIndex() const;
+    // Record an entry just appended to the buffer, or invalidate the index
+    void addToTagIndex(uint32_t tag, size_t entryIndex) const;
+    void invalidateTagIndex() const { mTagIndexValid = false; }
+
 };
 
 namespace hardware {
@@ -17,6 +17,7 @@ include $(CLEAR_VARS)
 LOCAL_ADDITIONAL_DEPENDENCIES := $(LOCAL_PATH)/Android.mk
 
 LOCAL_SRC_FILES:= \
+	CameraMetadataTests.cpp \
 	VendorTagDescriptorTests.cpp \
 	CameraBinderTests.cpp \
 	CameraZSLTests.cpp \
@@ -0,0 +1,247 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_NDEBUG 0
+#define LOG_TAG "CameraMetadataTests"
+
+#include <camera/CameraMetadata.h>
+#include <system/camera_metadata.h>
+#include <utils/Errors.h>
+#include <utils/Log.h>
+
+#include <gtest/gtest.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <random>
+#include <vector>
+
+using namespace android;
+
+#define ARRAY_SIZE(a)      (sizeof(a) / sizeof((a)[0]))
+
+// Tags of every type, as found in capture results
+static const uint32_t kResultTags[] = {
+    ANDROID_COLOR_CORRECTION_MODE,
+    ANDROID_COLOR_CORRECTION_TRANSFORM,
+    ANDROID_COLOR_CORRECTION_GAINS,
+    ANDROID_CONTROL_AE_MODE,
+    ANDROID_CONTROL_AE_REGIONS,
+    ANDROID_CONTROL_AF_MODE,
+    ANDROID_CONTROL_AWB_MODE,
+    ANDROID_CONTROL_ZOOM_RATIO,
+    ANDROID_JPEG_GPS_COORDINATES,
+    ANDROID_LENS_APERTURE,
+    ANDROID_LENS_FOCUS_DISTANCE,
+    ANDROID_REQUEST_FRAME_COUNT,
+    ANDROID_REQUEST_ID,
+    ANDROID_SCALER_CROP_REGION,
+    ANDROID_SENSOR_EXPOSURE_TIME,
+    ANDROID_SENSOR_SENSITIVITY,
+    ANDROID_SENSOR_TIMESTAMP,
+    ANDROID_STATISTICS_FACE_RECTANGLES,
+};
+
+static void UpdateRandom(CameraMetadata *metadata, uint32_t tag,
+        std::default_random_engine &gen) {
+    camera_metadata_ro_entry entry;
+    entry.tag = tag;
+    entry.type = get_camera_metadata_tag_type(tag);
+    entry.count = std::uniform_int_distribution<size_t>(1, 8)(gen);
+    std::vector<uint8_t> data(entry.count * camera_metadata_type_size[entry.type]);
+    for (auto &byte : data) {
+        byte = gen();
+    }
+    entry.data.u8 = data.data();
+    ASSERT_EQ(OK, metadata->update(entry));
+}
+
+// Lookups must give the same entries with and without the tag index
+static void ExpectSameEntries(const CameraMetadata &indexed, const CameraMetadata &plain) {
+    ASSERT_EQ(plain.entryCount(), indexed.entryCount());
+    for (uint32_t tag : kResultTags) {
+        SCOPED_TRACE(get_camera_metadata_tag_name(tag));
+        camera_metadata_ro_entry expected = plain.find(tag);
+        camera_metadata_ro_entry actual = indexed.find(tag);
+        ASSERT_EQ(expected.count, actual.count);
+        EXPECT_EQ(plain.exists(tag), indexed.exists(tag));
+        if (expected.count == 0) continue;
+        EXPECT_EQ(expected.index, actual.index);
+        EXPECT_EQ(expected.type, actual.type);
+        EXPECT_EQ(0, memcmp(expected.data.u8, actual.data.u8,
+                expected.count * camera_metadata_type_size[expected.type]));
+    }
+}
+
+TEST(CameraMetadataTest, TagIndexMatchesSearch) {
+    std::default_random_engine gen(42);
+    std::uniform_int_distribution<size_t> tagDist(0, ARRAY_SIZE(kResultTags) - 1);
+    std::uniform_int_distribution<int> opDist(0, 19);
+
+    CameraMetadata indexed, plain;
+    indexed.setTagIndexEnabled(true);
+    for (int i = 0; i < 2000; i++) {
+        uint32_t tag = kResultTags[tagDist(gen)];
+        switch (opDist(gen)) {
+            case 0:
+            case 1:
+            case 2:
+                EXPECT_EQ(plain.erase(tag), indexed.erase(tag));
+                break;
+            case 3:
+                EXPECT_EQ(plain.sort(), indexed.sort());
+                break;
+            case 4: {
+                // Sorted metadata with duplicate tags may find either entry
+                plain.erase(tag);
+                indexed.erase(tag);
+                CameraMetadata other;
+                UpdateRandom(&other, tag, gen);
+                EXPECT_EQ(plain.append(other), indexed.append(other));
+                break;
+            }
+            case 5:
+                plain.clear();
+                indexed.clear();
+                break;
+            default: {
+                std::default_random_engine dataGen = gen;
+                UpdateRandom(&plain, tag, dataGen);
+                UpdateRandom(&indexed, tag, gen);
+                break;
+            }
+        }
+        ASSERT_NO_FATAL_FAILURE(ExpectSameEntries(indexed, plain));
+    }
+}
+
+TEST(CameraMetadataTest, TagIndexDuplicateTags) {
+    std::default_random_engine gen(0);
+    CameraMetadata indexed, other;
+    indexed.setTagIndexEnabled(true);
+    UpdateRandom(&indexed, ANDROID_REQUEST_ID, gen);
+    UpdateRandom(&indexed, ANDROID_SENSOR_TIMESTAMP, gen);
+    UpdateRandom(&other, ANDROID_SENSOR_TIMESTAMP, gen);
+    ASSERT_EQ(1u, indexed.find(ANDROID_SENSOR_TIMESTAMP).index);
+
+    // Like the search of unsorted metadata, the first entry is found
+    ASSERT_EQ(OK, indexed.append(other));
+    CameraMetadata plain(indexed);
+    EXPECT_EQ(1u, indexed.find(ANDROID_SENSOR_TIMESTAMP).index);
+    ExpectSameEntries(indexed, plain);
+}
+
+TEST(CameraMetadataTest, TagIndexEditedBuffer) {
+    std::default_random_engine gen(1);
+    CameraMetadata indexed;
+    indexed.setTagIndexEnabled(true);
+    for (uint32_t tag : kResultTags) {
+        UpdateRandom(&indexed, tag, gen);
+    }
+    ASSERT_TRUE(indexed.exists(ANDROID_REQUEST_ID));
+
+    // Entries removed through the raw buffer are not found afterwards
+    camera_metadata_t *buffer = const_cast<camera_metadata_t *>(indexed.getAndLock());
+    camera_metadata_entry entry;
+    ASSERT_EQ(OK, find_camera_metadata_entry(buffer, ANDROID_REQUEST_ID, &entry));
+    ASSERT_EQ(OK, delete_camera_metadata_entry(buffer, entry.index));
+    indexed.unlock(buffer);
+
+    CameraMetadata plain(indexed);
+    EXPECT_FALSE(indexed.exists(ANDROID_REQUEST_ID));
+    ExpectSameEntries(indexed, plain);
+}
+
+TEST(CameraMetadataTest, TagIndexSwap) {
+    std::default_random_engine gen(2);
+    CameraMetadata indexed, other;
+    indexed.setTagIndexEnabled(true);
+    UpdateRandom(&indexed, ANDROID_SENSOR_TIMESTAMP, gen);
+    UpdateRandom(&other, ANDROID_REQUEST_ID, gen);
+    UpdateRandom(&other, ANDROID_SENSOR_EXPOSURE_TIME, gen);
+    ASSERT_TRUE(indexed.exists(ANDROID_SENSOR_TIMESTAMP));
+
+    indexed.swap(other);
+    EXPECT_FALSE(indexed.exists(ANDROID_SENSOR_TIMESTAMP));
+    EXPECT_TRUE(indexed.exists(ANDROID_SENSOR_EXPOSURE_TIME));
+    EXPECT_EQ(1u, indexed.find(ANDROID_SENSOR_EXPOSURE_TIME).index);
+    EXPECT_TRUE(other.exists(ANDROID_SENSOR_TIMESTAMP));
+}
+
+// Entries of two metadata buffers must match, in the same order
+static void ExpectSameBuffer(const CameraMetadata &actual, const CameraMetadata &expected) {
+    const camera_metadata_t *a = actual.getAndLock();
+    const camera_metadata_t *e = expected.getAndLock();
+    ASSERT_EQ(get_camera_metadata_entry_count(e), get_camera_metadata_entry_count(a));
+    for (size_t i = 0; i < get_camera_metadata_entry_count(e); i++) {
+        camera_metadata_ro_entry aEntry, eEntry;
+        ASSERT_EQ(OK, get_camera_metadata_ro_entry(a, i, &aEntry));
+        ASSERT_EQ(OK, get_camera_metadata_ro_entry(e, i, &eEntry));
+        EXPECT_EQ(eEntry.tag, aEntry.tag);
+        ASSERT_EQ(eEntry.count, aEntry.count);
+        EXPECT_EQ(0, memcmp(eEntry.data.u8, aEntry.data.u8,
+                eEntry.count * camera_metadata_type_size[eEntry.type]));
+    }
+    actual.unlock(a);
+    expected.unlock(e);
+}
+
+TEST(CameraMetadataTest, UpdateFromChangedEntries) {
+    std::default_random_engine gen(3);
+    CameraMetadata latest, settings;
+    for (uint32_t tag : kResultTags) {
+        UpdateRandom(&settings, tag, gen);
+    }
+    settings.sort();
+
+    size_t changedCount;
+    const camera_metadata_t *buffer = settings.getAndLock();
+    ASSERT_EQ(OK, latest.updateFrom(buffer, &changedCount));
+    settings.unlock(buffer);
+    EXPECT_EQ(ARRAY_SIZE(kResultTags), changedCount);
+    ExpectSameBuffer(latest, settings);
+
+    // Per frame changes of the same tags, the new values possibly of a different size
+    std::uniform_int_distribution<size_t> tagDist(0, ARRAY_SIZE(kResultTags) - 1);
+    latest.setTagIndexEnabled(true);
+    for (int i = 0; i < 200; i++) {
+        CameraMetadata next(settings);
+        uint32_t tag = kResultTags[tagDist(gen)];
+        UpdateRandom(&next, tag, gen);
+
+        buffer = next.getAndLock();
+        ASSERT_EQ(OK, latest.updateFrom(buffer, &changedCount));
+        next.unlock(buffer);
+        // A value that doesn't fit in the data left takes a whole copy
+        EXPECT_TRUE(changedCount <= 1 || changedCount == ARRAY_SIZE(kResultTags));
+        ASSERT_NO_FATAL_FAILURE(ExpectSameBuffer(latest, next));
+        ASSERT_NO_FATAL_FAILURE(ExpectSameEntries(latest, next));
+        settings = next;
+    }
+
+    // Different tags mean a whole copy
+    CameraMetadata other;
+    UpdateRandom(&other, ANDROID_REQUEST_ID, gen);
+    buffer = other.getAndLock();
+    ASSERT_EQ(OK, latest.updateFrom(buffer, &changedCount));
+    other.unlock(buffer);
+    EXPECT_EQ(1u, changedCount);
+    ExpectSameBuffer(latest, other);
+
+    ASSERT_EQ(OK, latest.updateFrom(nullptr, &changedCount));
+    EXPECT_EQ(1u, changedCount);
+    EXPECT_TRUE(latest.isEmpty());
+}
@@ -32,6 +32,7 @@
 #include <binder/IServiceManager.h>
 #include <binder/ProcessState.h>
 #include <datasource/DataSourceFactory.h>
+#include <datasource/FileSource.h>
 #include <media/DataSource.h>
 #include <media/stagefright/MediaSource.h>
 #include <media/IMediaHTTPService.h>
@@ -1162,6 +1163,12 @@ int main(int argc, char **argv) {
         sp<MediaSource> mediaSource;
 
         if (isJPEG) {
+            // JPEGSource reads the whole image into one buffer; map local files so
+            // that the buffer points at the file's pages instead of a copy.
+            sp<FileSource> fileSource = new FileSource(filename);
+            if (fileSource->initCheck() == OK && fileSource->enableMmap() == OK) {
+                dataSource = fileSource;
+            }
             mediaSource = new JPEGSource(dataSource);
             if (gWriteMP4) {
                 mediaSources.push(mediaSource);
@@ -31,6 +31,7 @@
 
 namespace android {
 
+class MediaBufferBase;
 class String8;
 
 class DataSource : public DataSourceBase, public virtual RefBase {
@@ -65,6 +66,14 @@ public:
         return String8("application/octet-stream");
     }
 
+    // Returns a MediaBufferBase whose data points directly at the source's
+    // bytes in [offset, offset + size), with a local reference already held by
+    // the caller, or nullptr if the source cannot expose its data without
+    // copying. Sources backed by memory-mapped files override this.
+    virtual MediaBufferBase *createMappedBuffer(off64_t /*offset*/, size_t /*size*/) {
+        return nullptr;
+    }
+
     CDataSource *wrap() {
         if (mWrapper) {
             return mWrapper;
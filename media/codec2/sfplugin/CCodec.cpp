@@ -697,7 +697,9 @@ private:
 
 CCodec::CCodec()
     : mChannel(new CCodecBufferChannel(std::make_shared<CCodecCallbackImpl>(this))),
-      mConfig(new CCodecConfig) {
+      mConfig(new CCodecConfig),
+      mReportedPipelineDepth(0),
+      mReportedPipelineDepthReason(nullptr) {
 }
 
 CCodec::~CCodec() {
@@ -1255,6 +1257,33 @@ void CCodec::configure(const sp<AMessage> &msg) {
             }
         }
 
+        // Pipeline depth autotuning: real-time sessions trade throughput for
+        // latency, non-realtime ones (e.g. transcoding) the other way around.
+        // The choice can be overridden through android._pipeline-autotune.
+        PipelineWatcher::AutotuneMode autotune = PipelineWatcher::AUTOTUNE_OFF;
+        AString autotuneName;
+        int32_t lowLatency = 0;
+        int32_t priority = 0;
+        if (msg->findString("android._pipeline-autotune", &autotuneName)) {
+            if (autotuneName == "throughput") {
+                autotune = PipelineWatcher::AUTOTUNE_THROUGHPUT;
+            } else if (autotuneName == "latency") {
+                autotune = PipelineWatcher::AUTOTUNE_LATENCY;
+            } else if (autotuneName != "off") {
+                ALOGW("unknown pipeline autotune mode '%s'; ignored", autotuneName.c_str());
+            }
+        } else if (msg->findInt32(KEY_LOW_LATENCY, &lowLatency) && lowLatency) {
+            autotune = PipelineWatcher::AUTOTUNE_LATENCY;
+        } else if (msg->findInt32(KEY_PRIORITY, &priority) && priority == 1) {
+            autotune = PipelineWatcher::AUTOTUNE_THROUGHPUT;
+        }
+        mChannel->setPipelineAutotuneMode(autotune);
+        if (autotune != PipelineWatcher::AUTOTUNE_OFF) {
+            sp<AMessage> metrics = new AMessage;
+            metrics->setString(kCodecPipelineAutotune, PipelineWatcher::AsString(autotune));
+            mCallback->onMetricsUpdated(metrics);
+        }
+
         err = config->setParameters(comp, configUpdate, C2_DONT_BLOCK);
         if (err != OK) {
             ALOGW("failed to configure c2 params");
@@ -1542,6 +1571,8 @@ void CCodec::configure(const sp<AMessage> &msg) {
     config->queryConfiguration(comp);
 
     mMetrics = new AMessage;
+    mReportedPipelineDepth = 0;
+    mReportedPipelineDepthReason = nullptr;
     mChannel->resetBuffersPixelFormat((config->mDomain & Config::IS_ENCODER) ? true : false);
 
     mCallback->onComponentConfigured(config->mInputFormat, config->mOutputFormat);
@@ -1898,6 +1929,7 @@ void CCodec::initiateStop() {
         }
         state->set(STOPPING);
     }
+    reportWorkBatchSizes();
     mChannel->reset();
     bool pushBlankBuffer = mConfig.lock().get()->mPushBlankBuffersOnStop;
     sp<AMessage> stopMessage(new AMessage(kWhatStop, this));
@@ -1998,6 +2030,7 @@ void CCodec::initiateRelease(bool sendCallback /* = true */) {
         }
     }
 
+    reportWorkBatchSizes();
     mChannel->reset();
     bool pushBlankBuffer = mConfig.lock().get()->mPushBlankBuffersOnStop;
     // thiz holds strong ref to this while the thread is running.
@@ -2041,6 +2074,12 @@ void CCodec::release(bool sendCallback, bool pushBlankBuffer) {
     }
 }
 
+void CCodec::reportWorkBatchSizes() {
+    sp<AMessage> metrics = new AMessage;
+    metrics->setString(kCodecWorkBatchSizes, mChannel->getWorkBatchSizeStats().c_str());
+    mCallback->onMetricsUpdated(metrics);
+}
+
 status_t CCodec::setSurface(const sp<Surface> &surface) {
     bool pushBlankBuffer = false;
     {
@@ -2096,6 +2135,7 @@ void CCodec::signalFlush() {
             return;
     }
 
+    reportWorkBatchSizes();
     mChannel->stop();
     (new AMessage(kWhatFlush, this))->post();
 }
@@ -2544,6 +2584,16 @@ void CCodec::onMessageReceived(const sp<AMessage> &msg) {
                     mCallback->onMetricsUpdated(mMetrics);
                 }
             }
+            const char *depthReason = nullptr;
+            uint32_t depth = mChannel->getPipelineDepth(&depthReason);
+            if (depth != mReportedPipelineDepth || depthReason != mReportedPipelineDepthReason) {
+                mReportedPipelineDepth = depth;
+                mReportedPipelineDepthReason = depthReason;
+                sp<AMessage> metrics = new AMessage;
+                metrics->setInt32(kCodecPipelineDepth, depth);
+                metrics->setString(kCodecPipelineDepthReason, depthReason);
+                mCallback->onMetricsUpdated(metrics);
+            }
             break;
         }
         case kWhatWatch: {
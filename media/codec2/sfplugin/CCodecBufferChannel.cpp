@@ -165,6 +165,7 @@ CCodecBufferChannel::CCodecBufferChannel(
       mIsSurfaceToDisplay(false),
       mHasPresentFenceTimes(false),
       mRenderingDepth(3u),
+      mNumAutotuneSlots(0u),
       mMetaMode(MODE_NONE),
       mInputMetEos(false),
       mLastInputBufferAvailableTs(0u),
@@ -360,24 +361,9 @@ status_t CCodecBufferChannel::queueInputBufferInternal(
     if (!items.empty()) {
         ScopedTrace trace(ATRACE_TAG, android::base::StringPrintf(
                 "CCodecBufferChannel::queue(%s@ts=%lld)", mName, (long long)timeUs).c_str());
-        {
-            Mutexed<PipelineWatcher>::Locked watcher(mPipelineWatcher);
-            PipelineWatcher::Clock::time_point now = PipelineWatcher::Clock::now();
-            for (const std::unique_ptr<C2Work> &work : items) {
-                watcher->onWorkQueued(
-                        work->input.ordinal.frameIndex.peeku(),
-                        std::vector(work->input.buffers),
-                        now);
-            }
-        }
-        err = mComponent->queue(&items);
+        err = queueWork(&items, mInputMetEos);
     }
-    if (err != C2_OK) {
-        Mutexed<PipelineWatcher>::Locked watcher(mPipelineWatcher);
-        for (const std::unique_ptr<C2Work> &work : items) {
-            watcher->onWorkDone(work->input.ordinal.frameIndex.peeku());
-        }
-    } else {
+    if (err == C2_OK) {
         Mutexed<Input>::Locked input(mInput);
         bool released = false;
         if (copy) {
@@ -393,6 +379,63 @@ status_t CCodecBufferChannel::queueInputBufferInternal(
     return err;
 }
 
+c2_status_t CCodecBufferChannel::queueWork(
+        std::list<std::unique_ptr<C2Work>> *items, bool submitNow) {
+    mPendingWork.lock()->add(items);
+    return submitPendingWork(submitNow);
+}
+
+void CCodecBufferChannel::submitPendingWork() {
+    c2_status_t err = submitPendingWork(false /* submitNow */);
+    if (err != C2_OK) {
+        ALOGE("[%s] failed to queue held work items: %d", mName, err);
+        mCCodecCallback->onError(err, ACTION_CODE_FATAL);
+    }
+}
+
+c2_status_t CCodecBufferChannel::submitPendingWork(bool submitNow) {
+    // Keeps the submission order while queue() runs without mPendingWork.
+    std::lock_guard<std::mutex> queueLock(mQueueLock);
+    std::list<std::unique_ptr<C2Work>> batch;
+    {
+        Mutexed<WorkBatcher>::Locked pending(mPendingWork);
+        Mutexed<PipelineWatcher>::Locked watcher(mPipelineWatcher);
+        // Held work is taken from onWorkDone() once the component catches up.
+        batch = pending->takeBatch(*watcher, submitNow);
+    }
+    if (batch.empty()) {
+        return C2_OK;
+    }
+    size_t numWorks = batch.size();
+    {
+        Mutexed<PipelineWatcher>::Locked watcher(mPipelineWatcher);
+        PipelineWatcher::Clock::time_point now = PipelineWatcher::Clock::now();
+        for (const std::unique_ptr<C2Work> &work : batch) {
+            watcher->onWorkQueued(
+                    work->input.ordinal.frameIndex.peeku(),
+                    std::vector(work->input.buffers),
+                    now);
+        }
+    }
+    c2_status_t err = mComponent->queue(&batch);
+
+    Mutexed<PipelineWatcher>::Locked watcher(mPipelineWatcher);
+    if (err != C2_OK) {
+        for (const std::unique_ptr<C2Work> &work : batch) {
+            watcher->onWorkDone(work->input.ordinal.frameIndex.peeku());
+        }
+    } else {
+        watcher->onWorkBatchQueued(numWorks);
+    }
+    return err;
+}
+
+void CCodecBufferChannel::discardPendingWork() {
+    Mutexed<WorkBatcher>::Locked pending(mPendingWork);
+    ALOGV_IF(pending->size() > 0, "[%s] discarding %zu held work items", mName, pending->size());
+    pending->discard();
+}
+
 status_t CCodecBufferChannel::setParameters(std::vector<std::unique_ptr<C2Param>> &params) {
     QueueGuard guard(mSync);
     if (!guard.isRunning()) {
@@ -767,6 +810,7 @@ void CCodecBufferChannel::feedInputBufferIfAvailable() {
 }
 
 void CCodecBufferChannel::feedInputBufferIfAvailableInternal() {
+    submitPendingWork();
     if (mInputMetEos) {
         return;
     }
@@ -1282,8 +1326,9 @@ status_t CCodecBufferChannel::start(
     uint32_t pipelineDelayValue = pipelineDelay ? pipelineDelay.value : 0;
     uint32_t outputDelayValue = outputDelay ? outputDelay.value : 0;
 
-    size_t numInputSlots = inputDelayValue + pipelineDelayValue + kSmoothnessFactor;
-    size_t numOutputSlots = outputDelayValue + kSmoothnessFactor;
+    size_t numInputSlots =
+            inputDelayValue + pipelineDelayValue + kSmoothnessFactor + mNumAutotuneSlots;
+    size_t numOutputSlots = outputDelayValue + kSmoothnessFactor + mNumAutotuneSlots;
 
     // TODO: get this from input format
     bool secure = mComponent->getName().find(".secure") != std::string::npos;
@@ -1676,7 +1721,8 @@ status_t CCodecBufferChannel::start(
         watcher->inputDelay(inputDelayValue)
                 .pipelineDelay(pipelineDelayValue)
                 .outputDelay(outputDelayValue)
-                .smoothnessFactor(kSmoothnessFactor);
+                .smoothnessFactor(kSmoothnessFactor)
+                .inputSlots(numInputSlots);
         watcher->flush();
     }
 
@@ -1796,6 +1842,7 @@ status_t CCodecBufferChannel::requestInitialInputBuffers(
 
 void CCodecBufferChannel::stop() {
     mSync.stop();
+    discardPendingWork();
     mFirstValidFrameIndex = mFrameIndex.load(std::memory_order_relaxed);
 }
 
@@ -1852,6 +1899,7 @@ void CCodecBufferChannel::release() {
 
 void CCodecBufferChannel::flush(const std::list<std::unique_ptr<C2Work>> &flushedWork) {
     ALOGV("[%s] flush", mName);
+    discardPendingWork();
     std::list<std::unique_ptr<C2Work>> configs;
     mInput.lock()->lastFlushIndex = mFrameIndex.load(std::memory_order_relaxed);
     {
@@ -1910,6 +1958,9 @@ void CCodecBufferChannel::onWorkDone(
         const C2StreamInitDataInfo::output *initData) {
     if (handleWork(std::move(work), outputFormat, initData)) {
         feedInputBufferIfAvailable();
+    } else {
+        // the pipeline has room now even if no new input can be reported
+        submitPendingWork();
     }
 }
 
@@ -2100,22 +2151,27 @@ bool CCodecBufferChannel::handleWork(
         }
     }
     if (newInputDelay || newPipelineDelay) {
-        Mutexed<Input>::Locked input(mInput);
-        size_t newNumSlots =
-            newInputDelay.value_or(input->inputDelay) +
-            newPipelineDelay.value_or(input->pipelineDelay) +
-            kSmoothnessFactor;
-        if (input->buffers->isArrayMode()) {
-            if (input->numSlots >= newNumSlots) {
-                input->numExtraSlots = 0;
+        size_t numInputSlots = 0;
+        {
+            Mutexed<Input>::Locked input(mInput);
+            size_t newNumSlots =
+                newInputDelay.value_or(input->inputDelay) +
+                newPipelineDelay.value_or(input->pipelineDelay) +
+                kSmoothnessFactor + mNumAutotuneSlots;
+            if (input->buffers->isArrayMode()) {
+                if (input->numSlots >= newNumSlots) {
+                    input->numExtraSlots = 0;
+                } else {
+                    input->numExtraSlots = newNumSlots - input->numSlots;
+                }
+                ALOGV("[%s] onWorkDone: updated number of extra slots to %zu (input array mode)",
+                      mName, input->numExtraSlots);
             } else {
-                input->numExtraSlots = newNumSlots - input->numSlots;
+                input->numSlots = newNumSlots;
             }
-            ALOGV("[%s] onWorkDone: updated number of extra slots to %zu (input array mode)",
-                  mName, input->numExtraSlots);
-        } else {
-            input->numSlots = newNumSlots;
+            numInputSlots = input->numSlots + input->numExtraSlots;
         }
+        (void)mPipelineWatcher.lock()->inputSlots(numInputSlots);
     }
     size_t numOutputSlots = 0;
     uint32_t reorderDepth = 0;
@@ -2135,7 +2191,7 @@ bool CCodecBufferChannel::handleWork(
         reorderDepth = output->buffers->getReorderDepth();
         if (newOutputDelay) {
             output->outputDelay = newOutputDelay.value();
-            numOutputSlots = newOutputDelay.value() + kSmoothnessFactor;
+            numOutputSlots = newOutputDelay.value() + kSmoothnessFactor + mNumAutotuneSlots;
             if (output->numSlots < numOutputSlots) {
                 output->numSlots = numOutputSlots;
                 if (output->buffers->isArrayMode()) {
@@ -2428,6 +2484,26 @@ void CCodecBufferChannel::setMetaMode(MetaMode mode) {
     mMetaMode = mode;
 }
 
+void CCodecBufferChannel::setPipelineAutotuneMode(PipelineWatcher::AutotuneMode mode) {
+    ALOGV("[%s] pipeline depth autotuning: %s", mName, PipelineWatcher::AsString(mode));
+    // The extra depth needs buffers to fill it; takes effect on the next start().
+    mNumAutotuneSlots = (mode == PipelineWatcher::AUTOTUNE_THROUGHPUT)
+            ? PipelineWatcher::kAutotuneMaxExtraDepth : 0u;
+    mPipelineWatcher.lock()->autotuneMode(mode);
+}
+
+uint32_t CCodecBufferChannel::getPipelineDepth(const char **reason) {
+    Mutexed<PipelineWatcher>::Locked watcher(mPipelineWatcher);
+    if (reason) {
+        *reason = watcher->depthReason();
+    }
+    return watcher->depth();
+}
+
+std::string CCodecBufferChannel::getWorkBatchSizeStats() {
+    return mPipelineWatcher.lock()->batchSizeStats();
+}
+
 void CCodecBufferChannel::setCrypto(const sp<ICrypto> &crypto) {
     if (mCrypto != nullptr) {
         for (std::pair<wp<HidlMemory>, int32_t> entry : mHeapSeqNumMap) {
@@ -36,6 +36,7 @@
 #include "FrameReassembler.h"
 #include "InputSurfaceWrapper.h"
 #include "PipelineWatcher.h"
+#include "WorkBatcher.h"
 
 namespace android {
 
@@ -208,6 +209,25 @@ public:
 
     void setMetaMode(MetaMode mode);
 
+    /**
+     * Select how the pipeline depth is tuned at runtime.
+     */
+    void setPipelineAutotuneMode(PipelineWatcher::AutotuneMode mode);
+
+    /**
+     * Get the current pipeline depth.
+     *
+     * @param reason  set to a static string explaining the current depth.
+     * @return the number of work items the pipeline currently accepts.
+     */
+    uint32_t getPipelineDepth(const char **reason);
+
+    /**
+     * @return the number of work items submitted to the component together,
+     *         as a histogram of batch sizes since the codec was created.
+     */
+    std::string getWorkBatchSizeStats();
+
     /**
      * get pixel format from output buffers.
      *
@@ -292,6 +312,14 @@ private:
     status_t queueInputBufferInternal(sp<MediaCodecBuffer> buffer,
                                       std::shared_ptr<C2LinearBlock> encryptedBlock = nullptr,
                                       size_t blockSize = 0);
+    // Submits |items| to the component, together with any held work. If the
+    // component is behind and |submitNow| is false, holds them instead.
+    c2_status_t queueWork(std::list<std::unique_ptr<C2Work>> *items, bool submitNow);
+    // Submits held work once the component has caught up, or right away if
+    // |submitNow| is true.
+    void submitPendingWork();
+    c2_status_t submitPendingWork(bool submitNow);
+    void discardPendingWork();
     bool handleWork(
             std::unique_ptr<C2Work> work, const sp<AMessage> &outputFormat,
             const C2StreamInitDataInfo::output *initData);
@@ -343,6 +371,10 @@ private:
     };
     Mutexed<Output> mOutput;
     Mutexed<std::list<std::unique_ptr<C2Work>>> mFlushedConfigs;
+    // work items held back while the component is behind
+    Mutexed<WorkBatcher> mPendingWork;
+    // held while submitting work to the component
+    std::mutex mQueueLock;
 
     std::atomic_uint64_t mFrameIndex;
     std::atomic_uint64_t mFirstValidFrameIndex;
@@ -362,6 +394,8 @@ private:
     };
     Mutexed<OutputSurface> mOutputSurface;
     int mRenderingDepth;
+    // slots added on both ports so that the autotuner can deepen the pipeline
+    uint32_t mNumAutotuneSlots;
 
     struct BlockPools {
         C2Allocator::id_t inputAllocatorId;
@@ -17,6 +17,7 @@
 //#define LOG_NDEBUG 0
 #define LOG_TAG "PipelineWatcher"
 
+#include <algorithm>
 #include <numeric>
 
 #include <log/log.h>
@@ -45,6 +46,35 @@ PipelineWatcher &PipelineWatcher::smoothnessFactor(uint32_t value) {
     return *this;
 }
 
+PipelineWatcher &PipelineWatcher::inputSlots(uint32_t value) {
+    mInputSlots = value;
+    mDepthAdjustment = std::min(mDepthAdjustment, maxDepthAdjustment());
+    return *this;
+}
+
+PipelineWatcher &PipelineWatcher::autotuneMode(AutotuneMode mode) {
+    mAutotuneMode = mode;
+    mDepthAdjustment = 0;
+    mLastStep = 0;
+    mLastThroughput = 0.0;
+    mLastLatencyMs = 0.0;
+    mBestThroughput = 0.0;
+    mDepthSettled = false;
+    mDepthReason = (mode == AUTOTUNE_OFF) ? "static" : "probing";
+    resetWindow();
+    return *this;
+}
+
+// static
+const char *PipelineWatcher::AsString(AutotuneMode mode) {
+    switch (mode) {
+        case AUTOTUNE_OFF:          return "off";
+        case AUTOTUNE_THROUGHPUT:   return "throughput";
+        case AUTOTUNE_LATENCY:      return "latency";
+        default:                    return "unknown";
+    }
+}
+
 void PipelineWatcher::onWorkQueued(
         uint64_t frameIndex,
         std::vector<std::shared_ptr<C2Buffer>> &&buffers,
@@ -84,6 +114,10 @@ std::shared_ptr<C2Buffer> PipelineWatcher::onInputBufferReleased(
 }
 
 void PipelineWatcher::onWorkDone(uint64_t frameIndex) {
+    onWorkDone(frameIndex, Clock::now());
+}
+
+void PipelineWatcher::onWorkDone(uint64_t frameIndex, const Clock::time_point &doneAt) {
     ALOGV("onWorkDone(frameIndex=%llu)", (unsigned long long)frameIndex);
     auto it = mFramesInPipeline.find(frameIndex);
     if (it == mFramesInPipeline.end()) {
@@ -91,17 +125,156 @@ void PipelineWatcher::onWorkDone(uint64_t frameIndex) {
               (unsigned long long)frameIndex);
         return;
     }
+    if (mAutotuneMode != AUTOTUNE_OFF) {
+        if (mFramesInPipeline.size() >= depth()) {
+            ++mWindowFullFrames;
+        }
+        if (mWindowStart == Clock::time_point()) {
+            // The first completion only opens the measurement window.
+            mWindowStart = doneAt;
+        } else {
+            ++mWindowFrames;
+            mWindowLatency += doneAt - it->second.queuedAt;
+        }
+    }
     (void)mFramesInPipeline.erase(it);
+    if (mWindowFrames >= kAutotuneWindowFrames) {
+        onWindowComplete(doneAt);
+    }
+}
+
+void PipelineWatcher::resetWindow() {
+    mWindowFrames = 0;
+    mWindowFullFrames = 0;
+    mWindowStart = Clock::time_point();
+    mWindowLatency = Clock::duration::zero();
+}
+
+bool PipelineWatcher::adjustDepth(int32_t step) {
+    // Never go below the delays the component needs to make progress, and
+    // always keep at least one work item in flight.
+    int32_t minAdjustment = -int32_t(mSmoothnessFactor);
+    if (mInputDelay + mPipelineDelay + mOutputDelay == 0) {
+        minAdjustment = std::min(minAdjustment + 1, 0);
+    }
+    int32_t adjustment = std::clamp(
+            mDepthAdjustment + step, minAdjustment, maxDepthAdjustment());
+    if (adjustment == mDepthAdjustment) {
+        return false;
+    }
+    mDepthAdjustment = adjustment;
+    return true;
+}
+
+int32_t PipelineWatcher::maxDepthAdjustment() const {
+    // Work items beyond the input slots could never be queued.
+    int64_t freeSlots = int64_t(mInputSlots) - mInputDelay - mPipelineDelay - mSmoothnessFactor;
+    return int32_t(std::clamp(freeSlots, int64_t(0), int64_t(kAutotuneMaxExtraDepth)));
+}
+
+void PipelineWatcher::onWindowComplete(const Clock::time_point &now) {
+    using std::chrono::duration_cast;
+    using std::chrono::duration;
+    double seconds = duration_cast<duration<double>>(now - mWindowStart).count();
+    double latencyMs = duration_cast<duration<double, std::milli>>(mWindowLatency).count()
+            / mWindowFrames;
+    // whether the depth limit, rather than the input rate, bounded the pipeline
+    bool depthBound = mWindowFullFrames * 2 > mWindowFrames;
+    double throughput = seconds > 0 ? mWindowFrames / seconds : 0.0;
+    int32_t step = 0;
+
+    if (mAutotuneMode == AUTOTUNE_THROUGHPUT) {
+        // Hill-climb: keep moving in the same direction while throughput
+        // improves, undo the last step once it stops paying off.
+        if (mLastThroughput <= 0.0) {
+            step = depthBound ? 1 : 0;
+            mDepthReason = depthBound ? "probing" : "input bound";
+        } else if (throughput > mLastThroughput * 1.02) {
+            step = depthBound ? (mLastStep != 0 ? mLastStep : 1) : 0;
+            mDepthReason = "throughput improved";
+        } else if (throughput < mLastThroughput * 0.98 && mLastStep != 0) {
+            (void)adjustDepth(-mLastStep);
+            mDepthSettled = true;
+            mDepthReason = "throughput dropped";
+        } else {
+            mDepthReason = depthBound ? "throughput stable" : "input bound";
+        }
+    } else if (mAutotuneMode == AUTOTUNE_LATENCY) {
+        // Shrink while work items queue up at the component, but give depth
+        // back as soon as the component can no longer keep up with the input.
+        mBestThroughput = std::max(mBestThroughput, throughput);
+        if (depthBound && throughput < mBestThroughput * 0.9) {
+            step = 1;
+            mBestThroughput = throughput;
+            mDepthSettled = true;
+            mDepthReason = "throughput below target";
+        } else if (mLastStep < 0 && latencyMs >= mLastLatencyMs * 0.98) {
+            (void)adjustDepth(-mLastStep);
+            mDepthSettled = true;
+            mDepthReason = "no latency gain";
+        } else if (depthBound && !mDepthSettled) {
+            step = -1;
+            mDepthReason = "reducing latency";
+        } else {
+            mDepthReason = "latency stable";
+        }
+    }
+
+    if (step != 0 && !adjustDepth(step)) {
+        step = 0;
+        mDepthReason = (mAutotuneMode == AUTOTUNE_LATENCY) ? "minimum depth" : "maximum depth";
+    }
+    ALOGV("autotune(%s): %.1f fps, %.2f ms latency, %u/%u full, depth %u (%s)",
+          AsString(mAutotuneMode), throughput, latencyMs, mWindowFullFrames, mWindowFrames,
+          depth(), mDepthReason);
+    mLastStep = step;
+    mLastThroughput = throughput;
+    mLastLatencyMs = latencyMs;
+    resetWindow();
+    mWindowStart = now;
+}
+
+void PipelineWatcher::onWorkBatchQueued(size_t numWorks) {
+    if (numWorks == 0) {
+        return;
+    }
+    size_t bucket = 0;
+    for (size_t limit = 1; bucket + 1 < kNumBatchSizeBuckets && numWorks > limit; limit *= 2) {
+        ++bucket;
+    }
+    ++mBatchSizeCounts[bucket];
+}
+
+std::string PipelineWatcher::batchSizeStats() const {
+    static const char *kBucketNames[kNumBatchSizeBuckets] = { "1", "2", "3-4", "5-8", ">8" };
+    std::string stats;
+    for (size_t i = 0; i < kNumBatchSizeBuckets; ++i) {
+        stats += (i == 0 ? "" : ", ");
+        stats += kBucketNames[i];
+        stats += ": ";
+        stats += std::to_string(mBatchSizeCounts[i]);
+    }
+    return stats;
 }
 
 void PipelineWatcher::flush() {
     ALOGV("flush");
     mFramesInPipeline.clear();
+    // keep the learned depth; only the measurement in progress is invalid.
+    resetWindow();
+}
+
+uint32_t PipelineWatcher::smoothness() const {
+    return uint32_t(std::max(int32_t(mSmoothnessFactor) + mDepthAdjustment, 0));
+}
+
+uint32_t PipelineWatcher::depth() const {
+    return mInputDelay + mPipelineDelay + mOutputDelay + smoothness();
 }
 
 bool PipelineWatcher::pipelineFull(size_t *pipelineRoom) const {
-    if (mFramesInPipeline.size() >=
-            mInputDelay + mPipelineDelay + mOutputDelay + mSmoothnessFactor) {
+    const uint32_t smoothnessFactor = smoothness();
+    if (mFramesInPipeline.size() >= depth()) {
         ALOGV("pipelineFull: too many frames in pipeline (%zu)", mFramesInPipeline.size());
         return true;
     }
@@ -117,14 +290,14 @@ bool PipelineWatcher::pipelineFull(size_t *pipelineRoom) const {
                 return true;
             });
     if (sizeWithInputReleased >=
-            mPipelineDelay + mOutputDelay + mSmoothnessFactor) {
+            mPipelineDelay + mOutputDelay + smoothnessFactor) {
         ALOGV("pipelineFull: too many frames in pipeline, with input released (%zu)",
               sizeWithInputReleased);
         return true;
     }
 
     size_t sizeWithInputsPending = mFramesInPipeline.size() - sizeWithInputReleased;
-    if (sizeWithInputsPending > mPipelineDelay + mInputDelay + mSmoothnessFactor) {
+    if (sizeWithInputsPending > mPipelineDelay + mInputDelay + smoothnessFactor) {
         ALOGV("pipelineFull: too many inputs pending (%zu) in pipeline, with inputs released (%zu)",
               sizeWithInputsPending, sizeWithInputReleased);
         return true;
@@ -132,8 +305,7 @@ bool PipelineWatcher::pipelineFull(size_t *pipelineRoom) const {
     ALOGV("pipeline has room (total: %zu, input released: %zu)",
           mFramesInPipeline.size(), sizeWithInputReleased);
     if (pipelineRoom) {
-        *pipelineRoom = mInputDelay + mPipelineDelay + mOutputDelay + mSmoothnessFactor
-                                - mFramesInPipeline.size();
+        *pipelineRoom = depth() - mFramesInPipeline.size();
     }
     return false;
 }
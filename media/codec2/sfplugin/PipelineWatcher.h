@@ -17,9 +17,11 @@
 #ifndef PIPELINE_WATCHER_H_
 #define PIPELINE_WATCHER_H_
 
+#include <array>
 #include <chrono>
 #include <map>
 #include <memory>
+#include <string>
 
 #include <C2Work.h>
 
@@ -33,11 +35,51 @@ class PipelineWatcher {
 public:
     typedef std::chrono::steady_clock Clock;
 
+    /**
+     * Depth autotuning modes.
+     *
+     * AUTOTUNE_OFF         the pipeline depth follows the delays reported by
+     *                      the component plus the smoothness factor.
+     * AUTOTUNE_THROUGHPUT  the depth is grown while doing so increases the
+     *                      measured throughput, e.g. for transcoding.
+     * AUTOTUNE_LATENCY     the depth is shrunk as long as the throughput
+     *                      holds, e.g. for real-time communication.
+     */
+    enum AutotuneMode {
+        AUTOTUNE_OFF,
+        AUTOTUNE_THROUGHPUT,
+        AUTOTUNE_LATENCY,
+    };
+
+    /**
+     * Number of completed work items between two depth adjustments.
+     */
+    static constexpr uint32_t kAutotuneWindowFrames = 30;
+
+    /**
+     * Maximum number of work items the autotuner may add on top of the
+     * nominal depth.
+     */
+    static constexpr uint32_t kAutotuneMaxExtraDepth = 4;
+
     PipelineWatcher()
         : mInputDelay(0),
           mPipelineDelay(0),
           mOutputDelay(0),
-          mSmoothnessFactor(0) {}
+          mSmoothnessFactor(0),
+          mInputSlots(UINT32_MAX),
+          mBatchSizeCounts{},
+          mAutotuneMode(AUTOTUNE_OFF),
+          mDepthAdjustment(0),
+          mLastStep(0),
+          mWindowFrames(0),
+          mWindowFullFrames(0),
+          mWindowLatency(Clock::duration::zero()),
+          mLastThroughput(0.0),
+          mLastLatencyMs(0.0),
+          mDepthSettled(false),
+          mBestThroughput(0.0),
+          mDepthReason("static") {}
     ~PipelineWatcher() = default;
 
     /**
@@ -64,6 +106,23 @@ public:
      */
     PipelineWatcher &smoothnessFactor(uint32_t value);
 
+    /**
+     * The autotuner never adds more depth than the client has input slots
+     * to fill. No limit by default.
+     *
+     * \param value the number of input buffer slots of the client
+     * \return  this object
+     */
+    PipelineWatcher &inputSlots(uint32_t value);
+
+    /**
+     * Select the depth autotuning mode. Any previous adjustment is dropped.
+     *
+     * \param mode the new autotuning mode
+     * \return  this object
+     */
+    PipelineWatcher &autotuneMode(AutotuneMode mode);
+
     /**
      * Client queued a work item to the component.
      *
@@ -94,11 +153,49 @@ public:
      */
     void onWorkDone(uint64_t frameIndex);
 
+    /**
+     * The component finished processing a work item.
+     *
+     * \param frameIndex  input frame index
+     * \param doneAt      time when the work item was returned
+     */
+    void onWorkDone(uint64_t frameIndex, const Clock::time_point &doneAt);
+
+    /**
+     * Client submitted work items to the component in a single call.
+     *
+     * \param numWorks  number of work items submitted together
+     */
+    void onWorkBatchQueued(size_t numWorks);
+
     /**
      * Flush the pipeline.
      */
     void flush();
 
+    /**
+     * \return number of work items queued and not yet done.
+     */
+    size_t numFramesInPipeline() const { return mFramesInPipeline.size(); }
+
+    /**
+     * Batch sizes are counted in buckets of 1, 2, 3-4, 5-8 and more than 8
+     * work items.
+     */
+    static constexpr size_t kNumBatchSizeBuckets = 5;
+
+    /**
+     * \return number of submissions in each batch size bucket since creation.
+     */
+    const std::array<uint64_t, kNumBatchSizeBuckets> &batchSizeCounts() const {
+        return mBatchSizeCounts;
+    }
+
+    /**
+     * \return the batch size distribution as a human readable string.
+     */
+    std::string batchSizeStats() const;
+
     /**
      * \param   pipelineRoom   additional work items that pipeline can take
      *                         before getting full.
@@ -108,6 +205,23 @@ public:
      */
     bool pipelineFull(size_t *pipelineRoom = nullptr) const;
 
+    /**
+     * \return the number of work items the pipeline currently accepts,
+     *          including any adjustment made by the autotuner.
+     */
+    uint32_t depth() const;
+
+    /**
+     * \return a short static string describing why the pipeline has its
+     *          current depth.
+     */
+    const char *depthReason() const { return mDepthReason; }
+
+    /**
+     * \return name of the autotuning mode.
+     */
+    static const char *AsString(AutotuneMode mode);
+
     /**
      * Return elapsed processing time of a work item, nth from the longest
      * processing time to the shortest.
@@ -124,6 +238,7 @@ private:
     uint32_t mPipelineDelay;
     uint32_t mOutputDelay;
     uint32_t mSmoothnessFactor;
+    uint32_t mInputSlots;
 
     struct Frame {
         Frame(std::vector<std::shared_ptr<C2Buffer>> &&b,
@@ -134,6 +249,32 @@ private:
         const Clock::time_point queuedAt;
     };
     std::map<uint64_t, Frame> mFramesInPipeline;
+
+    std::array<uint64_t, kNumBatchSizeBuckets> mBatchSizeCounts;
+
+    AutotuneMode mAutotuneMode;
+    // Adjustment applied to the smoothness factor; never shrinks the pipeline
+    // below the delays required by the component.
+    int32_t mDepthAdjustment;
+    // Last adjustment step taken in throughput mode (-1, 0 or 1).
+    int32_t mLastStep;
+    uint32_t mWindowFrames;
+    // completions seen while the pipeline was at its depth limit
+    uint32_t mWindowFullFrames;
+    Clock::time_point mWindowStart;
+    Clock::duration mWindowLatency;
+    double mLastThroughput;
+    double mLastLatencyMs;
+    // set once a step had to be undone; the depth is then held
+    bool mDepthSettled;
+    double mBestThroughput;
+    const char *mDepthReason;
+
+    uint32_t smoothness() const;
+    int32_t maxDepthAdjustment() const;
+    void resetWindow();
+    bool adjustDepth(int32_t step);
+    void onWindowComplete(const Clock::time_point &now);
 };
 
 }  // namespace android
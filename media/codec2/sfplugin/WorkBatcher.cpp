@@ -0,0 +1,60 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "WorkBatcher"
+
+#include <log/log.h>
+
+#include "WorkBatcher.h"
+
+namespace android {
+
+void WorkBatcher::add(std::list<std::unique_ptr<C2Work>> *items) {
+    for (const std::unique_ptr<C2Work> &work : *items) {
+        // flush() must see codec config, and the component must see EOS to drain
+        if (work->input.flags & (C2FrameData::FLAG_CODEC_CONFIG
+                                 | C2FrameData::FLAG_END_OF_STREAM)) {
+            mSubmitNow = true;
+        }
+    }
+    mHeld.splice(mHeld.end(), *items);
+}
+
+std::list<std::unique_ptr<C2Work>> WorkBatcher::takeBatch(
+        const PipelineWatcher &watcher, bool submitNow) {
+    std::list<std::unique_ptr<C2Work>> batch;
+    if (mHeld.empty()) {
+        return batch;
+    }
+    // Held work is not counted in the pipeline, so it is full only if the
+    // submitted work alone keeps the component busy.
+    if (!submitNow && !mSubmitNow && mHeld.size() < kMaxBatchSize
+            && watcher.numFramesInPipeline() > 0 && watcher.pipelineFull()) {
+        ALOGV("component is behind; holding %zu work items", mHeld.size());
+        return batch;
+    }
+    batch.swap(mHeld);
+    mSubmitNow = false;
+    return batch;
+}
+
+void WorkBatcher::discard() {
+    mHeld.clear();
+    mSubmitNow = false;
+}
+
+}  // namespace android
@@ -0,0 +1,84 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WORK_BATCHER_H_
+#define WORK_BATCHER_H_
+
+#include <list>
+#include <memory>
+
+#include <C2Work.h>
+
+#include "PipelineWatcher.h"
+
+namespace android {
+
+/**
+ * Holds work items back while the component is behind, so that they can be
+ * submitted together in a single queue() call once it catches up.
+ */
+class WorkBatcher {
+public:
+    /**
+     * Held work is submitted once this many work items are held, even if the
+     * component is still behind.
+     */
+    static constexpr size_t kMaxBatchSize = 8;
+
+    WorkBatcher() : mSubmitNow(false) {}
+    ~WorkBatcher() = default;
+
+    /**
+     * Client queued work items. They are held after any work already held.
+     * Codec config and end of stream work is never held, and neither is the
+     * work held before it.
+     *
+     * \param items work items to add; emptied by this call
+     */
+    void add(std::list<std::unique_ptr<C2Work>> *items);
+
+    /**
+     * Take the work items to submit to the component now, in queueing order.
+     * That is all the held work, unless the component is behind: the watcher
+     * has work in the pipeline and is full, fewer than kMaxBatchSize items
+     * are held, and none of them must be submitted right away. The held work
+     * is then taken by a later call, e.g. once a work item is done.
+     *
+     * \param watcher   the pipeline watcher of the submitted work
+     * \param submitNow take the held work even if the component is behind
+     * \return the work items to submit; empty to keep holding
+     */
+    std::list<std::unique_ptr<C2Work>> takeBatch(const PipelineWatcher &watcher, bool submitNow);
+
+    /**
+     * Drop the held work, e.g. on flush or stop.
+     */
+    void discard();
+
+    /**
+     * \return number of work items held.
+     */
+    size_t size() const { return mHeld.size(); }
+
+private:
+    std::list<std::unique_ptr<C2Work>> mHeld;
+    // held work includes codec config or end of stream
+    bool mSubmitNow;
+};
+
+}  // namespace android
+
+#endif  // WORK_BATCHER_H_
@@ -112,6 +112,7 @@ private:
     void stop(bool pushBlankBuffer);
     void flush();
     void release(bool sendCallback, bool pushBlankBuffer);
+    void reportWorkBatchSizes();
 
     /**
      * Creates an input surface for the current device configuration compatible with CCodec.
@@ -206,6 +207,9 @@ private:
     Mutexed<std::list<std::unique_ptr<C2Work>>> mWorkDoneQueue;
 
     sp<AMessage> mMetrics;
+    // last pipeline depth and reason reported to MediaCodec metrics
+    uint32_t mReportedPipelineDepth;
+    const char *mReportedPipelineDepthReason;
 
     friend class CCodecCallbackImpl;
 
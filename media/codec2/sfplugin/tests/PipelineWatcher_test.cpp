@@ -0,0 +1,153 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "PipelineWatcher.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+namespace android {
+
+using namespace std::chrono_literals;
+
+class PipelineWatcherTest : public ::testing::Test {
+protected:
+    static constexpr uint32_t kSmoothnessFactor = 4;
+
+    /**
+     * Simulate a component that processes up to |parallelism| work items at a
+     * time, each taking |serviceTime|, fed by a client that keeps the pipeline
+     * as full as the watcher and its |numSlots| input slots allow. The
+     * component holds on to the input buffer until the work is done.
+     */
+    void run(PipelineWatcher &watcher, size_t numSlots, size_t parallelism,
+             PipelineWatcher::Clock::duration serviceTime, size_t numFrames) {
+        watcher.inputSlots(numSlots);
+        PipelineWatcher::Clock::time_point now = PipelineWatcher::Clock::now();
+        std::vector<PipelineWatcher::Clock::time_point> freeAt(parallelism, now);
+        std::deque<std::pair<uint64_t, PipelineWatcher::Clock::time_point>> inFlight;
+        uint64_t frameIndex = 0;
+        for (size_t done = 0; done < numFrames; ++done) {
+            while (inFlight.size() < numSlots && !watcher.pipelineFull()) {
+                auto server = std::min_element(freeAt.begin(), freeAt.end());
+                *server = std::max(*server, now) + serviceTime;
+                inFlight.emplace_back(frameIndex, *server);
+                watcher.onWorkQueued(frameIndex++, {}, now);
+            }
+            ASSERT_FALSE(inFlight.empty());
+            now = std::max(now, inFlight.front().second);
+            watcher.onWorkDone(inFlight.front().first, now);
+            inFlight.pop_front();
+        }
+    }
+};
+
+TEST_F(PipelineWatcherTest, StaticDepth) {
+    PipelineWatcher watcher;
+    watcher.inputDelay(1).pipelineDelay(2).outputDelay(3).smoothnessFactor(kSmoothnessFactor);
+    EXPECT_EQ(10u, watcher.depth());
+    run(watcher, 7, 16, 10ms, 300);
+    EXPECT_EQ(10u, watcher.depth());
+    EXPECT_STREQ("static", watcher.depthReason());
+}
+
+TEST_F(PipelineWatcherTest, ThroughputModeGrowsDepth) {
+    PipelineWatcher watcher;
+    watcher.smoothnessFactor(kSmoothnessFactor)
+            .autotuneMode(PipelineWatcher::AUTOTUNE_THROUGHPUT);
+    EXPECT_EQ(kSmoothnessFactor, watcher.depth());
+    // The component could take more work items than the nominal depth, and
+    // the client has the extra slots to give it.
+    run(watcher, kSmoothnessFactor + PipelineWatcher::kAutotuneMaxExtraDepth,
+        kSmoothnessFactor + 2, 10ms, 600);
+    EXPECT_GT(watcher.depth(), kSmoothnessFactor);
+    EXPECT_LE(watcher.depth(), kSmoothnessFactor + PipelineWatcher::kAutotuneMaxExtraDepth);
+}
+
+TEST_F(PipelineWatcherTest, ThroughputModeStopsAtSlotLimit) {
+    PipelineWatcher watcher;
+    watcher.pipelineDelay(1).smoothnessFactor(kSmoothnessFactor)
+            .autotuneMode(PipelineWatcher::AUTOTUNE_THROUGHPUT);
+    // One input slot to spare; more depth could not be filled.
+    run(watcher, 1 + kSmoothnessFactor + 1, 16, 10ms, 600);
+    EXPECT_EQ(1 + kSmoothnessFactor + 1, watcher.depth());
+}
+
+TEST_F(PipelineWatcherTest, ThroughputModeWithoutFreeSlots) {
+    PipelineWatcher watcher;
+    watcher.smoothnessFactor(kSmoothnessFactor)
+            .autotuneMode(PipelineWatcher::AUTOTUNE_THROUGHPUT);
+    run(watcher, kSmoothnessFactor, 16, 10ms, 300);
+    EXPECT_EQ(kSmoothnessFactor, watcher.depth());
+}
+
+TEST_F(PipelineWatcherTest, SlotLimitCapsLearnedDepth) {
+    PipelineWatcher watcher;
+    watcher.smoothnessFactor(kSmoothnessFactor)
+            .autotuneMode(PipelineWatcher::AUTOTUNE_THROUGHPUT);
+    run(watcher, kSmoothnessFactor + PipelineWatcher::kAutotuneMaxExtraDepth,
+        16, 10ms, 600);
+    ASSERT_GT(watcher.depth(), kSmoothnessFactor + 1);
+    // e.g. the component raised its delays and the slots did not grow as much
+    watcher.inputSlots(kSmoothnessFactor + 1);
+    EXPECT_EQ(kSmoothnessFactor + 1, watcher.depth());
+}
+
+TEST_F(PipelineWatcherTest, LatencyModeShrinksDepth) {
+    PipelineWatcher watcher;
+    watcher.pipelineDelay(1).smoothnessFactor(kSmoothnessFactor)
+            .autotuneMode(PipelineWatcher::AUTOTUNE_LATENCY);
+    // A serial component gains nothing from work items waiting in its queue.
+    run(watcher, 1 + kSmoothnessFactor, 1, 10ms, 600);
+    EXPECT_LT(watcher.depth(), 1 + kSmoothnessFactor);
+    // never below the delay declared by the component
+    EXPECT_GE(watcher.depth(), 1u);
+}
+
+TEST_F(PipelineWatcherTest, AutotuneOffRestoresDepth) {
+    PipelineWatcher watcher;
+    watcher.smoothnessFactor(kSmoothnessFactor)
+            .autotuneMode(PipelineWatcher::AUTOTUNE_LATENCY);
+    run(watcher, kSmoothnessFactor, 1, 10ms, 300);
+    watcher.autotuneMode(PipelineWatcher::AUTOTUNE_OFF);
+    EXPECT_EQ(kSmoothnessFactor, watcher.depth());
+}
+
+TEST_F(PipelineWatcherTest, BatchSizeBuckets) {
+    PipelineWatcher watcher;
+    for (size_t numWorks : {0, 1, 2, 3, 4, 5, 8, 9, 100}) {
+        watcher.onWorkBatchQueued(numWorks);
+    }
+    // an empty batch is not counted
+    const std::array<uint64_t, PipelineWatcher::kNumBatchSizeBuckets> expected = {1, 1, 2, 2, 2};
+    EXPECT_EQ(expected, watcher.batchSizeCounts());
+    EXPECT_EQ("1: 1, 2: 1, 3-4: 2, 5-8: 2, >8: 2", watcher.batchSizeStats());
+}
+
+TEST_F(PipelineWatcherTest, BatchSizesSurviveFlush) {
+    PipelineWatcher watcher;
+    watcher.onWorkBatchQueued(1);
+    watcher.onWorkBatchQueued(6);
+    watcher.flush();
+    watcher.onWorkBatchQueued(6);
+    const std::array<uint64_t, PipelineWatcher::kNumBatchSizeBuckets> expected = {1, 0, 0, 2, 0};
+    EXPECT_EQ(expected, watcher.batchSizeCounts());
+}
+
+} // namespace android
@@ -0,0 +1,161 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "WorkBatcher.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+namespace android {
+
+class WorkBatcherTest : public ::testing::Test {
+protected:
+    static constexpr uint32_t kDepth = 2;
+
+    void SetUp() override {
+        mWatcher.smoothnessFactor(kDepth);
+    }
+
+    // Queue |count| work items to the component, as CCodecBufferChannel does
+    // for each batch it takes.
+    void submit(size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            mWatcher.onWorkQueued(mNextSubmitted++, {}, PipelineWatcher::Clock::now());
+        }
+    }
+
+    // The component is behind: the submitted work alone fills the pipeline.
+    void fillPipeline() {
+        submit(kDepth);
+        ASSERT_TRUE(mWatcher.pipelineFull());
+    }
+
+    void add(uint32_t flags = 0) {
+        std::list<std::unique_ptr<C2Work>> items;
+        items.emplace_back(new C2Work);
+        items.back()->input.ordinal.frameIndex = mNextAdded++;
+        items.back()->input.flags = (C2FrameData::flags_t)flags;
+        mBatcher.add(&items);
+        EXPECT_TRUE(items.empty());
+    }
+
+    std::vector<uint64_t> takeBatch(bool submitNow = false) {
+        std::vector<uint64_t> frameIndices;
+        for (const std::unique_ptr<C2Work> &work : mBatcher.takeBatch(mWatcher, submitNow)) {
+            frameIndices.push_back(work->input.ordinal.frameIndex.peeku());
+        }
+        return frameIndices;
+    }
+
+    PipelineWatcher mWatcher;
+    WorkBatcher mBatcher;
+    uint64_t mNextSubmitted = 1000;
+    uint64_t mNextAdded = 0;
+};
+
+TEST_F(WorkBatcherTest, SubmitsRightAwayWithRoom) {
+    add();
+    EXPECT_EQ(std::vector<uint64_t>({0}), takeBatch());
+    EXPECT_EQ(0u, mBatcher.size());
+    EXPECT_TRUE(takeBatch().empty());
+}
+
+TEST_F(WorkBatcherTest, HoldsWhileComponentIsBehind) {
+    ASSERT_NO_FATAL_FAILURE(fillPipeline());
+    add();
+    EXPECT_TRUE(takeBatch().empty());
+    add();
+    EXPECT_TRUE(takeBatch().empty());
+    EXPECT_EQ(2u, mBatcher.size());
+}
+
+TEST_F(WorkBatcherTest, ReleasesHeldWorkOnCompletion) {
+    ASSERT_NO_FATAL_FAILURE(fillPipeline());
+    add();
+    add();
+    add();
+    ASSERT_TRUE(takeBatch().empty());
+
+    // as from CCodecBufferChannel::onWorkDone()
+    mWatcher.onWorkDone(1000);
+    EXPECT_EQ(std::vector<uint64_t>({0, 1, 2}), takeBatch());
+    EXPECT_EQ(0u, mBatcher.size());
+}
+
+TEST_F(WorkBatcherTest, NeverHoldsEndOfStream) {
+    ASSERT_NO_FATAL_FAILURE(fillPipeline());
+    add();
+    ASSERT_TRUE(takeBatch().empty());
+    add(C2FrameData::FLAG_END_OF_STREAM);
+    // the work held before EOS goes out with it, in order
+    EXPECT_EQ(std::vector<uint64_t>({0, 1}), takeBatch());
+}
+
+TEST_F(WorkBatcherTest, NeverHoldsCodecConfig) {
+    ASSERT_NO_FATAL_FAILURE(fillPipeline());
+    add(C2FrameData::FLAG_CODEC_CONFIG);
+    EXPECT_EQ(std::vector<uint64_t>({0}), takeBatch());
+
+    // only the work that came with the config skipped the hold
+    add();
+    EXPECT_TRUE(takeBatch().empty());
+}
+
+TEST_F(WorkBatcherTest, SubmitNowTakesHeldWork) {
+    ASSERT_NO_FATAL_FAILURE(fillPipeline());
+    add();
+    ASSERT_TRUE(takeBatch().empty());
+    EXPECT_EQ(std::vector<uint64_t>({0}), takeBatch(true /* submitNow */));
+}
+
+TEST_F(WorkBatcherTest, SubmitsFullBatchWhileBehind) {
+    ASSERT_NO_FATAL_FAILURE(fillPipeline());
+    for (size_t i = 0; i + 1 < WorkBatcher::kMaxBatchSize; ++i) {
+        add();
+        ASSERT_TRUE(takeBatch().empty());
+    }
+    add();
+    EXPECT_EQ(WorkBatcher::kMaxBatchSize, takeBatch().size());
+}
+
+TEST_F(WorkBatcherTest, DiscardDropsHeldWork) {
+    ASSERT_NO_FATAL_FAILURE(fillPipeline());
+    add();
+    add();
+    ASSERT_TRUE(takeBatch().empty());
+
+    // as on CCodecBufferChannel::flush() or stop()
+    mBatcher.discard();
+    mWatcher.flush();
+    EXPECT_EQ(0u, mBatcher.size());
+    EXPECT_TRUE(takeBatch().empty());
+
+    // new work after the flush is not mixed with the dropped work
+    add();
+    EXPECT_EQ(std::vector<uint64_t>({2}), takeBatch());
+}
+
+TEST_F(WorkBatcherTest, DiscardForgetsEndOfStream) {
+    ASSERT_NO_FATAL_FAILURE(fillPipeline());
+    add(C2FrameData::FLAG_END_OF_STREAM);
+    mBatcher.discard();
+
+    add();
+    EXPECT_TRUE(takeBatch().empty());
+}
+
+} // namespace android
@@ -21,6 +21,8 @@
 #include <datasource/FileSource.h>
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/FoundationUtils.h>
+#include <media/stagefright/MediaBuffer.h>
+#include <sys/mman.h>
 #include <sys/types.h>
 #include <unistd.h>
 #include <sys/types.h>
@@ -29,6 +31,51 @@
 
 namespace android {
 
+// A read-only mapping of the source's byte range. Shared between the
+// FileSource and every buffer handed out by createMappedBuffer().
+struct FileSource::Mapping : public RefBase {
+    Mapping(void *base, size_t mappedSize, size_t dataOffset)
+        : mBase(base),
+          mMappedSize(mappedSize),
+          mDataOffset(dataOffset) {
+    }
+
+    uint8_t *data() const {
+        return (uint8_t *)mBase + mDataOffset;
+    }
+
+protected:
+    virtual ~Mapping() {
+        if (munmap(mBase, mMappedSize) != 0) {
+            ALOGW("munmap of %zu bytes failed (%s)", mMappedSize, strerror(errno));
+        }
+    }
+
+private:
+    void *mBase;
+    size_t mMappedSize;
+    size_t mDataOffset;
+
+    DISALLOW_EVIL_CONSTRUCTORS(Mapping);
+};
+
+// Keeps the mapping alive for a single mapped MediaBuffer and deletes both
+// once the last local reference to the buffer is released.
+struct FileSource::MappedBufferObserver : public MediaBufferObserver {
+    explicit MappedBufferObserver(const sp<Mapping> &mapping)
+        : mMapping(mapping) {
+    }
+
+    virtual void signalBufferReturned(MediaBufferBase *buffer) {
+        buffer->setObserver(nullptr);
+        buffer->release();
+        delete this;
+    }
+
+private:
+    sp<Mapping> mMapping;
+};
+
 FileSource::FileSource(const char *filename)
     : mFd(-1),
       mOffset(0),
@@ -122,6 +169,12 @@ ssize_t FileSource::readAt(off64_t offset, void *data, size_t size) {
 }
 
 ssize_t FileSource::readAt_l(off64_t offset, void *data, size_t size) {
+    if (mMapping != nullptr) {
+        // readAt() has already clamped the request to [0, mLength).
+        memcpy(data, mMapping->data() + offset, size);
+        return size;
+    }
+
     off64_t result = lseek64(mFd, offset + mOffset, SEEK_SET);
     if (result == -1) {
         ALOGE("seek to %lld failed", (long long)(offset + mOffset));
@@ -143,4 +196,56 @@ status_t FileSource::getSize(off64_t *size) {
     return OK;
 }
 
+status_t FileSource::enableMmap() {
+    Mutex::Autolock autoLock(mLock);
+
+    if (mFd < 0) {
+        return NO_INIT;
+    }
+    if (mMapping != nullptr) {
+        return OK;
+    }
+    if (mLength <= 0) {
+        return ERROR_UNSUPPORTED;
+    }
+
+    long pageSize = sysconf(_SC_PAGESIZE);
+    if (pageSize <= 0) {
+        return UNKNOWN_ERROR;
+    }
+    off64_t mapOffset = mOffset - (mOffset % pageSize);
+    size_t dataOffset = mOffset - mapOffset;
+    if ((uint64_t)mLength > SIZE_MAX - dataOffset) {
+        ALOGW("%s too large to map", mName.c_str());
+        return ERROR_UNSUPPORTED;
+    }
+    size_t mappedSize = dataOffset + mLength;
+
+    void *base = mmap64(nullptr, mappedSize, PROT_READ, MAP_SHARED, mFd, mapOffset);
+    if (base == MAP_FAILED) {
+        ALOGW("mmap of %s failed (%s)", mName.c_str(), strerror(errno));
+        return UNKNOWN_ERROR;
+    }
+    // Extractors mostly walk samples forward; let the kernel read ahead.
+    (void)madvise(base, mappedSize, MADV_SEQUENTIAL);
+
+    mMapping = new Mapping(base, mappedSize, dataOffset);
+    ALOGV("mapped %s (%zu bytes)", mName.c_str(), mappedSize);
+    return OK;
+}
+
+MediaBufferBase *FileSource::createMappedBuffer(off64_t offset, size_t size) {
+    Mutex::Autolock autoLock(mLock);
+
+    if (mMapping == nullptr || offset < 0 || offset >= mLength
+            || (uint64_t)size > (uint64_t)(mLength - offset)) {
+        return nullptr;
+    }
+
+    MediaBuffer *buffer = new MediaBuffer(mMapping->data() + offset, size);
+    buffer->setObserver(new MappedBufferObserver(mMapping));
+    buffer->add_ref();
+    return buffer;
+}
+
 }  // namespace android
@@ -46,6 +46,19 @@ public:
         return mName;
     }
 
+    // Maps the source's byte range read-only into memory. Once mapped, reads
+    // are served from the mapping instead of lseek/read, and
+    // createMappedBuffer() can hand out views into the mapped pages.
+    // Should only be used for files that are not truncated while open, since
+    // touching a page past the new end of file raises SIGBUS.
+    status_t enableMmap();
+
+    // Returns a MediaBuffer referencing the mapped pages of [offset, offset + size)
+    // without copying, or nullptr if enableMmap() has not succeeded or the range
+    // is out of bounds. The mapping stays valid until the last such buffer is
+    // released, even if this FileSource is destroyed first.
+    virtual MediaBufferBase *createMappedBuffer(off64_t offset, size_t size);
+
 protected:
     virtual ~FileSource();
     virtual ssize_t readAt_l(off64_t offset, void *data, size_t size);
@@ -56,7 +69,11 @@ protected:
     Mutex mLock;
 
 private:
+    struct Mapping;
+    struct MappedBufferObserver;
+
     String8 mName;
+    sp<Mapping> mMapping;
 
     FileSource(const FileSource &);
     FileSource &operator=(const FileSource &);
@@ -0,0 +1,181 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// #define LOG_NDEBUG 0
+#define LOG_TAG "FileSource_test"
+#include <utils/Log.h>
+
+#include <gtest/gtest.h>
+
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <android-base/file.h>
+#include <datasource/FileSource.h>
+#include <media/stagefright/JPEGSource.h>
+#include <media/stagefright/MediaBufferBase.h>
+#include <media/stagefright/MetaData.h>
+
+namespace android {
+
+// Spans several pages, so that reads and views cross page boundaries
+static const size_t kFileSize = 3 * 4096 + 123;
+// Not page aligned, so that the mapping has to start before the source's range
+static const off64_t kSourceOffset = 1000;
+
+class FileSourceTest : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        mContents.resize(kFileSize);
+        for (size_t i = 0; i < kFileSize; i++) {
+            mContents[i] = (uint8_t)(i * 7 + i / 256);
+        }
+        ASSERT_TRUE(base::WriteFully(mFile.fd, mContents.data(), mContents.size()));
+    }
+
+    // A source over the file's bytes from kSourceOffset to the end
+    sp<FileSource> createSource() {
+        int fd = open(mFile.path, O_RDONLY);
+        EXPECT_GE(fd, 0);
+        return new FileSource(fd, kSourceOffset, kFileSize - kSourceOffset);
+    }
+
+    const uint8_t *sourceData(off64_t offset) const {
+        return mContents.data() + kSourceOffset + offset;
+    }
+
+    TemporaryFile mFile;
+    std::vector<uint8_t> mContents;
+};
+
+TEST_F(FileSourceTest, MappedReadsMatchFileReads) {
+    sp<FileSource> source = createSource();
+    ASSERT_EQ(OK, source->initCheck());
+    sp<FileSource> mappedSource = createSource();
+    ASSERT_EQ(OK, mappedSource->enableMmap());
+    // Mapping again is a no-op
+    ASSERT_EQ(OK, mappedSource->enableMmap());
+
+    const off64_t length = kFileSize - kSourceOffset;
+    const off64_t offsets[] = {0, 1, 4095, 4096, length - 10, length - 1};
+    for (off64_t offset : offsets) {
+        std::vector<uint8_t> expected(100), actual(100);
+        ssize_t expectedSize = source->readAt(offset, expected.data(), expected.size());
+        ssize_t actualSize = mappedSource->readAt(offset, actual.data(), actual.size());
+        ASSERT_EQ(expectedSize, actualSize) << offset;
+        ASSERT_EQ(std::min<off64_t>(100, length - offset), actualSize) << offset;
+        EXPECT_EQ(0, memcmp(sourceData(offset), actual.data(), actualSize)) << offset;
+    }
+
+    // Reads past the end are clamped the same way
+    uint8_t byte;
+    EXPECT_EQ(0, mappedSource->readAt(length, &byte, 1));
+    EXPECT_EQ(source->readAt(-1, &byte, 1), mappedSource->readAt(-1, &byte, 1));
+}
+
+TEST_F(FileSourceTest, MappedBufferPointsAtFileBytes) {
+    sp<FileSource> source = createSource();
+    const off64_t length = kFileSize - kSourceOffset;
+
+    // No views until the source is mapped
+    EXPECT_EQ(nullptr, source->createMappedBuffer(0, 10));
+    ASSERT_EQ(OK, source->enableMmap());
+
+    MediaBufferBase *buffer = source->createMappedBuffer(4000, 500);
+    ASSERT_NE(nullptr, buffer);
+    EXPECT_EQ(500u, buffer->range_length());
+    EXPECT_EQ(0, memcmp(sourceData(4000), buffer->data(), 500));
+    buffer->release();
+
+    // The whole range can be viewed, but nothing past it
+    buffer = source->createMappedBuffer(0, length);
+    ASSERT_NE(nullptr, buffer);
+    EXPECT_EQ(0, memcmp(sourceData(0), buffer->data(), length));
+    buffer->release();
+    EXPECT_EQ(nullptr, source->createMappedBuffer(0, length + 1));
+    EXPECT_EQ(nullptr, source->createMappedBuffer(length, 1));
+    EXPECT_EQ(nullptr, source->createMappedBuffer(-1, 1));
+}
+
+TEST_F(FileSourceTest, MappedBufferOutlivesSource) {
+    sp<FileSource> source = createSource();
+    ASSERT_EQ(OK, source->enableMmap());
+    MediaBufferBase *first = source->createMappedBuffer(0, 100);
+    MediaBufferBase *second = source->createMappedBuffer(8000, 100);
+    ASSERT_NE(nullptr, first);
+    ASSERT_NE(nullptr, second);
+
+    // The views keep the pages mapped after the source and its file are gone
+    source.clear();
+    EXPECT_EQ(0, memcmp(sourceData(0), first->data(), 100));
+    first->release();
+    EXPECT_EQ(0, memcmp(sourceData(8000), second->data(), 100));
+    second->release();
+}
+
+// Baseline JPEG of 32x16 with a stub scan
+static const uint8_t kJpeg[] = {
+    0xff, 0xd8,
+    0xff, 0xc0, 0x00, 0x0b, 0x08, 0x00, 0x10, 0x00, 0x20, 0x01, 0x01, 0x11, 0x00,
+    0xff, 0xda, 0x00, 0x08, 0x01, 0x01, 0x00, 0x00, 0x3f, 0x00,
+    0x12, 0x34, 0x56, 0x78,
+    0xff, 0xd9,
+};
+
+TEST(JPEGSourceTest, ReadsMappedImageWithoutCopy) {
+    TemporaryFile file;
+    ASSERT_TRUE(base::WriteFully(file.fd, kJpeg, sizeof(kJpeg)));
+
+    for (bool mapped : {false, true}) {
+        sp<FileSource> source = new FileSource(file.path);
+        ASSERT_EQ(OK, source->initCheck());
+        if (mapped) {
+            ASSERT_EQ(OK, source->enableMmap());
+        }
+        sp<JPEGSource> jpegSource = new JPEGSource(source);
+        int32_t width, height;
+        ASSERT_TRUE(jpegSource->getFormat()->findInt32(kKeyWidth, &width));
+        ASSERT_TRUE(jpegSource->getFormat()->findInt32(kKeyHeight, &height));
+        EXPECT_EQ(32, width);
+        EXPECT_EQ(16, height);
+
+        ASSERT_EQ(OK, jpegSource->start());
+        MediaBufferBase *buffer;
+        ASSERT_EQ(OK, jpegSource->read(&buffer));
+        ASSERT_EQ(sizeof(kJpeg), buffer->range_length());
+        const uint8_t *data = (const uint8_t *)buffer->data() + buffer->range_offset();
+        EXPECT_EQ(0, memcmp(kJpeg, data, sizeof(kJpeg)));
+
+        // A mapped view is the one the source hands out for the same range
+        MediaBufferBase *view = source->createMappedBuffer(0, sizeof(kJpeg));
+        EXPECT_EQ(mapped, view != nullptr);
+        if (view != nullptr) {
+            EXPECT_EQ(view->data(), buffer->data());
+            view->release();
+        }
+        buffer->release();
+
+        // The whole image went out in the first buffer
+        EXPECT_NE(OK, jpegSource->read(&buffer));
+        EXPECT_EQ(OK, jpegSource->stop());
+    }
+}
+
+}  // namespace android
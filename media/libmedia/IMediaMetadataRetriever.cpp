@@ -40,6 +40,7 @@ enum {
     GET_FRAME_AT_INDEX,
     EXTRACT_ALBUM_ART,
     EXTRACT_METADATA,
+    GET_SCALED_FRAME_AT_TIME,
 };
 
 class BpMediaMetadataRetriever: public BpInterface<IMediaMetadataRetriever>
@@ -131,6 +132,26 @@ public:
         return interface_cast<IMemory>(reply.readStrongBinder());
     }
 
+    sp<IMemory> getScaledFrameAtTime(
+            int64_t timeUs, int option, int colorFormat, int dstWidth, int dstHeight)
+    {
+        ALOGV("getScaledFrameAtTime: time(%" PRId64 " us), option(%d), colorFormat(%d) "
+                "size(%dx%d)", timeUs, option, colorFormat, dstWidth, dstHeight);
+        Parcel data, reply;
+        data.writeInterfaceToken(IMediaMetadataRetriever::getInterfaceDescriptor());
+        data.writeInt64(timeUs);
+        data.writeInt32(option);
+        data.writeInt32(colorFormat);
+        data.writeInt32(dstWidth);
+        data.writeInt32(dstHeight);
+        remote()->transact(GET_SCALED_FRAME_AT_TIME, data, &reply);
+        status_t ret = reply.readInt32();
+        if (ret != NO_ERROR) {
+            return NULL;
+        }
+        return interface_cast<IMemory>(reply.readStrongBinder());
+    }
+
     sp<IMemory> getImageAtIndex(int index, int colorFormat, bool metaOnly, bool thumbnail)
     {
         ALOGV("getImageAtIndex: index %d, colorFormat(%d) metaOnly(%d) thumbnail(%d)",
@@ -323,6 +344,25 @@ status_t BnMediaMetadataRetriever::onTransact(
             }
             return NO_ERROR;
         } break;
+        case GET_SCALED_FRAME_AT_TIME: {
+            CHECK_INTERFACE(IMediaMetadataRetriever, data, reply);
+            int64_t timeUs = data.readInt64();
+            int option = data.readInt32();
+            int colorFormat = data.readInt32();
+            int dstWidth = data.readInt32();
+            int dstHeight = data.readInt32();
+            ALOGV("getScaledFrameAtTime: time(%" PRId64 " us), option(%d), colorFormat(%d), "
+                    "size(%dx%d)", timeUs, option, colorFormat, dstWidth, dstHeight);
+            sp<IMemory> bitmap = getScaledFrameAtTime(
+                    timeUs, option, colorFormat, dstWidth, dstHeight);
+            if (bitmap != 0) {  // Don't send NULL across the binder interface
+                reply->writeInt32(NO_ERROR);
+                reply->writeStrongBinder(IInterface::asBinder(bitmap));
+            } else {
+                reply->writeInt32(UNKNOWN_ERROR);
+            }
+            return NO_ERROR;
+        } break;
         case GET_IMAGE_AT_INDEX: {
             CHECK_INTERFACE(IMediaMetadataRetriever, data, reply);
             int index = data.readInt32();
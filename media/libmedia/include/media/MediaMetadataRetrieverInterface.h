@@ -45,6 +45,8 @@ public:
     virtual status_t    setDataSource(const sp<DataSource>& source, const char *mime) = 0;
     virtual sp<IMemory> getFrameAtTime(
             int64_t timeUs, int option, int colorFormat, bool metaOnly) = 0;
+    virtual sp<IMemory> getScaledFrameAtTime(
+            int64_t timeUs, int option, int colorFormat, int dstWidth, int dstHeight) = 0;
     virtual sp<IMemory> getImageAtIndex(
             int index, int colorFormat, bool metaOnly, bool thumbnail) = 0;
     virtual sp<IMemory> getImageRectAtIndex(
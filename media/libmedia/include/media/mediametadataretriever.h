@@ -97,6 +97,10 @@ public:
             const sp<IDataSource>& dataSource, const char *mime = NULL);
     sp<IMemory> getFrameAtTime(int64_t timeUs, int option,
             int colorFormat = HAL_PIXEL_FORMAT_RGB_565, bool metaOnly = false);
+    // Like getFrameAtTime(), but the frame is scaled down to fit within
+    // dstWidth x dstHeight, keeping its aspect ratio.
+    sp<IMemory> getScaledFrameAtTime(int64_t timeUs, int option,
+            int colorFormat, int dstWidth, int dstHeight);
     sp<IMemory> getImageAtIndex(int index,
             int colorFormat = HAL_PIXEL_FORMAT_RGB_565, bool metaOnly = false, bool thumbnail = false);
     sp<IMemory> getImageRectAtIndex(
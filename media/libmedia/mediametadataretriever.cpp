@@ -154,6 +154,19 @@ sp<IMemory> MediaMetadataRetriever::getFrameAtTime(
     return mRetriever->getFrameAtTime(timeUs, option, colorFormat, metaOnly);
 }
 
+sp<IMemory> MediaMetadataRetriever::getScaledFrameAtTime(
+        int64_t timeUs, int option, int colorFormat, int dstWidth, int dstHeight)
+{
+    ALOGV("getScaledFrameAtTime: time(%" PRId64 " us) option(%d) colorFormat(%d) size(%dx%d)",
+            timeUs, option, colorFormat, dstWidth, dstHeight);
+    Mutex::Autolock _l(mLock);
+    if (mRetriever == 0) {
+        ALOGE("retriever is not initialized");
+        return NULL;
+    }
+    return mRetriever->getScaledFrameAtTime(timeUs, option, colorFormat, dstWidth, dstHeight);
+}
+
 sp<IMemory> MediaMetadataRetriever::getImageAtIndex(
         int index, int colorFormat, bool metaOnly, bool thumbnail) {
     ALOGV("getImageAtIndex: index(%d) colorFormat(%d) metaOnly(%d) thumbnail(%d)",
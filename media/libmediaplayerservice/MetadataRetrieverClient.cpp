@@ -212,6 +212,26 @@ sp<IMemory> MetadataRetrieverClient::getFrameAtTime(
     return frame;
 }
 
+sp<IMemory> MetadataRetrieverClient::getScaledFrameAtTime(
+        int64_t timeUs, int option, int colorFormat, int dstWidth, int dstHeight)
+{
+    ALOGV("getScaledFrameAtTime: time(%lld us) option(%d) colorFormat(%d), size(%dx%d)",
+            (long long)timeUs, option, colorFormat, dstWidth, dstHeight);
+    Mutex::Autolock lock(mLock);
+    Mutex::Autolock glock(sLock);
+    if (mRetriever == NULL) {
+        ALOGE("retriever is not initialized");
+        return NULL;
+    }
+    sp<IMemory> frame = mRetriever->getScaledFrameAtTime(
+            timeUs, option, colorFormat, dstWidth, dstHeight);
+    if (frame == NULL) {
+        ALOGE("failed to capture a scaled video frame");
+        return NULL;
+    }
+    return frame;
+}
+
 sp<IMemory> MetadataRetrieverClient::getImageAtIndex(
         int index, int colorFormat, bool metaOnly, bool thumbnail) {
     ALOGV("getImageAtIndex: index(%d) colorFormat(%d), metaOnly(%d) thumbnail(%d)",
@@ -367,6 +367,19 @@ sp<IMemory> StagefrightMetadataRetriever::getFrameAtTime(
     return getFrameInternal(timeUs, option, colorFormat, metaOnly);
 }
 
+sp<IMemory> StagefrightMetadataRetriever::getScaledFrameAtTime(
+        int64_t timeUs, int option, int colorFormat, int dstWidth, int dstHeight) {
+    ALOGV("getScaledFrameAtTime: %" PRId64 " us option: %d colorFormat: %d, size: %dx%d",
+            timeUs, option, colorFormat, dstWidth, dstHeight);
+    if (dstWidth <= 0 || dstHeight <= 0) {
+        ALOGE("invalid target size %dx%d", dstWidth, dstHeight);
+        return NULL;
+    }
+
+    return getFrameInternal(
+            timeUs, option, colorFormat, false /*metaOnly*/, dstWidth, dstHeight);
+}
+
 sp<IMemory> StagefrightMetadataRetriever::getFrameAtIndex(
         int frameIndex, int colorFormat, bool metaOnly) {
     ALOGV("getFrameAtIndex: frameIndex %d, colorFormat: %d, metaOnly: %d",
@@ -384,7 +397,8 @@ sp<IMemory> StagefrightMetadataRetriever::getFrameAtIndex(
 }
 
 sp<IMemory> StagefrightMetadataRetriever::getFrameInternal(
-        int64_t timeUs, int option, int colorFormat, bool metaOnly) {
+        int64_t timeUs, int option, int colorFormat, bool metaOnly,
+        int dstWidth, int dstHeight) {
     mDecoder.clear();
     mLastDecodedIndex = -1;
 
@@ -471,6 +485,9 @@ sp<IMemory> StagefrightMetadataRetriever::getFrameInternal(
     for (size_t i = 0; i < matchingCodecs.size(); ++i) {
         const AString &componentName = matchingCodecs[i];
         sp<VideoFrameDecoder> decoder = new VideoFrameDecoder(componentName, trackMeta, source);
+        if (dstWidth > 0 && dstHeight > 0) {
+            decoder->setTargetSize(dstWidth, dstHeight);
+        }
         if (decoder->init(timeUs, option, colorFormat) == OK) {
             sp<IMemory> frame = decoder->extractFrame();
             if (frame != nullptr) {
@@ -43,6 +43,8 @@ struct StagefrightMetadataRetriever : public MediaMetadataRetrieverBase {
 
     virtual sp<IMemory> getFrameAtTime(
             int64_t timeUs, int option, int colorFormat, bool metaOnly);
+    virtual sp<IMemory> getScaledFrameAtTime(
+            int64_t timeUs, int option, int colorFormat, int dstWidth, int dstHeight);
     virtual sp<IMemory> getImageAtIndex(
             int index, int colorFormat, bool metaOnly, bool thumbnail);
     virtual sp<IMemory> getImageRectAtIndex(
@@ -69,7 +71,8 @@ private:
     void clearMetadata();
 
     sp<IMemory> getFrameInternal(
-            int64_t timeUs, int option, int colorFormat, bool metaOnly);
+            int64_t timeUs, int option, int colorFormat, bool metaOnly,
+            int dstWidth = 0, int dstHeight = 0);
 
     sp<IMemory> getImageInternal(
             int index, int colorFormat, bool metaOnly, bool thumbnail, FrameRect* rect);
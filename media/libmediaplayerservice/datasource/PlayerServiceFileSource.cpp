@@ -91,6 +91,17 @@ ssize_t PlayerServiceFileSource::readAt(off64_t offset, void *data, size_t size)
     }
 }
 
+MediaBufferBase *PlayerServiceFileSource::createMappedBuffer(off64_t offset, size_t size) {
+    {
+        Mutex::Autolock autoLock(mLock);
+        if (mDecryptHandle != NULL && DecryptApiType::CONTAINER_BASED
+                == mDecryptHandle->decryptApiType) {
+            return nullptr;
+        }
+    }
+    return FileSource::createMappedBuffer(offset, size);
+}
+
 sp<DecryptHandle> PlayerServiceFileSource::DrmInitialization(const char *mime) {
     if (getuid() == AID_MEDIA_EX) {
        return NULL; // no DRM in media extractor
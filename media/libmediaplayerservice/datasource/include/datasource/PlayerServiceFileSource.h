@@ -37,6 +37,9 @@ public:
 
     virtual ssize_t readAt(off64_t offset, void *data, size_t size);
 
+    // Mapped views would expose encrypted bytes for forward-locked content.
+    virtual MediaBufferBase *createMappedBuffer(off64_t offset, size_t size);
+
     static bool requiresDrm(int fd, int64_t offset, int64_t length, const char *mime);
 
 protected:
@@ -79,6 +79,13 @@ void MetadataRetrieverFuzzer::getData() {
     bool metaOnly = mFdp.ConsumeBool();
     mMdRetriever->getFrameAtTime(timeUs, option, colorFormat, metaOnly);
 
+    timeUs = mFdp.ConsumeIntegral<int64_t>();
+    option = mFdp.ConsumeIntegral<int32_t>();
+    colorFormat = mFdp.ConsumeIntegral<int32_t>();
+    int32_t dstWidth = mFdp.ConsumeIntegral<int32_t>();
+    int32_t dstHeight = mFdp.ConsumeIntegral<int32_t>();
+    mMdRetriever->getScaledFrameAtTime(timeUs, option, colorFormat, dstWidth, dstHeight);
+
     int32_t index = mFdp.ConsumeIntegral<int32_t>();
     colorFormat = mFdp.ConsumeIntegral<int32_t>();
     metaOnly = mFdp.ConsumeBool();
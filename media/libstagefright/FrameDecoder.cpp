@@ -265,6 +265,8 @@ FrameDecoder::FrameDecoder(
       mSource(source),
       mDstFormat(OMX_COLOR_Format16bitRGB565),
       mDstBpp(2),
+      mTargetWidth(0),
+      mTargetHeight(0),
       mHaveMoreInputs(true),
       mFirstSample(true) {
 }
@@ -289,6 +291,54 @@ bool isHDR(const sp<AMessage> &format) {
             transfer == ColorUtils::kColorTransferHLG);
 }
 
+void FrameDecoder::setTargetSize(int32_t maxWidth, int32_t maxHeight) {
+    mTargetWidth = maxWidth;
+    mTargetHeight = maxHeight;
+}
+
+ColorConverter *FrameDecoder::getColorConverter(
+        int32_t srcFormat, const sp<AMessage> &outputFormat) {
+    // The converter caches the source layout of the first frame it converts.
+    if (mConverter == nullptr || mConverterFormat != outputFormat) {
+        mConverter = std::make_unique<ColorConverter>(
+                (OMX_COLOR_FORMATTYPE)srcFormat, dstFormat());
+        mConverter->setNumThreads(ColorConverter::GetDefaultNumThreads());
+        mConverterFormat = outputFormat;
+    }
+    return mConverter.get();
+}
+
+bool FrameDecoder::getScaledSize(int32_t width, int32_t height,
+        int32_t *scaledWidth, int32_t *scaledHeight) const {
+    *scaledWidth = width;
+    *scaledHeight = height;
+    if (mTargetWidth <= 0 || mTargetHeight <= 0 || width <= 0 || height <= 0) {
+        return false;
+    }
+
+    // The target size is for the frame as displayed.
+    int32_t targetWidth = mTargetWidth;
+    int32_t targetHeight = mTargetHeight;
+    int32_t rotationAngle;
+    if (mTrackMeta->findInt32(kKeyRotation, &rotationAngle)
+            && (rotationAngle == 90 || rotationAngle == 270)) {
+        std::swap(targetWidth, targetHeight);
+    }
+    if (width <= targetWidth && height <= targetHeight) {
+        return false;
+    }
+
+    int64_t fitWidth = targetWidth;
+    int64_t fitHeight = (int64_t)height * targetWidth / width;
+    if (fitHeight > targetHeight) {
+        fitHeight = targetHeight;
+        fitWidth = (int64_t)width * targetHeight / height;
+    }
+    *scaledWidth = std::max(fitWidth, (int64_t)1);
+    *scaledHeight = std::max(fitHeight, (int64_t)1);
+    return true;
+}
+
 status_t FrameDecoder::init(
         int64_t frameTimeUs, int option, int colorFormat) {
     if (!getDstColorFormat((android_pixel_format_t)colorFormat,
@@ -664,11 +714,41 @@ status_t VideoFrameDecoder::onOutputReceived(
         bitDepth = 10;
     }
 
+    ColorConverter &converter = *getColorConverter(srcFormat, outputFormat);
+
+    uint32_t standard, range, transfer;
+    if (!outputFormat->findInt32("color-standard", (int32_t*)&standard)) {
+        standard = 0;
+    }
+    if (!outputFormat->findInt32("color-range", (int32_t*)&range)) {
+        range = 0;
+    }
+    if (!outputFormat->findInt32("color-transfer", (int32_t*)&transfer)) {
+        transfer = 0;
+    }
+    sp<ABuffer> imgObj;
+    if (videoFrameBuffer->meta()->findBuffer("image-data", &imgObj)) {
+        MediaImage2 *imageData = nullptr;
+        imageData = (MediaImage2 *)(imgObj.get()->data());
+        if (imageData != nullptr) {
+            converter.setSrcMediaImage2(*imageData);
+        }
+    }
+    converter.setSrcColorSpace(standard, range, transfer);
+
     if (mFrame == NULL) {
+        const int32_t cropWidth = crop_right - crop_left + 1;
+        const int32_t cropHeight = crop_bottom - crop_top + 1;
+        int32_t frameWidth = cropWidth;
+        int32_t frameHeight = cropHeight;
+        // Thumbnails are scaled by the color converter, so a frame captured
+        // from the surface stays at full size.
+        bool scaled = mCaptureLayer == nullptr && converter.isValidForScaling()
+                && getScaledSize(cropWidth, cropHeight, &frameWidth, &frameHeight);
         sp<IMemory> frameMem = allocVideoFrame(
                 trackMeta(),
-                (crop_right - crop_left + 1),
-                (crop_bottom - crop_top + 1),
+                frameWidth,
+                frameHeight,
                 0,
                 0,
                 dstBpp(),
@@ -679,6 +759,12 @@ status_t VideoFrameDecoder::onOutputReceived(
         }
 
         mFrame = static_cast<VideoFrame*>(frameMem->unsecurePointer());
+        if (scaled) {
+            ALOGV("scaling %dx%d frame to %dx%d",
+                    cropWidth, cropHeight, frameWidth, frameHeight);
+            mFrame->mDisplayWidth = (int64_t)mFrame->mDisplayWidth * frameWidth / cropWidth;
+            mFrame->mDisplayHeight = (int64_t)mFrame->mDisplayHeight * frameHeight / cropHeight;
+        }
 
         setFrame(frameMem);
     }
@@ -688,30 +774,9 @@ status_t VideoFrameDecoder::onOutputReceived(
     if (mCaptureLayer != nullptr) {
         return captureSurface();
     }
-    ColorConverter converter((OMX_COLOR_FORMATTYPE)srcFormat, dstFormat());
-
-    uint32_t standard, range, transfer;
-    if (!outputFormat->findInt32("color-standard", (int32_t*)&standard)) {
-        standard = 0;
-    }
-    if (!outputFormat->findInt32("color-range", (int32_t*)&range)) {
-        range = 0;
-    }
-    if (!outputFormat->findInt32("color-transfer", (int32_t*)&transfer)) {
-        transfer = 0;
-    }
-    sp<ABuffer> imgObj;
-    if (videoFrameBuffer->meta()->findBuffer("image-data", &imgObj)) {
-        MediaImage2 *imageData = nullptr;
-        imageData = (MediaImage2 *)(imgObj.get()->data());
-        if (imageData != nullptr) {
-            converter.setSrcMediaImage2(*imageData);
-        }
-    }
     if (srcFormat == COLOR_FormatYUV420Flexible && imgObj.get() == nullptr) {
         return ERROR_UNSUPPORTED;
     }
-    converter.setSrcColorSpace(standard, range, transfer);
     if (converter.isValid()) {
         converter.convert(
                 (const uint8_t *)videoFrameBuffer->data(),
@@ -967,7 +1032,7 @@ status_t MediaImageDecoder::onOutputReceived(
         setFrame(frameMem);
     }
 
-    ColorConverter converter((OMX_COLOR_FORMATTYPE)srcFormat, dstFormat());
+    ColorConverter &converter = *getColorConverter(srcFormat, outputFormat);
 
     uint32_t standard, range, transfer;
     if (!outputFormat->findInt32("color-standard", (int32_t*)&standard)) {
@@ -75,9 +75,8 @@ status_t JPEGSource::start(MetaData *) {
         return UNKNOWN_ERROR;
     }
 
-    mGroup = new MediaBufferGroup;
-    mGroup->add_buffer(new MediaBuffer(mSize));
-
+    // The buffer group is only needed if the source can't hand out mapped views,
+    // see read().
     mOffset = 0;
 
     mStarted = true;
@@ -118,7 +117,18 @@ status_t JPEGSource::read(
         return UNKNOWN_ERROR;
     }
 
-    MediaBufferBase *buffer;
+    // Sources backed by a mapped file hand out the image without copying it.
+    MediaBufferBase *buffer = mSource->createMappedBuffer(mOffset, mSize - mOffset);
+    if (buffer != NULL) {
+        mOffset = mSize;
+        *out = buffer;
+        return OK;
+    }
+
+    if (mGroup == NULL) {
+        mGroup = new MediaBufferGroup;
+        mGroup->add_buffer(new MediaBuffer(mSize));
+    }
     mGroup->acquire_buffer(&buffer);
 
     ssize_t n = mSource->readAt(mOffset, buffer->data(), mSize - mOffset);
@@ -73,6 +73,8 @@ static const int64_t kInitialDelayTimeUs     = 700000LL;
 static const int64_t kMaxMetadataSize = 0x4000000LL;   // 64MB max per-frame metadata size
 static const int64_t kMaxCttsOffsetTimeUs = 30 * 60 * 1000000LL;  // 30 minutes
 static const size_t kESDSScratchBufferSize = 10;  // kMaxAtomSize in Mpeg4Extractor 64MB
+// Fragments a track may buffer while the fragmented moov waits for another track's first one
+static const size_t kMaxFragmentsBeforeMoov = 4;
 
 static const char kMetaKey_Version[]    = "com.android.version";
 static const char kMetaKey_Manufacturer[]      = "com.android.manufacturer";
@@ -165,6 +167,18 @@ public:
     bool isExifData(MediaBufferBase *buffer, uint32_t *tiffHdrOffset) const;
     void addChunkOffset(off64_t offset);
     void addItemOffsetAndSize(off64_t offset, size_t size, bool isExif);
+    int32_t getTimeScale() const { return mTimeScale; }
+    // Duration of the last sample written in a fragment, reused for the last
+    // sample of the next one. Only accessed from the writer thread.
+    int64_t getLastFragmentSampleDurationTicks() const {
+        return mLastFragmentSampleDurationTicks;
+    }
+    void setLastFragmentSampleDurationTicks(int64_t ticks) {
+        mLastFragmentSampleDurationTicks = ticks;
+    }
+    // Takes the config the moov of a fragmented file is written from. Called
+    // from the track thread, with the writer lock held, as it buffers a chunk.
+    void snapshotFragmentedConfig_l();
     void flushItemRefs();
     TrackId& getTrackId() { return mTrackId; }
     status_t dump(int fd, const Vector<String16>& args) const;
@@ -184,7 +198,8 @@ private:
             : mElementCapacity(elementCapacity),
             mTotalNumTableEntries(0),
             mNumValuesInCurrEntry(0),
-            mCurrTableEntriesElement(NULL) {
+            mCurrTableEntriesElement(NULL),
+            mCountOnly(false) {
             CHECK_GT(mElementCapacity, 0u);
             // Ensure no integer overflow on allocation in add().
             CHECK_LT(ENTRY_SIZE, UINT32_MAX / mElementCapacity);
@@ -255,10 +270,25 @@ private:
             }
         }
 
+        // Only keep track of the number of entries from now on; the values
+        // themselves are dropped. Used when the samples are described by track
+        // fragments instead of by this table.
+        void setCountOnly() {
+            CHECK_EQ(mTotalNumTableEntries, 0u);
+            mCountOnly = true;
+        }
+
         // Store a single value.
         // @arg value must be in network byte order.
         void add(const TYPE& value) {
             CHECK_LT(mNumValuesInCurrEntry, mElementCapacity);
+            if (mCountOnly) {
+                if ((++mNumValuesInCurrEntry % ENTRY_SIZE) == 0) {
+                    ++mTotalNumTableEntries;
+                    mNumValuesInCurrEntry = 0;
+                }
+                return;
+            }
             uint32_t nEntries = mTotalNumTableEntries % mElementCapacity;
             uint32_t nValues  = mNumValuesInCurrEntry % ENTRY_SIZE;
             if (nEntries == 0 && nValues == 0) {
@@ -282,6 +312,7 @@ private:
         // 2. followed by the values in the table enties in order
         // @arg writer the writer to actual write to the storage
         void write(MPEG4Writer *writer) const {
+            CHECK(!mCountOnly);
             CHECK_EQ(mNumValuesInCurrEntry % ENTRY_SIZE, 0u);
             uint32_t nEntries = mTotalNumTableEntries;
             writer->writeInt32(nEntries);
@@ -307,6 +338,7 @@ private:
         uint32_t         mNumValuesInCurrEntry;  // up to ENTRY_SIZE
         TYPE             *mCurrTableEntriesElement;
         mutable List<TYPE *>     mTableEntryList;
+        bool             mCountOnly;
 
         DISALLOW_EVIL_CONSTRUCTORS(ListTableEntries);
     };
@@ -356,6 +388,15 @@ private:
     int64_t mMinCttsOffsetTimeUs;
     int64_t mMinCttsOffsetTicks;
     int64_t mMaxCttsOffsetTicks;
+    int64_t mLastFragmentSampleDurationTicks;
+    // What the moov of a fragmented file needs from the track. Codec specific
+    // data arriving after the first frame is ignored, so this is fixed by the
+    // time the first chunk is buffered. The writer thread writes the moov from
+    // it and never reads the sample tables that the track thread updates.
+    struct FragmentedConfig {
+        bool mTaken;
+        bool mHasSampleEntry;  // The codec specific data is complete
+    } mFragmentedConfig;
 
     // Save the last 10 frames' timestamp and frame type for debug.
     struct TimestampDebugHelperEntry {
@@ -493,6 +534,7 @@ private:
     void writeVideoFourCCBox();
     void writeMetadataFourCCBox();
     void writeStblBox();
+    void writeEmptySampleTables();
     void writeEdtsBox();
 
     Track(const Track &);
@@ -536,6 +578,18 @@ void MPEG4Writer::initInternal(int fd, bool isFirstSession) {
     mSendNotify = false;
     mWriteSeekErr = false;
     mFallocateErr = false;
+    mFragmented = false;
+    mFragmentDurationUs = 0;
+    mFragmentedMoovWritten = false;
+    mFragmentSequenceNumber = 0;
+    mIOThreadDone = false;
+    mIOThreadStarted = false;
+    if (isFirstSession) {
+        for (size_t i = 0; i < kMaxWriteBatchesInFlight + 1; i++) {
+            mWriteBatches.emplace_back(new WriteBatch);
+        }
+    }
+    mPendingWrite = NULL;
     // Reset following variables for all the sessions and they will be
     // initialized in start(MetaData *param).
     mIsRealTimeRecording = true;
@@ -947,14 +1001,30 @@ status_t MPEG4Writer::start(MetaData *param) {
     CHECK_GT(mTimeScale, 0);
     ALOGV("movie time scale: %d", mTimeScale);
 
+    int64_t fragmentDurationUs;
+    if (param && param->findInt64(kKeyFragmentDurationUs, &fragmentDurationUs)
+            && fragmentDurationUs > 0) {
+        if (mHasFileLevelMeta) {
+            ALOGW("Fragmented output is not supported for image tracks, ignored");
+        } else {
+            mFragmented = true;
+            mFragmentDurationUs = fragmentDurationUs;
+            ALOGI("Fragmented output, fragment duration %" PRId64 " us", mFragmentDurationUs);
+        }
+    }
+
     /*
      * When the requested file size limit is small, the priority
      * is to meet the file size limit requirement, rather than
      * to make the file streamable. mStreamableFile does not tell
      * whether the actual recorded file is streamable or not.
+     *
+     * A fragmented file is streamable by construction: its moov is
+     * written ahead of the first fragment, so no space is reserved.
      */
     mStreamableFile =
-        (mMaxFileSizeLimitBytes != 0 &&
+        (!mFragmented &&
+         mMaxFileSizeLimitBytes != 0 &&
          mMaxFileSizeLimitBytes >= kMinStreamableFileSizeInBytes);
 
     /*
@@ -1062,7 +1132,9 @@ status_t MPEG4Writer::start(MetaData *param) {
 
     mOffset = mMdatOffset;
     seekOrPostError(mFd, mMdatOffset, SEEK_SET);
-    write("\x00\x00\x00\x01mdat????????", 16);
+    if (!mFragmented) {
+        write("\x00\x00\x00\x01mdat????????", 16);
+    }
 
     /* Confirm whether the writing of the initial file atoms, ftyp and free,
      * are written to the file properly by posting kWhatNoIOErrorSoFar to the
@@ -1124,6 +1196,9 @@ status_t MPEG4Writer::stopWriterThread() {
         err = UNKNOWN_ERROR;
     }
     mWriterThreadStarted = false;
+    // The tracks and the writer thread have stopped queueing; let the last
+    // batches reach the file before the headers get fixed up.
+    stopIOThread();
     return err;
 }
 
@@ -1357,6 +1432,18 @@ status_t MPEG4Writer::reset(bool stopSource, bool waitForAnyPreviousCallToComple
         return mResetStatus;
     }
 
+    if (mFragmented) {
+        // Every fragment is already complete in the file and the moov was
+        // written before the first one, so there is nothing left to patch.
+        mMdatEndOffset = mOffset;
+        status_t errRelease = release();
+        if (err == OK) {
+            err = errRelease;
+        }
+        mResetStatus = err;
+        return mResetStatus;
+    }
+
     // Fix up the size of the 'mdat' chunk.
     seekOrPostError(mFd, mMdatOffset + 8, SEEK_SET);
     uint64_t size = mOffset - mMdatOffset;
@@ -1642,6 +1729,7 @@ off64_t MPEG4Writer::addSample_l(
         ALOGV("mOffset:%lld, mMaxOffsetAppend:%lld, bytesWritten:%lld", (long long)mOffset,
                   (long long)mMaxOffsetAppend, (long long)*bytesWritten);
         mMaxOffsetAppend = std::max(mOffset, mMaxOffsetAppend);
+        flushPendingWrites_l();
         seekOrPostError(mFd, mMaxOffsetAppend, SEEK_SET);
         return offset;
     }
@@ -1653,12 +1741,13 @@ off64_t MPEG4Writer::addSample_l(
     } else {
         if (tiffHdrOffset > 0) {
             tiffHdrOffset = htonl(tiffHdrOffset);
-            writeOrPostError(mFd, &tiffHdrOffset, 4);  // exif_tiff_header_offset field
+            // exif_tiff_header_offset field
+            queuePrefix_l((const uint8_t *)&tiffHdrOffset, 4);
             mOffset += 4;
         }
 
-        writeOrPostError(mFd, (const uint8_t*)buffer->data() + buffer->range_offset(),
-                         buffer->range_length());
+        queueWrite_l((const uint8_t*)buffer->data() + buffer->range_offset(),
+                     buffer->range_length());
 
         mOffset += buffer->range_length();
     }
@@ -1696,6 +1785,7 @@ void MPEG4Writer::addMultipleLengthPrefixedSamples_l(MediaBuffer *buffer) {
     while (getNextNALUnit(&data, &searchSize, &nextNalStart,
             &nextNalSize, true) == OK) {
         size_t currentNalSize = nextNalStart - currentNalStart - 4 /* strip start-code */;
+        // nalBuf only describes a range of buffer, which outlives the pending writes.
         MediaBuffer *nalBuf = new MediaBuffer((void *)currentNalStart, currentNalSize);
         addLengthPrefixedSample_l(nalBuf);
         nalBuf->release();
@@ -1719,8 +1809,8 @@ void MPEG4Writer::addLengthPrefixedSample_l(MediaBuffer *buffer) {
         x[1] = (length >> 16) & 0xff;
         x[2] = (length >> 8) & 0xff;
         x[3] = length & 0xff;
-        writeOrPostError(mFd, &x, 4);
-        writeOrPostError(mFd, (const uint8_t*)buffer->data() + buffer->range_offset(), length);
+        queuePrefix_l(x, 4);
+        queueWrite_l((const uint8_t*)buffer->data() + buffer->range_offset(), length);
         mOffset += length + 4;
     } else {
         ALOGV("mUse2ByteNalLength");
@@ -1729,12 +1819,161 @@ void MPEG4Writer::addLengthPrefixedSample_l(MediaBuffer *buffer) {
         uint8_t x[2];
         x[0] = length >> 8;
         x[1] = length & 0xff;
-        writeOrPostError(mFd, &x, 2);
-        writeOrPostError(mFd, (const uint8_t*)buffer->data() + buffer->range_offset(), length);
+        queuePrefix_l(x, 2);
+        queueWrite_l((const uint8_t*)buffer->data() + buffer->range_offset(), length);
         mOffset += length + 2;
     }
 }
 
+void MPEG4Writer::queuePrefix_l(const uint8_t *prefix, size_t size) {
+    CHECK_LE(size, 4u);
+    if (mPendingWrite->mNumIovecs == WriteBatch::kMaxIovecs) {
+        flushPendingWrites_l();
+    }
+    // Every queued prefix also takes an iovec, so this storage cannot run out
+    // before mIovecs does.
+    uint8_t *dst = mPendingWrite->mPrefixes + mPendingWrite->mPrefixesSize;
+    memcpy(dst, prefix, size);
+    mPendingWrite->mPrefixesSize += size;
+    queueWrite_l(dst, size);
+}
+
+void MPEG4Writer::queueWrite_l(const void *data, size_t size) {
+    if (size == 0) {
+        return;
+    }
+    if (mPendingWrite->mNumIovecs == WriteBatch::kMaxIovecs) {
+        flushPendingWrites_l();
+    }
+    WriteBatch *batch = mPendingWrite;
+    batch->mIovecs[batch->mNumIovecs].iov_base = const_cast<void *>(data);
+    batch->mIovecs[batch->mNumIovecs].iov_len = size;
+    ++batch->mNumIovecs;
+    batch->mBytes += size;
+}
+
+void MPEG4Writer::flushPendingWrites_l(List<MediaBuffer *> *samples) {
+    WriteBatch *batch = mPendingWrite;
+    if (samples != NULL) {
+        while (!samples->empty()) {
+            batch->mSamples.push_back(*samples->begin());
+            samples->erase(samples->begin());
+        }
+    }
+    if (batch->mNumIovecs == 0 && batch->mSamples.empty()) {
+        return;
+    }
+
+    // The batch is written at an explicit offset. Move the file position past
+    // it right away, so that the writes after it land where they would have if
+    // it had been written synchronously.
+    batch->mFd = mFd;
+    if (batch->mBytes > 0 && !mWriteSeekErr) {
+        off64_t endOffset = lseek64(mFd, batch->mBytes, SEEK_CUR);
+        if (endOffset < 0) {
+            mWriteSeekErr = true;
+            ALOGE("flushPendingWrites_l seek by %zu failed, error:%s(%d)", batch->mBytes,
+                    std::strerror(errno), errno);
+            sp<AMessage> msg = new AMessage(kWhatIOError, mReflector);
+            msg->setInt32("err", ERROR_IO);
+            WARN_UNLESS(msg->post() == OK, "flushPendingWrites_l:error posting ERROR_IO");
+        } else {
+            batch->mOffset = endOffset - batch->mBytes;
+        }
+    }
+
+    std::unique_lock<std::mutex> lock(mWriteQueueLock);
+    mWriteQueue.push_back(batch);
+    mWriteQueueCondition.notify_all();
+    // Bound the data in flight: wait for a batch to be written before filling another.
+    mWriteQueueCondition.wait(lock, [this] { return !mFreeWriteBatches.empty(); });
+    mPendingWrite = mFreeWriteBatches.back();
+    mFreeWriteBatches.pop_back();
+}
+
+void MPEG4Writer::startIOThread() {
+    mIOThreadDone = false;
+    mWriteQueue.clear();
+    mFreeWriteBatches.clear();
+    for (auto &batch : mWriteBatches) {
+        batch->clear();
+        mFreeWriteBatches.push_back(batch.get());
+    }
+    mPendingWrite = mFreeWriteBatches.back();
+    mFreeWriteBatches.pop_back();
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+    pthread_create(&mIOThread, &attr, IOThreadWrapper, this);
+    pthread_attr_destroy(&attr);
+    mIOThreadStarted = true;
+}
+
+void MPEG4Writer::stopIOThread() {
+    if (!mIOThreadStarted) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mWriteQueueLock);
+        mIOThreadDone = true;
+        mWriteQueueCondition.notify_all();
+    }
+    // The thread writes out every submitted batch before it exits.
+    pthread_join(mIOThread, NULL);
+    mIOThreadStarted = false;
+    CHECK_EQ(mPendingWrite->mNumIovecs, 0u);
+    CHECK(mPendingWrite->mSamples.empty());
+}
+
+// static
+void *MPEG4Writer::IOThreadWrapper(void *me) {
+    static_cast<MPEG4Writer *>(me)->ioThreadFunc();
+    return NULL;
+}
+
+void MPEG4Writer::ioThreadFunc() {
+    prctl(PR_SET_NAME, (unsigned long)"MPEG4WriterIO", 0, 0, 0);
+
+    if (mIsBackgroundMode) {
+        androidSetThreadPriority(0 /* tid (0 = current) */, ANDROID_PRIORITY_BACKGROUND);
+    }
+
+    std::unique_lock<std::mutex> lock(mWriteQueueLock);
+    for (;;) {
+        mWriteQueueCondition.wait(lock, [this] { return mIOThreadDone || !mWriteQueue.empty(); });
+        if (mWriteQueue.empty()) {
+            break;
+        }
+        WriteBatch *batch = mWriteQueue.front();
+        mWriteQueue.pop_front();
+        lock.unlock();
+
+        if (batch->mBytes > 0) {
+            pwritevOrPostError(batch->mFd, batch->mIovecs, batch->mNumIovecs, batch->mBytes,
+                    batch->mOffset);
+        }
+        while (!batch->mSamples.empty()) {
+            List<MediaBuffer *>::iterator it = batch->mSamples.begin();
+            (*it)->release();
+            batch->mSamples.erase(it);
+        }
+        batch->clear();
+
+        lock.lock();
+        mFreeWriteBatches.push_back(batch);
+        mWriteQueueCondition.notify_all();
+    }
+}
+
+void MPEG4Writer::recordWriteDuration(std::chrono::microseconds duration) {
+    std::lock_guard<std::mutex> lock(mWriteDurationLock);
+    mWriteDurationPQ.emplace(duration);
+    if (mWriteDurationPQ.size() > kWriteDurationsCount) {
+        mWriteDurationPQ.pop();
+    }
+}
+
 size_t MPEG4Writer::write(
         const void *ptr, size_t size, size_t nmemb) {
 
@@ -1777,12 +2016,7 @@ void MPEG4Writer::writeOrPostError(int fd, const void* buf, size_t count) {
     auto beforeTP = std::chrono::high_resolution_clock::now();
     ssize_t bytesWritten = ::write(fd, buf, count);
     auto afterTP = std::chrono::high_resolution_clock::now();
-    auto writeDuration =
-            std::chrono::duration_cast<std::chrono::microseconds>(afterTP - beforeTP).count();
-    mWriteDurationPQ.emplace(writeDuration);
-    if (mWriteDurationPQ.size() > kWriteDurationsCount) {
-        mWriteDurationPQ.pop();
-    }
+    recordWriteDuration(std::chrono::duration_cast<std::chrono::microseconds>(afterTP - beforeTP));
 
     /* Write as much as possible during stop() execution when there was an error
      * (mWriteSeekErr == true) in the previous call to write() or lseek64().
@@ -1800,6 +2034,29 @@ void MPEG4Writer::writeOrPostError(int fd, const void* buf, size_t count) {
     WARN_UNLESS(msg->post() == OK, "writeOrPostError:error posting ERROR_IO");
 }
 
+void MPEG4Writer::pwritevOrPostError(
+        int fd, const struct iovec *iov, int iovcnt, size_t count, off64_t offset) {
+    if (mWriteSeekErr == true)
+        return;
+
+    auto beforeTP = std::chrono::high_resolution_clock::now();
+    ssize_t bytesWritten = ::pwritev(fd, iov, iovcnt, offset);
+    auto afterTP = std::chrono::high_resolution_clock::now();
+    recordWriteDuration(std::chrono::duration_cast<std::chrono::microseconds>(afterTP - beforeTP));
+
+    if (bytesWritten == count)
+        return;
+    mWriteSeekErr = true;
+    ALOGE("pwritevOrPostError bytesWritten:%zd, count:%zu, iovcnt:%d, offset:%" PRId64
+          ", error:%s(%d)", bytesWritten, count, iovcnt, (int64_t)offset,
+          std::strerror(errno), errno);
+
+    // Can't guarantee that file is usable or write would succeed anymore, hence signal to stop.
+    sp<AMessage> msg = new AMessage(kWhatIOError, mReflector);
+    msg->setInt32("err", ERROR_IO);
+    WARN_UNLESS(msg->post() == OK, "pwritevOrPostError:error posting ERROR_IO");
+}
+
 void MPEG4Writer::seekOrPostError(int fd, off64_t offset, int whence) {
     if (mWriteSeekErr == true)
         return;
@@ -2215,6 +2472,8 @@ MPEG4Writer::Track::Track(
       mMinCttsOffsetTimeUs(0),
       mMinCttsOffsetTicks(0),
       mMaxCttsOffsetTicks(0),
+      mLastFragmentSampleDurationTicks(0),
+      mFragmentedConfig{false, false},
       mDoviProfile(0),
       mCodecSpecificData(NULL),
       mCodecSpecificDataSize(0),
@@ -2291,6 +2550,7 @@ void MPEG4Writer::Track::resetInternal() {
     mStarted = false;
     mGotStartKeyFrame = false;
     mIsMalformed = false;
+    mFragmentedConfig = {false, false};
     mTrackDurationUs = 0;
     mEstimatedTrackSizeBytes = 0;
     mSamplesHaveSameSize = false;
@@ -2766,6 +3026,9 @@ void MPEG4Writer::bufferChunk(const Chunk& chunk) {
          it != mChunkInfos.end(); ++it) {
 
         if (chunk.mTrack == it->mTrack) {  // Found owner
+            if (mFragmented) {
+                chunk.mTrack->snapshotFragmentedConfig_l();
+            }
             it->mChunks.push_back(chunk);
             mChunkReadyCondition.signal();
             return;
@@ -2779,10 +3042,14 @@ void MPEG4Writer::writeChunkToFile(Chunk* chunk) {
     ALOGV("writeChunkToFile: %" PRId64 " from %s track",
         chunk->mTimeStampUs, chunk->mTrack->getTrackType());
 
-    int32_t isFirstSample = true;
-    while (!chunk->mSamples.empty()) {
-        List<MediaBuffer *>::iterator it = chunk->mSamples.begin();
+    if (mFragmented) {
+        writeFragmentToFile(chunk);
+        return;
+    }
 
+    int32_t isFirstSample = true;
+    for (List<MediaBuffer *>::iterator it = chunk->mSamples.begin();
+         it != chunk->mSamples.end(); ++it) {
         uint32_t tiffHdrOffset;
         if (!(*it)->meta_data().findInt32(
                 kKeyExifTiffOffset, (int32_t*)&tiffHdrOffset)) {
@@ -2800,12 +3067,152 @@ void MPEG4Writer::writeChunkToFile(Chunk* chunk) {
             chunk->mTrack->addChunkOffset(offset);
             isFirstSample = false;
         }
+    }
 
-        (*it)->release();
-        (*it) = NULL;
-        chunk->mSamples.erase(it);
+    // The whole chunk goes out in one gathered write. The samples go along with
+    // it and are released by the I/O thread once their payloads reach the file.
+    flushPendingWrites_l(&chunk->mSamples);
+}
+
+void MPEG4Writer::writeFragmentedMoovBox() {
+    beginBox("moov");
+    writeMvhdBox(0);
+    if (mAreGeoTagsAvailable) {
+        writeUdtaBox();
     }
-    chunk->mSamples.clear();
+    writeMoovLevelMetaBox();
+    for (List<ChunkInfo>::iterator it = mChunkInfos.begin(); it != mChunkInfos.end(); ++it) {
+        if (!it->mDropped) {
+            it->mTrack->writeTrackHeader();
+        }
+    }
+    beginBox("mvex");
+    for (List<ChunkInfo>::iterator it = mChunkInfos.begin(); it != mChunkInfos.end(); ++it) {
+        if (it->mDropped) {
+            continue;
+        }
+        beginBox("trex");
+        writeInt32(0);  // version=0, flags=0
+        writeInt32(it->mTrack->getTrackId().getId());
+        writeInt32(1);  // default_sample_description_index
+        writeInt32(0);  // default_sample_duration
+        writeInt32(0);  // default_sample_size
+        writeInt32(0);  // default_sample_flags
+        endBox();  // trex
+    }
+    endBox();  // mvex
+    endBox();  // moov
+    ALOGI("MOOV atom was written ahead of the fragments");
+}
+
+/*
+ * Writes one chunk as a moof/mdat pair. The sample sizes are only known once
+ * the samples have been laid out (start codes become length prefixes), so
+ * the payloads are written first, after a hole of exactly the moof + mdat
+ * header size, and the headers are filled in afterwards.
+ */
+void MPEG4Writer::writeFragmentToFile(Chunk* chunk) {
+    if (!mFragmentedMoovWritten) {
+        writeFragmentedMoovBox();
+        mFragmentedMoovWritten = true;
+    }
+
+    Track *track = chunk->mTrack;
+    const uint32_t sampleCount = chunk->mSamples.size();
+    if (sampleCount == 0) {
+        return;
+    }
+
+    const uint32_t trunSize = 20 + sampleCount * 16;
+    const uint32_t trafSize = 8 + 16 /* tfhd */ + 20 /* tfdt */ + trunSize;
+    const uint32_t moofSize = 8 + 16 /* mfhd */ + trafSize;
+    const off64_t moofOffset = mOffset;
+
+    mOffset += moofSize + 8;
+    seekOrPostError(mFd, mOffset, SEEK_SET);
+
+    struct FragmentSample {
+        int64_t decodingTimeUs;
+        int64_t compositionTimeUs;
+        uint32_t size;
+        bool isSync;
+    };
+    std::vector<FragmentSample> samples;
+    samples.reserve(sampleCount);
+    for (List<MediaBuffer *>::iterator it = chunk->mSamples.begin();
+         it != chunk->mSamples.end(); ++it) {
+        FragmentSample sample;
+        int32_t isSync = false;
+        CHECK((*it)->meta_data().findInt64(kKeyDecodingTime, &sample.decodingTimeUs));
+        CHECK((*it)->meta_data().findInt64(kKeyTime, &sample.compositionTimeUs));
+        (*it)->meta_data().findInt32(kKeyIsSyncFrame, &isSync);
+        sample.isSync = isSync;
+
+        size_t bytesWritten;
+        addSample_l(*it, track->usePrefix(), 0 /* tiffHdrOffset */, &bytesWritten);
+        sample.size = bytesWritten;
+        samples.push_back(sample);
+    }
+    flushPendingWrites_l(&chunk->mSamples);
+    const off64_t mdatEndOffset = mOffset;
+
+    const int64_t timeScale = track->getTimeScale();
+    auto toTicks = [timeScale](int64_t timeUs) -> int64_t {
+        return (timeUs * timeScale + 500000LL) / 1000000LL;
+    };
+
+    std::vector<uint8_t> header;
+    header.reserve(moofSize + 8);
+    auto put32 = [&header](uint32_t x) {
+        header.push_back(x >> 24);
+        header.push_back((x >> 16) & 0xff);
+        header.push_back((x >> 8) & 0xff);
+        header.push_back(x & 0xff);
+    };
+    auto putBoxHeader = [&header, &put32](uint32_t size, const char *fourcc) {
+        put32(size);
+        header.insert(header.end(), fourcc, fourcc + 4);
+    };
+
+    putBoxHeader(moofSize, "moof");
+    putBoxHeader(16, "mfhd");
+    put32(0);                          // version=0, flags=0
+    put32(++mFragmentSequenceNumber);
+    putBoxHeader(trafSize, "traf");
+    putBoxHeader(16, "tfhd");
+    put32(0x020000);                   // version=0, flags=default-base-is-moof
+    put32(track->getTrackId().getId());
+    putBoxHeader(20, "tfdt");
+    put32(1 << 24);                    // version=1, flags=0
+    uint64_t baseMediaDecodeTime = toTicks(samples[0].decodingTimeUs);
+    put32(baseMediaDecodeTime >> 32);
+    put32(baseMediaDecodeTime & 0xffffffff);
+    putBoxHeader(trunSize, "trun");
+    // version=1 for signed composition offsets; flags=data-offset, sample
+    // duration, size, flags and composition time offset present.
+    put32((1 << 24) | 0x000f01);
+    put32(sampleCount);
+    put32(moofSize + 8);               // data_offset, relative to the moof
+    int64_t lastDurationTicks = track->getLastFragmentSampleDurationTicks();
+    for (size_t i = 0; i < samples.size(); ++i) {
+        int64_t decodingTicks = toTicks(samples[i].decodingTimeUs);
+        if (i + 1 < samples.size()) {
+            lastDurationTicks = toTicks(samples[i + 1].decodingTimeUs) - decodingTicks;
+        }
+        put32(lastDurationTicks);
+        put32(samples[i].size);
+        // sample_depends_on=2 for sync samples, else sample_depends_on=1 and
+        // sample_is_non_sync_sample=1.
+        put32(samples[i].isSync ? 0x02000000 : 0x01010000);
+        put32(toTicks(samples[i].compositionTimeUs) - decodingTicks);
+    }
+    track->setLastFragmentSampleDurationTicks(lastDurationTicks);
+    putBoxHeader(mdatEndOffset - moofOffset - moofSize, "mdat");
+    CHECK_EQ(header.size(), moofSize + 8);
+
+    seekOrPostError(mFd, moofOffset, SEEK_SET);
+    writeOrPostError(mFd, header.data(), header.size());
+    seekOrPostError(mFd, mdatEndOffset, SEEK_SET);
 }
 
 void MPEG4Writer::writeAllChunks() {
@@ -2816,6 +3223,11 @@ void MPEG4Writer::writeAllChunks() {
         writeChunkToFile(&chunk);
         ++outstandingChunks;
     }
+    if (mFragmented && !mFragmentedMoovWritten) {
+        // No samples at all; still leave a playable (empty) movie behind.
+        writeFragmentedMoovBox();
+        mFragmentedMoovWritten = true;
+    }
 
     sendSessionSummary();
 
@@ -2826,10 +3238,48 @@ void MPEG4Writer::writeAllChunks() {
 bool MPEG4Writer::findChunkToWrite(Chunk *chunk) {
     ALOGV("findChunkToWrite");
 
+    if (mFragmented && !mFragmentedMoovWritten) {
+        // The moov must describe a track before its first fragment goes out,
+        // and a track has its codec specific data once it buffers a chunk.
+        // Wait for every track, but only until one has buffered
+        // kMaxFragmentsBeforeMoov fragments; a track without a chunk by then
+        // is left out of the file, so that it cannot hold the others back.
+        bool allTracksReady = true;
+        size_t maxBufferedChunks = 0;
+        for (List<ChunkInfo>::iterator it = mChunkInfos.begin();
+             it != mChunkInfos.end(); ++it) {
+            allTracksReady = allTracksReady && !it->mChunks.empty();
+            maxBufferedChunks = std::max(maxBufferedChunks, it->mChunks.size());
+        }
+        if (!allTracksReady && !mDone && maxBufferedChunks < kMaxFragmentsBeforeMoov) {
+            return false;
+        }
+        for (List<ChunkInfo>::iterator it = mChunkInfos.begin();
+             it != mChunkInfos.end(); ++it) {
+            if (it->mChunks.empty() && !it->mDropped) {
+                ALOGW("%s track has no data for the fragmented moov, dropping it",
+                        it->mTrack->getTrackType());
+                it->mDropped = true;
+            }
+        }
+    }
+
     int64_t minTimestampUs = 0x7FFFFFFFFFFFFFFFLL;
     Track *track = NULL;
     for (List<ChunkInfo>::iterator it = mChunkInfos.begin();
          it != mChunkInfos.end(); ++it) {
+        if (it->mDropped) {
+            // Not in the moov; its fragments could not be read back.
+            while (!it->mChunks.empty()) {
+                List<MediaBuffer *> &samples = it->mChunks.begin()->mSamples;
+                for (List<MediaBuffer *>::iterator sampleIt = samples.begin();
+                     sampleIt != samples.end(); ++sampleIt) {
+                    (*sampleIt)->release();
+                }
+                it->mChunks.erase(it->mChunks.begin());
+            }
+            continue;
+        }
         if (!it->mChunks.empty()) {
             List<Chunk>::iterator chunkIt = it->mChunks.begin();
             if (chunkIt->mTimeStampUs < minTimestampUs) {
@@ -2919,6 +3369,7 @@ status_t MPEG4Writer::startWriterThread() {
         info.mTrack = *it;
         info.mPrevChunkTimestampUs = 0;
         info.mMaxInterChunkDurUs = 0;
+        info.mDropped = false;
         mChunkInfos.push_back(info);
     }
 
@@ -2928,6 +3379,7 @@ status_t MPEG4Writer::startWriterThread() {
     pthread_create(&mThread, &attr, ThreadWrapper, this);
     pthread_attr_destroy(&attr);
     mWriterThreadStarted = true;
+    startIOThread();
     return OK;
 }
 
@@ -2969,6 +3421,18 @@ status_t MPEG4Writer::Track::start(MetaData *params) {
 
     initTrackingProgressStatus(params);
 
+    if (mOwner->isFragmented()) {
+        // Samples are described by the track fragments; only the counts are
+        // needed for bookkeeping, which keeps memory flat however long the
+        // recording runs.
+        mStszTableEntries->setCountOnly();
+        mCo64TableEntries->setCountOnly();
+        mStscTableEntries->setCountOnly();
+        mStssTableEntries->setCountOnly();
+        mSttsTableEntries->setCountOnly();
+        mCttsTableEntries->setCountOnly();
+    }
+
     sp<MetaData> meta = new MetaData;
     if (mOwner->isRealTimeRecording() && mOwner->numTracks() > 1) {
         /*
@@ -3480,6 +3944,8 @@ status_t MPEG4Writer::Track::threadEntry() {
     int32_t count = 0;
     const int64_t interleaveDurationUs = mOwner->interleaveDuration();
     const bool hasMultipleTracks = (mOwner->numTracks() > 1);
+    // Fragments are always formed from chunks, even for a single track.
+    const bool useChunks = hasMultipleTracks || mOwner->isFragmented();
     int64_t chunkTimestampUs = 0;
     int32_t nChunks = 0;
     int32_t nActualFrames = 0;        // frames containing non-CSD data (non-0 length)
@@ -3965,10 +4431,38 @@ status_t MPEG4Writer::Track::threadEntry() {
                 trackProgressStatus(timestampUs);
             }
         }
-        if (!hasMultipleTracks) {
+        if (mOwner->isFragmented() && !mIsHeif) {
+            // The writer builds each trun from per-sample timing, as the
+            // sample tables are not kept in this mode.
+            int64_t compositionOffsetUs =
+                    mIsVideo ? cttsOffsetTimeUs - kMaxCttsOffsetTimeUs : 0;
+            copy->meta_data().setInt64(kKeyDecodingTime, timestampUs);
+            copy->meta_data().setInt64(kKeyTime, timestampUs + compositionOffsetUs);
+            copy->meta_data().setInt32(kKeyIsSyncFrame, mIsVideo ? isSync : true);
+
+            // Cut a fragment once it spans the fragment duration, and only in
+            // front of a sync sample for video so every fragment is decodable
+            // on its own.
+            if (!mChunkSamples.empty() && (!mIsVideo || isSync)
+                    && timestampUs - chunkTimestampUs >= mOwner->fragmentDurationUs()) {
+                ++nChunks;
+                bufferChunk(chunkTimestampUs);
+            }
+            if (mChunkSamples.empty()) {
+                chunkTimestampUs = timestampUs;
+            }
+            mChunkSamples.push_back(copy);
+            continue;
+        }
+
+        if (!useChunks) {
             size_t bytesWritten;
             off64_t offset = mOwner->addSample_l(
                     copy, usePrefix, tiffHdrOffset, &bytesWritten);
+            List<MediaBuffer *> samples;
+            samples.push_back(copy);
+            mOwner->flushPendingWrites_l(&samples);
+            copy = NULL;
 
             if (mIsHeif) {
                 addItemOffsetAndSize(offset, bytesWritten, isExif);
@@ -3977,8 +4471,6 @@ status_t MPEG4Writer::Track::threadEntry() {
                     addChunkOffset(offset);
                 }
             }
-            copy->release();
-            copy = NULL;
             continue;
         }
 
@@ -4028,7 +4520,7 @@ status_t MPEG4Writer::Track::threadEntry() {
             }
         } else {
             // Last chunk
-            if (!hasMultipleTracks) {
+            if (!useChunks) {
                 addOneStscTableEntry(1, mStszTableEntries->count());
             } else if (!mChunkSamples.empty()) {
                 addOneStscTableEntry(++nChunks, mChunkSamples.size());
@@ -4247,6 +4739,14 @@ void MPEG4Writer::Track::bufferChunk(int64_t timestampUs) {
     mChunkSamples.clear();
 }
 
+void MPEG4Writer::Track::snapshotFragmentedConfig_l() {
+    if (mFragmentedConfig.mTaken) {
+        return;
+    }
+    mFragmentedConfig.mHasSampleEntry = !mIsMalformed && checkCodecSpecificData() == OK;
+    mFragmentedConfig.mTaken = true;
+}
+
 int64_t MPEG4Writer::Track::getDurationUs() const {
     return mTrackDurationUs + getStartTimeOffsetTimeUs() + mOwner->getStartTimeOffsetBFramesUs();
 }
@@ -4369,7 +4869,11 @@ int64_t MPEG4Writer::Track::getMinCttsOffsetTimeUs() {
 void MPEG4Writer::Track::writeStblBox() {
     mOwner->beginBox("stbl");
     // Add subboxes for only non-empty and well-formed tracks.
-    if (mStszTableEntries->count() > 0 && !isTrackMalFormed()) {
+    // In fragmented mode the track is written before its samples.
+    bool hasSampleEntry = mOwner->isFragmented()
+            ? mFragmentedConfig.mHasSampleEntry
+            : mStszTableEntries->count() > 0 && !isTrackMalFormed();
+    if (hasSampleEntry) {
         mOwner->beginBox("stsd");
         mOwner->writeInt32(0);               // version=0, flags=0
         mOwner->writeInt32(1);               // entry count
@@ -4381,18 +4885,44 @@ void MPEG4Writer::Track::writeStblBox() {
             writeMetadataFourCCBox();
         }
         mOwner->endBox();  // stsd
-        writeSttsBox();
-        if (mIsVideo) {
-            writeCttsBox();
-            writeStssBox();
+        if (mOwner->isFragmented()) {
+            writeEmptySampleTables();
+        } else {
+            writeSttsBox();
+            if (mIsVideo) {
+                writeCttsBox();
+                writeStssBox();
+            }
+            writeStszBox();
+            writeStscBox();
+            writeCo64Box();
         }
-        writeStszBox();
-        writeStscBox();
-        writeCo64Box();
     }
     mOwner->endBox();  // stbl
 }
 
+// The mandatory sample tables of a fragmented file's moov; the samples
+// themselves are listed in the trun boxes of the fragments.
+void MPEG4Writer::Track::writeEmptySampleTables() {
+    mOwner->beginBox("stts");
+    mOwner->writeInt32(0);  // version=0, flags=0
+    mOwner->writeInt32(0);  // entry count
+    mOwner->endBox();  // stts
+    mOwner->beginBox("stsc");
+    mOwner->writeInt32(0);  // version=0, flags=0
+    mOwner->writeInt32(0);  // entry count
+    mOwner->endBox();  // stsc
+    mOwner->beginBox("stsz");
+    mOwner->writeInt32(0);  // version=0, flags=0
+    mOwner->writeInt32(0);  // sample size
+    mOwner->writeInt32(0);  // sample count
+    mOwner->endBox();  // stsz
+    mOwner->beginBox("stco");
+    mOwner->writeInt32(0);  // version=0, flags=0
+    mOwner->writeInt32(0);  // entry count
+    mOwner->endBox();  // stco
+}
+
 void MPEG4Writer::Track::writeMetadataFourCCBox() {
     const char *mime;
     bool success = mMeta->findCString(kKeyMIMEType, &mime);
@@ -4755,7 +5285,8 @@ void MPEG4Writer::Track::writeTkhdBox(uint32_t now) {
     mOwner->writeInt32(now);           // modification time
     mOwner->writeInt32(mTrackId.getId()); // track id starts with 1
     mOwner->writeInt32(0);             // reserved
-    int64_t trakDurationUs = getDurationUs();
+    // The duration of a fragmented track is the sum of its fragments.
+    int64_t trakDurationUs = mOwner->isFragmented() ? 0 : getDurationUs();
     int32_t mvhdTimeScale = mOwner->getTimeScale();
     int32_t tkhdDuration =
         (trakDurationUs * mvhdTimeScale + 5E5) / 1E6;
@@ -4828,6 +5359,12 @@ void MPEG4Writer::Track::writeHdlrBox() {
 }
 
 void MPEG4Writer::Track::writeEdtsBox() {
+    if (mOwner->isFragmented()) {
+        // Start offsets are not known yet when the moov of a fragmented file
+        // is written; fragments carry absolute decode times instead.
+        return;
+    }
+
     ALOGV("%s : getStartTimeOffsetTimeUs of track:%" PRId64 " us", getTrackType(),
         getStartTimeOffsetTimeUs());
 
@@ -4958,7 +5495,7 @@ void MPEG4Writer::Track::writeEdtsBox() {
 }
 
 void MPEG4Writer::Track::writeMdhdBox(uint32_t now) {
-    int64_t trakDurationUs = getDurationUs();
+    int64_t trakDurationUs = mOwner->isFragmented() ? 0 : getDurationUs();
     int64_t mdhdDuration = (trakDurationUs * mTimeScale + 5E5) / 1E6;
     mOwner->beginBox("mdhd");
 
@@ -3186,6 +3186,93 @@ status_t MediaCodec::releaseOutputBuffer(size_t index) {
     return PostAndAwaitResponse(msg, &response);
 }
 
+status_t MediaCodec::queueInputBuffers(
+        const BatchBufferInfo *infos,
+        size_t count,
+        size_t *numQueued,
+        AString *errorDetailMsg) {
+    if (errorDetailMsg != NULL) {
+        errorDetailMsg->clear();
+    }
+    *numQueued = 0;
+    if (count == 0) {
+        return OK;
+    } else if (infos == NULL) {
+        return BAD_VALUE;
+    }
+
+    // |infos| stays valid as we wait for the response.
+    sp<AMessage> msg = new AMessage(kWhatQueueInputBuffers, this);
+    msg->setPointer("infos", (void *)infos);
+    msg->setSize("count", count);
+    msg->setPointer("errorDetailMsg", errorDetailMsg);
+
+    sp<AMessage> response;
+    status_t err = PostAndAwaitResponse(msg, &response);
+    if (response != NULL) {
+        response->findSize("numQueued", numQueued);
+    }
+    return err;
+}
+
+status_t MediaCodec::dequeueInputBuffers(
+        size_t *indices, size_t maxCount, size_t *count, int64_t timeoutUs) {
+    *count = 0;
+    if (indices == NULL || maxCount == 0) {
+        return BAD_VALUE;
+    }
+
+    sp<AMessage> msg = new AMessage(kWhatDequeueInputBuffers, this);
+    msg->setPointer("indices", indices);
+    msg->setSize("maxCount", maxCount);
+
+    sp<AMessage> response;
+    status_t err = PostAndAwaitResponse(msg, &response);
+    if (err == -EAGAIN && timeoutUs != 0) {
+        // Nothing is available yet, wait for the first buffer.
+        err = dequeueInputBuffer(&indices[0], timeoutUs);
+        if (err == OK) {
+            *count = 1;
+        }
+        return err;
+    } else if (err != OK) {
+        return err;
+    }
+
+    CHECK(response->findSize("count", count));
+    return OK;
+}
+
+status_t MediaCodec::dequeueOutputBuffers(
+        BatchBufferInfo *infos, size_t maxCount, size_t *count, int64_t timeoutUs) {
+    *count = 0;
+    if (infos == NULL || maxCount == 0) {
+        return BAD_VALUE;
+    }
+
+    sp<AMessage> msg = new AMessage(kWhatDequeueOutputBuffers, this);
+    msg->setPointer("infos", infos);
+    msg->setSize("maxCount", maxCount);
+
+    sp<AMessage> response;
+    status_t err = PostAndAwaitResponse(msg, &response);
+    if (err == -EAGAIN && timeoutUs != 0) {
+        // Nothing is available yet, wait for the first buffer.
+        BatchBufferInfo &info = infos[0];
+        err = dequeueOutputBuffer(&info.mIndex, &info.mOffset, &info.mSize,
+                &info.mPresentationTimeUs, &info.mFlags, timeoutUs);
+        if (err == OK) {
+            *count = 1;
+        }
+        return err;
+    } else if (err != OK) {
+        return err;
+    }
+
+    CHECK(response->findSize("count", count));
+    return OK;
+}
+
 status_t MediaCodec::signalEndOfInputStream() {
     sp<AMessage> msg = new AMessage(kWhatSignalEndOfInputStream, this);
 
@@ -5148,6 +5235,208 @@ void MediaCodec::onMessageReceived(const sp<AMessage> &msg) {
             break;
         }
 
+        case kWhatQueueInputBuffers:
+        {
+            sp<AReplyToken> replyID;
+            CHECK(msg->senderAwaitsResponse(&replyID));
+
+            if (!isExecuting()) {
+                mErrorLog.log(LOG_TAG, base::StringPrintf(
+                        "queueInputBuffers() is valid only at Executing states; currently %s",
+                        apiStateString().c_str()));
+                PostReplyWithError(replyID, INVALID_OPERATION);
+                break;
+            } else if (mFlags & kFlagStickyError) {
+                PostReplyWithError(replyID, getStickyError());
+                break;
+            }
+
+            void *infosPtr;
+            size_t count;
+            void *errorDetailMsg;
+            CHECK(msg->findPointer("infos", &infosPtr));
+            CHECK(msg->findSize("count", &count));
+            CHECK(msg->findPointer("errorDetailMsg", &errorDetailMsg));
+            const BatchBufferInfo *infos = (const BatchBufferInfo *)infosPtr;
+
+            // Each buffer goes through the same path as a queueInputBuffer()
+            // call, only without a round trip per buffer.
+            status_t err = OK;
+            size_t numQueued = 0;
+            for (; numQueued < count; ++numQueued) {
+                const BatchBufferInfo &info = infos[numQueued];
+                sp<AMessage> entry = new AMessage(kWhatQueueInputBuffer, this);
+                entry->setSize("index", info.mIndex);
+                entry->setSize("offset", info.mOffset);
+                entry->setSize("size", info.mSize);
+                entry->setInt64("timeUs", info.mPresentationTimeUs);
+                entry->setInt32("flags", info.mFlags);
+                entry->setPointer("errorDetailMsg", errorDetailMsg);
+
+                if (!mLeftover.empty()) {
+                    mLeftover.push_back(entry);
+                    err = handleLeftover(info.mIndex);
+                } else {
+                    err = onQueueInputBuffer(entry);
+                }
+                if (err != OK) {
+                    break;
+                }
+            }
+
+            sp<AMessage> response = new AMessage;
+            response->setSize("numQueued", numQueued);
+            if (err != OK) {
+                response->setInt32("err", err);
+            }
+            response->postReply(replyID);
+            break;
+        }
+
+        case kWhatDequeueInputBuffers:
+        {
+            sp<AReplyToken> replyID;
+            CHECK(msg->senderAwaitsResponse(&replyID));
+
+            if (!isExecuting()) {
+                mErrorLog.log(LOG_TAG, base::StringPrintf(
+                        "dequeueInputBuffers() is valid only at Executing states; currently %s",
+                        apiStateString().c_str()));
+                PostReplyWithError(replyID, INVALID_OPERATION);
+                break;
+            } else if (mFlags & kFlagIsAsync) {
+                mErrorLog.log(LOG_TAG, "dequeueInputBuffers can't be used in async mode");
+                PostReplyWithError(replyID, INVALID_OPERATION);
+                break;
+            } else if (mHaveInputSurface) {
+                mErrorLog.log(LOG_TAG, "dequeueInputBuffers can't be used with input surface");
+                PostReplyWithError(replyID, INVALID_OPERATION);
+                break;
+            } else if (mFlags & kFlagDequeueInputPending) {
+                mErrorLog.log(LOG_TAG,
+                        "Invalid to call while another dequeue input request is pending");
+                PostReplyWithError(replyID, INVALID_OPERATION);
+                break;
+            } else if (mFlags & kFlagStickyError) {
+                PostReplyWithError(replyID, getStickyError());
+                break;
+            }
+
+            void *indicesPtr;
+            size_t maxCount;
+            CHECK(msg->findPointer("indices", &indicesPtr));
+            CHECK(msg->findSize("maxCount", &maxCount));
+            size_t *indices = (size_t *)indicesPtr;
+
+            size_t count = 0;
+            while (count < maxCount) {
+                ssize_t index = dequeuePortBuffer(kPortIndexInput);
+                if (index < 0) {
+                    CHECK_EQ(index, -EAGAIN);
+                    break;
+                }
+                indices[count++] = index;
+            }
+
+            if (count == 0) {
+                PostReplyWithError(replyID, -EAGAIN);
+                break;
+            }
+            sp<AMessage> response = new AMessage;
+            response->setSize("count", count);
+            response->postReply(replyID);
+            break;
+        }
+
+        case kWhatDequeueOutputBuffers:
+        {
+            sp<AReplyToken> replyID;
+            CHECK(msg->senderAwaitsResponse(&replyID));
+
+            if (!isExecuting()) {
+                mErrorLog.log(LOG_TAG, base::StringPrintf(
+                        "dequeueOutputBuffers() is valid only at Executing states; currently %s",
+                        apiStateString().c_str()));
+                PostReplyWithError(replyID, INVALID_OPERATION);
+                break;
+            } else if (mFlags & kFlagIsAsync) {
+                mErrorLog.log(LOG_TAG, "dequeueOutputBuffers can't be used in async mode");
+                PostReplyWithError(replyID, INVALID_OPERATION);
+                break;
+            } else if (mFlags & kFlagDequeueOutputPending) {
+                mErrorLog.log(LOG_TAG,
+                        "Invalid to call while another dequeue output request is pending");
+                PostReplyWithError(replyID, INVALID_OPERATION);
+                break;
+            } else if (mFlags & kFlagStickyError) {
+                PostReplyWithError(replyID, getStickyError());
+                break;
+            } else if (mFlags & kFlagOutputBuffersChanged) {
+                PostReplyWithError(replyID, INFO_OUTPUT_BUFFERS_CHANGED);
+                mFlags &= ~kFlagOutputBuffersChanged;
+                break;
+            }
+
+            void *infosPtr;
+            size_t maxCount;
+            CHECK(msg->findPointer("infos", &infosPtr));
+            CHECK(msg->findSize("maxCount", &maxCount));
+            BatchBufferInfo *infos = (BatchBufferInfo *)infosPtr;
+
+            status_t err = OK;
+            size_t count = 0;
+            while (count < maxCount) {
+                BufferInfo *info = peekNextPortBuffer(kPortIndexOutput);
+                if (!info) {
+                    break;
+                }
+
+                // As in handleDequeueOutputBuffer(), a format change is reported
+                // at the buffer that carries it. If buffers precede it in this
+                // batch, it is left pending for the next dequeue call.
+                const sp<MediaCodecBuffer> &buffer = info->mData;
+                handleOutputFormatChangeIfNeeded(buffer);
+                if (mFlags & kFlagOutputFormatChanged) {
+                    if (count == 0) {
+                        err = INFO_FORMAT_CHANGED;
+                        mFlags &= ~kFlagOutputFormatChanged;
+                    }
+                    break;
+                }
+
+                ssize_t index = dequeuePortBuffer(kPortIndexOutput);
+                if (discardDecodeOnlyOutputBuffer(index)) {
+                    continue;
+                }
+
+                int64_t timeUs;
+                int32_t flags;
+                CHECK(buffer->meta()->findInt64("timeUs", &timeUs));
+                CHECK(buffer->meta()->findInt32("flags", &flags));
+
+                BatchBufferInfo &out = infos[count++];
+                out.mIndex = index;
+                out.mOffset = buffer->offset();
+                out.mSize = buffer->size();
+                out.mPresentationTimeUs = timeUs;
+                out.mFlags = flags;
+
+                statsBufferReceived(timeUs, buffer);
+            }
+
+            if (err == OK && count == 0) {
+                err = -EAGAIN;
+            }
+            if (err != OK) {
+                PostReplyWithError(replyID, err);
+                break;
+            }
+            sp<AMessage> response = new AMessage;
+            response->setSize("count", count);
+            response->postReply(replyID);
+            break;
+        }
+
         case kWhatReleaseOutputBuffer:
         {
             sp<AReplyToken> replyID;
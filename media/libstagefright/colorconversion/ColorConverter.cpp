@@ -26,25 +26,24 @@
 #include <media/stagefright/MediaCodecConstants.h>
 #include <media/stagefright/MediaErrors.h>
 
+#include "ColorConverterKernels.h"
+
 #include "libyuv/convert_from.h"
 #include "libyuv/convert_argb.h"
 #include "libyuv/planar_functions.h"
+#include "libyuv/scale.h"
+#include "libyuv/scale_uv.h"
 #include "libyuv/video_common.h"
+#include <algorithm>
+#include <condition_variable>
 #include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
 #include <sys/time.h>
 
 #define PERF_PROFILING 0
 
-#if defined(__aarch64__) || defined(__ARM_NEON__)
-#define USE_NEON_Y410 1
-#else
-#define USE_NEON_Y410 0
-#endif
-
-#if USE_NEON_Y410
-#include <arm_neon.h>
-#endif
-
 namespace android {
 typedef const struct libyuv::YuvConstants LibyuvConstants;
 
@@ -453,25 +452,179 @@ const struct ColorConverter::Coeffs BT2020_LTD_10BIT = { 299, 431,  48, 167, 550
 constexpr int CLIP_RANGE_MIN_8BIT = -294;
 constexpr int CLIP_RANGE_MAX_8BIT = 552;
 
-constexpr int CLIP_RANGE_MIN_10BIT = -1175;
-constexpr int CLIP_RANGE_MAX_10BIT = 2218;
+// Frames are only split if every band gets at least this many rows.
+constexpr size_t kMinRowsPerBand = 64;
+
+// Beyond this, banding mostly contends for memory bandwidth.
+constexpr size_t kMaxDefaultThreads = 4;
+
+// Box filter for interleaved 16-bit chroma (P010), which libyuv can only
+// scale by fixed ratios. Each output sample averages the source samples its
+// footprint covers.
+void ScaleUVPlane16Box(
+        const uint16_t *src, size_t srcStride, size_t srcWidth, size_t srcHeight,
+        uint16_t *dst, size_t dstStride, size_t dstWidth, size_t dstHeight) {
+    for (size_t y = 0; y < dstHeight; ++y) {
+        const size_t top = y * srcHeight / dstHeight;
+        const size_t bottom = std::max(top + 1, (y + 1) * srcHeight / dstHeight);
+        for (size_t x = 0; x < dstWidth; ++x) {
+            const size_t left = x * srcWidth / dstWidth;
+            const size_t right = std::max(left + 1, (x + 1) * srcWidth / dstWidth);
+            uint64_t sumU = 0, sumV = 0;
+            for (size_t row = top; row < bottom; ++row) {
+                const uint16_t *uv = src + row * srcStride + left * 2;
+                for (size_t col = left; col < right; ++col) {
+                    sumU += uv[0];
+                    sumV += uv[1];
+                    uv += 2;
+                }
+            }
+            const uint64_t count = (bottom - top) * (right - left);
+            dst[x * 2] = (sumU + count / 2) / count;
+            dst[x * 2 + 1] = (sumV + count / 2) / count;
+        }
+        dst += dstStride;
+    }
+}
+
+// Downscales one plane of |width| x |height| samples; strides are in bytes.
+// libyuv uses a box filter when reducing by 2x or more and bilinear
+// filtering otherwise, both with its SIMD row functions.
+void ScalePlane(
+        const uint8_t *src, size_t srcStride, size_t srcWidth, size_t srcHeight,
+        uint8_t *dst, size_t dstStride, size_t dstWidth, size_t dstHeight,
+        bool is16Bit, bool isInterleaved) {
+    if (is16Bit && isInterleaved) {
+        ScaleUVPlane16Box(
+                (const uint16_t *)src, srcStride / 2, srcWidth, srcHeight,
+                (uint16_t *)dst, dstStride / 2, dstWidth, dstHeight);
+    } else if (is16Bit) {
+        libyuv::ScalePlane_16(
+                (const uint16_t *)src, srcStride / 2, srcWidth, srcHeight,
+                (uint16_t *)dst, dstStride / 2, dstWidth, dstHeight, libyuv::kFilterBox);
+    } else if (isInterleaved) {
+        libyuv::UVScale(
+                src, srcStride, srcWidth, srcHeight,
+                dst, dstStride, dstWidth, dstHeight, libyuv::kFilterBox);
+    } else {
+        libyuv::ScalePlane(
+                src, srcStride, srcWidth, srcHeight,
+                dst, dstStride, dstWidth, dstHeight, libyuv::kFilterBox);
+    }
+}
+
+// Row kernels take the matrix with the sign of the green terms applied and
+// the luma offset at the bit depth they do the math in.
+YuvRowCoeffs RowCoeffs(const ColorConverter::Coeffs &matrix, int32_t lumaOffsetScale) {
+    return YuvRowCoeffs{
+        matrix._y, matrix._r_v, -matrix._g_u, -matrix._g_v, matrix._b_u,
+        matrix._c16 * lumaOffsetScale };
+}
 
 }
 
+/*
+ * Runs the bands of a conversion on a fixed set of threads. The calling
+ * thread converts bands as well, so a pool for N threads has N - 1 workers.
+ */
+struct ColorConverter::WorkerPool {
+    explicit WorkerPool(size_t numWorkers)
+        : mJob(nullptr),
+          mNextIndex(0),
+          mCount(0),
+          mPending(0),
+          mResult(OK),
+          mQuit(false) {
+        for (size_t i = 0; i < numWorkers; ++i) {
+            mThreads.emplace_back([this] { threadLoop(); });
+        }
+    }
+
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(mLock);
+            mQuit = true;
+        }
+        mWorkAvailable.notify_all();
+        for (std::thread &thread : mThreads) {
+            thread.join();
+        }
+    }
+
+    size_t numWorkers() const {
+        return mThreads.size();
+    }
+
+    // Runs job(0) .. job(count - 1) and returns the first error, if any.
+    status_t run(size_t count, const std::function<status_t(size_t)> &job) {
+        std::unique_lock<std::mutex> lock(mLock);
+        mJob = &job;
+        mNextIndex = 0;
+        mCount = count;
+        mPending = count;
+        mResult = OK;
+        mWorkAvailable.notify_all();
+        while (runNext(lock)) {
+        }
+        mWorkDone.wait(lock, [this] { return mPending == 0; });
+        mJob = nullptr;
+        return mResult;
+    }
+
+private:
+    std::mutex mLock;
+    std::condition_variable mWorkAvailable;
+    std::condition_variable mWorkDone;
+    const std::function<status_t(size_t)> *mJob;
+    size_t mNextIndex;
+    size_t mCount;
+    size_t mPending;
+    status_t mResult;
+    bool mQuit;
+    std::vector<std::thread> mThreads;
+
+    // Runs the next job index, if any is left, with |lock| released.
+    bool runNext(std::unique_lock<std::mutex> &lock) {
+        if (mJob == nullptr || mNextIndex >= mCount) {
+            return false;
+        }
+        const std::function<status_t(size_t)> &job = *mJob;
+        size_t index = mNextIndex++;
+        lock.unlock();
+        status_t err = job(index);
+        lock.lock();
+        if (err != OK && mResult == OK) {
+            mResult = err;
+        }
+        if (--mPending == 0) {
+            mWorkDone.notify_all();
+        }
+        return true;
+    }
+
+    void threadLoop() {
+        pthread_setname_np(pthread_self(), "ColorConverter");
+        std::unique_lock<std::mutex> lock(mLock);
+        while (!mQuit) {
+            if (!runNext(lock)) {
+                mWorkAvailable.wait(lock);
+            }
+        }
+    }
+};
+
 ColorConverter::ColorConverter(
         OMX_COLOR_FORMATTYPE from, OMX_COLOR_FORMATTYPE to)
     : mSrcFormat(from),
       mDstFormat(to),
       mSrcColorSpace({0, 0, 0}),
       mClip(NULL),
-      mClip10Bit(NULL) {
+      mNumThreads(1) {
 }
 
 ColorConverter::~ColorConverter() {
     delete[] mClip;
     mClip = NULL;
-    delete[] mClip10Bit;
-    mClip10Bit = NULL;
 }
 
 // Set MediaImage2 Flexible formats
@@ -660,26 +813,71 @@ status_t ColorConverter::convert(
     if (!(src.isValid()
             && dst.isValid()
             && (src.mCropLeft & 1) == 0
-            && src.cropWidth() == dst.cropWidth()
-            && src.cropHeight() == dst.cropHeight())) {
+            && dst.cropWidth() <= src.cropWidth()
+            && dst.cropHeight() <= src.cropHeight())) {
         return ERROR_UNSUPPORTED;
     }
+    const bool isScaled = (src.cropWidth() != dst.cropWidth()
+            || src.cropHeight() != dst.cropHeight());
 #if PERF_PROFILING
     int64_t startTimeUs = ALooper::GetNowUs();
 #endif
-    status_t err;
     switch ((int32_t)mSrcFormat) {
-        case COLOR_FormatYUV420Flexible:
-            err = convertYUVMediaImage(src, dst);
-            break;
-
         case OMX_COLOR_FormatYUV420Planar:
             if (!mSrcImage) {
                 mSrcImage = Image(CreateYUV420PlanarMediaImage2(
-                        srcWidth, srcHeight, srcStride, srcHeight, 8 /*bitDepth*/));
+                        srcWidth, srcHeight, src.mStride, srcHeight, 8 /*bitDepth*/));
             }
-            err = convertYUVMediaImage(src, dst);
+            break;
+
+        case OMX_QCOM_COLOR_FormatYVU420SemiPlanar:
+            if (!mSrcImage) {
+                mSrcImage = Image(CreateYUV420SemiPlanarMediaImage2(
+                    srcWidth, srcHeight, src.mStride, srcHeight, 8 /*bitDepth*/, false));
+            }
+            break;
+
+        case OMX_COLOR_FormatYUV420SemiPlanar:
+        case OMX_TI_COLOR_FormatYUV420PackedSemiPlanar:
+            if (!mSrcImage) {
+                mSrcImage = Image(CreateYUV420SemiPlanarMediaImage2(
+                    srcWidth, srcHeight, src.mStride, srcHeight, 8 /*bitDepth*/));
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    status_t err;
+    size_t numBands = std::min(mNumThreads, src.cropHeight() / kMinRowsPerBand);
+    if (isScaled) {
+        err = convertScaled(src, dst);
+    } else if (numBands > 1) {
+        err = convertInBands(src, dst, numBands);
+    } else {
+        err = convertBand(src, dst);
+    }
+
+#if PERF_PROFILING
+    int64_t endTimeUs = ALooper::GetNowUs();
+    ALOGD("%s image took %lld us (%zu bands)", asString_ColorFormat(mSrcFormat,"Unknown"),
+            (long long) (endTimeUs - startTimeUs), std::max(numBands, (size_t)1));
+#endif
+
+    return err;
+}
 
+status_t ColorConverter::convertBand(
+        const BitmapParams &src, const BitmapParams &dst) {
+    status_t err;
+    switch ((int32_t)mSrcFormat) {
+        case COLOR_FormatYUV420Flexible:
+        case OMX_COLOR_FormatYUV420Planar:
+        case OMX_QCOM_COLOR_FormatYVU420SemiPlanar:
+        case OMX_COLOR_FormatYUV420SemiPlanar:
+        case OMX_TI_COLOR_FormatYUV420PackedSemiPlanar:
+            err = convertYUVMediaImage(src, dst);
             break;
 
         case OMX_COLOR_FormatYUV420Planar16:
@@ -688,45 +886,245 @@ status_t ColorConverter::convert(
 
         case COLOR_FormatYUVP010:
             err = convertYUVP010(src, dst);
-
             break;
 
         case OMX_COLOR_FormatCbYCrY:
             err = convertCbYCrY(src, dst);
             break;
 
-        case OMX_QCOM_COLOR_FormatYVU420SemiPlanar:
-            if (!mSrcImage) {
-                mSrcImage = Image(CreateYUV420SemiPlanarMediaImage2(
-                    srcWidth, srcHeight, srcStride, srcHeight, 8 /*bitDepth*/, false));
-            }
-            err = convertYUVMediaImage(src, dst);
+        default:
 
+            CHECK(!"Should not be here. Unknown color conversion.");
             break;
+    }
+    return err;
+}
 
-        case OMX_COLOR_FormatYUV420SemiPlanar:
-        case OMX_TI_COLOR_FormatYUV420PackedSemiPlanar:
-            if (!mSrcImage) {
-                mSrcImage = Image(CreateYUV420SemiPlanarMediaImage2(
-                    srcWidth, srcHeight, srcStride, srcHeight, 8 /*bitDepth*/));
-            }
-            err = convertYUVMediaImage(src, dst);
+void ColorConverter::setNumThreads(size_t numThreads) {
+    mNumThreads = std::max(numThreads, (size_t)1);
+    if (mWorkerPool && mWorkerPool->numWorkers() != mNumThreads - 1) {
+        mWorkerPool.reset();
+    }
+}
+
+// static
+size_t ColorConverter::GetDefaultNumThreads() {
+    size_t numCpus = std::thread::hardware_concurrency();
+    return std::clamp(numCpus, (size_t)1, kMaxDefaultThreads);
+}
+
+size_t ColorConverter::getBandAlignment() const {
+    size_t alignment = 2;
+    if (mSrcImage) {
+        const MediaImage2 &image = mSrcImage->getMediaImage2();
+        alignment = std::max({alignment,
+                (size_t)image.mPlane[MediaImage2::PlaneIndex::U].mVertSubsampling,
+                (size_t)image.mPlane[MediaImage2::PlaneIndex::V].mVertSubsampling});
+    }
+    return alignment;
+}
+
+ColorConverter::WorkerPool *ColorConverter::getWorkerPool() {
+    if (!mWorkerPool) {
+        mWorkerPool = std::make_unique<WorkerPool>(mNumThreads - 1);
+    }
+    return mWorkerPool.get();
+}
+
+status_t ColorConverter::convertInBands(
+        const BitmapParams &src, const BitmapParams &dst, size_t numBands) {
+    // Set up the shared tables before the bands start to run.
+    (void)initClip();
+
+    // Every band but the last one covers a whole number of chroma rows.
+    const size_t alignment = getBandAlignment();
+    const size_t height = src.cropHeight();
+    size_t rowsPerBand = (height + numBands - 1) / numBands;
+    rowsPerBand = (rowsPerBand + alignment - 1) / alignment * alignment;
+    numBands = (height + rowsPerBand - 1) / rowsPerBand;
+
+    return getWorkerPool()->run(numBands, [&](size_t band) -> status_t {
+        size_t top = band * rowsPerBand;
+        size_t rows = std::min(rowsPerBand, height - top);
+        BitmapParams bandSrc = src;
+        bandSrc.mCropTop += top;
+        bandSrc.mCropBottom = bandSrc.mCropTop + rows - 1;
+        BitmapParams bandDst = dst;
+        bandDst.mCropTop += top;
+        bandDst.mCropBottom = bandDst.mCropTop + rows - 1;
+        return convertBand(bandSrc, bandDst);
+    });
+}
+
+bool ColorConverter::isValidForScaling() const {
+    OMX_COLOR_FORMATTYPE scaledFormat;
+    return isValid() && getScaledFormat(&scaledFormat);
+}
+
+bool ColorConverter::getScaledFormat(OMX_COLOR_FORMATTYPE *format) const {
+    switch ((int32_t)mSrcFormat) {
+        case OMX_COLOR_FormatYUV420Planar16:
+        case COLOR_FormatYUVP010:
+            *format = mSrcFormat;
+            return true;
+
+        case OMX_COLOR_FormatCbYCrY:
+            return false;
 
+        default:
             break;
+    }
 
+    if (mSrcImage) {
+        if (mSrcImage->getBitDepth() != ImageBitDepth8) {
+            return false;
+        }
+        switch (mSrcImage->getLayout()) {
+            case ImageLayout420Planar:
+                *format = OMX_COLOR_FormatYUV420Planar;
+                return true;
+            case ImageLayout420SemiPlanar:
+                *format = mSrcImage->isNV21()
+                        ? OMX_QCOM_COLOR_FormatYVU420SemiPlanar
+                        : OMX_COLOR_FormatYUV420SemiPlanar;
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    switch ((int32_t)mSrcFormat) {
+        case OMX_COLOR_FormatYUV420Planar:
+        case OMX_QCOM_COLOR_FormatYVU420SemiPlanar:
+            *format = mSrcFormat;
+            return true;
+        case OMX_COLOR_FormatYUV420SemiPlanar:
+        case OMX_TI_COLOR_FormatYUV420PackedSemiPlanar:
+            *format = OMX_COLOR_FormatYUV420SemiPlanar;
+            return true;
         default:
+            return false;
+    }
+}
 
-            CHECK(!"Should not be here. Unknown color conversion.");
-            break;
+/*
+ * Downscales the source planes into an intermediate frame at the dst crop
+ * size, in the same layout and bit depth as the source, and converts that.
+ * The full resolution frame is only read once and never converted.
+ */
+status_t ColorConverter::convertScaled(
+        const BitmapParams &src, const BitmapParams &dst) {
+    OMX_COLOR_FORMATTYPE scaledFormat;
+    if (!getScaledFormat(&scaledFormat)) {
+        return ERROR_UNSUPPORTED;
+    }
+    const bool isSemiPlanar = (scaledFormat != OMX_COLOR_FormatYUV420Planar
+            && scaledFormat != OMX_COLOR_FormatYUV420Planar16);
+    const bool is16Bit = (src.mBpp == 2);
+
+    const uint8_t *srcBits = (const uint8_t *)src.mBits;
+    const uint8_t *srcY, *srcU, *srcV = nullptr;
+    size_t srcYStride, srcUStride, srcVStride;
+    if (is16Bit) {
+        srcYStride = src.mStride;
+        srcY = srcBits + src.mCropTop * src.mStride + src.mCropLeft * src.mBpp;
+        if (isSemiPlanar) {
+            srcUStride = src.mStride;
+            srcU = srcBits + src.mStride * src.mHeight
+                    + (src.mCropTop / 2) * src.mStride + src.mCropLeft * src.mBpp;
+        } else {
+            srcUStride = srcVStride = src.mStride / 2;
+            srcU = srcBits + src.mStride * src.mHeight
+                    + (src.mCropTop / 2) * (src.mStride / 2) + (src.mCropLeft / 2) * src.mBpp;
+            srcV = srcU + (src.mStride / 2) * (src.mHeight / 2);
+        }
+    } else {
+        uint32_t yOffset, uOffset, vOffset;
+        status_t err = getSrcYUVPlaneOffsetAndStride(
+                src, &yOffset, &uOffset, &vOffset, &srcYStride, &srcUStride, &srcVStride);
+        if (err != OK) {
+            return err;
+        }
+        srcY = srcBits + yOffset;
+        if (isSemiPlanar) {
+            // NV21 is scaled as NV21, starting at the V sample.
+            srcU = srcBits + std::min(uOffset, vOffset);
+        } else {
+            srcU = srcBits + uOffset;
+            srcV = srcBits + vOffset;
+        }
     }
 
-#if PERF_PROFILING
-    int64_t endTimeUs = ALooper::GetNowUs();
-    ALOGD("%s image took %lld us", asString_ColorFormat(mSrcFormat,"Unknown"),
-            (long long) (endTimeUs - startTimeUs));
-#endif
+    // Even dimensions, so that chroma planes have whole rows and columns.
+    const size_t width = dst.cropWidth();
+    const size_t height = dst.cropHeight();
+    BitmapParams scaled(
+            nullptr, (width + 1) & ~1, (height + 1) & ~1, 0 /* stride */,
+            0, 0, width - 1, height - 1, scaledFormat);
+    mScaledFrame.resize(scaled.mStride * scaled.mHeight * 3 / 2);
+    scaled.mBits = mScaledFrame.data();
+
+    uint8_t *dstY = mScaledFrame.data();
+    uint8_t *dstU = dstY + scaled.mStride * scaled.mHeight;
+    uint8_t *dstV = isSemiPlanar ? nullptr : dstU + (scaled.mStride / 2) * (scaled.mHeight / 2);
+    const size_t dstUVStride = isSemiPlanar ? scaled.mStride : scaled.mStride / 2;
+
+    const size_t srcWidth = src.cropWidth();
+    const size_t srcHeight = src.cropHeight();
+    size_t numBands = std::min({mNumThreads, srcHeight / kMinRowsPerBand, height / 2});
+    size_t rowsPerBand = height;
+    if (numBands > 1) {
+        rowsPerBand = ((height + numBands - 1) / numBands + 1) & ~1;
+        numBands = (height + rowsPerBand - 1) / rowsPerBand;
+    }
 
-    return err;
+    // Each band maps its dst rows to the src rows they cover, starting both
+    // on a chroma row.
+    auto scaleBand = [&](size_t band) -> status_t {
+        const size_t top = band * rowsPerBand;
+        const size_t bottom = std::min(top + rowsPerBand, height);
+        const size_t srcTop = (top * srcHeight / height) & ~1;
+        const size_t srcBottom =
+                (bottom == height) ? srcHeight : (bottom * srcHeight / height) & ~1;
+
+        ScalePlane(srcY + srcTop * srcYStride, srcYStride, srcWidth, srcBottom - srcTop,
+                dstY + top * scaled.mStride, scaled.mStride, width, bottom - top,
+                is16Bit, false /* isInterleaved */);
+
+        const size_t srcChromaTop = srcTop / 2;
+        const size_t srcChromaRows = (srcBottom + 1) / 2 - srcChromaTop;
+        const size_t chromaTop = top / 2;
+        const size_t chromaRows = (bottom + 1) / 2 - chromaTop;
+        ScalePlane(srcU + srcChromaTop * srcUStride, srcUStride,
+                (srcWidth + 1) / 2, srcChromaRows,
+                dstU + chromaTop * dstUVStride, dstUVStride, (width + 1) / 2, chromaRows,
+                is16Bit, isSemiPlanar);
+        if (!isSemiPlanar) {
+            ScalePlane(srcV + srcChromaTop * srcVStride, srcVStride,
+                    (srcWidth + 1) / 2, srcChromaRows,
+                    dstV + chromaTop * dstUVStride, dstUVStride, (width + 1) / 2, chromaRows,
+                    is16Bit, false /* isInterleaved */);
+        }
+        return OK;
+    };
+    if (numBands > 1) {
+        (void)getWorkerPool()->run(numBands, scaleBand);
+    } else {
+        (void)scaleBand(0);
+    }
+
+    if (!mScaledConverter || mScaledConverter->mSrcFormat != scaledFormat) {
+        mScaledConverter.reset(new ColorConverter(scaledFormat, mDstFormat));
+    }
+    mScaledConverter->mSrcColorSpace = mSrcColorSpace;
+    // the layout is derived from the size of the intermediate frame
+    mScaledConverter->mSrcImage.reset();
+    mScaledConverter->setNumThreads(mNumThreads);
+    return mScaledConverter->convert(
+            scaled.mBits, scaled.mWidth, scaled.mHeight, scaled.mStride,
+            0, 0, width - 1, height - 1,
+            dst.mBits, dst.mWidth, dst.mHeight, dst.mStride,
+            dst.mCropLeft, dst.mCropTop, dst.mCropRight, dst.mCropBottom);
 }
 
 const struct ColorConverter::Coeffs *ColorConverter::getMatrix() const {
@@ -776,15 +1174,7 @@ status_t ColorConverter::convertCbYCrY(
     if (!matrix) {
         return ERROR_UNSUPPORTED;
     }
-
-    signed _b_u = matrix->_b_u;
-    signed _neg_g_u = -matrix->_g_u;
-    signed _neg_g_v = -matrix->_g_v;
-    signed _r_v = matrix->_r_v;
-    signed _y = matrix->_y;
-    signed _c16 = matrix->_c16;
-
-    uint8_t *kAdjustedClip = initClip();
+    const YuvRowCoeffs coeffs = RowCoeffs(*matrix, 1);
 
     uint16_t *dst_ptr = (uint16_t *)dst.mBits
         + dst.mCropTop * dst.mWidth + dst.mCropLeft;
@@ -793,43 +1183,7 @@ status_t ColorConverter::convertCbYCrY(
         + (src.mCropTop * src.mWidth + src.mCropLeft) * 2;
 
     for (size_t y = 0; y < src.cropHeight(); ++y) {
-        for (size_t x = 0; x < src.cropWidth() - 1; x += 2) {
-            signed y1 = (signed)src_ptr[2 * x + 1] - _c16;
-            signed y2 = (signed)src_ptr[2 * x + 3] - _c16;
-            signed u = (signed)src_ptr[2 * x] - 128;
-            signed v = (signed)src_ptr[2 * x + 2] - 128;
-
-            signed u_b = u * _b_u;
-            signed u_g = u * _neg_g_u;
-            signed v_g = v * _neg_g_v;
-            signed v_r = v * _r_v;
-
-            signed tmp1 = y1 * _y + 128;
-            signed b1 = (tmp1 + u_b) / 256;
-            signed g1 = (tmp1 + v_g + u_g) / 256;
-            signed r1 = (tmp1 + v_r) / 256;
-
-            signed tmp2 = y2 * _y + 128;
-            signed b2 = (tmp2 + u_b) / 256;
-            signed g2 = (tmp2 + v_g + u_g) / 256;
-            signed r2 = (tmp2 + v_r) / 256;
-
-            uint32_t rgb1 =
-                ((kAdjustedClip[r1] >> 3) << 11)
-                | ((kAdjustedClip[g1] >> 2) << 5)
-                | (kAdjustedClip[b1] >> 3);
-
-            uint32_t rgb2 =
-                ((kAdjustedClip[r2] >> 3) << 11)
-                | ((kAdjustedClip[g2] >> 2) << 5)
-                | (kAdjustedClip[b2] >> 3);
-
-            if (x + 1 < src.cropWidth()) {
-                *(uint32_t *)(&dst_ptr[x]) = (rgb2 << 16) | rgb1;
-            } else {
-                dst_ptr[x] = rgb1;
-            }
-        }
+        ConvertCbYCrYRowToRGB565(src_ptr, dst_ptr, src.cropWidth(), coeffs);
 
         src_ptr += src.mWidth * 2;
         dst_ptr += dst.mWidth;
@@ -1383,18 +1737,8 @@ status_t ColorConverter::convertYUV420Planar16(
     if (!matrix) {
         return ERROR_UNSUPPORTED;
     }
-
-    signed _b_u = matrix->_b_u;
-    signed _neg_g_u = -matrix->_g_u;
-    signed _neg_g_v = -matrix->_g_v;
-    signed _r_v = matrix->_r_v;
-    signed _y = matrix->_y;
-    signed _c16 = matrix->_c16;
-
-    uint8_t *kAdjustedClip = initClip();
-
-    auto readFromSrc = getReadFromChromaHorizSubsampled2Image8b(std::nullopt, mSrcFormat);
-    auto writeToDst = getWriteToDst(mDstFormat, (void *)kAdjustedClip);
+    // the 10-bit samples are reduced to 8 bits before the conversion
+    const YuvRowCoeffs coeffs = RowCoeffs(*matrix, 1);
 
     uint8_t *dst_ptr = (uint8_t *)dst.mBits
             + dst.mCropTop * dst.mStride + dst.mCropLeft * dst.mBpp;
@@ -1408,28 +1752,9 @@ status_t ColorConverter::convertYUV420Planar16(
     uint8_t *src_v = src_u + (src.mStride / 2) * (src.mHeight / 2);
 
     for (size_t y = 0; y < src.cropHeight(); ++y) {
-        for (size_t x = 0; x < src.cropWidth(); x += 2) {
-            signed y1, y2, u, v;
-            readFromSrc(src_y, src_u, src_v, x, &y1, &y2, &u, &v);
-
-            signed u_b = u * _b_u;
-            signed u_g = u * _neg_g_u;
-            signed v_g = v * _neg_g_v;
-            signed v_r = v * _r_v;
-
-            signed tmp1 = (y1 - _c16) * _y + 128;
-            signed b1 = (tmp1 + u_b) / 256;
-            signed g1 = (tmp1 + v_g + u_g) / 256;
-            signed r1 = (tmp1 + v_r) / 256;
-
-            signed tmp2 = (y2 - _c16) * _y + 128;
-            signed b2 = (tmp2 + u_b) / 256;
-            signed g2 = (tmp2 + v_g + u_g) / 256;
-            signed r2 = (tmp2 + v_r) / 256;
-
-            bool uncropped = x + 1 < src.cropWidth();
-            writeToDst(dst_ptr + x * dst.mBpp, uncropped, r1, g1, b1, r2, g2, b2);
-        }
+        ConvertPlanar16RowToRGB(
+                (const uint16_t *)src_y, (const uint16_t *)src_u, (const uint16_t *)src_v,
+                dst_ptr, src.cropWidth(), mDstFormat, coeffs);
 
         src_y += src.mStride;
 
@@ -1458,18 +1783,7 @@ status_t ColorConverter::convertYUVP010ToRGBA1010102(
     if (!matrix) {
         return ERROR_UNSUPPORTED;
     }
-
-    signed _b_u = matrix->_b_u;
-    signed _neg_g_u = -matrix->_g_u;
-    signed _neg_g_v = -matrix->_g_v;
-    signed _r_v = matrix->_r_v;
-    signed _y = matrix->_y;
-    signed _c64 = matrix->_c16 * 4;
-
-    uint16_t *kAdjustedClip10bit = initClip10Bit();
-
-//    auto readFromSrc = getReadFromSrc(mSrcFormat);
-    auto writeToDst = getWriteToDst(mDstFormat, (void *)kAdjustedClip10bit);
+    const YuvRowCoeffs coeffs = RowCoeffs(*matrix, 4 /* lumaOffsetScale */);
 
     uint8_t *dst_ptr = (uint8_t *)dst.mBits
             + dst.mCropTop * dst.mStride + dst.mCropLeft * dst.mBpp;
@@ -1482,32 +1796,7 @@ status_t ColorConverter::convertYUVP010ToRGBA1010102(
             + (src.mCropTop / 2) * src.mStride + src.mCropLeft * src.mBpp);
 
     for (size_t y = 0; y < src.cropHeight(); ++y) {
-        for (size_t x = 0; x < src.cropWidth(); x += 2) {
-            signed y1, y2, u, v;
-            y1 = (src_y[x] >> 6) - _c64;
-            y2 = (src_y[x + 1] >> 6) - _c64;
-            u = int(src_uv[x] >> 6) - 512;
-            v = int(src_uv[x + 1] >> 6) - 512;
-
-            signed u_b = u * _b_u;
-            signed u_g = u * _neg_g_u;
-            signed v_g = v * _neg_g_v;
-            signed v_r = v * _r_v;
-
-            signed tmp1 = y1 * _y + 128;
-            signed b1 = (tmp1 + u_b) / 256;
-            signed g1 = (tmp1 + v_g + u_g) / 256;
-            signed r1 = (tmp1 + v_r) / 256;
-
-            signed tmp2 = y2 * _y + 128;
-            signed b2 = (tmp2 + u_b) / 256;
-            signed g2 = (tmp2 + v_g + u_g) / 256;
-            signed r2 = (tmp2 + v_r) / 256;
-
-            bool uncropped = x + 1 < src.cropWidth();
-
-            writeToDst(dst_ptr + x * dst.mBpp, uncropped, r1, g1, b1, r2, g2, b2);
-        }
+        ConvertP010RowToRGBA1010102(src_y, src_uv, (uint32_t *)dst_ptr, src.cropWidth(), coeffs);
 
         src_y += src.mStride / 2;
 
@@ -1521,9 +1810,6 @@ status_t ColorConverter::convertYUVP010ToRGBA1010102(
     return OK;
 }
 
-
-#if !USE_NEON_Y410
-
 status_t ColorConverter::convertYUV420Planar16ToY410(
         const BitmapParams &src, const BitmapParams &dst) {
     uint8_t *dst_ptr = (uint8_t *)dst.mBits
@@ -1539,189 +1825,22 @@ status_t ColorConverter::convertYUV420Planar16ToY410(
     const uint8_t *src_v =
         src_u + (src.mStride / 2) * (src.mHeight / 2);
 
-    // Converting two lines at a time, slightly faster
-    for (size_t y = 0; y < src.cropHeight(); y += 2) {
-        uint32_t *dst_top = (uint32_t *) dst_ptr;
-        uint32_t *dst_bot = (uint32_t *) (dst_ptr + dst.mStride);
-        uint16_t *ptr_ytop = (uint16_t*) src_y;
-        uint16_t *ptr_ybot = (uint16_t*) (src_y + src.mStride);
-        uint16_t *ptr_u = (uint16_t*) src_u;
-        uint16_t *ptr_v = (uint16_t*) src_v;
-
-        uint32_t u01, v01, y01, y23, y45, y67, uv0, uv1;
-        size_t x = 0;
-        // x % 4 is always 0 so x + 3 will never overflow.
-        for (; x + 3 < src.cropWidth(); x += 4) {
-            u01 = *((uint32_t*)ptr_u); ptr_u += 2;
-            v01 = *((uint32_t*)ptr_v); ptr_v += 2;
-
-            y01 = *((uint32_t*)ptr_ytop); ptr_ytop += 2;
-            y23 = *((uint32_t*)ptr_ytop); ptr_ytop += 2;
-            y45 = *((uint32_t*)ptr_ybot); ptr_ybot += 2;
-            y67 = *((uint32_t*)ptr_ybot); ptr_ybot += 2;
-
-            uv0 = (u01 & 0x3FF) | ((v01 & 0x3FF) << 20);
-            uv1 = (u01 >> 16) | ((v01 >> 16) << 20);
-
-            *dst_top++ = ((y01 & 0x3FF) << 10) | uv0;
-            *dst_top++ = ((y01 >> 16) << 10) | uv0;
-            *dst_top++ = ((y23 & 0x3FF) << 10) | uv1;
-            *dst_top++ = ((y23 >> 16) << 10) | uv1;
-
-            *dst_bot++ = ((y45 & 0x3FF) << 10) | uv0;
-            *dst_bot++ = ((y45 >> 16) << 10) | uv0;
-            *dst_bot++ = ((y67 & 0x3FF) << 10) | uv1;
-            *dst_bot++ = ((y67 >> 16) << 10) | uv1;
-        }
-
-        // There should be at most 2 more pixels to process. Note that we don't
-        // need to consider odd case as the buffer is always aligned to even.
-        if (x < src.cropWidth()) {
-            u01 = *ptr_u;
-            v01 = *ptr_v;
-            y01 = *((uint32_t*)ptr_ytop);
-            y45 = *((uint32_t*)ptr_ybot);
-            uv0 = (u01 & 0x3FF) | ((v01 & 0x3FF) << 20);
-            *dst_top++ = ((y01 & 0x3FF) << 10) | uv0;
-            *dst_top++ = ((y01 >> 16) << 10) | uv0;
-            *dst_bot++ = ((y45 & 0x3FF) << 10) | uv0;
-            *dst_bot++ = ((y45 >> 16) << 10) | uv0;
-        }
-
-        src_y += src.mStride * 2;
-        src_u += src.mStride / 2;
-        src_v += src.mStride / 2;
-        dst_ptr += dst.mStride * 2;
-    }
-
-    return OK;
-}
-
-#else
-
-status_t ColorConverter::convertYUV420Planar16ToY410(
-        const BitmapParams &src, const BitmapParams &dst) {
-    uint8_t *out = (uint8_t *)dst.mBits
-        + dst.mCropTop * dst.mStride + dst.mCropLeft * dst.mBpp;
-
-    const uint8_t *src_y =
-        (const uint8_t *)src.mBits + src.mCropTop * src.mStride + src.mCropLeft * src.mBpp;
-
-    const uint8_t *src_u =
-        (const uint8_t *)src.mBits + src.mStride * src.mHeight
-        + (src.mCropTop / 2) * (src.mStride / 2) + (src.mCropLeft / 2) * src.mBpp;
-
-    const uint8_t *src_v =
-        src_u + (src.mStride / 2) * (src.mHeight / 2);
-
-    for (size_t y = 0; y < src.cropHeight(); y++) {
-        uint16_t *ptr_y = (uint16_t*) src_y;
-        uint16_t *ptr_u = (uint16_t*) src_u;
-        uint16_t *ptr_v = (uint16_t*) src_v;
-        uint32_t *ptr_out = (uint32_t *) out;
-
-        // Process 16-pixel at a time.
-        uint32_t *ptr_limit = ptr_out + (src.cropWidth() & ~15);
-        while (ptr_out < ptr_limit) {
-            uint16x4_t u0123 = vld1_u16(ptr_u); ptr_u += 4;
-            uint16x4_t u4567 = vld1_u16(ptr_u); ptr_u += 4;
-            uint16x4_t v0123 = vld1_u16(ptr_v); ptr_v += 4;
-            uint16x4_t v4567 = vld1_u16(ptr_v); ptr_v += 4;
-            uint16x4_t y0123 = vld1_u16(ptr_y); ptr_y += 4;
-            uint16x4_t y4567 = vld1_u16(ptr_y); ptr_y += 4;
-            uint16x4_t y89ab = vld1_u16(ptr_y); ptr_y += 4;
-            uint16x4_t ycdef = vld1_u16(ptr_y); ptr_y += 4;
-
-            uint32x2_t uvtempl;
-            uint32x4_t uvtempq;
-
-            uvtempq = vaddw_u16(vshll_n_u16(v0123, 20), u0123);
-
-            uvtempl = vget_low_u32(uvtempq);
-            uint32x4_t uv0011 = vreinterpretq_u32_u64(
-                    vaddw_u32(vshll_n_u32(uvtempl, 32), uvtempl));
-
-            uvtempl = vget_high_u32(uvtempq);
-            uint32x4_t uv2233 = vreinterpretq_u32_u64(
-                    vaddw_u32(vshll_n_u32(uvtempl, 32), uvtempl));
-
-            uvtempq = vaddw_u16(vshll_n_u16(v4567, 20), u4567);
-
-            uvtempl = vget_low_u32(uvtempq);
-            uint32x4_t uv4455 = vreinterpretq_u32_u64(
-                    vaddw_u32(vshll_n_u32(uvtempl, 32), uvtempl));
-
-            uvtempl = vget_high_u32(uvtempq);
-            uint32x4_t uv6677 = vreinterpretq_u32_u64(
-                    vaddw_u32(vshll_n_u32(uvtempl, 32), uvtempl));
-
-            uint32x4_t dsttemp;
-
-            dsttemp = vorrq_u32(uv0011, vshll_n_u16(y0123, 10));
-            vst1q_u32(ptr_out, dsttemp); ptr_out += 4;
-
-            dsttemp = vorrq_u32(uv2233, vshll_n_u16(y4567, 10));
-            vst1q_u32(ptr_out, dsttemp); ptr_out += 4;
-
-            dsttemp = vorrq_u32(uv4455, vshll_n_u16(y89ab, 10));
-            vst1q_u32(ptr_out, dsttemp); ptr_out += 4;
-
-            dsttemp = vorrq_u32(uv6677, vshll_n_u16(ycdef, 10));
-            vst1q_u32(ptr_out, dsttemp); ptr_out += 4;
-        }
+    for (size_t y = 0; y < src.cropHeight(); ++y) {
+        ConvertPlanar16RowToY410(
+                (const uint16_t *)src_y, (const uint16_t *)src_u, (const uint16_t *)src_v,
+                (uint32_t *)dst_ptr, src.cropWidth());
 
         src_y += src.mStride;
         if (y & 1) {
             src_u += src.mStride / 2;
             src_v += src.mStride / 2;
         }
-        out += dst.mStride;
-    }
-
-    // Process the left-overs out-of-loop, 2-pixel at a time. Note that we don't
-    // need to consider odd case as the buffer is always aligned to even.
-    if (src.cropWidth() & 15) {
-        size_t xstart = (src.cropWidth() & ~15);
-
-        uint8_t *out = (uint8_t *)dst.mBits + dst.mCropTop * dst.mStride
-                + (dst.mCropLeft + xstart) * dst.mBpp;
-
-        const uint8_t *src_y = (const uint8_t *)src.mBits + src.mCropTop * src.mStride
-                + (src.mCropLeft + xstart) * src.mBpp;
-
-        const uint8_t *src_u = (const uint8_t *)src.mBits + src.mStride * src.mHeight
-            + (src.mCropTop / 2) * (src.mStride / 2)
-            + ((src.mCropLeft + xstart) / 2) * src.mBpp;
-
-        const uint8_t *src_v = src_u + (src.mStride / 2) * (src.mHeight / 2);
-
-        for (size_t y = 0; y < src.cropHeight(); y++) {
-            uint16_t *ptr_y = (uint16_t*) src_y;
-            uint16_t *ptr_u = (uint16_t*) src_u;
-            uint16_t *ptr_v = (uint16_t*) src_v;
-            uint32_t *ptr_out = (uint32_t *) out;
-            for (size_t x = xstart; x < src.cropWidth(); x += 2) {
-                uint16_t u = *ptr_u++;
-                uint16_t v = *ptr_v++;
-                uint32_t y01 = *((uint32_t*)ptr_y); ptr_y += 2;
-                uint32_t uv = u | (((uint32_t)v) << 20);
-                *ptr_out++ = ((y01 & 0x3FF) << 10) | uv;
-                *ptr_out++ = ((y01 >> 16) << 10) | uv;
-            }
-            src_y += src.mStride;
-            if (y & 1) {
-                src_u += src.mStride / 2;
-                src_v += src.mStride / 2;
-            }
-            out += dst.mStride;
-        }
+        dst_ptr += dst.mStride;
     }
 
     return OK;
 }
 
-#endif // USE_NEON_Y410
-
 uint8_t *ColorConverter::initClip() {
     if (mClip == NULL) {
         mClip = new uint8_t[CLIP_RANGE_MAX_8BIT - CLIP_RANGE_MIN_8BIT + 1];
@@ -1734,16 +1853,4 @@ uint8_t *ColorConverter::initClip() {
     return &mClip[-CLIP_RANGE_MIN_8BIT];
 }
 
-uint16_t *ColorConverter::initClip10Bit() {
-    if (mClip10Bit == NULL) {
-        mClip10Bit = new uint16_t[CLIP_RANGE_MAX_10BIT - CLIP_RANGE_MIN_10BIT + 1];
-
-        for (signed i = CLIP_RANGE_MIN_10BIT; i <= CLIP_RANGE_MAX_10BIT; ++i) {
-            mClip10Bit[i - CLIP_RANGE_MIN_10BIT] = (i < 0) ? 0 : (i > 1023) ? 1023 : (uint16_t)i;
-        }
-    }
-
-    return &mClip10Bit[-CLIP_RANGE_MIN_10BIT];
-}
-
 }  // namespace android
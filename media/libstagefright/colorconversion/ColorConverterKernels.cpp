@@ -0,0 +1,825 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "ColorConverterKernels"
+#include <utils/Log.h>
+
+#include "ColorConverterKernels.h"
+
+#if defined(__aarch64__) || defined(__ARM_NEON__)
+#define USE_NEON_KERNELS 1
+#include <arm_neon.h>
+#else
+#define USE_NEON_KERNELS 0
+#endif
+
+#if defined(__SSE4_1__)
+#define USE_SSE41_KERNELS 1
+#include <immintrin.h>
+#else
+#define USE_SSE41_KERNELS 0
+#endif
+
+// AVX2 is not part of the x86 ABI; it is used when the CPU reports it.
+#if USE_SSE41_KERNELS && (defined(__clang__) || defined(__GNUC__))
+#define USE_AVX2_KERNELS 1
+#define AVX2_KERNEL __attribute__((target("avx2")))
+#else
+#define USE_AVX2_KERNELS 0
+#endif
+
+namespace android {
+
+// The scalar code divides by 256, which rounds towards zero, while the
+// vectorized code shifts right by 8, which rounds towards negative infinity.
+// The two only differ for negative values, which are clipped to 0 either way.
+
+static inline int32_t Clip(int32_t value, int32_t max) {
+    return value < 0 ? 0 : value > max ? max : value;
+}
+
+static inline uint32_t PackRGBA1010102(int32_t r, int32_t g, int32_t b) {
+    return Clip(r, 1023) | (Clip(g, 1023) << 10) | (Clip(b, 1023) << 20) | (3u << 30);
+}
+
+static inline uint16_t PackRGB565(int32_t r, int32_t g, int32_t b) {
+    return ((Clip(r, 255) >> 3) << 11) | ((Clip(g, 255) >> 2) << 5) | (Clip(b, 255) >> 3);
+}
+
+static inline void WriteRGB8(
+        uint8_t *dst, size_t x, OMX_COLOR_FORMATTYPE dstFormat,
+        int32_t r, int32_t g, int32_t b) {
+    switch ((int32_t)dstFormat) {
+        case OMX_COLOR_Format16bitRGB565:
+            ((uint16_t *)dst)[x] = PackRGB565(r, g, b);
+            break;
+        case OMX_COLOR_Format32BitRGBA8888:
+            ((uint32_t *)dst)[x] =
+                    Clip(r, 255) | (Clip(g, 255) << 8) | (Clip(b, 255) << 16) | (0xFFu << 24);
+            break;
+        case OMX_COLOR_Format32bitBGRA8888:
+            ((uint32_t *)dst)[x] =
+                    Clip(b, 255) | (Clip(g, 255) << 8) | (Clip(r, 255) << 16) | (0xFFu << 24);
+            break;
+        default:
+            break;
+    }
+}
+
+void ConvertP010RowToRGBA1010102_C(
+        const uint16_t *srcY, const uint16_t *srcUV, uint32_t *dst, size_t width,
+        const YuvRowCoeffs &coeffs) {
+    for (size_t x = 0; x < width; x += 2) {
+        signed y1 = (srcY[x] >> 6) - coeffs.mC16;
+        signed y2 = (srcY[x + 1] >> 6) - coeffs.mC16;
+        signed u = int(srcUV[x] >> 6) - 512;
+        signed v = int(srcUV[x + 1] >> 6) - 512;
+
+        signed u_b = u * coeffs.mBU;
+        signed u_g = u * coeffs.mNegGU;
+        signed v_g = v * coeffs.mNegGV;
+        signed v_r = v * coeffs.mRV;
+
+        signed tmp1 = y1 * coeffs.mY + 128;
+        dst[x] = PackRGBA1010102(
+                (tmp1 + v_r) / 256, (tmp1 + v_g + u_g) / 256, (tmp1 + u_b) / 256);
+
+        if (x + 1 < width) {
+            signed tmp2 = y2 * coeffs.mY + 128;
+            dst[x + 1] = PackRGBA1010102(
+                    (tmp2 + v_r) / 256, (tmp2 + v_g + u_g) / 256, (tmp2 + u_b) / 256);
+        }
+    }
+}
+
+void ConvertPlanar16RowToRGB_C(
+        const uint16_t *srcY, const uint16_t *srcU, const uint16_t *srcV,
+        uint8_t *dst, size_t width, OMX_COLOR_FORMATTYPE dstFormat,
+        const YuvRowCoeffs &coeffs) {
+    for (size_t x = 0; x < width; x += 2) {
+        signed y1 = (uint8_t)(srcY[x] >> 2);
+        signed y2 = (uint8_t)(srcY[x + 1] >> 2);
+        signed u = (uint8_t)(srcU[x / 2] >> 2) - 128;
+        signed v = (uint8_t)(srcV[x / 2] >> 2) - 128;
+
+        signed u_b = u * coeffs.mBU;
+        signed u_g = u * coeffs.mNegGU;
+        signed v_g = v * coeffs.mNegGV;
+        signed v_r = v * coeffs.mRV;
+
+        signed tmp1 = (y1 - coeffs.mC16) * coeffs.mY + 128;
+        WriteRGB8(dst, x, dstFormat,
+                (tmp1 + v_r) / 256, (tmp1 + v_g + u_g) / 256, (tmp1 + u_b) / 256);
+
+        if (x + 1 < width) {
+            signed tmp2 = (y2 - coeffs.mC16) * coeffs.mY + 128;
+            WriteRGB8(dst, x + 1, dstFormat,
+                    (tmp2 + v_r) / 256, (tmp2 + v_g + u_g) / 256, (tmp2 + u_b) / 256);
+        }
+    }
+}
+
+void ConvertPlanar16RowToY410_C(
+        const uint16_t *srcY, const uint16_t *srcU, const uint16_t *srcV,
+        uint32_t *dst, size_t width) {
+    for (size_t x = 0; x < width; ++x) {
+        uint32_t uv = (srcU[x / 2] & 0x3FF) | ((uint32_t)(srcV[x / 2] & 0x3FF) << 20);
+        dst[x] = ((uint32_t)(srcY[x] & 0x3FF) << 10) | uv;
+    }
+}
+
+void ConvertCbYCrYRowToRGB565_C(
+        const uint8_t *src, uint16_t *dst, size_t width, const YuvRowCoeffs &coeffs) {
+    for (size_t x = 0; x + 1 < width; x += 2) {
+        signed y1 = (signed)src[2 * x + 1] - coeffs.mC16;
+        signed y2 = (signed)src[2 * x + 3] - coeffs.mC16;
+        signed u = (signed)src[2 * x] - 128;
+        signed v = (signed)src[2 * x + 2] - 128;
+
+        signed u_b = u * coeffs.mBU;
+        signed u_g = u * coeffs.mNegGU;
+        signed v_g = v * coeffs.mNegGV;
+        signed v_r = v * coeffs.mRV;
+
+        signed tmp1 = y1 * coeffs.mY + 128;
+        signed tmp2 = y2 * coeffs.mY + 128;
+        dst[x] = PackRGB565(
+                (tmp1 + v_r) / 256, (tmp1 + v_g + u_g) / 256, (tmp1 + u_b) / 256);
+        dst[x + 1] = PackRGB565(
+                (tmp2 + v_r) / 256, (tmp2 + v_g + u_g) / 256, (tmp2 + u_b) / 256);
+    }
+}
+
+/*
+ * The vectorized kernels below handle 8 pixels per iteration and return the
+ * number of pixels converted, always a multiple of 8. Samples are first loaded
+ * as 16-bit lanes with each chroma sample duplicated for its two pixels, then
+ * widened to 32 bits for the matrix multiplication.
+ */
+
+#if USE_SSE41_KERNELS
+
+namespace {
+
+struct Yuv16 {
+    __m128i y, u, v;  // 8 pixels, 16-bit lanes
+};
+
+inline Yuv16 LoadP010_SSE41(const uint16_t *srcY, const uint16_t *srcUV) {
+    const __m128i dupU = _mm_setr_epi8(0, 1, 0, 1, 4, 5, 4, 5, 8, 9, 8, 9, 12, 13, 12, 13);
+    const __m128i dupV = _mm_setr_epi8(2, 3, 2, 3, 6, 7, 6, 7, 10, 11, 10, 11, 14, 15, 14, 15);
+    __m128i uv = _mm_srli_epi16(_mm_loadu_si128((const __m128i *)srcUV), 6);
+    return Yuv16{
+        _mm_srli_epi16(_mm_loadu_si128((const __m128i *)srcY), 6),
+        _mm_shuffle_epi8(uv, dupU),
+        _mm_shuffle_epi8(uv, dupV) };
+}
+
+inline Yuv16 LoadPlanar16_SSE41(
+        const uint16_t *srcY, const uint16_t *srcU, const uint16_t *srcV) {
+    __m128i u = _mm_loadl_epi64((const __m128i *)srcU);
+    __m128i v = _mm_loadl_epi64((const __m128i *)srcV);
+    return Yuv16{
+        _mm_loadu_si128((const __m128i *)srcY),
+        _mm_unpacklo_epi16(u, u),
+        _mm_unpacklo_epi16(v, v) };
+}
+
+// Planar16 samples reduced to 8 bits, as (uint8_t)(sample >> 2).
+inline Yuv16 LoadPlanar16To8Bit_SSE41(
+        const uint16_t *srcY, const uint16_t *srcU, const uint16_t *srcV) {
+    const __m128i mask = _mm_set1_epi16(0xFF);
+    Yuv16 s = LoadPlanar16_SSE41(srcY, srcU, srcV);
+    return Yuv16{
+        _mm_and_si128(_mm_srli_epi16(s.y, 2), mask),
+        _mm_and_si128(_mm_srli_epi16(s.u, 2), mask),
+        _mm_and_si128(_mm_srli_epi16(s.v, 2), mask) };
+}
+
+inline Yuv16 LoadCbYCrY_SSE41(const uint8_t *src) {
+    const __m128i shufY = _mm_setr_epi8(
+            1, -1, 3, -1, 5, -1, 7, -1, 9, -1, 11, -1, 13, -1, 15, -1);
+    const __m128i shufU = _mm_setr_epi8(
+            0, -1, 0, -1, 4, -1, 4, -1, 8, -1, 8, -1, 12, -1, 12, -1);
+    const __m128i shufV = _mm_setr_epi8(
+            2, -1, 2, -1, 6, -1, 6, -1, 10, -1, 10, -1, 14, -1, 14, -1);
+    __m128i s = _mm_loadu_si128((const __m128i *)src);
+    return Yuv16{
+        _mm_shuffle_epi8(s, shufY),
+        _mm_shuffle_epi8(s, shufU),
+        _mm_shuffle_epi8(s, shufV) };
+}
+
+inline __m128i Low32_SSE41(__m128i v) {
+    return _mm_cvtepu16_epi32(v);
+}
+
+inline __m128i High32_SSE41(__m128i v) {
+    return _mm_cvtepu16_epi32(_mm_unpackhi_epi64(v, v));
+}
+
+struct Coeffs_SSE41 {
+    explicit Coeffs_SSE41(const YuvRowCoeffs &c, int32_t uvOffset, int32_t max)
+        : y(_mm_set1_epi32(c.mY)),
+          rV(_mm_set1_epi32(c.mRV)),
+          negGU(_mm_set1_epi32(c.mNegGU)),
+          negGV(_mm_set1_epi32(c.mNegGV)),
+          bU(_mm_set1_epi32(c.mBU)),
+          c16(_mm_set1_epi32(c.mC16)),
+          uvOffset(_mm_set1_epi32(uvOffset)),
+          max(_mm_set1_epi32(max)) {}
+    __m128i y, rV, negGU, negGV, bU, c16, uvOffset, max;
+};
+
+struct Rgb_SSE41 {
+    __m128i r, g, b;  // 4 pixels, clipped
+};
+
+inline Rgb_SSE41 YuvToRgb_SSE41(__m128i y, __m128i u, __m128i v, const Coeffs_SSE41 &c) {
+    const __m128i zero = _mm_setzero_si128();
+    u = _mm_sub_epi32(u, c.uvOffset);
+    v = _mm_sub_epi32(v, c.uvOffset);
+    __m128i tmp = _mm_add_epi32(
+            _mm_mullo_epi32(_mm_sub_epi32(y, c.c16), c.y), _mm_set1_epi32(128));
+    __m128i r = _mm_srai_epi32(_mm_add_epi32(tmp, _mm_mullo_epi32(v, c.rV)), 8);
+    __m128i g = _mm_srai_epi32(_mm_add_epi32(tmp, _mm_add_epi32(
+            _mm_mullo_epi32(u, c.negGU), _mm_mullo_epi32(v, c.negGV))), 8);
+    __m128i b = _mm_srai_epi32(_mm_add_epi32(tmp, _mm_mullo_epi32(u, c.bU)), 8);
+    return Rgb_SSE41{
+        _mm_min_epi32(_mm_max_epi32(r, zero), c.max),
+        _mm_min_epi32(_mm_max_epi32(g, zero), c.max),
+        _mm_min_epi32(_mm_max_epi32(b, zero), c.max) };
+}
+
+inline __m128i Pack_SSE41(__m128i lo, int loShift, __m128i mid, int midShift,
+                          __m128i hi, int hiShift, uint32_t fill) {
+    return _mm_or_si128(
+            _mm_or_si128(_mm_sll_epi32(lo, _mm_cvtsi32_si128(loShift)),
+                         _mm_sll_epi32(mid, _mm_cvtsi32_si128(midShift))),
+            _mm_or_si128(_mm_sll_epi32(hi, _mm_cvtsi32_si128(hiShift)),
+                         _mm_set1_epi32((int32_t)fill)));
+}
+
+inline __m128i PackRGB565_SSE41(const Rgb_SSE41 &p) {
+    return Pack_SSE41(_mm_srli_epi32(p.b, 3), 0, _mm_srli_epi32(p.g, 2), 5,
+                      _mm_srli_epi32(p.r, 3), 11, 0);
+}
+
+inline void StoreRGB8_SSE41(
+        uint8_t *dst, OMX_COLOR_FORMATTYPE dstFormat, const Rgb_SSE41 &lo, const Rgb_SSE41 &hi) {
+    switch ((int32_t)dstFormat) {
+        case OMX_COLOR_Format16bitRGB565:
+            _mm_storeu_si128((__m128i *)dst,
+                    _mm_packus_epi32(PackRGB565_SSE41(lo), PackRGB565_SSE41(hi)));
+            break;
+        case OMX_COLOR_Format32BitRGBA8888:
+            _mm_storeu_si128((__m128i *)dst, Pack_SSE41(lo.r, 0, lo.g, 8, lo.b, 16, 0xFF000000));
+            _mm_storeu_si128((__m128i *)dst + 1,
+                    Pack_SSE41(hi.r, 0, hi.g, 8, hi.b, 16, 0xFF000000));
+            break;
+        case OMX_COLOR_Format32bitBGRA8888:
+            _mm_storeu_si128((__m128i *)dst, Pack_SSE41(lo.b, 0, lo.g, 8, lo.r, 16, 0xFF000000));
+            _mm_storeu_si128((__m128i *)dst + 1,
+                    Pack_SSE41(hi.b, 0, hi.g, 8, hi.r, 16, 0xFF000000));
+            break;
+        default:
+            break;
+    }
+}
+
+size_t P010RowToRGBA1010102_SSE41(
+        const uint16_t *srcY, const uint16_t *srcUV, uint32_t *dst, size_t width,
+        const YuvRowCoeffs &coeffs) {
+    const Coeffs_SSE41 c(coeffs, 512, 1023);
+    size_t x = 0;
+    for (; x + 8 <= width; x += 8) {
+        Yuv16 s = LoadP010_SSE41(srcY + x, srcUV + x);
+        Rgb_SSE41 lo = YuvToRgb_SSE41(Low32_SSE41(s.y), Low32_SSE41(s.u), Low32_SSE41(s.v), c);
+        Rgb_SSE41 hi = YuvToRgb_SSE41(
+                High32_SSE41(s.y), High32_SSE41(s.u), High32_SSE41(s.v), c);
+        _mm_storeu_si128((__m128i *)(dst + x), Pack_SSE41(lo.r, 0, lo.g, 10, lo.b, 20, 3u << 30));
+        _mm_storeu_si128((__m128i *)(dst + x + 4),
+                Pack_SSE41(hi.r, 0, hi.g, 10, hi.b, 20, 3u << 30));
+    }
+    return x;
+}
+
+size_t Planar16RowToRGB_SSE41(
+        const uint16_t *srcY, const uint16_t *srcU, const uint16_t *srcV,
+        uint8_t *dst, size_t width, OMX_COLOR_FORMATTYPE dstFormat,
+        const YuvRowCoeffs &coeffs) {
+    const Coeffs_SSE41 c(coeffs, 128, 255);
+    const size_t bpp = (dstFormat == OMX_COLOR_Format16bitRGB565) ? 2 : 4;
+    size_t x = 0;
+    for (; x + 8 <= width; x += 8) {
+        Yuv16 s = LoadPlanar16To8Bit_SSE41(srcY + x, srcU + x / 2, srcV + x / 2);
+        Rgb_SSE41 lo = YuvToRgb_SSE41(Low32_SSE41(s.y), Low32_SSE41(s.u), Low32_SSE41(s.v), c);
+        Rgb_SSE41 hi = YuvToRgb_SSE41(
+                High32_SSE41(s.y), High32_SSE41(s.u), High32_SSE41(s.v), c);
+        StoreRGB8_SSE41(dst + x * bpp, dstFormat, lo, hi);
+    }
+    return x;
+}
+
+size_t Planar16RowToY410_SSE41(
+        const uint16_t *srcY, const uint16_t *srcU, const uint16_t *srcV,
+        uint32_t *dst, size_t width) {
+    const __m128i mask = _mm_set1_epi16(0x3FF);
+    size_t x = 0;
+    for (; x + 8 <= width; x += 8) {
+        Yuv16 s = LoadPlanar16_SSE41(srcY + x, srcU + x / 2, srcV + x / 2);
+        s.y = _mm_and_si128(s.y, mask);
+        s.u = _mm_and_si128(s.u, mask);
+        s.v = _mm_and_si128(s.v, mask);
+        _mm_storeu_si128((__m128i *)(dst + x), Pack_SSE41(
+                Low32_SSE41(s.u), 0, Low32_SSE41(s.y), 10, Low32_SSE41(s.v), 20, 0));
+        _mm_storeu_si128((__m128i *)(dst + x + 4), Pack_SSE41(
+                High32_SSE41(s.u), 0, High32_SSE41(s.y), 10, High32_SSE41(s.v), 20, 0));
+    }
+    return x;
+}
+
+size_t CbYCrYRowToRGB565_SSE41(
+        const uint8_t *src, uint16_t *dst, size_t width, const YuvRowCoeffs &coeffs) {
+    const Coeffs_SSE41 c(coeffs, 128, 255);
+    size_t x = 0;
+    for (; x + 8 <= width; x += 8) {
+        Yuv16 s = LoadCbYCrY_SSE41(src + 2 * x);
+        Rgb_SSE41 lo = YuvToRgb_SSE41(Low32_SSE41(s.y), Low32_SSE41(s.u), Low32_SSE41(s.v), c);
+        Rgb_SSE41 hi = YuvToRgb_SSE41(
+                High32_SSE41(s.y), High32_SSE41(s.u), High32_SSE41(s.v), c);
+        _mm_storeu_si128((__m128i *)(dst + x),
+                _mm_packus_epi32(PackRGB565_SSE41(lo), PackRGB565_SSE41(hi)));
+    }
+    return x;
+}
+
+#if USE_AVX2_KERNELS
+
+// AVX2 converts all 8 pixels of an iteration in a single register.
+
+struct Coeffs_AVX2 {
+    AVX2_KERNEL explicit Coeffs_AVX2(const YuvRowCoeffs &c, int32_t uvOffset, int32_t max)
+        : y(_mm256_set1_epi32(c.mY)),
+          rV(_mm256_set1_epi32(c.mRV)),
+          negGU(_mm256_set1_epi32(c.mNegGU)),
+          negGV(_mm256_set1_epi32(c.mNegGV)),
+          bU(_mm256_set1_epi32(c.mBU)),
+          c16(_mm256_set1_epi32(c.mC16)),
+          uvOffset(_mm256_set1_epi32(uvOffset)),
+          max(_mm256_set1_epi32(max)) {}
+    __m256i y, rV, negGU, negGV, bU, c16, uvOffset, max;
+};
+
+struct Rgb_AVX2 {
+    __m256i r, g, b;  // 8 pixels, clipped
+};
+
+AVX2_KERNEL inline Rgb_AVX2 YuvToRgb_AVX2(const Yuv16 &s, const Coeffs_AVX2 &c) {
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i u = _mm256_sub_epi32(_mm256_cvtepu16_epi32(s.u), c.uvOffset);
+    __m256i v = _mm256_sub_epi32(_mm256_cvtepu16_epi32(s.v), c.uvOffset);
+    __m256i tmp = _mm256_add_epi32(
+            _mm256_mullo_epi32(_mm256_sub_epi32(_mm256_cvtepu16_epi32(s.y), c.c16), c.y),
+            _mm256_set1_epi32(128));
+    __m256i r = _mm256_srai_epi32(_mm256_add_epi32(tmp, _mm256_mullo_epi32(v, c.rV)), 8);
+    __m256i g = _mm256_srai_epi32(_mm256_add_epi32(tmp, _mm256_add_epi32(
+            _mm256_mullo_epi32(u, c.negGU), _mm256_mullo_epi32(v, c.negGV))), 8);
+    __m256i b = _mm256_srai_epi32(_mm256_add_epi32(tmp, _mm256_mullo_epi32(u, c.bU)), 8);
+    return Rgb_AVX2{
+        _mm256_min_epi32(_mm256_max_epi32(r, zero), c.max),
+        _mm256_min_epi32(_mm256_max_epi32(g, zero), c.max),
+        _mm256_min_epi32(_mm256_max_epi32(b, zero), c.max) };
+}
+
+AVX2_KERNEL inline __m256i Pack_AVX2(__m256i lo, int loShift, __m256i mid, int midShift,
+                                     __m256i hi, int hiShift, uint32_t fill) {
+    return _mm256_or_si256(
+            _mm256_or_si256(_mm256_sll_epi32(lo, _mm_cvtsi32_si128(loShift)),
+                            _mm256_sll_epi32(mid, _mm_cvtsi32_si128(midShift))),
+            _mm256_or_si256(_mm256_sll_epi32(hi, _mm_cvtsi32_si128(hiShift)),
+                            _mm256_set1_epi32((int32_t)fill)));
+}
+
+// Packs 8 32-bit RGB565 values into 8 16-bit lanes.
+AVX2_KERNEL inline __m128i PackRGB565_AVX2(const Rgb_AVX2 &p) {
+    __m256i rgb = Pack_AVX2(_mm256_srli_epi32(p.b, 3), 0, _mm256_srli_epi32(p.g, 2), 5,
+                            _mm256_srli_epi32(p.r, 3), 11, 0);
+    return _mm_packus_epi32(_mm256_castsi256_si128(rgb), _mm256_extracti128_si256(rgb, 1));
+}
+
+AVX2_KERNEL size_t P010RowToRGBA1010102_AVX2(
+        const uint16_t *srcY, const uint16_t *srcUV, uint32_t *dst, size_t width,
+        const YuvRowCoeffs &coeffs) {
+    const Coeffs_AVX2 c(coeffs, 512, 1023);
+    size_t x = 0;
+    for (; x + 8 <= width; x += 8) {
+        Rgb_AVX2 p = YuvToRgb_AVX2(LoadP010_SSE41(srcY + x, srcUV + x), c);
+        _mm256_storeu_si256((__m256i *)(dst + x), Pack_AVX2(p.r, 0, p.g, 10, p.b, 20, 3u << 30));
+    }
+    return x;
+}
+
+AVX2_KERNEL size_t Planar16RowToRGB_AVX2(
+        const uint16_t *srcY, const uint16_t *srcU, const uint16_t *srcV,
+        uint8_t *dst, size_t width, OMX_COLOR_FORMATTYPE dstFormat,
+        const YuvRowCoeffs &coeffs) {
+    const Coeffs_AVX2 c(coeffs, 128, 255);
+    size_t x = 0;
+    for (; x + 8 <= width; x += 8) {
+        Rgb_AVX2 p = YuvToRgb_AVX2(
+                LoadPlanar16To8Bit_SSE41(srcY + x, srcU + x / 2, srcV + x / 2), c);
+        switch ((int32_t)dstFormat) {
+            case OMX_COLOR_Format16bitRGB565:
+                _mm_storeu_si128((__m128i *)(dst + x * 2), PackRGB565_AVX2(p));
+                break;
+            case OMX_COLOR_Format32BitRGBA8888:
+                _mm256_storeu_si256((__m256i *)(dst + x * 4),
+                        Pack_AVX2(p.r, 0, p.g, 8, p.b, 16, 0xFF000000));
+                break;
+            case OMX_COLOR_Format32bitBGRA8888:
+                _mm256_storeu_si256((__m256i *)(dst + x * 4),
+                        Pack_AVX2(p.b, 0, p.g, 8, p.r, 16, 0xFF000000));
+                break;
+            default:
+                break;
+        }
+    }
+    return x;
+}
+
+AVX2_KERNEL size_t Planar16RowToY410_AVX2(
+        const uint16_t *srcY, const uint16_t *srcU, const uint16_t *srcV,
+        uint32_t *dst, size_t width) {
+    const __m128i mask = _mm_set1_epi16(0x3FF);
+    size_t x = 0;
+    for (; x + 8 <= width; x += 8) {
+        Yuv16 s = LoadPlanar16_SSE41(srcY + x, srcU + x / 2, srcV + x / 2);
+        _mm256_storeu_si256((__m256i *)(dst + x), Pack_AVX2(
+                _mm256_cvtepu16_epi32(_mm_and_si128(s.u, mask)), 0,
+                _mm256_cvtepu16_epi32(_mm_and_si128(s.y, mask)), 10,
+                _mm256_cvtepu16_epi32(_mm_and_si128(s.v, mask)), 20, 0));
+    }
+    return x;
+}
+
+AVX2_KERNEL size_t CbYCrYRowToRGB565_AVX2(
+        const uint8_t *src, uint16_t *dst, size_t width, const YuvRowCoeffs &coeffs) {
+    const Coeffs_AVX2 c(coeffs, 128, 255);
+    size_t x = 0;
+    for (; x + 8 <= width; x += 8) {
+        Rgb_AVX2 p = YuvToRgb_AVX2(LoadCbYCrY_SSE41(src + 2 * x), c);
+        _mm_storeu_si128((__m128i *)(dst + x), PackRGB565_AVX2(p));
+    }
+    return x;
+}
+
+bool HasAVX2() {
+    static const bool hasAVX2 = __builtin_cpu_supports("avx2");
+    return hasAVX2;
+}
+
+#endif  // USE_AVX2_KERNELS
+
+}  // namespace
+
+#endif  // USE_SSE41_KERNELS
+
+#if USE_NEON_KERNELS
+
+namespace {
+
+struct Yuv16 {
+    uint16x8_t y, u, v;  // 8 pixels, 16-bit lanes
+};
+
+inline uint16x8_t DupChroma_NEON(uint16x4_t c) {
+    uint16x4x2_t dup = vzip_u16(c, c);
+    return vcombine_u16(dup.val[0], dup.val[1]);
+}
+
+inline Yuv16 LoadP010_NEON(const uint16_t *srcY, const uint16_t *srcUV) {
+    uint16x4x2_t uv = vld2_u16(srcUV);
+    return Yuv16{
+        vshrq_n_u16(vld1q_u16(srcY), 6),
+        DupChroma_NEON(vshr_n_u16(uv.val[0], 6)),
+        DupChroma_NEON(vshr_n_u16(uv.val[1], 6)) };
+}
+
+inline Yuv16 LoadPlanar16_NEON(
+        const uint16_t *srcY, const uint16_t *srcU, const uint16_t *srcV) {
+    return Yuv16{ vld1q_u16(srcY), DupChroma_NEON(vld1_u16(srcU)), DupChroma_NEON(vld1_u16(srcV)) };
+}
+
+// Planar16 samples reduced to 8 bits, as (uint8_t)(sample >> 2).
+inline Yuv16 LoadPlanar16To8Bit_NEON(
+        const uint16_t *srcY, const uint16_t *srcU, const uint16_t *srcV) {
+    const uint16x8_t mask = vdupq_n_u16(0xFF);
+    Yuv16 s = LoadPlanar16_NEON(srcY, srcU, srcV);
+    return Yuv16{
+        vandq_u16(vshrq_n_u16(s.y, 2), mask),
+        vandq_u16(vshrq_n_u16(s.u, 2), mask),
+        vandq_u16(vshrq_n_u16(s.v, 2), mask) };
+}
+
+inline Yuv16 LoadCbYCrY_NEON(const uint8_t *src) {
+    // val[0] holds u0 v0 u1 v1 ..., val[1] holds the 8 luma samples
+    uint8x8x2_t s = vld2_u8(src);
+    uint8x8x2_t uv = vuzp_u8(s.val[0], s.val[0]);
+    return Yuv16{
+        vmovl_u8(s.val[1]),
+        vmovl_u8(vzip_u8(uv.val[0], uv.val[0]).val[0]),
+        vmovl_u8(vzip_u8(uv.val[1], uv.val[1]).val[0]) };
+}
+
+inline int32x4_t Low32_NEON(uint16x8_t v) {
+    return vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(v)));
+}
+
+inline int32x4_t High32_NEON(uint16x8_t v) {
+    return vreinterpretq_s32_u32(vmovl_u16(vget_high_u16(v)));
+}
+
+struct Rgb_NEON {
+    uint32x4_t r, g, b;  // 4 pixels, clipped
+};
+
+inline Rgb_NEON YuvToRgb_NEON(int32x4_t y, int32x4_t u, int32x4_t v,
+                              const YuvRowCoeffs &c, int32_t uvOffset, int32_t max) {
+    const int32x4_t zero = vdupq_n_s32(0);
+    const int32x4_t maxv = vdupq_n_s32(max);
+    u = vsubq_s32(u, vdupq_n_s32(uvOffset));
+    v = vsubq_s32(v, vdupq_n_s32(uvOffset));
+    int32x4_t tmp = vmlaq_n_s32(vdupq_n_s32(128), vsubq_s32(y, vdupq_n_s32(c.mC16)), c.mY);
+    int32x4_t r = vshrq_n_s32(vmlaq_n_s32(tmp, v, c.mRV), 8);
+    int32x4_t g = vshrq_n_s32(vmlaq_n_s32(vmlaq_n_s32(tmp, u, c.mNegGU), v, c.mNegGV), 8);
+    int32x4_t b = vshrq_n_s32(vmlaq_n_s32(tmp, u, c.mBU), 8);
+    return Rgb_NEON{
+        vreinterpretq_u32_s32(vminq_s32(vmaxq_s32(r, zero), maxv)),
+        vreinterpretq_u32_s32(vminq_s32(vmaxq_s32(g, zero), maxv)),
+        vreinterpretq_u32_s32(vminq_s32(vmaxq_s32(b, zero), maxv)) };
+}
+
+inline uint16x4_t PackRGB565_NEON(const Rgb_NEON &p) {
+    uint32x4_t rgb = vorrq_u32(
+            vorrq_u32(vshlq_n_u32(vshrq_n_u32(p.r, 3), 11), vshlq_n_u32(vshrq_n_u32(p.g, 2), 5)),
+            vshrq_n_u32(p.b, 3));
+    return vmovn_u32(rgb);
+}
+
+inline uint32x4_t PackRGBA8888_NEON(uint32x4_t first, uint32x4_t g, uint32x4_t third) {
+    return vorrq_u32(vorrq_u32(first, vshlq_n_u32(g, 8)),
+                     vorrq_u32(vshlq_n_u32(third, 16), vdupq_n_u32(0xFF000000)));
+}
+
+inline uint32x4_t Pack1010102_NEON(const Rgb_NEON &p) {
+    return vorrq_u32(vorrq_u32(p.r, vshlq_n_u32(p.g, 10)),
+                     vorrq_u32(vshlq_n_u32(p.b, 20), vdupq_n_u32(3u << 30)));
+}
+
+size_t P010RowToRGBA1010102_NEON(
+        const uint16_t *srcY, const uint16_t *srcUV, uint32_t *dst, size_t width,
+        const YuvRowCoeffs &coeffs) {
+    size_t x = 0;
+    for (; x + 8 <= width; x += 8) {
+        Yuv16 s = LoadP010_NEON(srcY + x, srcUV + x);
+        Rgb_NEON lo = YuvToRgb_NEON(
+                Low32_NEON(s.y), Low32_NEON(s.u), Low32_NEON(s.v), coeffs, 512, 1023);
+        Rgb_NEON hi = YuvToRgb_NEON(
+                High32_NEON(s.y), High32_NEON(s.u), High32_NEON(s.v), coeffs, 512, 1023);
+        vst1q_u32(dst + x, Pack1010102_NEON(lo));
+        vst1q_u32(dst + x + 4, Pack1010102_NEON(hi));
+    }
+    return x;
+}
+
+size_t Planar16RowToRGB_NEON(
+        const uint16_t *srcY, const uint16_t *srcU, const uint16_t *srcV,
+        uint8_t *dst, size_t width, OMX_COLOR_FORMATTYPE dstFormat,
+        const YuvRowCoeffs &coeffs) {
+    size_t x = 0;
+    for (; x + 8 <= width; x += 8) {
+        Yuv16 s = LoadPlanar16To8Bit_NEON(srcY + x, srcU + x / 2, srcV + x / 2);
+        Rgb_NEON lo = YuvToRgb_NEON(
+                Low32_NEON(s.y), Low32_NEON(s.u), Low32_NEON(s.v), coeffs, 128, 255);
+        Rgb_NEON hi = YuvToRgb_NEON(
+                High32_NEON(s.y), High32_NEON(s.u), High32_NEON(s.v), coeffs, 128, 255);
+        switch ((int32_t)dstFormat) {
+            case OMX_COLOR_Format16bitRGB565:
+                vst1q_u16((uint16_t *)dst + x,
+                          vcombine_u16(PackRGB565_NEON(lo), PackRGB565_NEON(hi)));
+                break;
+            case OMX_COLOR_Format32BitRGBA8888:
+                vst1q_u32((uint32_t *)dst + x, PackRGBA8888_NEON(lo.r, lo.g, lo.b));
+                vst1q_u32((uint32_t *)dst + x + 4, PackRGBA8888_NEON(hi.r, hi.g, hi.b));
+                break;
+            case OMX_COLOR_Format32bitBGRA8888:
+                vst1q_u32((uint32_t *)dst + x, PackRGBA8888_NEON(lo.b, lo.g, lo.r));
+                vst1q_u32((uint32_t *)dst + x + 4, PackRGBA8888_NEON(hi.b, hi.g, hi.r));
+                break;
+            default:
+                break;
+        }
+    }
+    return x;
+}
+
+size_t Planar16RowToY410_NEON(
+        const uint16_t *srcY, const uint16_t *srcU, const uint16_t *srcV,
+        uint32_t *dst, size_t width) {
+    const uint16x8_t mask = vdupq_n_u16(0x3FF);
+    size_t x = 0;
+    for (; x + 8 <= width; x += 8) {
+        Yuv16 s = LoadPlanar16_NEON(srcY + x, srcU + x / 2, srcV + x / 2);
+        uint16x8_t y = vandq_u16(s.y, mask);
+        uint16x8_t u = vandq_u16(s.u, mask);
+        uint16x8_t v = vandq_u16(s.v, mask);
+        vst1q_u32(dst + x, vorrq_u32(
+                vorrq_u32(vmovl_u16(vget_low_u16(u)), vshll_n_u16(vget_low_u16(y), 10)),
+                vshlq_n_u32(vmovl_u16(vget_low_u16(v)), 20)));
+        vst1q_u32(dst + x + 4, vorrq_u32(
+                vorrq_u32(vmovl_u16(vget_high_u16(u)), vshll_n_u16(vget_high_u16(y), 10)),
+                vshlq_n_u32(vmovl_u16(vget_high_u16(v)), 20)));
+    }
+    return x;
+}
+
+size_t CbYCrYRowToRGB565_NEON(
+        const uint8_t *src, uint16_t *dst, size_t width, const YuvRowCoeffs &coeffs) {
+    size_t x = 0;
+    for (; x + 8 <= width; x += 8) {
+        Yuv16 s = LoadCbYCrY_NEON(src + 2 * x);
+        Rgb_NEON lo = YuvToRgb_NEON(
+                Low32_NEON(s.y), Low32_NEON(s.u), Low32_NEON(s.v), coeffs, 128, 255);
+        Rgb_NEON hi = YuvToRgb_NEON(
+                High32_NEON(s.y), High32_NEON(s.u), High32_NEON(s.v), coeffs, 128, 255);
+        vst1q_u16(dst + x, vcombine_u16(PackRGB565_NEON(lo), PackRGB565_NEON(hi)));
+    }
+    return x;
+}
+
+}  // namespace
+
+#endif  // USE_NEON_KERNELS
+
+namespace {
+
+// Whole-row kernels: the vector kernel converts as many pixels as it can, and the
+// scalar code the rest of the row.
+
+template<size_t (*kVector)(const uint16_t *, const uint16_t *, uint32_t *, size_t,
+                           const YuvRowCoeffs &)>
+void P010RowToRGBA1010102(
+        const uint16_t *srcY, const uint16_t *srcUV, uint32_t *dst, size_t width,
+        const YuvRowCoeffs &coeffs) {
+    size_t x = kVector(srcY, srcUV, dst, width, coeffs);
+    if (x < width) {
+        ConvertP010RowToRGBA1010102_C(srcY + x, srcUV + x, dst + x, width - x, coeffs);
+    }
+}
+
+template<size_t (*kVector)(const uint16_t *, const uint16_t *, const uint16_t *, uint8_t *,
+                           size_t, OMX_COLOR_FORMATTYPE, const YuvRowCoeffs &)>
+void Planar16RowToRGB(
+        const uint16_t *srcY, const uint16_t *srcU, const uint16_t *srcV,
+        uint8_t *dst, size_t width, OMX_COLOR_FORMATTYPE dstFormat,
+        const YuvRowCoeffs &coeffs) {
+    size_t x = kVector(srcY, srcU, srcV, dst, width, dstFormat, coeffs);
+    if (x < width) {
+        const size_t bpp = (dstFormat == OMX_COLOR_Format16bitRGB565) ? 2 : 4;
+        ConvertPlanar16RowToRGB_C(
+                srcY + x, srcU + x / 2, srcV + x / 2, dst + x * bpp, width - x,
+                dstFormat, coeffs);
+    }
+}
+
+template<size_t (*kVector)(const uint16_t *, const uint16_t *, const uint16_t *, uint32_t *,
+                           size_t)>
+void Planar16RowToY410(
+        const uint16_t *srcY, const uint16_t *srcU, const uint16_t *srcV,
+        uint32_t *dst, size_t width) {
+    size_t x = kVector(srcY, srcU, srcV, dst, width);
+    if (x < width) {
+        ConvertPlanar16RowToY410_C(srcY + x, srcU + x / 2, srcV + x / 2, dst + x, width - x);
+    }
+}
+
+template<size_t (*kVector)(const uint8_t *, uint16_t *, size_t, const YuvRowCoeffs &)>
+void CbYCrYRowToRGB565(
+        const uint8_t *src, uint16_t *dst, size_t width, const YuvRowCoeffs &coeffs) {
+    size_t x = kVector(src, dst, width, coeffs);
+    if (x < width) {
+        ConvertCbYCrYRowToRGB565_C(src + 2 * x, dst + x, width - x, coeffs);
+    }
+}
+
+#define ROW_KERNELS(isa, name) {                        \
+    name,                                               \
+    P010RowToRGBA1010102<P010RowToRGBA1010102_##isa>,   \
+    Planar16RowToRGB<Planar16RowToRGB_##isa>,           \
+    Planar16RowToY410<Planar16RowToY410_##isa>,         \
+    CbYCrYRowToRGB565<CbYCrYRowToRGB565_##isa>,         \
+}
+
+const ColorConverterRowKernels kKernels_C = {
+    "c",
+    ConvertP010RowToRGBA1010102_C,
+    ConvertPlanar16RowToRGB_C,
+    ConvertPlanar16RowToY410_C,
+    ConvertCbYCrYRowToRGB565_C,
+};
+#if USE_SSE41_KERNELS
+const ColorConverterRowKernels kKernels_SSE41 = ROW_KERNELS(SSE41, "sse4.1");
+#endif
+#if USE_AVX2_KERNELS
+const ColorConverterRowKernels kKernels_AVX2 = ROW_KERNELS(AVX2, "avx2");
+#endif
+#if USE_NEON_KERNELS
+const ColorConverterRowKernels kKernels_NEON = ROW_KERNELS(NEON, "neon");
+#endif
+
+#undef ROW_KERNELS
+
+const ColorConverterRowKernels &FastestKernels() {
+    static const ColorConverterRowKernels *kernels = [] {
+        static const ColorConverterIsa kFastestFirst[] = {
+            kColorConverterIsaAVX2,
+            kColorConverterIsaSSE41,
+            kColorConverterIsaNEON,
+        };
+        for (ColorConverterIsa isa : kFastestFirst) {
+            if (const ColorConverterRowKernels *supported = GetColorConverterRowKernels(isa)) {
+                return supported;
+            }
+        }
+        return &kKernels_C;
+    }();
+    return *kernels;
+}
+
+}  // namespace
+
+const ColorConverterRowKernels *GetColorConverterRowKernels(ColorConverterIsa isa) {
+    switch (isa) {
+        case kColorConverterIsaC:
+            return &kKernels_C;
+#if USE_SSE41_KERNELS
+        case kColorConverterIsaSSE41:
+            return &kKernels_SSE41;
+#endif
+#if USE_AVX2_KERNELS
+        case kColorConverterIsaAVX2:
+            return HasAVX2() ? &kKernels_AVX2 : nullptr;
+#endif
+#if USE_NEON_KERNELS
+        case kColorConverterIsaNEON:
+            return &kKernels_NEON;
+#endif
+        default:
+            return nullptr;
+    }
+}
+
+void ConvertP010RowToRGBA1010102(
+        const uint16_t *srcY, const uint16_t *srcUV, uint32_t *dst, size_t width,
+        const YuvRowCoeffs &coeffs) {
+    FastestKernels().mP010ToRGBA1010102(srcY, srcUV, dst, width, coeffs);
+}
+
+void ConvertPlanar16RowToRGB(
+        const uint16_t *srcY, const uint16_t *srcU, const uint16_t *srcV,
+        uint8_t *dst, size_t width, OMX_COLOR_FORMATTYPE dstFormat,
+        const YuvRowCoeffs &coeffs) {
+    FastestKernels().mPlanar16ToRGB(srcY, srcU, srcV, dst, width, dstFormat, coeffs);
+}
+
+void ConvertPlanar16RowToY410(
+        const uint16_t *srcY, const uint16_t *srcU, const uint16_t *srcV,
+        uint32_t *dst, size_t width) {
+    FastestKernels().mPlanar16ToY410(srcY, srcU, srcV, dst, width);
+}
+
+void ConvertCbYCrYRowToRGB565(
+        const uint8_t *src, uint16_t *dst, size_t width, const YuvRowCoeffs &coeffs) {
+    FastestKernels().mCbYCrYToRGB565(src, dst, width, coeffs);
+}
+
+const char *ColorConverterKernelsIsa() {
+    return FastestKernels().mIsa;
+}
+
+}  // namespace android
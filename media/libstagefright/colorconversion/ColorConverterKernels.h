@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COLOR_CONVERTER_KERNELS_H_
+
+#define COLOR_CONVERTER_KERNELS_H_
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <OMX_IVCommon.h>
+
+namespace android {
+
+/*
+ * Row kernels for the color conversion paths that libyuv does not cover.
+ *
+ * Every kernel converts a single row of |width| pixels. The plain versions
+ * pick the fastest implementation available on the device (NEON on ARM,
+ * AVX2 or SSE4.1 on x86) and finish the row with the scalar code; the *_C
+ * versions are the scalar reference the vectorized code is bit-exact with.
+ *
+ * Chroma is horizontally subsampled by 2; |srcU|, |srcV| and |srcUV| point
+ * to the chroma samples of the first pixel of the row.
+ */
+
+// YUV to RGB matrix, see ColorConverter::Coeffs.
+struct YuvRowCoeffs {
+    int32_t mY;
+    int32_t mRV;
+    int32_t mNegGU;
+    int32_t mNegGV;
+    int32_t mBU;
+    int32_t mC16;  // luma offset at the bit depth of the source
+};
+
+// P010 (10-bit semi-planar, MSB aligned) to RGBA_1010102.
+void ConvertP010RowToRGBA1010102(
+        const uint16_t *srcY, const uint16_t *srcUV, uint32_t *dst, size_t width,
+        const YuvRowCoeffs &coeffs);
+void ConvertP010RowToRGBA1010102_C(
+        const uint16_t *srcY, const uint16_t *srcUV, uint32_t *dst, size_t width,
+        const YuvRowCoeffs &coeffs);
+
+// YUV420Planar16 (10-bit planar, LSB aligned) to 8-bit RGB. |dstFormat| is one of
+// OMX_COLOR_Format16bitRGB565, OMX_COLOR_Format32BitRGBA8888 or
+// OMX_COLOR_Format32bitBGRA8888.
+void ConvertPlanar16RowToRGB(
+        const uint16_t *srcY, const uint16_t *srcU, const uint16_t *srcV,
+        uint8_t *dst, size_t width, OMX_COLOR_FORMATTYPE dstFormat,
+        const YuvRowCoeffs &coeffs);
+void ConvertPlanar16RowToRGB_C(
+        const uint16_t *srcY, const uint16_t *srcU, const uint16_t *srcV,
+        uint8_t *dst, size_t width, OMX_COLOR_FORMATTYPE dstFormat,
+        const YuvRowCoeffs &coeffs);
+
+// YUV420Planar16 to Y410 (packed 4:4:4, no color conversion).
+void ConvertPlanar16RowToY410(
+        const uint16_t *srcY, const uint16_t *srcU, const uint16_t *srcV,
+        uint32_t *dst, size_t width);
+void ConvertPlanar16RowToY410_C(
+        const uint16_t *srcY, const uint16_t *srcU, const uint16_t *srcV,
+        uint32_t *dst, size_t width);
+
+// Interleaved CbYCrY (UYVY) to RGB565. A trailing odd pixel is left untouched.
+void ConvertCbYCrYRowToRGB565(
+        const uint8_t *src, uint16_t *dst, size_t width, const YuvRowCoeffs &coeffs);
+void ConvertCbYCrYRowToRGB565_C(
+        const uint8_t *src, uint16_t *dst, size_t width, const YuvRowCoeffs &coeffs);
+
+// Instruction sets the kernels can be built for.
+enum ColorConverterIsa {
+    kColorConverterIsaC,
+    kColorConverterIsaSSE41,
+    kColorConverterIsaAVX2,
+    kColorConverterIsaNEON,
+};
+
+// The kernels of one instruction set. Each converts the whole row, finishing it
+// with the scalar code where the row is not a multiple of the vector length.
+struct ColorConverterRowKernels {
+    const char *mIsa;
+    void (*mP010ToRGBA1010102)(
+            const uint16_t *srcY, const uint16_t *srcUV, uint32_t *dst, size_t width,
+            const YuvRowCoeffs &coeffs);
+    void (*mPlanar16ToRGB)(
+            const uint16_t *srcY, const uint16_t *srcU, const uint16_t *srcV,
+            uint8_t *dst, size_t width, OMX_COLOR_FORMATTYPE dstFormat,
+            const YuvRowCoeffs &coeffs);
+    void (*mPlanar16ToY410)(
+            const uint16_t *srcY, const uint16_t *srcU, const uint16_t *srcV,
+            uint32_t *dst, size_t width);
+    void (*mCbYCrYToRGB565)(
+            const uint8_t *src, uint16_t *dst, size_t width, const YuvRowCoeffs &coeffs);
+};
+
+// Kernels of |isa|, or nullptr if they are not built for this architecture or the
+// CPU does not support them. The plain kernels use the fastest set available.
+const ColorConverterRowKernels *GetColorConverterRowKernels(ColorConverterIsa isa);
+
+// Name of the instruction set the plain kernels use on this device.
+const char *ColorConverterKernelsIsa();
+
+}  // namespace android
+
+#endif  // COLOR_CONVERTER_KERNELS_H_
@@ -191,6 +191,9 @@ void SoftwareRenderer::resetFormatIfChanged(
     CHECK(mCropWidth > 0);
     CHECK(mCropHeight > 0);
     CHECK(mConverter == NULL || mConverter->isValid());
+    if (mConverter != NULL) {
+        mConverter->setNumThreads(ColorConverter::GetDefaultNumThreads());
+    }
 
     CHECK_EQ(0,
             native_window_set_usage(
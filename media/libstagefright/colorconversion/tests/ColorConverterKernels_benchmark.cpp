@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <vector>
+
+#include "ColorConverterKernels.h"
+
+using namespace android;
+
+// BT.2020 limited range, 10-bit and 8-bit
+static const YuvRowCoeffs kCoeffs10Bit = { 299, 431, -48, -167, 550, 64 };
+static const YuvRowCoeffs kCoeffs8Bit = { 298, 430, -48, -167, 548, 16 };
+
+struct Frame {
+    Frame(size_t width, size_t height)
+        : mWidth(width),
+          mHeight(height),
+          mLuma(width * height, 0x8000),
+          mChroma(width * height / 2, 0x7000),
+          mOut(width * height) {}
+
+    const size_t mWidth;
+    const size_t mHeight;
+    std::vector<uint16_t> mLuma;
+    std::vector<uint16_t> mChroma;  // interleaved, or U followed by V
+    std::vector<uint32_t> mOut;
+};
+
+static void SetRate(benchmark::State &state, const Frame &frame) {
+    state.counters["Mpixel/s"] = benchmark::Counter(
+            (double)state.iterations() * frame.mWidth * frame.mHeight / 1e6,
+            benchmark::Counter::kIsRate);
+}
+
+template<bool kScalar>
+static void BM_P010ToRGBA1010102(benchmark::State &state) {
+    Frame frame(state.range(0), state.range(1));
+    for (auto _ : state) {
+        for (size_t y = 0; y < frame.mHeight; ++y) {
+            const uint16_t *srcY = frame.mLuma.data() + y * frame.mWidth;
+            const uint16_t *srcUV = frame.mChroma.data() + (y / 2) * frame.mWidth;
+            uint32_t *dst = frame.mOut.data() + y * frame.mWidth;
+            if (kScalar) {
+                ConvertP010RowToRGBA1010102_C(srcY, srcUV, dst, frame.mWidth, kCoeffs10Bit);
+            } else {
+                ConvertP010RowToRGBA1010102(srcY, srcUV, dst, frame.mWidth, kCoeffs10Bit);
+            }
+        }
+        benchmark::ClobberMemory();
+    }
+    SetRate(state, frame);
+}
+
+template<bool kScalar>
+static void BM_Planar16ToRGBA8888(benchmark::State &state) {
+    Frame frame(state.range(0), state.range(1));
+    const size_t chromaPlaneSize = frame.mChroma.size() / 2;
+    for (auto _ : state) {
+        for (size_t y = 0; y < frame.mHeight; ++y) {
+            const uint16_t *srcY = frame.mLuma.data() + y * frame.mWidth;
+            const uint16_t *srcU = frame.mChroma.data() + (y / 2) * (frame.mWidth / 2);
+            const uint16_t *srcV = srcU + chromaPlaneSize;
+            uint8_t *dst = (uint8_t *)(frame.mOut.data() + y * frame.mWidth);
+            if (kScalar) {
+                ConvertPlanar16RowToRGB_C(srcY, srcU, srcV, dst, frame.mWidth,
+                        OMX_COLOR_Format32BitRGBA8888, kCoeffs8Bit);
+            } else {
+                ConvertPlanar16RowToRGB(srcY, srcU, srcV, dst, frame.mWidth,
+                        OMX_COLOR_Format32BitRGBA8888, kCoeffs8Bit);
+            }
+        }
+        benchmark::ClobberMemory();
+    }
+    SetRate(state, frame);
+}
+
+template<bool kScalar>
+static void BM_Planar16ToY410(benchmark::State &state) {
+    Frame frame(state.range(0), state.range(1));
+    const size_t chromaPlaneSize = frame.mChroma.size() / 2;
+    for (auto _ : state) {
+        for (size_t y = 0; y < frame.mHeight; ++y) {
+            const uint16_t *srcY = frame.mLuma.data() + y * frame.mWidth;
+            const uint16_t *srcU = frame.mChroma.data() + (y / 2) * (frame.mWidth / 2);
+            const uint16_t *srcV = srcU + chromaPlaneSize;
+            uint32_t *dst = frame.mOut.data() + y * frame.mWidth;
+            if (kScalar) {
+                ConvertPlanar16RowToY410_C(srcY, srcU, srcV, dst, frame.mWidth);
+            } else {
+                ConvertPlanar16RowToY410(srcY, srcU, srcV, dst, frame.mWidth);
+            }
+        }
+        benchmark::ClobberMemory();
+    }
+    SetRate(state, frame);
+}
+
+template<bool kScalar>
+static void BM_CbYCrYToRGB565(benchmark::State &state) {
+    Frame frame(state.range(0), state.range(1));
+    for (auto _ : state) {
+        for (size_t y = 0; y < frame.mHeight; ++y) {
+            // 16 bits per pixel, so the luma plane serves as the packed source
+            const uint8_t *src = (const uint8_t *)(frame.mLuma.data() + y * frame.mWidth);
+            uint16_t *dst = (uint16_t *)frame.mOut.data() + y * frame.mWidth;
+            if (kScalar) {
+                ConvertCbYCrYRowToRGB565_C(src, dst, frame.mWidth, kCoeffs8Bit);
+            } else {
+                ConvertCbYCrYRowToRGB565(src, dst, frame.mWidth, kCoeffs8Bit);
+            }
+        }
+        benchmark::ClobberMemory();
+    }
+    SetRate(state, frame);
+}
+
+static void FrameSizes(benchmark::internal::Benchmark *b) {
+    b->Args({1920, 1080})->Args({3840, 2160});
+}
+
+BENCHMARK_TEMPLATE(BM_P010ToRGBA1010102, true)->Apply(FrameSizes);
+BENCHMARK_TEMPLATE(BM_P010ToRGBA1010102, false)->Apply(FrameSizes);
+BENCHMARK_TEMPLATE(BM_Planar16ToRGBA8888, true)->Apply(FrameSizes);
+BENCHMARK_TEMPLATE(BM_Planar16ToRGBA8888, false)->Apply(FrameSizes);
+BENCHMARK_TEMPLATE(BM_Planar16ToY410, true)->Apply(FrameSizes);
+BENCHMARK_TEMPLATE(BM_Planar16ToY410, false)->Apply(FrameSizes);
+BENCHMARK_TEMPLATE(BM_CbYCrYToRGB565, true)->Apply(FrameSizes);
+BENCHMARK_TEMPLATE(BM_CbYCrYToRGB565, false)->Apply(FrameSizes);
+
+int main(int argc, char **argv) {
+    benchmark::Initialize(&argc, argv);
+    benchmark::AddCustomContext("isa", ColorConverterKernelsIsa());
+    benchmark::RunSpecifiedBenchmarks();
+    return 0;
+}
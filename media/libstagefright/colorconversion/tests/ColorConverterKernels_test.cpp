@@ -0,0 +1,214 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "ColorConverterKernelsTest"
+#include <utils/Log.h>
+
+#include <gtest/gtest.h>
+
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "ColorConverterKernels.h"
+
+namespace android {
+
+// BT.601 full range, BT.709 limited range and BT.2020 limited range 10-bit, as used by
+// ColorConverter. The luma offset is at the bit depth of the source.
+static const YuvRowCoeffs kCoeffs8Bit[] = {
+    { 256, 359,  -88, -183, 454, 0 },
+    { 298, 459,  -55, -136, 541, 16 },
+};
+static const YuvRowCoeffs kCoeffs10Bit[] = {
+    { 256, 377,  -42, -146, 482, 0 },
+    { 299, 431,  -48, -167, 550, 64 },
+};
+
+// Widths around the vector length, plus 1080p and 4K rows.
+static const size_t kWidths[] = { 1, 2, 3, 7, 8, 9, 15, 16, 17, 30, 33, 1920, 1921, 3840 };
+
+// Rows are converted this many samples apart beyond their width, so that the rows
+// after the first are not aligned.
+static const size_t kStridePaddings[] = { 0, 1, 3 };
+static const size_t kRows = 3;
+
+// Every vectorized instruction set the kernels can be built for.
+static const ColorConverterIsa kVectorIsas[] = {
+    kColorConverterIsaSSE41,
+    kColorConverterIsaAVX2,
+    kColorConverterIsaNEON,
+};
+
+static std::string IsaName(const ::testing::TestParamInfo<ColorConverterIsa> &info) {
+    switch (info.param) {
+        case kColorConverterIsaSSE41: return "SSE41";
+        case kColorConverterIsaAVX2:  return "AVX2";
+        case kColorConverterIsaNEON:  return "NEON";
+        default:                      return "C";
+    }
+}
+
+// Compares the kernels of one instruction set against the scalar ones.
+class ColorConverterKernelsTest : public ::testing::TestWithParam<ColorConverterIsa> {
+protected:
+    void SetUp() override {
+        mKernels = GetColorConverterRowKernels(GetParam());
+        if (mKernels == nullptr) {
+            GTEST_SKIP() << "kernels are not built for this architecture or not supported "
+                         << "by this CPU";
+        }
+        ALOGV("testing %s kernels", mKernels->mIsa);
+    }
+
+    template<typename T>
+    std::vector<T> randomSamples(size_t count) {
+        std::uniform_int_distribution<uint32_t> dist(0, std::numeric_limits<T>::max());
+        std::vector<T> samples(count);
+        for (T &sample : samples) {
+            sample = (T)dist(mRandom);
+        }
+        return samples;
+    }
+
+    const ColorConverterRowKernels *mKernels = nullptr;
+    std::mt19937 mRandom{0x5eed};
+};
+
+TEST_P(ColorConverterKernelsTest, P010ToRGBA1010102) {
+    for (const YuvRowCoeffs &coeffs : kCoeffs10Bit) {
+        for (size_t width : kWidths) {
+            for (size_t padding : kStridePaddings) {
+                const size_t stride = width + padding;
+                // padded by a chroma pair, as the scalar code reads a trailing odd luma sample
+                std::vector<uint16_t> y = randomSamples<uint16_t>(kRows * stride + 2);
+                std::vector<uint16_t> uv = randomSamples<uint16_t>(kRows * stride + 2);
+                // the padding of the destination must be left untouched
+                std::vector<uint32_t> expected(kRows * stride, 0xDEADBEEF);
+                std::vector<uint32_t> actual(expected);
+                for (size_t row = 0; row < kRows; ++row) {
+                    const size_t offset = row * stride;
+                    ConvertP010RowToRGBA1010102_C(y.data() + offset, uv.data() + offset,
+                            expected.data() + offset, width, coeffs);
+                    mKernels->mP010ToRGBA1010102(y.data() + offset, uv.data() + offset,
+                            actual.data() + offset, width, coeffs);
+                }
+                ASSERT_EQ(expected, actual) << "width " << width << " stride " << stride;
+            }
+        }
+    }
+}
+
+TEST_P(ColorConverterKernelsTest, Planar16ToRGB) {
+    static const OMX_COLOR_FORMATTYPE kFormats[] = {
+        OMX_COLOR_Format16bitRGB565,
+        OMX_COLOR_Format32BitRGBA8888,
+        OMX_COLOR_Format32bitBGRA8888,
+    };
+    for (OMX_COLOR_FORMATTYPE format : kFormats) {
+        size_t bpp = (format == OMX_COLOR_Format16bitRGB565) ? 2 : 4;
+        for (const YuvRowCoeffs &coeffs : kCoeffs8Bit) {
+            for (size_t width : kWidths) {
+                for (size_t padding : kStridePaddings) {
+                    const size_t stride = width + padding;
+                    const size_t chromaStride = stride / 2 + 1;
+                    std::vector<uint16_t> y = randomSamples<uint16_t>(kRows * stride + 2);
+                    std::vector<uint16_t> u = randomSamples<uint16_t>(kRows * chromaStride);
+                    std::vector<uint16_t> v = randomSamples<uint16_t>(kRows * chromaStride);
+                    std::vector<uint8_t> expected(kRows * stride * bpp, 0xA5);
+                    std::vector<uint8_t> actual(expected);
+                    for (size_t row = 0; row < kRows; ++row) {
+                        const size_t offset = row * stride;
+                        const size_t chromaOffset = row * chromaStride;
+                        ConvertPlanar16RowToRGB_C(y.data() + offset, u.data() + chromaOffset,
+                                v.data() + chromaOffset, expected.data() + offset * bpp, width,
+                                format, coeffs);
+                        mKernels->mPlanar16ToRGB(y.data() + offset, u.data() + chromaOffset,
+                                v.data() + chromaOffset, actual.data() + offset * bpp, width,
+                                format, coeffs);
+                    }
+                    ASSERT_EQ(expected, actual)
+                            << "format " << format << " width " << width << " stride " << stride;
+                }
+            }
+        }
+    }
+}
+
+TEST_P(ColorConverterKernelsTest, Planar16ToY410) {
+    for (size_t width : kWidths) {
+        for (size_t padding : kStridePaddings) {
+            const size_t stride = width + padding;
+            const size_t chromaStride = stride / 2 + 1;
+            std::vector<uint16_t> y = randomSamples<uint16_t>(kRows * stride);
+            std::vector<uint16_t> u = randomSamples<uint16_t>(kRows * chromaStride);
+            std::vector<uint16_t> v = randomSamples<uint16_t>(kRows * chromaStride);
+            std::vector<uint32_t> expected(kRows * stride, 0xDEADBEEF);
+            std::vector<uint32_t> actual(expected);
+            for (size_t row = 0; row < kRows; ++row) {
+                const size_t offset = row * stride;
+                const size_t chromaOffset = row * chromaStride;
+                ConvertPlanar16RowToY410_C(y.data() + offset, u.data() + chromaOffset,
+                        v.data() + chromaOffset, expected.data() + offset, width);
+                mKernels->mPlanar16ToY410(y.data() + offset, u.data() + chromaOffset,
+                        v.data() + chromaOffset, actual.data() + offset, width);
+            }
+            ASSERT_EQ(expected, actual) << "width " << width << " stride " << stride;
+        }
+    }
+}
+
+TEST_P(ColorConverterKernelsTest, CbYCrYToRGB565) {
+    for (const YuvRowCoeffs &coeffs : kCoeffs8Bit) {
+        for (size_t width : kWidths) {
+            for (size_t padding : kStridePaddings) {
+                const size_t stride = width + padding;
+                // in bytes, so that odd paddings leave the source rows unaligned
+                const size_t srcStride = 2 * width + 2 + padding;
+                std::vector<uint8_t> src = randomSamples<uint8_t>(kRows * srcStride);
+                std::vector<uint16_t> expected(kRows * stride, 0xDEAD);
+                std::vector<uint16_t> actual(expected);
+                for (size_t row = 0; row < kRows; ++row) {
+                    ConvertCbYCrYRowToRGB565_C(src.data() + row * srcStride,
+                            expected.data() + row * stride, width, coeffs);
+                    mKernels->mCbYCrYToRGB565(src.data() + row * srcStride,
+                            actual.data() + row * stride, width, coeffs);
+                }
+                ASSERT_EQ(expected, actual) << "width " << width << " stride " << stride;
+            }
+        }
+    }
+}
+
+INSTANTIATE_TEST_SUITE_P(Isa, ColorConverterKernelsTest, ::testing::ValuesIn(kVectorIsas),
+                         IsaName);
+
+// The plain kernels use the fastest instruction set the CPU supports.
+TEST(ColorConverterKernelsDispatchTest, UsesFastestSupportedIsa) {
+    const char *expected = GetColorConverterRowKernels(kColorConverterIsaC)->mIsa;
+    for (ColorConverterIsa isa : { kColorConverterIsaAVX2, kColorConverterIsaSSE41,
+                                   kColorConverterIsaNEON }) {
+        if (const ColorConverterRowKernels *kernels = GetColorConverterRowKernels(isa)) {
+            expected = kernels->mIsa;
+            break;
+        }
+    }
+    EXPECT_STREQ(expected, ColorConverterKernelsIsa());
+}
+
+}  // namespace android
@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <vector>
+
+#include <media/stagefright/ColorConverter.h>
+#include <media/stagefright/MediaCodecConstants.h>
+
+using namespace android;
+
+// Whole-frame conversion time with the frame split across 1, 2, 4 and 8
+// threads, as done for thumbnails and frame extraction.
+template<int32_t kSrcFormat, int32_t kDstFormat, size_t kSrcBpp>
+static void BM_ConvertFrame(benchmark::State &state) {
+    const size_t width = state.range(0);
+    const size_t height = state.range(1);
+    const size_t numThreads = state.range(2);
+
+    std::vector<uint8_t> src(width * height * kSrcBpp * 3 / 2, 0x80);
+    std::vector<uint32_t> dst(width * height);
+
+    ColorConverter converter((OMX_COLOR_FORMATTYPE)kSrcFormat, (OMX_COLOR_FORMATTYPE)kDstFormat);
+    if (!converter.isValid()) {
+        state.SkipWithError("unsupported conversion");
+        return;
+    }
+    converter.setNumThreads(numThreads);
+
+    for (auto _ : state) {
+        converter.convert(
+                src.data(), width, height, 0 /* srcStride */,
+                0, 0, width - 1, height - 1,
+                dst.data(), width, height, 0 /* dstStride */,
+                0, 0, width - 1, height - 1);
+        benchmark::ClobberMemory();
+    }
+    state.counters["Mpixel/s"] = benchmark::Counter(
+            (double)state.iterations() * width * height / 1e6, benchmark::Counter::kIsRate);
+}
+
+static void FrameSizesAndThreads(benchmark::internal::Benchmark *b) {
+    for (const auto &size : { std::make_pair(1920, 1080),
+                              std::make_pair(3840, 2160),
+                              std::make_pair(7680, 4320) }) {
+        for (int numThreads : { 1, 2, 4, 8 }) {
+            b->Args({size.first, size.second, numThreads});
+        }
+    }
+    b->ArgNames({"width", "height", "threads"})->UseRealTime();
+}
+
+BENCHMARK_TEMPLATE(BM_ConvertFrame,
+        OMX_COLOR_FormatYUV420Planar, OMX_COLOR_Format32BitRGBA8888, 1)
+        ->Apply(FrameSizesAndThreads);
+BENCHMARK_TEMPLATE(BM_ConvertFrame,
+        COLOR_FormatYUVP010, COLOR_Format32bitABGR2101010, 2)
+        ->Apply(FrameSizesAndThreads);
+
+// Thumbnail extraction from a decoded frame: the frame is either converted at
+// full size, or scaled down in YUV to fit |kThumbnailSize| and only the scaled
+// frame converted.
+template<int32_t kSrcFormat, int32_t kDstFormat, size_t kSrcBpp>
+static void BM_Thumbnail(benchmark::State &state) {
+    static constexpr size_t kThumbnailSize = 256;
+    const size_t width = state.range(0);
+    const size_t height = state.range(1);
+    const bool scaled = state.range(2);
+    const size_t dstWidth = scaled ? kThumbnailSize : width;
+    const size_t dstHeight = scaled ? kThumbnailSize * height / width : height;
+
+    std::vector<uint8_t> src(width * height * kSrcBpp * 3 / 2, 0x80);
+    std::vector<uint32_t> dst(dstWidth * dstHeight);
+
+    ColorConverter converter((OMX_COLOR_FORMATTYPE)kSrcFormat, (OMX_COLOR_FORMATTYPE)kDstFormat);
+    if (!converter.isValidForScaling()) {
+        state.SkipWithError("unsupported conversion");
+        return;
+    }
+
+    for (auto _ : state) {
+        converter.convert(
+                src.data(), width, height, 0 /* srcStride */,
+                0, 0, width - 1, height - 1,
+                dst.data(), dstWidth, dstHeight, 0 /* dstStride */,
+                0, 0, dstWidth - 1, dstHeight - 1);
+        benchmark::ClobberMemory();
+    }
+    state.counters["Mpixel/s"] = benchmark::Counter(
+            (double)state.iterations() * width * height / 1e6, benchmark::Counter::kIsRate);
+}
+
+static void ThumbnailSizes(benchmark::internal::Benchmark *b) {
+    for (const auto &size : { std::make_pair(1280, 720),
+                              std::make_pair(1920, 1080),
+                              std::make_pair(3840, 2160),
+                              std::make_pair(7680, 4320) }) {
+        for (int scaled : { 0, 1 }) {
+            b->Args({size.first, size.second, scaled});
+        }
+    }
+    b->ArgNames({"width", "height", "scaled"})->UseRealTime();
+}
+
+BENCHMARK_TEMPLATE(BM_Thumbnail,
+        OMX_COLOR_FormatYUV420Planar, OMX_COLOR_Format32BitRGBA8888, 1)
+        ->Apply(ThumbnailSizes);
+BENCHMARK_TEMPLATE(BM_Thumbnail,
+        OMX_COLOR_FormatYUV420SemiPlanar, OMX_COLOR_Format16bitRGB565, 1)
+        ->Apply(ThumbnailSizes);
+BENCHMARK_TEMPLATE(BM_Thumbnail,
+        COLOR_FormatYUVP010, COLOR_Format32bitABGR2101010, 2)
+        ->Apply(ThumbnailSizes);
+
+BENCHMARK_MAIN();
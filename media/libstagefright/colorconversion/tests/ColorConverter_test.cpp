@@ -0,0 +1,237 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "ColorConverterTest"
+#include <utils/Log.h>
+
+#include <gtest/gtest.h>
+
+#include <string.h>
+
+#include <random>
+#include <tuple>
+#include <vector>
+
+#include <media/stagefright/ColorConverter.h>
+#include <media/stagefright/MediaCodecConstants.h>
+#include <media/stagefright/MediaErrors.h>
+
+namespace android {
+
+// source format, destination format, source bytes per pixel and destination bytes per pixel
+typedef std::tuple<int32_t, int32_t, size_t, size_t> ConversionParams;
+
+class ColorConverterBandTest : public ::testing::TestWithParam<ConversionParams> {
+protected:
+    static constexpr size_t kWidth = 1280;
+    static constexpr size_t kHeight = 720;
+
+    // Converts a frame with the given number of threads, cropped to a region that does
+    // not start on a multiple of the band alignment.
+    std::vector<uint8_t> convert(const std::vector<uint8_t> &src, size_t numThreads) {
+        auto [srcFormat, dstFormat, srcBpp, dstBpp] = GetParam();
+        (void)srcBpp;
+        ColorConverter converter((OMX_COLOR_FORMATTYPE)srcFormat, (OMX_COLOR_FORMATTYPE)dstFormat);
+        EXPECT_TRUE(converter.isValid());
+        converter.setNumThreads(numThreads);
+
+        const size_t cropLeft = 16, cropTop = 3, cropRight = kWidth - 5, cropBottom = kHeight - 2;
+        const size_t cropWidth = cropRight - cropLeft + 1;
+        const size_t cropHeight = cropBottom - cropTop + 1;
+        std::vector<uint8_t> dst(cropWidth * cropHeight * dstBpp, 0);
+        EXPECT_EQ(OK, converter.convert(
+                src.data(), kWidth, kHeight, 0 /* srcStride */,
+                cropLeft, cropTop, cropRight, cropBottom,
+                dst.data(), cropWidth, cropHeight, 0 /* dstStride */,
+                0, 0, cropWidth - 1, cropHeight - 1));
+        return dst;
+    }
+};
+
+TEST_P(ColorConverterBandTest, MatchesSingleThreaded) {
+    const size_t srcBpp = std::get<2>(GetParam());
+    // 4:2:0 source: luma plane plus half as much chroma
+    std::vector<uint8_t> src(kWidth * kHeight * srcBpp * 3 / 2);
+    std::mt19937 random(0x5eed);
+    std::uniform_int_distribution<uint32_t> dist(0, 255);
+    for (uint8_t &byte : src) {
+        byte = dist(random);
+    }
+    if (std::get<0>(GetParam()) == OMX_COLOR_FormatYUV420Planar16) {
+        // keep the samples within 10 bits
+        for (size_t i = 1; i < src.size(); i += 2) {
+            src[i] &= 0x3;
+        }
+    }
+
+    std::vector<uint8_t> expected = convert(src, 1);
+    for (size_t numThreads : { 2, 3, 4, 8 }) {
+        ASSERT_EQ(expected, convert(src, numThreads)) << numThreads << " threads";
+    }
+}
+
+INSTANTIATE_TEST_SUITE_P(
+        ColorConverter, ColorConverterBandTest,
+        ::testing::Values(
+                ConversionParams(OMX_COLOR_FormatYUV420Planar,
+                                 OMX_COLOR_Format32BitRGBA8888, 1, 4),
+                ConversionParams(OMX_COLOR_FormatYUV420SemiPlanar,
+                                 OMX_COLOR_Format16bitRGB565, 1, 2),
+                ConversionParams(OMX_COLOR_FormatYUV420Planar16,
+                                 OMX_COLOR_Format32bitBGRA8888, 2, 4),
+                ConversionParams(OMX_COLOR_FormatYUV420Planar16,
+                                 OMX_COLOR_FormatYUV444Y410, 2, 4),
+                ConversionParams(COLOR_FormatYUVP010,
+                                 COLOR_Format32bitABGR2101010, 2, 4)));
+
+class ColorConverterScaleTest : public ::testing::TestWithParam<ConversionParams> {
+protected:
+    static constexpr size_t kWidth = 1280;
+    static constexpr size_t kHeight = 720;
+
+    // Pseudo-random sample of plane |plane| (0 = Y, 1 = U, 2 = V) at |x|, |y|.
+    static uint16_t sample(int plane, size_t x, size_t y, bool is10Bit) {
+        uint32_t hash = (x * 73856093u) ^ (y * 19349663u) ^ (plane * 83492791u);
+        hash ^= hash >> 13;
+        return (hash * 0x5bd1e995u >> 16) & (is10Bit ? 0x3ff : 0xff);
+    }
+
+    // A 4:2:0 frame where every sample is repeated |scale| x |scale| times.
+    std::vector<uint8_t> createFrame(size_t width, size_t height, size_t scale) {
+        const int32_t format = std::get<0>(GetParam());
+        const size_t bpp = std::get<2>(GetParam());
+        const bool isSemiPlanar = (format != OMX_COLOR_FormatYUV420Planar
+                && format != OMX_COLOR_FormatYUV420Planar16);
+        const bool is10Bit = (bpp == 2);
+        std::vector<uint8_t> frame(width * height * bpp * 3 / 2);
+        auto write = [&](size_t index, uint16_t value) {
+            if (format == COLOR_FormatYUVP010) {
+                value <<= 6;  // MSB aligned
+            }
+            if (bpp == 2) {
+                frame[index * 2] = value & 0xff;
+                frame[index * 2 + 1] = value >> 8;
+            } else {
+                frame[index] = value;
+            }
+        };
+        for (size_t y = 0; y < height; ++y) {
+            for (size_t x = 0; x < width; ++x) {
+                write(y * width + x, sample(0, x / scale, y / scale, is10Bit));
+            }
+        }
+        const size_t chromaBase = width * height;
+        for (size_t y = 0; y < height / 2; ++y) {
+            for (size_t x = 0; x < width / 2; ++x) {
+                uint16_t u = sample(1, x / scale, y / scale, is10Bit);
+                uint16_t v = sample(2, x / scale, y / scale, is10Bit);
+                if (isSemiPlanar) {
+                    write(chromaBase + y * width + x * 2, u);
+                    write(chromaBase + y * width + x * 2 + 1, v);
+                } else {
+                    write(chromaBase + y * (width / 2) + x, u);
+                    write(chromaBase * 5 / 4 + y * (width / 2) + x, v);
+                }
+            }
+        }
+        return frame;
+    }
+
+    std::vector<uint8_t> convert(
+            const std::vector<uint8_t> &src, size_t width, size_t height,
+            size_t cropLeft, size_t cropTop, size_t cropWidth, size_t cropHeight,
+            size_t dstWidth, size_t dstHeight, size_t numThreads) {
+        auto [srcFormat, dstFormat, srcBpp, dstBpp] = GetParam();
+        (void)srcBpp;
+        ColorConverter converter((OMX_COLOR_FORMATTYPE)srcFormat, (OMX_COLOR_FORMATTYPE)dstFormat);
+        EXPECT_TRUE(converter.isValidForScaling());
+        converter.setNumThreads(numThreads);
+
+        std::vector<uint8_t> dst(dstWidth * dstHeight * dstBpp, 0);
+        EXPECT_EQ(OK, converter.convert(
+                src.data(), width, height, 0 /* srcStride */,
+                cropLeft, cropTop, cropLeft + cropWidth - 1, cropTop + cropHeight - 1,
+                dst.data(), dstWidth, dstHeight, 0 /* dstStride */,
+                0, 0, dstWidth - 1, dstHeight - 1));
+        return dst;
+    }
+};
+
+// Halving a frame made of 2x2 blocks must give the same pixels as converting
+// a frame of the block values directly.
+TEST_P(ColorConverterScaleTest, HalfSizeMatchesDirectConversion) {
+    const std::vector<uint8_t> half = createFrame(kWidth / 2, kHeight / 2, 1);
+    const std::vector<uint8_t> full = createFrame(kWidth, kHeight, 2);
+
+    const size_t cropWidth = kWidth / 2 - 24, cropHeight = kHeight / 2 - 10;
+    std::vector<uint8_t> expected = convert(
+            half, kWidth / 2, kHeight / 2, 8, 2, cropWidth, cropHeight,
+            cropWidth, cropHeight, 1 /* numThreads */);
+    for (size_t numThreads : { 1, 4 }) {
+        ASSERT_EQ(expected, convert(
+                full, kWidth, kHeight, 16, 4, cropWidth * 2, cropHeight * 2,
+                cropWidth, cropHeight, numThreads)) << numThreads << " threads";
+    }
+}
+
+// A flat frame stays flat at any size, including odd ones.
+TEST_P(ColorConverterScaleTest, FlatFrameStaysFlat) {
+    const std::vector<uint8_t> flat = createFrame(kWidth, kHeight, kWidth);
+    const size_t dstBpp = std::get<3>(GetParam());
+    for (auto [dstWidth, dstHeight] : { std::make_pair(320, 180),
+                                        std::make_pair(199, 111),
+                                        std::make_pair(1, 1),
+                                        std::make_pair(1279, 719) }) {
+        std::vector<uint8_t> dst = convert(
+                flat, kWidth, kHeight, 0, 0, kWidth, kHeight, dstWidth, dstHeight, 4);
+        for (size_t i = dstBpp; i < dst.size(); i += dstBpp) {
+            ASSERT_EQ(0, memcmp(dst.data(), dst.data() + i, dstBpp))
+                    << dstWidth << "x" << dstHeight << " pixel " << i / dstBpp;
+        }
+    }
+}
+
+INSTANTIATE_TEST_SUITE_P(
+        ColorConverter, ColorConverterScaleTest,
+        ::testing::Values(
+                ConversionParams(OMX_COLOR_FormatYUV420Planar,
+                                 OMX_COLOR_Format32BitRGBA8888, 1, 4),
+                ConversionParams(OMX_COLOR_FormatYUV420SemiPlanar,
+                                 OMX_COLOR_Format16bitRGB565, 1, 2),
+                ConversionParams(OMX_QCOM_COLOR_FormatYVU420SemiPlanar,
+                                 OMX_COLOR_Format32bitBGRA8888, 1, 4),
+                ConversionParams(OMX_COLOR_FormatYUV420Planar16,
+                                 OMX_COLOR_FormatYUV444Y410, 2, 4),
+                ConversionParams(COLOR_FormatYUVP010,
+                                 COLOR_Format32bitABGR2101010, 2, 4)));
+
+TEST(ColorConverterTest, ScalingLimits) {
+    ColorConverter converter(OMX_COLOR_FormatYUV420Planar, OMX_COLOR_Format32BitRGBA8888);
+    ASSERT_TRUE(converter.isValidForScaling());
+    std::vector<uint8_t> src(64 * 64 * 3 / 2);
+    std::vector<uint32_t> dst(128 * 128);
+    // no upscaling
+    EXPECT_EQ(ERROR_UNSUPPORTED, converter.convert(
+            src.data(), 64, 64, 0, 0, 0, 63, 63,
+            dst.data(), 128, 128, 0, 0, 0, 127, 127));
+
+    ColorConverter packed(OMX_COLOR_FormatCbYCrY, OMX_COLOR_Format16bitRGB565);
+    EXPECT_TRUE(packed.isValid());
+    EXPECT_FALSE(packed.isValidForScaling());
+}
+
+}  // namespace android
@@ -29,6 +29,7 @@
 namespace android {
 
 struct AMessage;
+struct ColorConverter;
 struct MediaCodec;
 class IMediaSource;
 class MediaCodecBuffer;
@@ -45,6 +46,11 @@ struct FrameDecoder : public RefBase {
             const sp<MetaData> &trackMeta,
             const sp<IMediaSource> &source);
 
+    // Thumbnail mode: scale frames down to fit within |maxWidth| x |maxHeight|
+    // as displayed, keeping the aspect ratio. Scaling happens in YUV before
+    // color conversion. Must be called before init().
+    void setTargetSize(int32_t maxWidth, int32_t maxHeight);
+
     status_t init(int64_t frameTimeUs, int option, int colorFormat);
 
     sp<IMemory> extractFrame(FrameRect *rect = NULL);
@@ -82,6 +88,16 @@ protected:
     int32_t dstBpp()             const      { return mDstBpp; }
     void setFrame(const sp<IMemory> &frameMem) { mFrameMemory = frameMem; }
 
+    // Size to output a |width| x |height| frame at. Returns false if there is
+    // no target size or the frame already fits in it.
+    bool getScaledSize(int32_t width, int32_t height,
+            int32_t *scaledWidth, int32_t *scaledHeight) const;
+
+    // Converter from |srcFormat| to dstFormat() for frames in |outputFormat|.
+    // It is kept across frames, together with its worker threads, until the
+    // output format changes.
+    ColorConverter *getColorConverter(int32_t srcFormat, const sp<AMessage> &outputFormat);
+
 private:
     AString mComponentName;
     sp<MetaData> mTrackMeta;
@@ -89,10 +105,14 @@ private:
     OMX_COLOR_FORMATTYPE mDstFormat;
     ui::PixelFormat mCaptureFormat;
     int32_t mDstBpp;
+    int32_t mTargetWidth;
+    int32_t mTargetHeight;
     sp<IMemory> mFrameMemory;
     MediaSource::ReadOptions mReadOptions;
     sp<MediaCodec> mDecoder;
     sp<AMessage> mOutputFormat;
+    std::unique_ptr<ColorConverter> mConverter;
+    sp<AMessage> mConverterFormat;
     bool mHaveMoreInputs;
     bool mFirstSample;
     sp<Surface> mSurface;
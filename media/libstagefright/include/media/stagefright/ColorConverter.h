@@ -23,7 +23,9 @@
 #include <stdint.h>
 #include <utils/Errors.h>
 
+#include <memory>
 #include <optional>
+#include <vector>
 
 #include <OMX_Video.h>
 #include <media/hardware/VideoAPI.h>
@@ -42,6 +44,17 @@ struct ColorConverter {
 
     void setSrcColorSpace(uint32_t standard, uint32_t range, uint32_t transfer);
 
+    // Large frames are converted in horizontal bands on up to |numThreads|
+    // threads, including the calling one. Defaults to 1.
+    void setNumThreads(size_t numThreads);
+
+    // Number of threads worth using for large frames on this device.
+    static size_t GetDefaultNumThreads();
+
+    // Whether convert() accepts a dst crop smaller than the src crop. The
+    // source is then downscaled in YUV and only the scaled frame is converted.
+    bool isValidForScaling() const;
+
     status_t convert(
             const void *srcBits,
             size_t srcWidth, size_t srcHeight, size_t srcStride,
@@ -99,6 +112,7 @@ private:
     } BitDepth_t;
 
     struct BitmapParams;
+    struct WorkerPool;
 
 
     class Image {
@@ -165,10 +179,29 @@ private:
     std::optional<Image> mSrcImage;
     ColorSpace mSrcColorSpace;
     uint8_t *mClip;
-    uint16_t *mClip10Bit;
+    size_t mNumThreads;
+    std::unique_ptr<WorkerPool> mWorkerPool;
+    std::vector<uint8_t> mScaledFrame;
+    std::unique_ptr<ColorConverter> mScaledConverter;
 
     uint8_t *initClip();
-    uint16_t *initClip10Bit();
+
+    WorkerPool *getWorkerPool();
+
+    // bands must start on a row that has chroma samples of its own
+    size_t getBandAlignment() const;
+
+    status_t convertInBands(
+            const BitmapParams &src, const BitmapParams &dst, size_t numBands);
+
+    status_t convertBand(
+            const BitmapParams &src, const BitmapParams &dst);
+
+    // format of the intermediate frame for downscaling, false if unsupported
+    bool getScaledFormat(OMX_COLOR_FORMATTYPE *format) const;
+
+    status_t convertScaled(
+            const BitmapParams &src, const BitmapParams &dst);
 
     // resolve YUVFormat from YUV420Flexible
     bool isValidForMediaImage2() const;
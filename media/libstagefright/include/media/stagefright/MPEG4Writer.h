@@ -19,6 +19,7 @@
 #define MPEG4_WRITER_H_
 
 #include <stdio.h>
+#include <sys/uio.h>
 
 #include <media/stagefright/MediaWriter.h>
 #include <utils/List.h>
@@ -26,8 +27,13 @@
 #include <map>
 #include <media/stagefright/foundation/AHandlerReflector.h>
 #include <media/stagefright/foundation/ALooper.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
 #include <mutex>
 #include <queue>
+#include <vector>
 
 namespace android {
 
@@ -63,6 +69,10 @@ public:
     inline size_t write(const void *ptr, size_t size, size_t nmemb);
     // Write to file system by calling ::write() or post error message to looper on failure.
     void writeOrPostError(int fd, const void *buf, size_t count);
+    // Gather-write to file system at the given offset by calling ::pwritev() or post error
+    // message to looper on failure.
+    void pwritevOrPostError(int fd, const struct iovec *iov, int iovcnt, size_t count,
+            off64_t offset);
     // Seek in the file by calling ::lseek64() or post error message to looper on failure.
     void seekOrPostError(int fd, off64_t offset, int whence);
     void endBox();
@@ -125,15 +135,61 @@ private:
     bool mAreGeoTagsAvailable;
     int32_t mStartTimeOffsetMs;
     bool mSwitchPending;
-    bool mWriteSeekErr;
+    // Also set by the I/O thread when an asynchronous sample write fails.
+    std::atomic<bool> mWriteSeekErr;
     bool mFallocateErr;
+    // Fragmented MP4 output: an initial moov without samples, then one
+    // moof/mdat pair per chunk, so nothing accumulates across the recording.
+    bool mFragmented;
+    int64_t mFragmentDurationUs;
+    bool mFragmentedMoovWritten;
+    uint32_t mFragmentSequenceNumber;
     bool mPreAllocationEnabled;
     status_t mResetStatus;
-    // Queue to hold top long write durations
+    // Queue to hold top long write durations, fed by the writer and the I/O threads
+    std::mutex mWriteDurationLock;
     std::priority_queue<std::chrono::microseconds, std::vector<std::chrono::microseconds>,
                         std::greater<std::chrono::microseconds>> mWriteDurationPQ;
     const uint8_t kWriteDurationsCount = 5;
 
+    // Sample data (length prefixes and payloads) queued by addSample_l() into
+    // a batch, which flushPendingWrites_l() hands to the I/O thread to be
+    // written with a single pwritev(). Payload iovecs point into the batch's
+    // samples, which the I/O thread releases once the batch is written.
+    struct WriteBatch {
+        static const size_t kMaxIovecs = 256;
+        struct iovec mIovecs[kMaxIovecs];
+        size_t mNumIovecs;
+        size_t mBytes;
+        // Backing store for queued length prefixes; at most 4 bytes per iovec.
+        uint8_t mPrefixes[kMaxIovecs * 4];
+        size_t mPrefixesSize;
+        int mFd;
+        off64_t mOffset;
+        List<MediaBuffer *> mSamples;
+
+        WriteBatch() { clear(); }
+        void clear() {
+            mNumIovecs = 0;
+            mBytes = 0;
+            mPrefixesSize = 0;
+            mFd = -1;
+            mOffset = 0;
+        }
+    };
+    // Batches submitted but not yet written; flushPendingWrites_l() waits for
+    // one to complete once this many are in flight.
+    static const size_t kMaxWriteBatchesInFlight = 4;
+    std::vector<std::unique_ptr<WriteBatch>> mWriteBatches;
+    WriteBatch *mPendingWrite;                 // Being filled by addSample_l()
+    std::mutex mWriteQueueLock;
+    std::condition_variable mWriteQueueCondition;
+    std::deque<WriteBatch *> mWriteQueue;      // Submitted, in file order
+    std::vector<WriteBatch *> mFreeWriteBatches;
+    bool mIOThreadDone;
+    bool mIOThreadStarted;
+    pthread_t mIOThread;
+
     sp<ALooper> mLooper;
     sp<AHandlerReflector<MPEG4Writer> > mReflector;
 
@@ -156,6 +212,8 @@ private:
     int32_t getStartTimeOffsetBFramesUs();
     status_t startTracks(MetaData *params);
     size_t numTracks();
+    bool isFragmented() const { return mFragmented; }
+    int64_t fragmentDurationUs() const { return mFragmentDurationUs; }
     int64_t estimateMoovBoxSize(int32_t bitRate);
     int64_t estimateFileLevelMetaSize(MetaData *params);
     void writeCachedBoxToFile(const char *type);
@@ -184,6 +242,9 @@ private:
         // Max time interval between neighboring chunks
         int64_t mMaxInterChunkDurUs;
 
+        // Left out of the fragmented moov; its chunks are discarded
+        bool mDropped;
+
     };
 
     bool            mIsFirstChunk;
@@ -246,6 +307,13 @@ private:
     status_t stopWriterThread();
     static void *ThreadWrapper(void *me);
     void threadFunc();
+    // The I/O thread writes the batches of sample data flushed by the writer
+    // or track threads, so that laying out the next chunk overlaps the write.
+    void startIOThread();
+    void stopIOThread();
+    static void *IOThreadWrapper(void *me);
+    void ioThreadFunc();
+    void recordWriteDuration(std::chrono::microseconds duration);
     status_t setupAndStartLooper();
     void stopAndReleaseLooper();
 
@@ -261,6 +329,8 @@ private:
 
     // Actually write the given chunk to the file.
     void writeChunkToFile(Chunk* chunk);
+    void writeFragmentToFile(Chunk* chunk);
+    void writeFragmentedMoovBox();
 
     // Adjust other track media clock (presumably wall clock)
     // based on audio track media clock with the drift time.
@@ -297,6 +367,11 @@ private:
             uint32_t tiffHdrOffset, size_t *bytesWritten);
     void addLengthPrefixedSample_l(MediaBuffer *buffer);
     void addMultipleLengthPrefixedSamples_l(MediaBuffer *buffer);
+    void queueWrite_l(const void *data, size_t size);
+    void queuePrefix_l(const uint8_t *prefix, size_t size);
+    // Hand the queued sample data to the I/O thread. The samples, if any, are
+    // taken over and released once all the data queued so far is written.
+    void flushPendingWrites_l(List<MediaBuffer *> *samples = NULL);
     uint16_t addProperty_l(const ItemProperty &);
     status_t reserveItemId_l(size_t numItems, uint16_t *itemIdBase);
     uint16_t addItem_l(const ItemInfo &);
@@ -244,6 +244,39 @@ struct MediaCodec : public AHandler {
     status_t renderOutputBufferAndRelease(size_t index);
     status_t releaseOutputBuffer(size_t index);
 
+    // Describes one buffer of the batched calls below. The fields have the
+    // same meaning as the arguments of queueInputBuffer() and
+    // dequeueOutputBuffer().
+    struct BatchBufferInfo {
+        size_t mIndex;
+        size_t mOffset;
+        size_t mSize;
+        int64_t mPresentationTimeUs;
+        uint32_t mFlags;
+    };
+
+    // Batched variants of queueInputBuffer(), dequeueInputBuffer() and
+    // dequeueOutputBuffer() that handle several buffers in a single round
+    // trip to the codec's looper, for codecs with small frames where the
+    // per-call overhead dominates.
+    //
+    // queueInputBuffers() queues the buffers in order and stops at the first
+    // failure; |*numQueued| is set to the number of buffers queued.
+    status_t queueInputBuffers(
+            const BatchBufferInfo *infos,
+            size_t count,
+            size_t *numQueued,
+            AString *errorDetailMsg = NULL);
+
+    // Dequeue up to |maxCount| buffers. If none is available, these wait up to
+    // |timeoutUs| for the first one, as the single buffer variants do. On
+    // success |*count| is at least one. Output format changes are reported
+    // as INFO_FORMAT_CHANGED in order, i.e. after the buffers preceding them.
+    status_t dequeueInputBuffers(
+            size_t *indices, size_t maxCount, size_t *count, int64_t timeoutUs = 0ll);
+    status_t dequeueOutputBuffers(
+            BatchBufferInfo *infos, size_t maxCount, size_t *count, int64_t timeoutUs = 0ll);
+
     status_t signalEndOfInputStream();
 
     status_t getOutputFormat(sp<AMessage> *format) const;
@@ -353,7 +386,10 @@ private:
         kWhatRelease                        = 'rele',
         kWhatDequeueInputBuffer             = 'deqI',
         kWhatQueueInputBuffer               = 'queI',
+        kWhatQueueInputBuffers              = 'qIBs',
+        kWhatDequeueInputBuffers            = 'dIBs',
         kWhatDequeueOutputBuffer            = 'deqO',
+        kWhatDequeueOutputBuffers           = 'dOBs',
         kWhatReleaseOutputBuffer            = 'relO',
         kWhatSignalEndOfInputStream         = 'eois',
         kWhatGetBuffers                     = 'getB',
@@ -25,6 +25,17 @@ namespace android {
 // NB: These are not yet exposed as public Java API constants.
 inline constexpr char kCodecPixelFormat[] =
         "android.media.mediacodec.pixel-format";
+// pipeline depth autotuning mode: "throughput" or "latency"
+inline constexpr char kCodecPipelineAutotune[] =
+        "android.media.mediacodec.pipeline-autotune";
+// number of work items the pipeline accepts, and why
+inline constexpr char kCodecPipelineDepth[] =
+        "android.media.mediacodec.pipeline-depth";
+inline constexpr char kCodecPipelineDepthReason[] =
+        "android.media.mediacodec.pipeline-depth-reason";
+// histogram of the number of work items submitted to the component together
+inline constexpr char kCodecWorkBatchSizes[] =
+        "android.media.mediacodec.work-batch-sizes";
 
 }
 
@@ -136,6 +136,9 @@ enum {
 
     kKeyRealTimeRecording = 'rtrc',  // bool (int32_t)
     kKeyBackgroundMode = 'bkmd',  // bool (int32_t)
+    // If > 0, MPEG4Writer writes a fragmented file (moov, then moof/mdat pairs)
+    // with fragments of roughly this duration.
+    kKeyFragmentDurationUs = 'frdu',  // int64_t
 
     kKeyNumBuffers        = 'nbbf',  // int32_t
 
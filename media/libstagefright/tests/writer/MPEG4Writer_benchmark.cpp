@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <media/mediarecorder.h>
+#include <media/stagefright/MediaAdapter.h>
+#include <media/stagefright/MediaBuffer.h>
+#include <media/stagefright/MediaDefs.h>
+#include <media/stagefright/MetaData.h>
+#include <media/stagefright/MPEG4Writer.h>
+
+using namespace android;
+
+static const char kOutputFile[] = "/data/local/tmp/MPEG4Writer_benchmark.mp4";
+
+// One second of 4K120 at about 100 Mbit/s per track
+static const int kFrameCount = 120;
+static const int64_t kFrameIntervalUs = 1000000LL / 120;
+static const size_t kFrameSize = 100 * 1024;
+static const int kSyncFrameInterval = 30;
+
+// avcC with a 4 byte NAL length size and a stub SPS and PPS
+static const uint8_t kAvcc[] = {
+    0x01, 0x64, 0x00, 0x33, 0xff,
+    0xe1, 0x00, 0x04, 0x67, 0x64, 0x00, 0x33,
+    0x01, 0x00, 0x02, 0x68, 0xee,
+};
+
+// Number of write system calls of this process so far, or -1
+static int64_t getWriteSyscallCount() {
+    std::ifstream io("/proc/self/io");
+    std::string key;
+    int64_t value;
+    while (io >> key >> value) {
+        if (key == "syscw:") return value;
+    }
+    return -1;
+}
+
+// Annex-B frame as an encoder outputs it; the payload has no start code emulation
+static MediaBuffer *createFrame(int frame) {
+    MediaBuffer *buffer = new MediaBuffer(kFrameSize);
+    uint8_t *data = (uint8_t *)buffer->data();
+    const bool isSync = frame % kSyncFrameInterval == 0;
+    const uint8_t startCode[] = {0x00, 0x00, 0x00, 0x01, (uint8_t)(isSync ? 0x65 : 0x41)};
+    memcpy(data, startCode, sizeof(startCode));
+    memset(data + sizeof(startCode), 0xab, kFrameSize - sizeof(startCode));
+    buffer->meta_data().setInt64(kKeyTime, frame * kFrameIntervalUs);
+    buffer->meta_data().setInt64(kKeyDecodingTime, frame * kFrameIntervalUs);
+    buffer->meta_data().setInt32(kKeyIsSyncFrame, isSync);
+    // Released in MediaAdapter::signalBufferReturned().
+    buffer->add_ref();
+    return buffer;
+}
+
+// Sustained write rate of the writer, its number of write system calls per
+// frame, and how long a track waits in pushBuffer() per frame, for recordings
+// of 1, 2 and 4 video tracks. The samples are written by the writer's I/O
+// thread, so the wait only grows once the in-flight writes are at their bound.
+static void BM_RecordTracks(benchmark::State &state) {
+    const int trackCount = state.range(0);
+    int64_t syscalls = 0;
+    int64_t bytes = 0;
+    std::atomic<int64_t> pushWaitUs(0);
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        int fd = open(kOutputFile, O_CREAT | O_LARGEFILE | O_TRUNC | O_RDWR,
+                S_IRUSR | S_IWUSR);
+        if (fd < 0) {
+            state.SkipWithError("Failed to open output file");
+            break;
+        }
+        sp<MPEG4Writer> writer = new MPEG4Writer(fd);
+        std::vector<sp<MediaAdapter>> tracks;
+        for (int i = 0; i < trackCount; i++) {
+            sp<MetaData> trackMeta = new MetaData;
+            trackMeta->setCString(kKeyMIMEType, MEDIA_MIMETYPE_VIDEO_AVC);
+            trackMeta->setInt32(kKeyWidth, 3840);
+            trackMeta->setInt32(kKeyHeight, 2160);
+            trackMeta->setData(kKeyAVCC, kTypeAVCC, kAvcc, sizeof(kAvcc));
+            tracks.push_back(new MediaAdapter(trackMeta));
+            writer->addSource(tracks.back());
+        }
+        sp<MetaData> fileMeta = new MetaData;
+        fileMeta->setInt32(kKeyFileType, output_format::OUTPUT_FORMAT_MPEG_4);
+        fileMeta->setInt32(kKeyRealTimeRecording, false);
+        if (writer->start(fileMeta.get()) != OK) {
+            close(fd);
+            state.SkipWithError("Failed to start the writer");
+            break;
+        }
+        const int64_t syscallsBefore = getWriteSyscallCount();
+        state.ResumeTiming();
+
+        // pushBuffer() waits for the writer, so each track is fed from its own thread
+        std::vector<std::thread> threads;
+        for (auto &track : tracks) {
+            threads.emplace_back([track, &pushWaitUs]() {
+                for (int frame = 0; frame < kFrameCount; frame++) {
+                    MediaBuffer *buffer = createFrame(frame);
+                    auto before = std::chrono::steady_clock::now();
+                    track->pushBuffer(buffer);
+                    pushWaitUs += std::chrono::duration_cast<std::chrono::microseconds>(
+                            std::chrono::steady_clock::now() - before).count();
+                }
+                track->stop();
+            });
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+        writer->stop();
+
+        state.PauseTiming();
+        syscalls += getWriteSyscallCount() - syscallsBefore;
+        bytes += lseek64(fd, 0, SEEK_END);
+        writer.clear();
+        close(fd);
+        state.ResumeTiming();
+    }
+    unlink(kOutputFile);
+
+    state.SetBytesProcessed(bytes);
+    const double frames = (double)state.iterations() * kFrameCount * trackCount;
+    state.counters["syscalls/frame"] = benchmark::Counter((double)syscalls / frames);
+    state.counters["push_wait_us/frame"] = benchmark::Counter((double)pushWaitUs / frames);
+}
+
+BENCHMARK(BM_RecordTracks)
+        ->ArgName("tracks")
+        ->Arg(1)
+        ->Arg(2)
+        ->Arg(4)
+        ->Unit(benchmark::kMillisecond)
+        ->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -23,8 +23,11 @@
 #include <inttypes.h>
 #include <fstream>
 #include <iostream>
+#include <map>
 
 #include <media/NdkMediaExtractor.h>
+#include <media/stagefright/foundation/ByteUtils.h>
+#include <media/stagefright/MediaBuffer.h>
 #include <media/stagefright/MediaDefs.h>
 #include <media/stagefright/MetaData.h>
 #include <media/stagefright/Utils.h>
@@ -896,6 +899,218 @@ TEST_P(WriteFunctionalityTest, Mpeg4WriterTest) {
     close(fd);
 }
 
+static int64_t getResidentSetSizeBytes() {
+    std::ifstream statm("/proc/self/statm");
+    int64_t sizePages = 0, residentPages = 0;
+    if (!(statm >> sizePages >> residentPages)) return -1;
+    return residentPages * sysconf(_SC_PAGESIZE);
+}
+
+// Records a day of synthetic audio into a fragmented MPEG4 file and checks that the
+// writer's memory use does not grow with the recording length.
+TEST(FragmentedMpeg4WriterTest, FlatMemoryOverLongRecording) {
+    constexpr int64_t kFragmentDurationUs = 2000000LL;
+    constexpr int64_t kSampleIntervalUs = 100000LL;
+    constexpr int64_t kRecordingDurationUs = 24LL * 3600 * 1000000LL;
+    constexpr int64_t kWarmUpDurationUs = 3600LL * 1000000LL;
+    constexpr int64_t kMaxRssGrowthBytes = 2 * 1024 * 1024;
+    constexpr size_t kSampleSize = 32;
+
+    int32_t fd =
+            open(OUTPUT_FILE_NAME, O_CREAT | O_LARGEFILE | O_TRUNC | O_RDWR, S_IRUSR | S_IWUSR);
+    ASSERT_GE(fd, 0) << "Failed to open output file to dump writer's data";
+
+    sp<MPEG4Writer> writer = new MPEG4Writer(fd);
+    sp<AMessage> format = new AMessage;
+    format->setString("mime", MEDIA_MIMETYPE_AUDIO_AAC);
+    format->setInt32("channel-count", 2);
+    format->setInt32("sample-rate", 48000);
+    const uint8_t kAudioSpecificConfig[] = {0x11, 0x90};
+    format->setBuffer("csd-0", ABuffer::CreateAsCopy(kAudioSpecificConfig,
+                                                     sizeof(kAudioSpecificConfig)));
+    sp<MetaData> trackMeta = new MetaData;
+    convertMessageToMetaData(format, trackMeta);
+    sp<MediaAdapter> track = new MediaAdapter(trackMeta);
+    ASSERT_EQ((status_t)OK, writer->addSource(track));
+
+    sp<MetaData> fileMeta = new MetaData;
+    fileMeta->setInt32(kKeyFileType, output_format::OUTPUT_FORMAT_MPEG_4);
+    fileMeta->setInt32(kKeyRealTimeRecording, false);
+    fileMeta->setInt64(kKeyFragmentDurationUs, kFragmentDurationUs);
+    ASSERT_EQ((status_t)OK, writer->start(fileMeta.get()));
+
+    int64_t warmRssBytes = -1;
+    uint8_t data[kSampleSize] = {};
+    for (int64_t timeUs = 0; timeUs < kRecordingDurationUs; timeUs += kSampleIntervalUs) {
+        if (timeUs == kWarmUpDurationUs) {
+            warmRssBytes = getResidentSetSizeBytes();
+        }
+        MediaBuffer *mediaBuffer = new MediaBuffer(ABuffer::CreateAsCopy(data, sizeof(data)));
+        // Released in MediaAdapter::signalBufferReturned().
+        mediaBuffer->add_ref();
+        mediaBuffer->meta_data().setInt64(kKeyTime, timeUs);
+        mediaBuffer->meta_data().setInt64(kKeyDecodingTime, timeUs);
+        mediaBuffer->meta_data().setInt32(kKeyIsSyncFrame, true);
+        ASSERT_EQ((status_t)OK, track->pushBuffer(mediaBuffer));
+    }
+    int64_t finalRssBytes = getResidentSetSizeBytes();
+
+    ASSERT_EQ((status_t)OK, track->stop());
+    ASSERT_EQ((status_t)OK, writer->stop());
+
+    ASSERT_GT(warmRssBytes, 0) << "Could not read resident set size";
+    ASSERT_LE(finalRssBytes - warmRssBytes, kMaxRssGrowthBytes)
+            << "Writer memory grew from " << warmRssBytes << " to " << finalRssBytes
+            << " bytes over the recording";
+
+    // A moov up front, then one moof/mdat pair per fragment
+    constexpr int64_t kSampleCount = kRecordingDurationUs / kSampleIntervalUs;
+    constexpr int64_t kFragmentCount = kRecordingDurationUs / kFragmentDurationUs;
+    std::map<std::string, int64_t> boxCounts;
+    int64_t fileSize = lseek64(fd, 0, SEEK_END);
+    for (off64_t offset = 0; offset < fileSize;) {
+        uint8_t header[16];
+        ASSERT_EQ(8, pread64(fd, header, 8, offset)) << "Truncated box at " << offset;
+        uint64_t boxSize = U32_AT(header);
+        std::string type((const char *)header + 4, 4);
+        if (boxSize == 1) {
+            ASSERT_EQ(8, pread64(fd, header + 8, 8, offset + 8));
+            boxSize = U64_AT(header + 8);
+        }
+        ASSERT_GE(boxSize, 8u) << "Invalid " << type << " box at " << offset;
+        if (type == "moof") {
+            ASSERT_EQ(1, boxCounts["moov"]) << "Fragment written before the moov";
+        }
+        boxCounts[type]++;
+        offset += boxSize;
+    }
+    EXPECT_EQ(1, boxCounts["ftyp"]);
+    EXPECT_EQ(kFragmentCount, boxCounts["moof"]);
+    EXPECT_EQ(kFragmentCount, boxCounts["mdat"]);
+
+    // Every sample reads back through the MPEG4 extractor, in order and on time
+    AMediaExtractor *extractor = AMediaExtractor_new();
+    ASSERT_NE(extractor, nullptr) << "Extractor creation failed";
+    ASSERT_EQ(AMEDIA_OK, AMediaExtractor_setDataSourceFd(extractor, fd, 0, fileSize));
+    ASSERT_EQ(1u, AMediaExtractor_getTrackCount(extractor));
+    ASSERT_EQ(AMEDIA_OK, AMediaExtractor_selectTrack(extractor, 0));
+    int64_t sampleCount = 0;
+    for (; AMediaExtractor_getSampleTime(extractor) >= 0; AMediaExtractor_advance(extractor)) {
+        ASSERT_EQ(sampleCount * kSampleIntervalUs, AMediaExtractor_getSampleTime(extractor))
+                << "Unexpected timestamp of sample " << sampleCount;
+        ASSERT_EQ((ssize_t)kSampleSize, AMediaExtractor_getSampleSize(extractor));
+        ASSERT_TRUE(AMediaExtractor_getSampleFlags(extractor) & AMEDIAEXTRACTOR_SAMPLE_FLAG_SYNC);
+        sampleCount++;
+    }
+    EXPECT_EQ(kSampleCount, sampleCount) << "Unexpected number of samples";
+    AMediaExtractor_delete(extractor);
+
+    close(fd);
+    if (gEnv->cleanUp()) remove(OUTPUT_FILE_NAME);
+}
+
+// Counts the complete top level boxes of a file that may still be being written
+static std::map<std::string, int64_t> getTopLevelBoxCounts(int32_t fd) {
+    std::map<std::string, int64_t> boxCounts;
+    int64_t fileSize = lseek64(fd, 0, SEEK_END);
+    for (off64_t offset = 0; offset + 8 <= fileSize;) {
+        uint8_t header[16];
+        if (pread64(fd, header, 8, offset) != 8) break;
+        uint64_t boxSize = U32_AT(header);
+        if (boxSize == 1) {
+            if (pread64(fd, header + 8, 8, offset + 8) != 8) break;
+            boxSize = U64_AT(header + 8);
+        }
+        // Fragment headers are filled in after their payload
+        if (boxSize < 8 || offset + boxSize > fileSize) break;
+        boxCounts[std::string((const char *)header + 4, 4)]++;
+        offset += boxSize;
+    }
+    return boxCounts;
+}
+
+// Records a fragmented MPEG4 file with two audio tracks, one of which never produces
+// a sample. The moov and the other track's fragments must not wait for it.
+TEST(FragmentedMpeg4WriterTest, StalledTrackDoesNotHoldFragments) {
+    constexpr int64_t kFragmentDurationUs = 100000LL;
+    constexpr int64_t kSampleIntervalUs = 20000LL;
+    constexpr int64_t kRecordingDurationUs = 2000000LL;
+    constexpr int64_t kFragmentWaitUs = 5000000LL;
+    constexpr size_t kSampleSize = 32;
+
+    int32_t fd =
+            open(OUTPUT_FILE_NAME, O_CREAT | O_LARGEFILE | O_TRUNC | O_RDWR, S_IRUSR | S_IWUSR);
+    ASSERT_GE(fd, 0) << "Failed to open output file to dump writer's data";
+
+    sp<MPEG4Writer> writer = new MPEG4Writer(fd);
+    sp<MediaAdapter> tracks[2];
+    for (auto &track : tracks) {
+        sp<AMessage> format = new AMessage;
+        format->setString("mime", MEDIA_MIMETYPE_AUDIO_AAC);
+        format->setInt32("channel-count", 2);
+        format->setInt32("sample-rate", 48000);
+        const uint8_t kAudioSpecificConfig[] = {0x11, 0x90};
+        format->setBuffer("csd-0", ABuffer::CreateAsCopy(kAudioSpecificConfig,
+                                                         sizeof(kAudioSpecificConfig)));
+        sp<MetaData> trackMeta = new MetaData;
+        convertMessageToMetaData(format, trackMeta);
+        track = new MediaAdapter(trackMeta);
+        ASSERT_EQ((status_t)OK, writer->addSource(track));
+    }
+    sp<MediaAdapter> stalledTrack = tracks[1];
+
+    sp<MetaData> fileMeta = new MetaData;
+    fileMeta->setInt32(kKeyFileType, output_format::OUTPUT_FORMAT_MPEG_4);
+    fileMeta->setInt32(kKeyRealTimeRecording, false);
+    fileMeta->setInt64(kKeyFragmentDurationUs, kFragmentDurationUs);
+    ASSERT_EQ((status_t)OK, writer->start(fileMeta.get()));
+
+    uint8_t data[kSampleSize] = {};
+    for (int64_t timeUs = 0; timeUs < kRecordingDurationUs; timeUs += kSampleIntervalUs) {
+        MediaBuffer *mediaBuffer = new MediaBuffer(ABuffer::CreateAsCopy(data, sizeof(data)));
+        // Released in MediaAdapter::signalBufferReturned().
+        mediaBuffer->add_ref();
+        mediaBuffer->meta_data().setInt64(kKeyTime, timeUs);
+        mediaBuffer->meta_data().setInt64(kKeyDecodingTime, timeUs);
+        mediaBuffer->meta_data().setInt32(kKeyIsSyncFrame, true);
+        ASSERT_EQ((status_t)OK, tracks[0]->pushBuffer(mediaBuffer));
+    }
+
+    // The stalled track is still running; fragments must reach the file regardless
+    std::map<std::string, int64_t> boxCounts;
+    for (int64_t waitedUs = 0; waitedUs < kFragmentWaitUs; waitedUs += 10000) {
+        boxCounts = getTopLevelBoxCounts(fd);
+        if (boxCounts["moof"] > 0) break;
+        usleep(10000);
+    }
+    EXPECT_EQ(1, boxCounts["moov"]) << "No moov while a track is stalled";
+    EXPECT_GT(boxCounts["moof"], 0) << "No fragment while a track is stalled";
+
+    ASSERT_EQ((status_t)OK, stalledTrack->stop());
+    ASSERT_EQ((status_t)OK, tracks[0]->stop());
+    ASSERT_EQ((status_t)OK, writer->stop());
+
+    // The stalled track is left out, and every sample of the other one reads back
+    int64_t fileSize = lseek64(fd, 0, SEEK_END);
+    AMediaExtractor *extractor = AMediaExtractor_new();
+    ASSERT_NE(extractor, nullptr) << "Extractor creation failed";
+    ASSERT_EQ(AMEDIA_OK, AMediaExtractor_setDataSourceFd(extractor, fd, 0, fileSize));
+    ASSERT_EQ(1u, AMediaExtractor_getTrackCount(extractor));
+    ASSERT_EQ(AMEDIA_OK, AMediaExtractor_selectTrack(extractor, 0));
+    int64_t sampleCount = 0;
+    for (; AMediaExtractor_getSampleTime(extractor) >= 0; AMediaExtractor_advance(extractor)) {
+        ASSERT_EQ(sampleCount * kSampleIntervalUs, AMediaExtractor_getSampleTime(extractor))
+                << "Unexpected timestamp of sample " << sampleCount;
+        sampleCount++;
+    }
+    EXPECT_EQ(kRecordingDurationUs / kSampleIntervalUs, sampleCount)
+            << "Unexpected number of samples";
+    AMediaExtractor_delete(extractor);
+
+    close(fd);
+    if (gEnv->cleanUp()) remove(OUTPUT_FILE_NAME);
+}
+
 class ListenerTest
     : public WriterTest,
       public ::testing::TestWithParam<tuple<
@@ -387,6 +387,7 @@ void BlockIterator::advance_l() {
             CHECK(nextCluster != NULL);
             CHECK(!nextCluster->EOS());
 
+            mExtractor->appendToClusterIndex_l(mCluster, nextCluster);
             mCluster = nextCluster;
 
             res = mCluster->Parse(pos, len);
@@ -584,7 +585,12 @@ int64_t BlockIterator::blockTimeUs() const {
 }
 
 void BlockIterator::seekwithoutcue_l(int64_t seekTimeUs, int64_t *actualFrameTimeUs) {
-    mCluster = mExtractor->mSegment->FindCluster(seekTimeUs * 1000ll);
+    mCluster = mExtractor->findCluster_l(seekTimeUs * 1000ll);
+    if (mCluster == NULL || mCluster->EOS()) {
+        ALOGE("no cluster found for seek to %lld", (long long)seekTimeUs);
+        mCluster = NULL;
+        return;
+    }
     const long status = mCluster->GetFirst(mBlockEntry);
     if (status < 0) {  // error
         ALOGE("get last blockenry failed!");
@@ -1334,6 +1340,7 @@ MatroskaExtractor::MatroskaExtractor(DataSourceHelper *source)
     : mDataSource(source),
       mReader(new DataSourceBaseReader(mDataSource)),
       mSegment(NULL),
+      mClusterIndexComplete(false),
       mExtractedThumbnails(false),
       mIsWebm(false),
       mSeekPreRollNs(0) {
@@ -1401,13 +1408,25 @@ MatroskaExtractor::MatroskaExtractor(DataSourceHelper *source)
                 }
             }
 
+            // Only the first cluster is loaded up front. Without Cues, the
+            // remaining clusters are indexed lazily by findCluster_l() as
+            // playback and seeks walk the file, rather than scanning the
+            // whole segment here.
+            long len;
+            ret = mSegment->LoadCluster(pos, len);
             if (mCues) {
-                long len;
-                ret = mSegment->LoadCluster(pos, len);
                 ALOGV("has Cue data, Cluster num=%ld", mSegment->GetCount());
-            } else  {
-                long status_Load = mSegment->Load();
-                ALOGW("no Cue data,Segment Load status:%ld",status_Load);
+            } else {
+                // As with the full Segment::Load() this replaces, a bad
+                // cluster is not fatal without Cues; findCluster_l() indexes
+                // whatever can be parsed later on.
+                ALOGW_IF(ret < 0, "no Cue data, first cluster load status:%ld", ret);
+                ALOGV("no Cue data, clusters will be indexed on demand");
+                ret = 0;
+            }
+            if (ret >= 1) {
+                // no more clusters
+                ret = 0;
             }
         } else if (ret > 0) {
             ret = mkvparser::E_BUFFER_NOT_FULL;
@@ -2308,6 +2327,84 @@ media_status_t MatroskaExtractor::getMetaData(AMediaFormat *meta) {
     return AMEDIA_OK;
 }
 
+void MatroskaExtractor::appendToClusterIndex_l(
+        const mkvparser::Cluster *prev, const mkvparser::Cluster *cluster) {
+    // Keep the index contiguous: only extend it when |cluster| directly
+    // follows the last indexed cluster. Clusters reached through a jump
+    // are picked up later by findCluster_l() walking forward.
+    if (mClusterIndex.empty() || mClusterIndex.top().mCluster != prev) {
+        return;
+    }
+
+    const long long timeNs = cluster->GetTime();
+    if (timeNs < 0 || timeNs < mClusterIndex.top().mTimeNs) {
+        // error, or out of order timecodes; stop indexing past this point
+        mClusterIndexComplete = true;
+        return;
+    }
+
+    ClusterIndexEntry entry;
+    entry.mTimeNs = timeNs;
+    entry.mCluster = cluster;
+    mClusterIndex.push(entry);
+}
+
+// Returns the last cluster starting at or before |timeNs|, or the first
+// cluster if |timeNs| precedes it. Equivalent to Segment::FindCluster(), but
+// works off the cluster index, extending it only as far as |timeNs|.
+const mkvparser::Cluster *MatroskaExtractor::findCluster_l(long long timeNs) {
+    if (mClusterIndex.empty()) {
+        const mkvparser::Cluster *first = mSegment->GetFirst();
+        if (first == NULL || first->EOS()) {
+            return first;
+        }
+        ClusterIndexEntry entry;
+        entry.mTimeNs = first->GetTime();
+        entry.mCluster = first;
+        if (entry.mTimeNs < 0) {
+            return mSegment->FindCluster(timeNs);
+        }
+        mClusterIndex.push(entry);
+    }
+
+    while (!mClusterIndexComplete && mClusterIndex.top().mTimeNs <= timeNs) {
+        const mkvparser::Cluster *last = mClusterIndex.top().mCluster;
+        const mkvparser::Cluster *next;
+        long long pos;
+        long len;
+        const long res = mSegment->ParseNext(last, next, pos, len);
+        if (res != 0) {
+            if (res > 0) {
+                // no more clusters
+                mClusterIndexComplete = true;
+            }
+            break;
+        }
+        CHECK(next != NULL);
+
+        appendToClusterIndex_l(last, next);
+        if (mClusterIndex.top().mCluster != next) {
+            break;
+        }
+    }
+    ALOGV("cluster index has %zu entries%s", mClusterIndex.size(),
+            mClusterIndexComplete ? " (complete)" : "");
+
+    // Binary search for the first entry starting after timeNs.
+    size_t lo = 0;
+    size_t hi = mClusterIndex.size();
+    while (lo < hi) {
+        const size_t mid = lo + (hi - lo) / 2;
+        if (mClusterIndex.itemAt(mid).mTimeNs <= timeNs) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return mClusterIndex.itemAt(lo == 0 ? 0 : lo - 1).mCluster;
+}
+
 uint32_t MatroskaExtractor::flags() const {
     uint32_t x = CAN_PAUSE;
     if (!isLiveStreaming()) {
@@ -81,8 +81,18 @@ private:
         const mkvparser::CuePoint::TrackPosition *find(long long timeNs) const;
     };
 
+    // One entry per parsed cluster, in file order, so that seeking in files
+    // without Cues can binary search cluster start times instead of asking
+    // mkvparser to load (and re-read) cluster headers.
+    struct ClusterIndexEntry {
+        long long mTimeNs;
+        const mkvparser::Cluster *mCluster;
+    };
+
     Mutex mLock;
     Vector<TrackInfo> mTracks;
+    Vector<ClusterIndexEntry> mClusterIndex;
+    bool mClusterIndexComplete;
 
     DataSourceHelper *mDataSource;
     DataSourceBaseReader *mReader;
@@ -106,6 +116,10 @@ private:
             AMediaFormat *meta);
     bool isLiveStreaming() const;
 
+    void appendToClusterIndex_l(
+            const mkvparser::Cluster *prev, const mkvparser::Cluster *cluster);
+    const mkvparser::Cluster *findCluster_l(long long timeNs);
+
     MatroskaExtractor(const MatroskaExtractor &);
     MatroskaExtractor &operator=(const MatroskaExtractor &);
 };
@@ -19,6 +19,9 @@
 #include <utils/Log.h>
 
 #include <inttypes.h>
+#include <algorithm>
+#include <chrono>
+#include <memory>
 
 #include <datasource/FileSource.h>
 #include <media/stagefright/MediaBufferGroup.h>
@@ -45,12 +48,14 @@
 using namespace android;
 
 #define OUTPUT_DUMP_FILE "/data/local/tmp/extractorOutput"
+#define CORRUPT_CLIP_FILE "/data/local/tmp/extractorCorruptClip"
 
 constexpr int32_t kMaxCount = 10;
 constexpr int32_t kAudioDefaultSampleDuration = 20000;                       // 20ms
 constexpr int32_t kRandomSeekToleranceUs = 2 * kAudioDefaultSampleDuration;  // 40 ms;
 constexpr int32_t kRandomSeed = 700;
 constexpr int32_t kUndefined = -1;
+constexpr int32_t kSeekLatencyIterations = 50;
 
 enum inputID {
     // audio streams
@@ -829,6 +834,154 @@ TEST_P(ExtractorFunctionalityTest, MonkeySeekTest) {
     }
 }
 
+// Reports the average seek latency of the Matroska extractor and checks that every seek
+// lands on the expected sync sample. For clips without Cues this exercises the cluster
+// index built while seeking.
+TEST_P(ExtractorFunctionalityTest, SeekLatencyTest) {
+    if (mDisableTest) return;
+    if (mExtractorName != MKV) return;
+
+    string inputFileName = gEnv->getRes() + get<1>(GetParam());
+    ALOGV("Measures %s Extractor seek latency, filename %s", mContainer.c_str(),
+          inputFileName.c_str());
+
+    int32_t status = setDataSource(inputFileName);
+    ASSERT_EQ(status, 0) << "SetDataSource failed for" << mContainer << "extractor";
+
+    // The sync samples are listed by a separate extractor, so that reading the whole
+    // track doesn't index the clusters of the one under test ahead of the seeks.
+    vector<int64_t> seekablePoints;
+    {
+        unique_ptr<MediaExtractorPluginHelper> referenceExtractor(
+                new MatroskaExtractor(new DataSourceHelper(mDataSource->wrap())));
+        MediaTrackHelper *track = referenceExtractor->getTrack(0);
+        ASSERT_NE(track, nullptr) << "Failed to get reference track for index 0";
+        CMediaTrack *cTrack = wrap(track);
+        ASSERT_NE(cTrack, nullptr) << "Failed to get track wrapper for index 0";
+        MediaBufferGroup *bufferGroup = new MediaBufferGroup();
+        status = cTrack->start(track, bufferGroup->wrap());
+        ASSERT_EQ(OK, (media_status_t)status) << "Failed to start the reference track";
+        getSeekablePoints(seekablePoints, track);
+        status = cTrack->stop(track);
+        ASSERT_EQ(OK, status) << "Failed to stop the reference track";
+        delete bufferGroup;
+        delete track;
+    }
+    ASSERT_GT(seekablePoints.size(), 1u) << "Too few sync samples to test seeks";
+
+    status = createExtractor();
+    ASSERT_EQ(status, 0) << "Extractor creation failed for" << mContainer << "extractor";
+
+    int32_t numTracks = mExtractor->countTracks();
+    ASSERT_EQ(numTracks, mNumTracks)
+            << "Extractor reported wrong number of track for the given clip";
+
+    MediaTrackHelper *track = mExtractor->getTrack(0);
+    ASSERT_NE(track, nullptr) << "Failed to get track for index 0";
+
+    CMediaTrack *cTrack = wrap(track);
+    ASSERT_NE(cTrack, nullptr) << "Failed to get track wrapper for index 0";
+
+    MediaBufferGroup *bufferGroup = new MediaBufferGroup();
+    status = cTrack->start(track, bufferGroup->wrap());
+    ASSERT_EQ(OK, (media_status_t)status) << "Failed to start the track";
+
+    srand(kRandomSeed);
+    int64_t totalSeekTimeUs = 0;
+    for (int32_t i = 0; i < kSeekLatencyIterations; i++) {
+        // Just before a sync sample, so the previous one is expected
+        size_t seekIdx = rand() % (seekablePoints.size() - 1) + 1;
+        int64_t seekPts = seekablePoints[seekIdx] -
+                ((seekablePoints[seekIdx] - seekablePoints[seekIdx - 1]) >> 3);
+        MediaTrackHelper::ReadOptions options(
+                CMediaTrackReadOptions::SEEK_PREVIOUS_SYNC | CMediaTrackReadOptions::SEEK, seekPts);
+
+        MediaBufferHelper *buffer = nullptr;
+        auto start = chrono::steady_clock::now();
+        status = track->read(&buffer, &options);
+        auto end = chrono::steady_clock::now();
+        totalSeekTimeUs += chrono::duration_cast<chrono::microseconds>(end - start).count();
+        ASSERT_EQ(OK, (media_status_t)status) << "Seek to " << seekPts << " failed";
+        ASSERT_NE(buffer, nullptr) << "No sample after the seek to " << seekPts;
+        int64_t timeStamp = -1;
+        int32_t isSync = 0;
+        AMediaFormat_getInt64(buffer->meta_data(), AMEDIAFORMAT_KEY_TIME_US, &timeStamp);
+        AMediaFormat_getInt32(buffer->meta_data(), AMEDIAFORMAT_KEY_IS_SYNC_FRAME, &isSync);
+        buffer->release();
+        EXPECT_EQ(timeStamp, seekablePoints[seekIdx - 1]) << "Seek to " << seekPts;
+        EXPECT_TRUE(isSync) << "Seek to " << seekPts << " landed on a non-sync sample";
+    }
+    cout << "[   INFO   ] " << get<1>(GetParam()) << ": average seek latency "
+         << totalSeekTimeUs / kSeekLatencyIterations << " us\n";
+
+    status = cTrack->stop(track);
+    ASSERT_EQ(OK, status) << "Failed to stop the track";
+    delete bufferGroup;
+    delete track;
+}
+
+class MatroskaCorruptionTest : public ExtractorUnitTest, public ::testing::Test {};
+
+// A clip without Cues whose first cluster can't be loaded must still open with its tracks;
+// like a failed Segment::Load(), a bad cluster is not fatal to the whole file.
+TEST_F(MatroskaCorruptionTest, BadFirstClusterWithoutCues) {
+    setupExtractor("mkv");
+    if (mDisableTest) return;
+
+    string inputFileName = gEnv->getRes() + "withoutcues.mkv";
+    FILE *inputFp = fopen(inputFileName.c_str(), "rb");
+    ASSERT_NE(inputFp, nullptr) << "Unable to open " << inputFileName;
+    vector<uint8_t> clip;
+    uint8_t chunk[4096];
+    for (size_t n; (n = fread(chunk, 1, sizeof(chunk), inputFp)) > 0;) {
+        clip.insert(clip.end(), chunk, chunk + n);
+    }
+    fclose(inputFp);
+
+    // A zero byte is not a valid EBML size, so the first cluster fails to load
+    const uint8_t kClusterId[] = {0x1F, 0x43, 0xB6, 0x75};
+    auto cluster = search(clip.begin(), clip.end(), kClusterId, kClusterId + sizeof(kClusterId));
+    ASSERT_NE(cluster, clip.end()) << "No cluster in " << inputFileName;
+    ASSERT_LT(cluster + sizeof(kClusterId), clip.end());
+    *(cluster + sizeof(kClusterId)) = 0x00;
+
+    FILE *corruptFp = fopen(CORRUPT_CLIP_FILE, "wb");
+    ASSERT_NE(corruptFp, nullptr) << "Unable to create " << CORRUPT_CLIP_FILE;
+    ASSERT_EQ(clip.size(), fwrite(clip.data(), 1, clip.size(), corruptFp));
+    fclose(corruptFp);
+
+    int32_t status = setDataSource(CORRUPT_CLIP_FILE);
+    ASSERT_EQ(status, 0) << "SetDataSource failed for corrupt mkv clip";
+
+    status = createExtractor();
+    ASSERT_EQ(status, 0) << "Extractor creation failed for corrupt mkv clip";
+    ASSERT_EQ(2, mExtractor->countTracks()) << "Corrupt first cluster dropped the tracks";
+
+    MediaTrackHelper *track = mExtractor->getTrack(0);
+    ASSERT_NE(track, nullptr) << "Failed to get track for index 0";
+    CMediaTrack *cTrack = wrap(track);
+    ASSERT_NE(cTrack, nullptr) << "Failed to get track wrapper for index 0";
+    MediaBufferGroup *bufferGroup = new MediaBufferGroup();
+    status = cTrack->start(track, bufferGroup->wrap());
+    ASSERT_EQ(OK, (media_status_t)status) << "Failed to start the track";
+
+    // Reads and seeks have no cluster to work from, but must fail cleanly
+    MediaBufferHelper *buffer = nullptr;
+    status = track->read(&buffer);
+    if (buffer) buffer->release();
+    buffer = nullptr;
+    MediaTrackHelper::ReadOptions options(
+            CMediaTrackReadOptions::SEEK_PREVIOUS_SYNC | CMediaTrackReadOptions::SEEK, 1000000);
+    status = track->read(&buffer, &options);
+    if (buffer) buffer->release();
+
+    status = cTrack->stop(track);
+    ASSERT_EQ(OK, status) << "Failed to stop the track";
+    delete bufferGroup;
+    delete track;
+    remove(CORRUPT_CLIP_FILE);
+}
+
 // Tests extractors for invalid tracks
 TEST_P(ExtractorFunctionalityTest, SanityTest) {
     if (mDisableTest) return;
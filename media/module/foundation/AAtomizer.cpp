@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+#include <string.h>
 #include <sys/types.h>
 
 #include "AAtomizer.h"
@@ -21,44 +22,79 @@
 namespace android {
 
 // static
-AAtomizer AAtomizer::gAtomizer;
+AAtomizer &AAtomizer::Instance() {
+    static AAtomizer *sAtomizer = new AAtomizer;
+    return *sAtomizer;
+}
 
 // static
 const char *AAtomizer::Atomize(const char *name) {
-    return gAtomizer.atomize(name);
+    return Instance().atomize(name, strlen(name), true /* mustAdd */);
+}
+
+// static
+const char *AAtomizer::AtomizeIfRoom(const char *name, size_t len) {
+    // Most names are string literals, so remember the atoms recently handed
+    // out for a given pointer. The contents are compared as well, as the
+    // caller may reuse the same buffer for a different name.
+    struct CacheEntry {
+        const char *mName;
+        const char *mAtom;
+        size_t mLength;
+    };
+    static const size_t kCacheSize = 64;
+    static thread_local CacheEntry sCache[kCacheSize];
+
+    CacheEntry &entry = sCache[((uintptr_t)name >> 3) % kCacheSize];
+    if (entry.mName == name && entry.mLength == len && !memcmp(entry.mAtom, name, len)) {
+        return entry.mAtom;
+    }
+
+    const char *atom = Instance().atomize(name, len, false /* mustAdd */);
+    if (atom != NULL) {
+        entry.mName = name;
+        entry.mAtom = atom;
+        entry.mLength = len;
+    }
+    return atom;
 }
 
-AAtomizer::AAtomizer() {
-    for (size_t i = 0; i < 128; ++i) {
+AAtomizer::AAtomizer()
+    : mNumAtoms(0) {
+    for (size_t i = 0; i < kNumBuckets; ++i) {
         mAtoms.push(List<AString>());
     }
 }
 
-const char *AAtomizer::atomize(const char *name) {
+const char *AAtomizer::atomize(const char *name, size_t len, bool mustAdd) {
     Mutex::Autolock autoLock(mLock);
 
     const size_t n = mAtoms.size();
-    size_t index = AAtomizer::Hash(name) % n;
+    size_t index = AAtomizer::Hash(name, len) % n;
     List<AString> &entry = mAtoms.editItemAt(index);
     List<AString>::iterator it = entry.begin();
     while (it != entry.end()) {
-        if ((*it) == name) {
+        if ((*it).size() == len && !memcmp((*it).c_str(), name, len)) {
             return (*it).c_str();
         }
         ++it;
     }
 
-    entry.push_back(AString(name));
+    if (!mustAdd && mNumAtoms >= kMaxNumAtoms) {
+        return NULL;
+    }
+
+    entry.push_back(AString(name, len));
+    ++mNumAtoms;
 
     return (*--entry.end()).c_str();
 }
 
 // static
-uint32_t AAtomizer::Hash(const char *s) {
+uint32_t AAtomizer::Hash(const char *s, size_t len) {
     uint32_t sum = 0;
-    while (*s != '\0') {
-        sum = (sum * 31) + *s;
-        ++s;
+    for (size_t i = 0; i < len; ++i) {
+        sum = (sum * 31) + s[i];
     }
 
     return sum;
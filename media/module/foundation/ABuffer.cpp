@@ -22,6 +22,33 @@
 
 namespace android {
 
+// static
+AObjectPool &ABuffer::Pool() {
+    static AObjectPool *sPool = new AObjectPool("ABuffer", sizeof(ABuffer), 32);
+    return *sPool;
+}
+
+// static
+void *ABuffer::operator new(size_t size) {
+    return Pool().allocate(size);
+}
+
+// static
+void *ABuffer::operator new(size_t size, const std::nothrow_t &tag) {
+    return Pool().allocate(size, tag);
+}
+
+// static
+void ABuffer::operator delete(void *ptr, size_t size) {
+    Pool().release(ptr, size);
+}
+
+// static
+void ABuffer::operator delete(void *ptr, const std::nothrow_t &) {
+    // only used if a constructor throws; the size is not known here
+    Pool().release(ptr, 0);
+}
+
 ABuffer::ABuffer(size_t capacity)
     : mRangeOffset(0),
       mInt32Data(0),
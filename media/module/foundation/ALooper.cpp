@@ -23,6 +23,8 @@
 
 #include <sys/time.h>
 
+#include <algorithm>
+
 #include "ALooper.h"
 
 #include "AHandler.h"
@@ -74,7 +76,8 @@ int64_t ALooper::getNowUs() {
 }
 
 ALooper::ALooper()
-    : mRunningLocally(false) {
+    : mNextEventSeq(0),
+      mRunningLocally(false) {
     // clean up stale AHandlers. Doing it here instead of in the destructor avoids
     // the side effect of objects being deleted from the unregister function recursively.
     gLooperRoster.unregisterStaleHandlers();
@@ -169,6 +172,54 @@ status_t ALooper::stop() {
     return OK;
 }
 
+// static
+bool ALooper::DueLater(const Event &a, const Event &b) {
+    return a.mWhenUs > b.mWhenUs || (a.mWhenUs == b.mWhenUs && a.mSeq > b.mSeq);
+}
+
+bool ALooper::hasEvents_l() const {
+    return !mImmediateEvents.empty() || !mDelayedEvents.empty();
+}
+
+int64_t ALooper::nextEventTimeUs_l() const {
+    if (mDelayedEvents.empty()) {
+        return mImmediateEvents.front().mWhenUs;
+    } else if (mImmediateEvents.empty()) {
+        return mDelayedEvents.front().mWhenUs;
+    }
+    return std::min(mImmediateEvents.front().mWhenUs, mDelayedEvents.front().mWhenUs);
+}
+
+void ALooper::popNextEvent_l(Event *event) {
+    if (!mImmediateEvents.empty()
+            && (mDelayedEvents.empty()
+                    || DueLater(mDelayedEvents.front(), mImmediateEvents.front()))) {
+        *event = std::move(mImmediateEvents.front());
+        mImmediateEvents.pop_front();
+    } else {
+        std::pop_heap(mDelayedEvents.begin(), mDelayedEvents.end(), DueLater);
+        *event = std::move(mDelayedEvents.back());
+        mDelayedEvents.pop_back();
+    }
+}
+
+void ALooper::queueEvent_l(
+        int64_t whenUs, bool immediate, const sp<AMessage> &msg, const sp<RefBase> &token) {
+    Event event;
+    event.mWhenUs = whenUs;
+    event.mSeq = mNextEventSeq++;
+    event.mMessage = msg;
+    event.mToken = token;
+
+    // The FIFO stays sorted as long as the clock does not go backwards.
+    if (immediate && (mImmediateEvents.empty() || mImmediateEvents.back().mWhenUs <= whenUs)) {
+        mImmediateEvents.push_back(std::move(event));
+    } else {
+        mDelayedEvents.push_back(std::move(event));
+        std::push_heap(mDelayedEvents.begin(), mDelayedEvents.end(), DueLater);
+    }
+}
+
 void ALooper::post(const sp<AMessage> &msg, int64_t delayUs) {
     Mutex::Autolock autoLock(mLock);
 
@@ -181,21 +232,12 @@ void ALooper::post(const sp<AMessage> &msg, int64_t delayUs) {
         whenUs = getNowUs();
     }
 
-    List<Event>::iterator it = mEventQueue.begin();
-    while (it != mEventQueue.end() && (*it).mWhenUs <= whenUs) {
-        ++it;
-    }
-
-    Event event;
-    event.mWhenUs = whenUs;
-    event.mMessage = msg;
-    event.mToken = nullptr;
-
-    if (it == mEventQueue.begin()) {
+    // wake up the loop if this becomes the first event in the queue
+    if (!hasEvents_l() || whenUs < nextEventTimeUs_l()) {
         mQueueChangedCondition.signal();
     }
 
-    mEventQueue.insert(it, event);
+    queueEvent_l(whenUs, delayUs <= 0 /* immediate */, msg, nullptr);
 }
 
 status_t ALooper::postUnique(const sp<AMessage> &msg, const sp<RefBase> &token, int64_t delayUs) {
@@ -215,28 +257,20 @@ status_t ALooper::postUnique(const sp<AMessage> &msg, const sp<RefBase> &token,
     // We only need to wake the loop up if we're rescheduling to the earliest event in the queue.
     // This needs to be checked now, before we reschedule the message, in case this message is
     // already at the beginning of the queue.
-    bool shouldAwakeLoop = mEventQueue.empty() || whenUs < mEventQueue.begin()->mWhenUs;
+    bool shouldAwakeLoop = !hasEvents_l() || whenUs < nextEventTimeUs_l();
 
     // Erase any previously-posted event with this token.
-    for (auto i = mEventQueue.begin(); i != mEventQueue.end();) {
-        if (i->mToken == token) {
-            i = mEventQueue.erase(i);
-        } else {
-            ++i;
-        }
-    }
-
-    // Find the insertion point for the rescheduled message.
-    List<Event>::iterator i = mEventQueue.begin();
-    while (i != mEventQueue.end() && i->mWhenUs <= whenUs) {
-        ++i;
+    auto hasToken = [&token](const Event &event) { return event.mToken == token; };
+    mImmediateEvents.erase(
+            std::remove_if(mImmediateEvents.begin(), mImmediateEvents.end(), hasToken),
+            mImmediateEvents.end());
+    auto it = std::remove_if(mDelayedEvents.begin(), mDelayedEvents.end(), hasToken);
+    if (it != mDelayedEvents.end()) {
+        mDelayedEvents.erase(it, mDelayedEvents.end());
+        std::make_heap(mDelayedEvents.begin(), mDelayedEvents.end(), DueLater);
     }
 
-    Event event;
-    event.mWhenUs = whenUs;
-    event.mMessage = msg;
-    event.mToken = token;
-    mEventQueue.insert(i, event);
+    queueEvent_l(whenUs, delayUs <= 0 /* immediate */, msg, token);
 
     // If we rescheduled the event to be earlier than the first event, then we need to wake up the
     // looper earlier than it was previously scheduled to be woken up. Otherwise, it can sleep until
@@ -256,11 +290,11 @@ bool ALooper::loop() {
         if (mThread == NULL && !mRunningLocally) {
             return false;
         }
-        if (mEventQueue.empty()) {
+        if (!hasEvents_l()) {
             mQueueChangedCondition.wait(mLock);
             return true;
         }
-        int64_t whenUs = (*mEventQueue.begin()).mWhenUs;
+        int64_t whenUs = nextEventTimeUs_l();
         int64_t nowUs = getNowUs();
 
         if (whenUs > nowUs) {
@@ -273,8 +307,7 @@ bool ALooper::loop() {
             return true;
         }
 
-        event = *mEventQueue.begin();
-        mEventQueue.erase(mEventQueue.begin());
+        popNextEvent_l(&event);
     }
 
     event.mMessage->deliver();
@@ -23,9 +23,11 @@
 
 #include "ALooperRoster.h"
 
+#include "ABuffer.h"
 #include "ADebug.h"
 #include "AHandler.h"
 #include "AMessage.h"
+#include "AString.h"
 
 namespace android {
 
@@ -180,6 +182,13 @@ void ALooperRoster::dump(int fd, const Vector<String16>& args) {
         }
         s.append("\n");
     }
+
+    AString poolStats;
+    AMessage::Pool().appendStats(&poolStats);
+    AReplyToken::Pool().appendStats(&poolStats);
+    ABuffer::Pool().appendStats(&poolStats);
+    s.appendFormat(" object pools:\n%s", poolStats.c_str());
+
     (void)write(fd, s.string(), s.size());
 }
 
@@ -52,6 +52,49 @@ status_t AReplyToken::setReply(const sp<AMessage> &reply) {
     return OK;
 }
 
+// static
+AObjectPool &AReplyToken::Pool() {
+    static AObjectPool *sPool = new AObjectPool("AReplyToken", sizeof(AReplyToken), 16);
+    return *sPool;
+}
+
+// static
+void *AReplyToken::operator new(size_t size) {
+    return Pool().allocate(size);
+}
+
+// static
+void AReplyToken::operator delete(void *ptr, size_t size) {
+    Pool().release(ptr, size);
+}
+
+// static
+AObjectPool &AMessage::Pool() {
+    static AObjectPool *sPool = new AObjectPool("AMessage", sizeof(AMessage), 64);
+    return *sPool;
+}
+
+// static
+void *AMessage::operator new(size_t size) {
+    return Pool().allocate(size);
+}
+
+// static
+void *AMessage::operator new(size_t size, const std::nothrow_t &tag) {
+    return Pool().allocate(size, tag);
+}
+
+// static
+void AMessage::operator delete(void *ptr, size_t size) {
+    Pool().release(ptr, size);
+}
+
+// static
+void AMessage::operator delete(void *ptr, const std::nothrow_t &) {
+    // only used if a constructor throws; the size is not known here
+    Pool().release(ptr, 0);
+}
+
 AMessage::AMessage(void)
     : mWhat(0),
       mTarget(0) {
@@ -89,11 +132,11 @@ void AMessage::setTarget(const sp<const AHandler> &handler) {
 void AMessage::clear() {
     // Item needs to be handled delicately
     for (Item &item : mItems) {
-        delete[] item.mName;
-        item.mName = NULL;
+        item.freeName();
         freeItemValue(&item);
     }
     mItems.clear();
+    mIndex.clear();
 }
 
 void AMessage::freeItemValue(Item *item) {
@@ -150,7 +193,31 @@ static void reportStats() {
 }
 #endif
 
+static inline uint32_t hashName(const char *name, size_t len) {
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; ++i) {
+        hash = (hash ^ (uint8_t)name[i]) * 16777619u;
+    }
+    return hash;
+}
+
 inline size_t AMessage::findItemIndex(const char *name, size_t len) const {
+    if (!mIndex.empty()) {
+        const size_t mask = mIndex.size() - 1;
+        for (size_t slot = hashName(name, len) & mask; ; slot = (slot + 1) & mask) {
+            const uint16_t entry = mIndex[slot];
+            if (entry == 0) {
+                return mItems.size();
+            }
+            const Item &item = mItems[entry - 1];
+            if (item.mNameLength == len
+                    && (item.mName == name || !memcmp(item.mName, name, len))) {
+                return entry - 1;
+            }
+        }
+    }
+
 #ifdef DUMP_STATS
     size_t memchecks = 0;
 #endif
@@ -162,7 +229,7 @@ inline size_t AMessage::findItemIndex(const char *name, size_t len) const {
 #ifdef DUMP_STATS
         ++memchecks;
 #endif
-        if (!memcmp(mItems[i].mName, name, len)) {
+        if (mItems[i].mName == name || !memcmp(mItems[i].mName, name, len)) {
             break;
         }
     }
@@ -179,16 +246,79 @@ inline size_t AMessage::findItemIndex(const char *name, size_t len) const {
     return i;
 }
 
+void AMessage::addToIndex(size_t index) {
+    if (mIndex.empty() ? mItems.size() < kIndexThreshold : mItems.size() * 2 <= mIndex.size()) {
+        if (!mIndex.empty()) {
+            const Item &item = mItems[index];
+            const size_t mask = mIndex.size() - 1;
+            size_t slot = hashName(item.mName, item.mNameLength) & mask;
+            while (mIndex[slot] != 0) {
+                slot = (slot + 1) & mask;
+            }
+            mIndex[slot] = index + 1;
+        }
+        return;
+    }
+    rebuildIndex();
+}
+
+void AMessage::rebuildIndex() {
+    mIndex.clear();
+    if (mItems.size() < kIndexThreshold) {
+        return;
+    }
+
+    size_t size = 2 * kIndexThreshold;
+    while (size < mItems.size() * 2) {
+        size *= 2;
+    }
+    mIndex.resize(size, 0);
+
+    const size_t mask = size - 1;
+    for (size_t i = 0; i < mItems.size(); ++i) {
+        const Item &item = mItems[i];
+        size_t slot = hashName(item.mName, item.mNameLength) & mask;
+        bool duplicate = false;
+        while (mIndex[slot] != 0) {
+            const Item &other = mItems[mIndex[slot] - 1];
+            if (other.mNameLength == item.mNameLength
+                    && !memcmp(other.mName, item.mName, item.mNameLength)) {
+                // only reachable through FromParcel(); lookups find the first one
+                duplicate = true;
+                break;
+            }
+            slot = (slot + 1) & mask;
+        }
+        if (!duplicate) {
+            mIndex[slot] = i + 1;
+        }
+    }
+}
+
 // assumes item's name was uninitialized or NULL
-void AMessage::Item::setName(const char *name, size_t len) {
+void AMessage::Item::setName(const char *name, size_t len, bool intern) {
     mNameLength = len;
-    mName = new char[len + 1];
-    memcpy((void*)mName, name, len + 1);
+    mName = intern ? AAtomizer::AtomizeIfRoom(name, len) : nullptr;
+    mNameIsAtom = mName != nullptr;
+    if (!mNameIsAtom) {
+        char *copy = new char[len + 1];
+        memcpy(copy, name, len);
+        copy[len] = '\0';
+        mName = copy;
+    }
+}
+
+void AMessage::Item::freeName() {
+    if (!mNameIsAtom) {
+        delete[] mName;
+    }
+    mName = nullptr;
+    mNameIsAtom = false;
 }
 
 AMessage::Item::Item(const char *name, size_t len)
     : mType(kTypeInt32) {
-    // mName and mNameLength are initialized by setName
+    // mName, mNameLength and mNameIsAtom are initialized by setName
     setName(name, len);
 }
 
@@ -205,6 +335,7 @@ AMessage::Item *AMessage::allocateItem(const char *name) {
         i = mItems.size();
         // place a 'blank' item at the end - this is of type kTypeInt32
         mItems.emplace_back(name, len);
+        addToIndex(i);
         item = &mItems[i];
     }
 
@@ -491,6 +622,7 @@ bool AMessage::senderAwaitsResponse(sp<AReplyToken> *replyToken) {
 sp<AMessage> AMessage::dup() const {
     sp<AMessage> msg = new AMessage(mWhat, mHandler.promote());
     msg->mItems = mItems;
+    msg->mIndex = mIndex;
 
 #ifdef DUMP_STATS
     {
@@ -505,7 +637,9 @@ sp<AMessage> AMessage::dup() const {
         const Item *from = &mItems[i];
         Item *to = &msg->mItems[i];
 
-        to->setName(from->mName, from->mNameLength);
+        if (!from->mNameIsAtom) {
+            to->setName(from->mName, from->mNameLength, false /* intern */);
+        }
         to->mType = from->mType;
 
         switch (from->mType) {
@@ -771,8 +905,9 @@ sp<AMessage> AMessage::FromParcel(const Parcel &parcel, size_t maxNestingLevel)
             }
         }
 
-        item->setName(name, strlen(name));
+        item->setName(name, strlen(name), false /* intern */);
     }
+    msg->rebuildIndex();
 
     return msg;
 }
@@ -1026,9 +1161,9 @@ status_t AMessage::setEntryNameAt(size_t index, const char *name) {
     if (findItemIndex(name, len) < mItems.size()) {
         return ALREADY_EXISTS;
     }
-    delete[] mItems[index].mName;
-    mItems[index].mName = nullptr;
+    mItems[index].freeName();
     mItems[index].setName(name, len);
+    rebuildIndex();
     return OK;
 }
 
@@ -1091,8 +1226,7 @@ status_t AMessage::removeEntryAt(size_t index) {
         return BAD_INDEX;
     }
     // delete entry data and objects
-    delete[] mItems[index].mName;
-    mItems[index].mName = nullptr;
+    mItems[index].freeName();
     freeItemValue(&mItems[index]);
 
     // swap entry with last entry and clear last entry's data
@@ -1100,9 +1234,13 @@ status_t AMessage::removeEntryAt(size_t index) {
     if (index < lastIndex) {
         mItems[index] = mItems[lastIndex];
         mItems[lastIndex].mName = nullptr;
+        mItems[lastIndex].mNameIsAtom = false;
         mItems[lastIndex].mType = kTypeInt32;
     }
     mItems.pop_back();
+    if (!mIndex.empty()) {
+        rebuildIndex();
+    }
     return OK;
 }
 
@@ -0,0 +1,188 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "AObjectPool"
+#include <utils/Log.h>
+
+#include "AObjectPool.h"
+
+#include <atomic>
+
+#include "ADebug.h"
+#include "AString.h"
+
+namespace android {
+
+// Freed blocks are linked through their first word.
+struct AObjectPool::FreeList {
+    AObjectPool *mPool;
+    void *mHead;
+    size_t mCount;
+
+    // Only written by the owning thread; atomic so that getStats() may read
+    // them from other threads.
+    std::atomic<uint64_t> mAllocations;
+    std::atomic<uint64_t> mPoolHits;
+    std::atomic<uint64_t> mReleases;
+    std::atomic<uint64_t> mPoolReturns;
+};
+
+// Plain load and store instead of fetch_add, as there is a single writer.
+static inline void addToCounter(std::atomic<uint64_t> &counter, uint64_t value) {
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+AObjectPool::AObjectPool(const char *name, size_t objectSize, size_t maxCachedPerThread)
+    : mName(name),
+      mObjectSize(objectSize),
+      mMaxCachedPerThread(maxCachedPerThread),
+      mKeyValid(false),
+      mExitedStats{0, 0, 0, 0} {
+    CHECK_GE(mObjectSize, sizeof(void *));
+    int err = pthread_key_create(&mKey, DestroyFreeList);
+    if (err != 0) {
+        ALOGW("%s pool disabled: pthread_key_create failed (%d)", mName, err);
+    } else {
+        mKeyValid = true;
+    }
+}
+
+AObjectPool::FreeList *AObjectPool::getFreeList() {
+    if (!mKeyValid) {
+        return NULL;
+    }
+    FreeList *list = (FreeList *)pthread_getspecific(mKey);
+    if (list == NULL) {
+        list = new (std::nothrow) FreeList{this, NULL, 0, {0}, {0}, {0}, {0}};
+        if (list == NULL) {
+            return NULL;
+        }
+        if (pthread_setspecific(mKey, list) != 0) {
+            delete list;
+            return NULL;
+        }
+        std::lock_guard<std::mutex> lock(mListsLock);
+        mLists.push_back(list);
+    }
+    return list;
+}
+
+void *AObjectPool::takeFromFreeList(size_t size) {
+    // Without a free list (out of memory) the allocation is not counted.
+    FreeList *list = getFreeList();
+    if (list == NULL) {
+        return NULL;
+    }
+    addToCounter(list->mAllocations, 1);
+    if (size == mObjectSize && list->mHead != NULL) {
+        void *ptr = list->mHead;
+        list->mHead = *(void **)ptr;
+        --list->mCount;
+        addToCounter(list->mPoolHits, 1);
+        return ptr;
+    }
+    return NULL;
+}
+
+void *AObjectPool::allocate(size_t size) {
+    void *ptr = takeFromFreeList(size);
+    return ptr != NULL ? ptr : ::operator new(size);
+}
+
+void *AObjectPool::allocate(size_t size, const std::nothrow_t &tag) {
+    void *ptr = takeFromFreeList(size);
+    if (ptr == NULL) {
+        ptr = ::operator new(size, tag);
+        FreeList *list;
+        if (ptr == NULL && (list = getFreeList()) != NULL) {
+            // not handed out after all
+            list->mAllocations.store(list->mAllocations.load(std::memory_order_relaxed) - 1,
+                    std::memory_order_relaxed);
+        }
+    }
+    return ptr;
+}
+
+void AObjectPool::release(void *ptr, size_t size) {
+    if (ptr == NULL) {
+        return;
+    }
+    FreeList *list = getFreeList();
+    if (list != NULL) {
+        addToCounter(list->mReleases, 1);
+        if (size == mObjectSize && list->mCount < mMaxCachedPerThread) {
+            *(void **)ptr = list->mHead;
+            list->mHead = ptr;
+            ++list->mCount;
+            addToCounter(list->mPoolReturns, 1);
+            return;
+        }
+    }
+    ::operator delete(ptr);
+}
+
+void AObjectPool::retireFreeList(FreeList *list) {
+    std::lock_guard<std::mutex> lock(mListsLock);
+    mExitedStats.mAllocations += list->mAllocations.load(std::memory_order_relaxed);
+    mExitedStats.mPoolHits += list->mPoolHits.load(std::memory_order_relaxed);
+    mExitedStats.mReleases += list->mReleases.load(std::memory_order_relaxed);
+    mExitedStats.mPoolReturns += list->mPoolReturns.load(std::memory_order_relaxed);
+    for (auto it = mLists.begin(); it != mLists.end(); ++it) {
+        if (*it == list) {
+            mLists.erase(it);
+            break;
+        }
+    }
+}
+
+// static
+void AObjectPool::DestroyFreeList(void *ptr) {
+    FreeList *list = (FreeList *)ptr;
+    while (list->mHead != NULL) {
+        void *block = list->mHead;
+        list->mHead = *(void **)block;
+        ::operator delete(block);
+    }
+    list->mPool->retireFreeList(list);
+    delete list;
+}
+
+AObjectPool::Stats AObjectPool::getStats() const {
+    std::lock_guard<std::mutex> lock(mListsLock);
+    Stats stats = mExitedStats;
+    for (const FreeList *list : mLists) {
+        stats.mAllocations += list->mAllocations.load(std::memory_order_relaxed);
+        stats.mPoolHits += list->mPoolHits.load(std::memory_order_relaxed);
+        stats.mReleases += list->mReleases.load(std::memory_order_relaxed);
+        stats.mPoolReturns += list->mPoolReturns.load(std::memory_order_relaxed);
+    }
+    return stats;
+}
+
+void AObjectPool::appendStats(AString *s) const {
+    Stats stats = getStats();
+    s->append(AStringPrintf(
+            "  %s: %llu allocated (%llu from pool), %llu released (%llu to pool), %llu live\n",
+            mName,
+            (unsigned long long)stats.mAllocations,
+            (unsigned long long)stats.mPoolHits,
+            (unsigned long long)stats.mReleases,
+            (unsigned long long)stats.mPoolReturns,
+            (unsigned long long)(stats.mAllocations - stats.mReleases)));
+}
+
+}  // namespace android
@@ -31,17 +31,30 @@ namespace android {
 struct AAtomizer {
     static const char *Atomize(const char *name);
 
+    // Same as Atomize() for the first |len| characters of |name|, but returns
+    // NULL instead of adding a new atom once the table is full. For callers
+    // whose set of names is not known to be bounded.
+    static const char *AtomizeIfRoom(const char *name, size_t len);
+
 private:
-    static AAtomizer gAtomizer;
+    enum {
+        kNumBuckets = 512,
+        kMaxNumAtoms = 8192,
+    };
+
+    // Constructed on first use and never destroyed, as atoms may be needed
+    // during static initialization and destruction of other objects.
+    static AAtomizer &Instance();
 
     Mutex mLock;
     Vector<List<AString> > mAtoms;
+    size_t mNumAtoms;
 
     AAtomizer();
 
-    const char *atomize(const char *name);
+    const char *atomize(const char *name, size_t len, bool mustAdd);
 
-    static uint32_t Hash(const char *s);
+    static uint32_t Hash(const char *s, size_t len);
 
     DISALLOW_EVIL_CONSTRUCTORS(AAtomizer);
 };
@@ -22,6 +22,7 @@
 #include <stdint.h>
 
 #include <media/stagefright/foundation/ABase.h>
+#include <media/stagefright/foundation/AObjectPool.h>
 #include <utils/RefBase.h>
 
 namespace android {
@@ -48,6 +49,14 @@ struct ABuffer : public RefBase {
 
     sp<AMessage> meta();
 
+    // Recycles the storage of buffer objects (not of the data they own)
+    // through a per-thread pool.
+    static void *operator new(size_t size);
+    static void *operator new(size_t size, const std::nothrow_t &tag);
+    static void operator delete(void *ptr, size_t size);
+    static void operator delete(void *ptr, const std::nothrow_t &tag);
+    static AObjectPool &Pool();
+
 protected:
     virtual ~ABuffer();
 
@@ -26,6 +26,9 @@
 #include <utils/RefBase.h>
 #include <utils/threads.h>
 
+#include <deque>
+#include <vector>
+
 namespace android {
 
 struct AHandler;
@@ -69,6 +72,7 @@ private:
 
     struct Event {
         int64_t mWhenUs;
+        uint64_t mSeq;  // orders events due at the same time by posting order
         sp<AMessage> mMessage;
         sp<RefBase> mToken;
     };
@@ -78,7 +82,22 @@ private:
 
     AString mName;
 
-    List<Event> mEventQueue;
+    // Pending events are delivered in (mWhenUs, mSeq) order. Messages posted
+    // without a delay are due in posting order, so they are appended to a
+    // FIFO instead of being sorted into the heap of delayed events.
+    std::deque<Event> mImmediateEvents;
+    std::vector<Event> mDelayedEvents;  // min-heap on (mWhenUs, mSeq)
+    uint64_t mNextEventSeq;
+
+    bool hasEvents_l() const;
+    // returns the time the next event is due; there must be pending events
+    int64_t nextEventTimeUs_l() const;
+    void popNextEvent_l(Event *event);
+    void queueEvent_l(
+            int64_t whenUs, bool immediate, const sp<AMessage> &msg, const sp<RefBase> &token);
+
+    // heap ordering of events, the earliest event is on top
+    static bool DueLater(const Event &a, const Event &b);
 
     struct LooperThread;
     sp<LooperThread> mThread;
@@ -21,6 +21,7 @@
 #include <media/stagefright/foundation/ABase.h>
 #include <media/stagefright/foundation/AData.h>
 #include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AObjectPool.h>
 #include <utils/KeyedVector.h>
 #include <utils/RefBase.h>
 
@@ -59,6 +60,12 @@ private:
     }
     // sets the reply for this token. returns OK or error
     status_t setReply(const sp<AMessage> &reply);
+
+public:
+    // One token is created per synchronous call, so recycle their storage.
+    static void *operator new(size_t size);
+    static void operator delete(void *ptr, size_t size);
+    static AObjectPool &Pool();
 };
 
 struct AMessage : public RefBase {
@@ -281,6 +288,14 @@ struct AMessage : public RefBase {
      */
     status_t removeEntryByName(const char *name);
 
+    // Messages are created and released for every buffer exchanged between
+    // loopers, so their storage is recycled through a per-thread pool.
+    static void *operator new(size_t size);
+    static void *operator new(size_t size, const std::nothrow_t &tag);
+    static void operator delete(void *ptr, size_t size);
+    static void operator delete(void *ptr, const std::nothrow_t &tag);
+    static AObjectPool &Pool();
+
 protected:
     virtual ~AMessage();
 
@@ -310,16 +325,34 @@ private:
         const char *mName;
         size_t      mNameLength;
         Type mType;
-        void setName(const char *name, size_t len);
-        Item() : mName(nullptr), mNameLength(0), mType(kTypeInt32) { }
+        // mName is owned by AAtomizer and shared, rather than owned by this item.
+        bool mNameIsAtom;
+        // Sets the name, interning it unless |intern| is false (e.g. for names that come from
+        // another process) or the atom table is full. Assumes the name was unset or freed.
+        void setName(const char *name, size_t len, bool intern = true);
+        void freeName();
+        Item() : mName(nullptr), mNameLength(0), mType(kTypeInt32), mNameIsAtom(false) { }
         Item(const char *name, size_t length);
     };
 
     enum {
-        kMaxNumItems = 256
+        kMaxNumItems = 256,
+        // Messages with at least this many items are also indexed by name hash.
+        kIndexThreshold = 16,
     };
     std::vector<Item> mItems;
 
+    // Open addressing hash table of (item index + 1), 0 marking an empty slot. Empty while the
+    // message has fewer than kIndexThreshold items. Its size is a power of 2 and at least
+    // twice the number of items.
+    std::vector<uint16_t> mIndex;
+
+    /** Adds item |index| to mIndex, or rebuilds mIndex if it needs to grow. */
+    void addToIndex(size_t index);
+
+    /** Rebuilds mIndex from scratch. Needed after items are renamed or reordered. */
+    void rebuildIndex();
+
     /**
      * Allocates an item with the given key |name|. If the key already exists, the corresponding
      * item value is freed. Otherwise a new item is added.
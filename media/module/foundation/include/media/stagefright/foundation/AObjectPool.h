@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef A_OBJECT_POOL_H_
+
+#define A_OBJECT_POOL_H_
+
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <mutex>
+#include <new>
+#include <vector>
+
+#include <media/stagefright/foundation/ABase.h>
+
+namespace android {
+
+struct AString;
+
+/**
+ * Recycles the storage of fixed-size objects that are allocated and released
+ * at a high rate, e.g. the AMessage and ABuffer shells created for every
+ * buffer passed between loopers.
+ *
+ * Freed blocks are kept on a small per-thread free list. As each looper runs
+ * on its own thread, messages released by a handler are reused for the
+ * messages and replies it posts next without going through malloc. Requests
+ * for any other size, and releases once the free list is full, go straight to
+ * the global allocator.
+ *
+ * The statistics are also kept per thread, so that allocations on different
+ * threads don't write to shared counters. getStats() sums them up.
+ */
+struct AObjectPool {
+    struct Stats {
+        uint64_t mAllocations;  // total number of blocks handed out
+        uint64_t mPoolHits;     // allocations served from a free list
+        uint64_t mReleases;     // total number of blocks released
+        uint64_t mPoolReturns;  // releases kept on a free list
+    };
+
+    AObjectPool(const char *name, size_t objectSize, size_t maxCachedPerThread);
+
+    void *allocate(size_t size);
+    void *allocate(size_t size, const std::nothrow_t &tag);
+    void release(void *ptr, size_t size);
+
+    Stats getStats() const;
+
+    // Appends a one-line summary of the statistics to |s|.
+    void appendStats(AString *s) const;
+
+private:
+    struct FreeList;
+
+    const char *mName;
+    const size_t mObjectSize;
+    const size_t mMaxCachedPerThread;
+    pthread_key_t mKey;
+    bool mKeyValid;
+
+    // Free lists of the live threads, and the totals of the threads that exited
+    mutable std::mutex mListsLock;
+    std::vector<FreeList *> mLists;
+    Stats mExitedStats;
+
+    FreeList *getFreeList();
+    void *takeFromFreeList(size_t size);
+    void retireFreeList(FreeList *list);
+
+    static void DestroyFreeList(void *list);
+
+    DISALLOW_EVIL_CONSTRUCTORS(AObjectPool);
+};
+
+}  // namespace android
+
+#endif  // A_OBJECT_POOL_H_
@@ -0,0 +1,130 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <media/stagefright/foundation/AHandler.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AMessage.h>
+#include <utils/Mutex.h>
+
+using namespace android;
+
+static constexpr size_t kNumMessages = 10000;
+
+// Every fourth message is delayed, as with the polling and timeout messages
+// NuPlayer and MediaCodec keep pending next to the per-buffer messages.
+static int64_t delayForMessage(size_t i, int64_t maxDelayUs) {
+    if (i % 4 != 0) {
+        return 0;
+    }
+    return (int64_t)((i * 7919) % 1000 + 1) * maxDelayUs / 1000;
+}
+
+struct CountingHandler : public AHandler {
+    CountingHandler()
+        : mReceived(0),
+          mTotalLatencyUs(0) {
+    }
+
+    void reset() {
+        Mutex::Autolock autoLock(mLock);
+        mReceived = 0;
+        mTotalLatencyUs = 0;
+    }
+
+    // Returns the average dispatch latency in us.
+    double waitFor(size_t count) {
+        Mutex::Autolock autoLock(mLock);
+        while (mReceived < count) {
+            mCondition.wait(mLock);
+        }
+        return (double)mTotalLatencyUs / count;
+    }
+
+protected:
+    void onMessageReceived(const sp<AMessage> &msg) override {
+        int64_t dueUs = 0;
+        msg->findInt64("dueUs", &dueUs);
+        int64_t latencyUs = ALooper::GetNowUs() - dueUs;
+
+        Mutex::Autolock autoLock(mLock);
+        mTotalLatencyUs += latencyUs;
+        if (++mReceived == kNumMessages) {
+            mCondition.signal();
+        }
+    }
+
+private:
+    Mutex mLock;
+    Condition mCondition;
+    size_t mReceived;
+    int64_t mTotalLatencyUs;
+};
+
+// Cost of posting to a looper that has many delayed messages pending.
+static void BM_PostMixed(benchmark::State& state) {
+    for (auto _ : state) {
+        state.PauseTiming();
+        sp<ALooper> looper = new ALooper;
+        sp<CountingHandler> handler = new CountingHandler;
+        looper->registerHandler(handler);
+        state.ResumeTiming();
+
+        for (size_t i = 0; i < kNumMessages; ++i) {
+            sp<AMessage> msg = new AMessage('post', handler);
+            msg->post(delayForMessage(i, 10000000ll /* maxDelayUs */));
+        }
+
+        state.PauseTiming();
+        looper->unregisterHandler(handler->id());
+        looper.clear();
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * kNumMessages);
+}
+
+// Time to post and deliver messages with short delays, and the average time
+// between a message becoming due and its delivery.
+static void BM_PostAndDispatchMixed(benchmark::State& state) {
+    sp<ALooper> looper = new ALooper;
+    looper->setName("ALooper_benchmark");
+    sp<CountingHandler> handler = new CountingHandler;
+    looper->registerHandler(handler);
+    looper->start();
+
+    double latencyUs = 0;
+    for (auto _ : state) {
+        handler->reset();
+        for (size_t i = 0; i < kNumMessages; ++i) {
+            int64_t delayUs = delayForMessage(i, 2000 /* maxDelayUs */);
+            sp<AMessage> msg = new AMessage('disp', handler);
+            msg->setInt64("dueUs", ALooper::GetNowUs() + delayUs);
+            msg->post(delayUs);
+        }
+        latencyUs += handler->waitFor(kNumMessages);
+    }
+    state.SetItemsProcessed(state.iterations() * kNumMessages);
+    state.counters["dispatchLatencyUs"] = latencyUs / state.iterations();
+
+    looper->unregisterHandler(handler->id());
+    looper->stop();
+}
+
+BENCHMARK(BM_PostMixed);
+BENCHMARK(BM_PostAndDispatchMixed)->UseRealTime();
+
+BENCHMARK_MAIN();
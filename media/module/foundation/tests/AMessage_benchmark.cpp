@@ -0,0 +1,137 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/AMessage.h>
+
+using namespace android;
+
+// Shaped after the per-buffer messages MediaCodec posts to itself.
+static sp<AMessage> makeQueueInputBufferMessage() {
+    sp<AMessage> msg = new AMessage('queI', nullptr);
+    msg->setSize("index", 3);
+    msg->setSize("offset", 0);
+    msg->setSize("size", 4096);
+    msg->setInt64("timeUs", 33333);
+    msg->setInt32("flags", 0);
+    msg->setPointer("errorDetailMsg", nullptr);
+    return msg;
+}
+
+// Shaped after a video decoder format as passed to configure().
+static sp<AMessage> makeVideoFormatMessage() {
+    sp<AMessage> msg = new AMessage();
+    msg->setString("mime", "video/avc");
+    msg->setInt32("width", 1920);
+    msg->setInt32("height", 1080);
+    msg->setInt32("max-width", 1920);
+    msg->setInt32("max-height", 1080);
+    msg->setInt32("max-input-size", 1048576);
+    msg->setInt32("color-format", 0x7f420888);
+    msg->setInt32("color-standard", 1);
+    msg->setInt32("color-range", 2);
+    msg->setInt32("color-transfer", 3);
+    msg->setInt32("frame-rate", 30);
+    msg->setInt32("priority", 0);
+    msg->setInt32("profile", 8);
+    msg->setInt32("level", 2048);
+    msg->setInt32("rotation-degrees", 0);
+    msg->setInt32("low-latency", 0);
+    msg->setInt32("push-blank-buffers-on-shutdown", 1);
+    msg->setInt32("android._num-input-buffers", 4);
+    msg->setInt32("android._num-output-buffers", 4);
+    msg->setInt64("durationUs", 60000000);
+    msg->setFloat("operating-rate", 30.0f);
+    msg->setString("language", "und");
+    msg->setInt32("track-id", 1);
+    msg->setInt32("sar-width", 1);
+    msg->setInt32("sar-height", 1);
+    msg->setInt32("crop-left", 0);
+    msg->setInt32("crop-top", 0);
+    msg->setInt32("crop-right", 1919);
+    msg->setInt32("crop-bottom", 1079);
+    msg->setBuffer("csd-0", ABuffer::CreateAsCopy("\x00\x00\x00\x01\x67", 5));
+    msg->setBuffer("csd-1", ABuffer::CreateAsCopy("\x00\x00\x00\x01\x68", 5));
+    return msg;
+}
+
+static void BM_SetSmall(benchmark::State& state) {
+    for (auto _ : state) {
+        sp<AMessage> msg = makeQueueInputBufferMessage();
+        benchmark::DoNotOptimize(msg.get());
+    }
+}
+
+static void BM_SetLarge(benchmark::State& state) {
+    for (auto _ : state) {
+        sp<AMessage> msg = makeVideoFormatMessage();
+        benchmark::DoNotOptimize(msg.get());
+    }
+}
+
+static void BM_FindSmall(benchmark::State& state) {
+    sp<AMessage> msg = makeQueueInputBufferMessage();
+    size_t index, size;
+    int64_t timeUs;
+    int32_t flags;
+    for (auto _ : state) {
+        msg->findSize("index", &index);
+        msg->findSize("size", &size);
+        msg->findInt64("timeUs", &timeUs);
+        msg->findInt32("flags", &flags);
+        benchmark::DoNotOptimize(flags);
+    }
+}
+
+static void BM_FindLarge(benchmark::State& state) {
+    sp<AMessage> msg = makeVideoFormatMessage();
+    int32_t width, height, cropBottom;
+    sp<ABuffer> csd;
+    for (auto _ : state) {
+        msg->findInt32("width", &width);
+        msg->findInt32("height", &height);
+        msg->findInt32("crop-bottom", &cropBottom);
+        msg->findBuffer("csd-1", &csd);
+        benchmark::DoNotOptimize(msg->contains("hdr-static-info"));
+    }
+}
+
+static void BM_DupSmall(benchmark::State& state) {
+    sp<AMessage> msg = makeQueueInputBufferMessage();
+    for (auto _ : state) {
+        sp<AMessage> copy = msg->dup();
+        benchmark::DoNotOptimize(copy.get());
+    }
+}
+
+static void BM_DupLarge(benchmark::State& state) {
+    sp<AMessage> msg = makeVideoFormatMessage();
+    for (auto _ : state) {
+        sp<AMessage> copy = msg->dup();
+        benchmark::DoNotOptimize(copy.get());
+    }
+}
+
+BENCHMARK(BM_SetSmall);
+BENCHMARK(BM_SetLarge);
+BENCHMARK(BM_FindSmall);
+BENCHMARK(BM_FindLarge);
+BENCHMARK(BM_DupSmall);
+BENCHMARK(BM_DupLarge);
+
+BENCHMARK_MAIN();
@@ -21,6 +21,9 @@
 #include <gtest/gtest.h>
 #include <utils/RefBase.h>
 
+#include <thread>
+
+#include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/AMessage.h>
 #include <media/stagefright/foundation/AHandler.h>
 #include <media/stagefright/foundation/ALooper.h>
@@ -169,6 +172,111 @@ TEST(AMessage_tests, settersAndGetters) {
   EXPECT_NE(OK, m1->removeEntryByName("notpresent"));
 }
 
+// Large messages are looked up through a hash index; make sure it stays consistent as entries
+// are added, renamed, removed and copied.
+TEST(AMessage_tests, largeMessageLookups) {
+  sp<AMessage> m1 = new AMessage();
+
+  char name[16];
+  for (int32_t i = 0; i < 100; ++i) {
+    snprintf(name, sizeof(name), "key-%d", i);
+    m1->setInt32(name, i);
+  }
+  EXPECT_EQ(100, m1->countEntries());
+
+  int32_t i32;
+  for (int32_t i = 0; i < 100; ++i) {
+    snprintf(name, sizeof(name), "key-%d", i);
+    EXPECT_TRUE(m1->findInt32(name, &i32));
+    EXPECT_EQ(i, i32);
+  }
+  EXPECT_FALSE(m1->findInt32("key-100", &i32));
+
+  // overwriting does not add entries
+  m1->setInt32("key-7", 700);
+  EXPECT_EQ(100, m1->countEntries());
+  EXPECT_TRUE(m1->findInt32("key-7", &i32));
+  EXPECT_EQ(700, i32);
+
+  EXPECT_EQ(OK, m1->removeEntryByName("key-3"));
+  EXPECT_FALSE(m1->contains("key-3"));
+  EXPECT_TRUE(m1->findInt32("key-99", &i32));
+  EXPECT_EQ(99, i32);
+
+  size_t index = m1->findEntryByName("key-42");
+  ASSERT_LT(index, m1->countEntries());
+  EXPECT_EQ(ALREADY_EXISTS, m1->setEntryNameAt(index, "key-43"));
+  EXPECT_EQ(OK, m1->setEntryNameAt(index, "renamed"));
+  EXPECT_FALSE(m1->contains("key-42"));
+  EXPECT_TRUE(m1->findInt32("renamed", &i32));
+  EXPECT_EQ(42, i32);
+
+  sp<AMessage> m2 = m1->dup();
+  m1->clear();
+  EXPECT_FALSE(m1->contains("key-0"));
+  EXPECT_EQ(99, m2->countEntries());
+  EXPECT_TRUE(m2->findInt32("renamed", &i32));
+  EXPECT_EQ(42, i32);
+  EXPECT_TRUE(m2->findInt32("key-0", &i32));
+  EXPECT_EQ(0, i32);
+  m2->setInt32("key-100", 100);
+  EXPECT_TRUE(m2->findInt32("key-100", &i32));
+  EXPECT_EQ(100, i32);
+}
+
+TEST(AMessage_tests, recyclesMessageAndBufferStorage) {
+  AObjectPool::Stats msgStats = AMessage::Pool().getStats();
+  AObjectPool::Stats bufStats = ABuffer::Pool().getStats();
+
+  for (int32_t i = 0; i < 10; ++i) {
+    sp<AMessage> msg = new AMessage();
+    msg->setInt32("index", i);
+    sp<ABuffer> buffer = new ABuffer(16);
+    buffer->meta()->setInt64("timeUs", i);
+    msg->setBuffer("buffer", buffer);
+  }
+
+  // every object after the first one reuses the storage of a released one
+  AObjectPool::Stats newMsgStats = AMessage::Pool().getStats();
+  AObjectPool::Stats newBufStats = ABuffer::Pool().getStats();
+  EXPECT_LE(20u, newMsgStats.mAllocations - msgStats.mAllocations);
+  EXPECT_LE(20u, newMsgStats.mReleases - msgStats.mReleases);
+  EXPECT_LE(18u, newMsgStats.mPoolHits - msgStats.mPoolHits);
+  EXPECT_LE(10u, newBufStats.mAllocations - bufStats.mAllocations);
+  EXPECT_LE(9u, newBufStats.mPoolHits - bufStats.mPoolHits);
+
+  // objects of the same type remain independent
+  sp<AMessage> m1 = new AMessage();
+  sp<AMessage> m2 = new AMessage();
+  m1->setInt32("value", 1);
+  m2->setInt32("value", 2);
+  int32_t i32;
+  EXPECT_TRUE(m1->findInt32("value", &i32));
+  EXPECT_EQ(1, i32);
+  EXPECT_TRUE(m2->findInt32("value", &i32));
+  EXPECT_EQ(2, i32);
+}
+
+TEST(AMessage_tests, countsPoolStatsOfAllThreads) {
+  AObjectPool::Stats stats = AMessage::Pool().getStats();
+
+  // the counters of a thread are kept after it exits
+  std::thread thread([] {
+    for (int32_t i = 0; i < 10; ++i) {
+      sp<AMessage> msg = new AMessage();
+    }
+  });
+  thread.join();
+  for (int32_t i = 0; i < 5; ++i) {
+    sp<AMessage> msg = new AMessage();
+  }
+
+  AObjectPool::Stats newStats = AMessage::Pool().getStats();
+  EXPECT_LE(15u, newStats.mAllocations - stats.mAllocations);
+  EXPECT_LE(15u, newStats.mReleases - stats.mReleases);
+  EXPECT_LE(13u, newStats.mPoolHits - stats.mPoolHits);
+}
+
 TEST(AMessage_tests, deliversMultipleMessagesInOrderImmediately) {
   sp<NiceMock<MockHandler>> mockHandler = new NiceMock<MockHandler>;
   sp<LooperWithSettableClock> looper = new LooperWithSettableClock();
@@ -45,6 +45,11 @@
 
 #include <inttypes.h>
 
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 namespace android {
 using hardware::hidl_string;
 using hardware::hidl_vec;
@@ -60,6 +65,22 @@ typedef hidl::memory::V1_0::IMemory TMemory;
 
 static const size_t kTSPacketSize = 188;
 
+// Upper bound on the threads (including the caller's) used by PARALLEL_DEMUX.
+static const size_t kMaxDemuxThreads = 4;
+
+// An elementary stream TS packet whose header has already been parsed,
+// waiting to be handed to its stream. |mPayload| points into the buffer
+// passed to feedTSPackets().
+struct ATSParser::PendingPacket {
+    Stream *mStream;
+    const uint8_t *mPayload;
+    size_t mPayloadSize;
+    unsigned mContinuityCounter;
+    unsigned mPayloadUnitStartIndicator;
+    unsigned mTransportScramblingControl;
+    unsigned mRandomAccessIndicator;
+};
+
 struct ATSParser::Program : public RefBase {
     Program(ATSParser *parser, unsigned programNumber, unsigned programMapPID,
             int64_t lastRecoveredPTS);
@@ -77,6 +98,22 @@ struct ATSParser::Program : public RefBase {
             unsigned random_access_indicator,
             ABitReader *br, status_t *err, SyncEvent *event);
 
+    // Same as parsePID() without an event, but only queues the packet for
+    // drainPendingPackets() instead of parsing it.
+    bool queuePID(
+            unsigned pid, unsigned continuity_counter,
+            unsigned payload_unit_start_indicator,
+            unsigned transport_scrambling_control,
+            unsigned random_access_indicator,
+            ABitReader *br);
+
+    bool hasPendingPackets() const {
+        return !mPendingPackets.empty();
+    }
+
+    // Parse all queued packets in order. Returns the first error encountered.
+    status_t drainPendingPackets();
+
     void signalDiscontinuity(
             DiscontinuityType type, const sp<AMessage> &extra);
 
@@ -129,6 +166,7 @@ private:
     uint64_t mFirstPTS;
     int64_t mLastRecoveredPTS;
     sp<AMessage> mSampleAesKeyItem;
+    std::vector<PendingPacket> mPendingPackets;
 
     status_t parseProgramMap(ABitReader *br);
     int64_t recoverPTS(uint64_t PTS_33bit);
@@ -278,6 +316,103 @@ private:
     DISALLOW_EVIL_CONSTRUCTORS(PSISection);
 };
 
+// Fixed set of threads draining the pending packets of several programs.
+// The thread calling drain() works alongside them. Programs share no
+// mutable parsing state, so each is drained by exactly one thread.
+struct ATSParser::DemuxWorkers {
+    explicit DemuxWorkers(size_t numThreads);
+    ~DemuxWorkers();
+
+    // Returns once every program in |programs| has been drained, with the
+    // first error encountered.
+    status_t drain(const std::vector<sp<Program>> &programs);
+
+private:
+    std::mutex mLock;
+    std::condition_variable mWorkCondition;
+    std::condition_variable mDoneCondition;
+    std::vector<std::thread> mThreads;
+    const std::vector<sp<Program>> *mPrograms;
+    size_t mNextProgram;
+    size_t mProgramsRemaining;
+    status_t mResult;
+    bool mQuit;
+
+    void threadLoop();
+    // Drains the next unclaimed program, if any. Called with |lock| held;
+    // releases it while parsing.
+    bool drainOne(std::unique_lock<std::mutex> &lock);
+
+    DISALLOW_EVIL_CONSTRUCTORS(DemuxWorkers);
+};
+
+ATSParser::DemuxWorkers::DemuxWorkers(size_t numThreads)
+    : mPrograms(NULL),
+      mNextProgram(0),
+      mProgramsRemaining(0),
+      mResult(OK),
+      mQuit(false) {
+    for (size_t i = 0; i < numThreads; ++i) {
+        mThreads.emplace_back(&DemuxWorkers::threadLoop, this);
+    }
+}
+
+ATSParser::DemuxWorkers::~DemuxWorkers() {
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mQuit = true;
+    }
+    mWorkCondition.notify_all();
+    for (std::thread &thread : mThreads) {
+        thread.join();
+    }
+}
+
+status_t ATSParser::DemuxWorkers::drain(const std::vector<sp<Program>> &programs) {
+    std::unique_lock<std::mutex> lock(mLock);
+    mPrograms = &programs;
+    mNextProgram = 0;
+    mProgramsRemaining = programs.size();
+    mResult = OK;
+    mWorkCondition.notify_all();
+
+    while (drainOne(lock)) {
+    }
+    mDoneCondition.wait(lock, [this] { return mProgramsRemaining == 0; });
+
+    mPrograms = NULL;
+    return mResult;
+}
+
+void ATSParser::DemuxWorkers::threadLoop() {
+    std::unique_lock<std::mutex> lock(mLock);
+    while (!mQuit) {
+        if (!drainOne(lock)) {
+            mWorkCondition.wait(lock);
+        }
+    }
+}
+
+bool ATSParser::DemuxWorkers::drainOne(std::unique_lock<std::mutex> &lock) {
+    if (mPrograms == NULL || mNextProgram >= mPrograms->size()) {
+        return false;
+    }
+
+    sp<Program> program = mPrograms->at(mNextProgram++);
+    lock.unlock();
+    status_t err = program->drainPendingPackets();
+    program.clear();
+    lock.lock();
+
+    if (err != OK && mResult == OK) {
+        mResult = err;
+    }
+    if (--mProgramsRemaining == 0) {
+        mDoneCondition.notify_all();
+    }
+    return true;
+}
+
 ATSParser::SyncEvent::SyncEvent(off64_t offset)
     : mHasReturnedData(false), mOffset(offset), mTimeUs(0) {}
 
@@ -345,6 +480,49 @@ bool ATSParser::Program::parsePID(
     return true;
 }
 
+bool ATSParser::Program::queuePID(
+        unsigned pid, unsigned continuity_counter,
+        unsigned payload_unit_start_indicator,
+        unsigned transport_scrambling_control,
+        unsigned random_access_indicator,
+        ABitReader *br) {
+    ssize_t index = mStreams.indexOfKey(pid);
+    if (index < 0) {
+        return false;
+    }
+
+    PendingPacket packet;
+    packet.mStream = mStreams.editValueAt(index).get();
+    packet.mPayload = br->data();
+    packet.mPayloadSize = br->numBitsLeft() / 8;
+    packet.mContinuityCounter = continuity_counter;
+    packet.mPayloadUnitStartIndicator = payload_unit_start_indicator;
+    packet.mTransportScramblingControl = transport_scrambling_control;
+    packet.mRandomAccessIndicator = random_access_indicator;
+    mPendingPackets.push_back(packet);
+
+    return true;
+}
+
+status_t ATSParser::Program::drainPendingPackets() {
+    status_t result = OK;
+    for (const PendingPacket &packet : mPendingPackets) {
+        ABitReader br(packet.mPayload, packet.mPayloadSize);
+        status_t err = packet.mStream->parse(
+                packet.mContinuityCounter,
+                packet.mPayloadUnitStartIndicator,
+                packet.mTransportScramblingControl,
+                packet.mRandomAccessIndicator,
+                &br, NULL /* event */);
+        if (err != OK && result == OK) {
+            result = err;
+        }
+    }
+    mPendingPackets.clear();
+
+    return result;
+}
+
 void ATSParser::Program::signalDiscontinuity(
         DiscontinuityType type, const sp<AMessage> &extra) {
     int64_t mediaTimeUs;
@@ -1968,6 +2146,8 @@ ATSParser::ATSParser(uint32_t flags)
       mTimeOffsetUs(0LL),
       mLastRecoveredPTS(-1LL),
       mNumTSPacketsParsed(0),
+      mDeferStreamPackets(false),
+      mDeferredErr(OK),
       mNumPCRs(0) {
     mPSISections.add(0 /* PID */, new PSISection);
     mCasManager = new CasManager();
@@ -1987,6 +2167,62 @@ status_t ATSParser::feedTSPacket(const void *data, size_t size,
     return parseTS(&br, event);
 }
 
+status_t ATSParser::feedTSPackets(const void *data, size_t size) {
+    if (size % kTSPacketSize != 0) {
+        ALOGE("Wrong TS packets size");
+        return BAD_VALUE;
+    }
+
+    mDeferStreamPackets = (mFlags & PARALLEL_DEMUX) != 0;
+    mDeferredErr = OK;
+
+    status_t result = OK;
+    const uint8_t *packet = (const uint8_t *)data;
+    for (size_t offset = 0; offset < size; offset += kTSPacketSize) {
+        ABitReader br(packet + offset, kTSPacketSize);
+        status_t err = parseTS(&br, NULL /* event */);
+        if (err != OK && result == OK) {
+            result = err;
+        }
+    }
+
+    if (mDeferStreamPackets) {
+        drainPendingPackets();
+        mDeferStreamPackets = false;
+        if (result == OK) {
+            result = mDeferredErr;
+        }
+    }
+
+    return result;
+}
+
+void ATSParser::drainPendingPackets() {
+    std::vector<sp<Program>> programs;
+    for (size_t i = 0; i < mPrograms.size(); ++i) {
+        if (mPrograms.itemAt(i)->hasPendingPackets()) {
+            programs.push_back(mPrograms.itemAt(i));
+        }
+    }
+
+    status_t err = OK;
+    if (programs.size() == 1) {
+        err = programs[0]->drainPendingPackets();
+    } else if (programs.size() > 1) {
+        if (mDemuxWorkers == nullptr) {
+            size_t numThreads = std::min(
+                    (size_t)std::thread::hardware_concurrency(), kMaxDemuxThreads);
+            // The calling thread is one of the workers.
+            mDemuxWorkers.reset(new DemuxWorkers(numThreads > 1 ? numThreads - 1 : 1));
+        }
+        err = mDemuxWorkers->drain(programs);
+    }
+
+    if (err != OK && mDeferredErr == OK) {
+        mDeferredErr = err;
+    }
+}
+
 status_t ATSParser::setMediaCas(const sp<ICas> &cas) {
     status_t err = mCasManager->setMediaCas(cas);
     if (err != OK) {
@@ -2153,6 +2389,11 @@ status_t ATSParser::parsePID(
     ssize_t sectionIndex = mPSISections.indexOfKey(PID);
 
     if (sectionIndex >= 0) {
+        if (mDeferStreamPackets) {
+            // PAT/PMT may add or remove streams; catch them up first.
+            drainPendingPackets();
+        }
+
         sp<PSISection> section = mPSISections.valueAt(sectionIndex);
 
         if (payload_unit_start_indicator) {
@@ -2226,6 +2467,19 @@ status_t ATSParser::parsePID(
 
     bool handled = false;
     for (size_t i = 0; i < mPrograms.size(); ++i) {
+        if (mDeferStreamPackets) {
+            if (mPrograms.editItemAt(i)->queuePID(
+                        PID, continuity_counter,
+                        payload_unit_start_indicator,
+                        transport_scrambling_control,
+                        random_access_indicator,
+                        br)) {
+                handled = true;
+                break;
+            }
+            continue;
+        }
+
         status_t err;
         if (mPrograms.editItemAt(i)->parsePID(
                     PID, continuity_counter,
@@ -2243,6 +2497,10 @@ status_t ATSParser::parsePID(
     }
 
     if (!handled) {
+        if (mDeferStreamPackets && mCasManager->isCAPid(PID)) {
+            // An ECM may update the keys of packets queued after it.
+            drainPendingPackets();
+        }
         handled = mCasManager->parsePID(br, PID);
     }
 
@@ -96,6 +96,24 @@ void ElementaryStreamQueue::setCasInfo(
     mCasSessionId = sessionId;
 }
 
+// Drops the first |size| bytes of |buffer|. Rather than moving the remaining
+// data to the front after every access unit, only the start of the range is
+// advanced; the consumed space is reclaimed by reclaimFront() once appending
+// runs out of room at the end of the buffer.
+static void trimFront(const sp<ABuffer> &buffer, size_t size) {
+    buffer->setRange(buffer->offset() + size, buffer->size() - size);
+}
+
+// Makes room for |neededSize| bytes of pending data, which must fit in the
+// capacity of |buffer|, by moving the pending data back to the front.
+static void reclaimFront(const sp<ABuffer> &buffer, size_t neededSize) {
+    if (buffer->offset() + neededSize <= buffer->capacity()) {
+        return;
+    }
+    memmove(buffer->base(), buffer->data(), buffer->size());
+    buffer->setRange(0, buffer->size());
+}
+
 static int32_t readVariableBits(ABitReader &bits, int32_t nbits) {
     int32_t value = 0;
     int32_t more_bits = 1;
@@ -1176,10 +1194,12 @@ status_t ElementaryStreamQueue::appendData(
         }
 
         mBuffer = buffer;
+    } else {
+        reclaimFront(mBuffer, neededSize);
     }
 
     memcpy(mBuffer->data() + mBuffer->size(), data, size);
-    mBuffer->setRange(0, mBuffer->size() + size);
+    mBuffer->setRange(mBuffer->offset(), mBuffer->size() + size);
 
     RangeInfo info;
     info.mLength = size;
@@ -1222,9 +1242,12 @@ void ElementaryStreamQueue::appendScrambledData(
         }
 
         mScrambledBuffer = buffer;
+    } else {
+        reclaimFront(mScrambledBuffer, neededSize);
     }
     memcpy(mScrambledBuffer->data() + mScrambledBuffer->size(), data, size);
-    mScrambledBuffer->setRange(0, mScrambledBuffer->size() + size);
+    mScrambledBuffer->setRange(
+            mScrambledBuffer->offset(), mScrambledBuffer->size() + size);
 
     ScrambledRangeInfo scrambledInfo;
     scrambledInfo.mLength = size;
@@ -1281,7 +1304,7 @@ sp<ABuffer> ElementaryStreamQueue::dequeueScrambledAccessUnit() {
     // range on mBuffer. Note that the leading clear bytes includes the
     // PES header portion, while mBuffer doesn't.
     if ((int32_t)leadingClearBytes > pesOffset) {
-        mBuffer->setRange(0, leadingClearBytes - pesOffset);
+        mBuffer->setRange(mBuffer->offset(), leadingClearBytes - pesOffset);
     } else {
         mBuffer->setRange(0, 0);
     }
@@ -1359,11 +1382,7 @@ sp<ABuffer> ElementaryStreamQueue::dequeueScrambledAccessUnit() {
     scrambledAccessUnit->meta()->setBuffer("encBytes", encSizes);
     scrambledAccessUnit->meta()->setInt32("pesOffset", pesOffset);
 
-    memmove(mScrambledBuffer->data(),
-            mScrambledBuffer->data() + scrambledLength,
-            mScrambledBuffer->size() - scrambledLength);
-
-    mScrambledBuffer->setRange(0, mScrambledBuffer->size() - scrambledLength);
+    trimFront(mScrambledBuffer, scrambledLength);
 
     ALOGV("[stream %d] dequeued scrambled AU: timeUs=%lld, size=%zu",
             mMode, (long long)timeUs, scrambledAccessUnit->size());
@@ -1388,11 +1407,7 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnit() {
         memcpy(accessUnit->data(), mBuffer->data(), info.mLength);
         accessUnit->meta()->setInt64("timeUs", info.mTimestampUs);
 
-        memmove(mBuffer->data(),
-                mBuffer->data() + info.mLength,
-                mBuffer->size() - info.mLength);
-
-        mBuffer->setRange(0, mBuffer->size() - info.mLength);
+        trimFront(mBuffer, info.mLength);
 
         if (mFormat == NULL) {
             mFormat = new MetaData;
@@ -1479,12 +1494,7 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitDTSOrDTSHD() {
     accessUnit->meta()->setInt64("timeUs", timeUs);
     accessUnit->meta()->setInt32("isSync", 1);
 
-    memmove(
-        mBuffer->data(),
-        mBuffer->data() + syncStartPos + payloadSize,
-        mBuffer->size() - syncStartPos - payloadSize);
-
-    mBuffer->setRange(0, mBuffer->size() - syncStartPos - payloadSize);
+    trimFront(mBuffer, syncStartPos + payloadSize);
 
     return accessUnit;
 }
@@ -1533,12 +1543,7 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitDTSUHD()
     accessUnit->meta()->setInt64("timeUs", timeUs);
     accessUnit->meta()->setInt32("isSync", 1);
 
-    memmove(
-        mBuffer->data(),
-        mBuffer->data() + syncStartPos + payloadSize,
-        mBuffer->size() - syncStartPos - payloadSize);
-
-    mBuffer->setRange(0, mBuffer->size() - syncStartPos - payloadSize);
+    trimFront(mBuffer, syncStartPos + payloadSize);
 
     return accessUnit;
 }
@@ -1605,12 +1610,7 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitEAC3() {
     accessUnit->meta()->setInt64("timeUs", timeUs);
     accessUnit->meta()->setInt32("isSync", 1);
 
-    memmove(
-            mBuffer->data(),
-            mBuffer->data() + syncStartPos + payloadSize,
-            mBuffer->size() - syncStartPos - payloadSize);
-
-    mBuffer->setRange(0, mBuffer->size() - syncStartPos - payloadSize);
+    trimFront(mBuffer, syncStartPos + payloadSize);
 
     return accessUnit;
 }
@@ -1669,12 +1669,7 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitAC4() {
     accessUnit->meta()->setInt64("timeUs", timeUs);
     accessUnit->meta()->setInt32("isSync", 1);
 
-    memmove(
-            mBuffer->data(),
-            mBuffer->data() + syncStartPos + payloadSize,
-            mBuffer->size() - syncStartPos - payloadSize);
-
-    mBuffer->setRange(0, mBuffer->size() - syncStartPos - payloadSize);
+    trimFront(mBuffer, syncStartPos + payloadSize);
     return accessUnit;
 }
 
@@ -1736,12 +1731,7 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitPCMAudio() {
         ptr[i] = ntohs(ptr[i]);
     }
 
-    memmove(
-            mBuffer->data(),
-            mBuffer->data() + 4 + payloadSize,
-            mBuffer->size() - 4 - payloadSize);
-
-    mBuffer->setRange(0, mBuffer->size() - 4 - payloadSize);
+    trimFront(mBuffer, 4 + payloadSize);
 
     return accessUnit;
 }
@@ -1885,9 +1875,7 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitAAC() {
     sp<ABuffer> accessUnit = new ABuffer(offset);
     memcpy(accessUnit->data(), mBuffer->data(), offset);
 
-    memmove(mBuffer->data(), mBuffer->data() + offset,
-            mBuffer->size() - offset);
-    mBuffer->setRange(0, mBuffer->size() - offset);
+    trimFront(mBuffer, offset);
 
     accessUnit->meta()->setInt64("timeUs", timeUs);
     accessUnit->meta()->setInt32("isSync", 1);
@@ -2072,11 +2060,7 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitH264() {
             const NALPosition &pos = nals.itemAt(nals.size() - 1);
             size_t nextScan = pos.nalOffset + pos.nalSize;
 
-            memmove(mBuffer->data(),
-                    mBuffer->data() + nextScan,
-                    mBuffer->size() - nextScan);
-
-            mBuffer->setRange(0, mBuffer->size() - nextScan);
+            trimFront(mBuffer, nextScan);
 
             int64_t timeUs = fetchTimestamp(nextScan);
             if (timeUs < 0LL) {
@@ -2158,11 +2142,7 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitMPEGAudio() {
     sp<ABuffer> accessUnit = new ABuffer(frameSize);
     memcpy(accessUnit->data(), data, frameSize);
 
-    memmove(mBuffer->data(),
-            mBuffer->data() + frameSize,
-            mBuffer->size() - frameSize);
-
-    mBuffer->setRange(0, mBuffer->size() - frameSize);
+    trimFront(mBuffer, frameSize);
 
     int64_t timeUs = fetchTimestamp(frameSize);
     if (timeUs < 0LL) {
@@ -2285,11 +2265,11 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitMPEGVideo() {
         currentStartCode = data[offset + 3];
 
         if (currentStartCode == 0xb3 && mFormat == NULL) {
-            memmove(mBuffer->data(), mBuffer->data() + offset, size - offset);
+            trimFront(mBuffer, offset);
+            data = mBuffer->data();
             size -= offset;
             (void)fetchTimestamp(offset);
             offset = 0;
-            mBuffer->setRange(0, size);
         }
 
         if ((prevStartCode == 0xb3 && currentStartCode != 0xb5)
@@ -2318,11 +2298,7 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitMPEGVideo() {
                 sp<ABuffer> csd = new ABuffer(offset);
                 memcpy(csd->data(), data, offset);
 
-                memmove(mBuffer->data(),
-                        mBuffer->data() + offset,
-                        mBuffer->size() - offset);
-
-                mBuffer->setRange(0, mBuffer->size() - offset);
+                trimFront(mBuffer, offset);
                 size -= offset;
                 (void)fetchTimestamp(offset);
                 offset = 0;
@@ -2361,11 +2337,7 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitMPEGVideo() {
                 sp<ABuffer> accessUnit = new ABuffer(offset);
                 memcpy(accessUnit->data(), data, offset);
 
-                memmove(mBuffer->data(),
-                        mBuffer->data() + offset,
-                        mBuffer->size() - offset);
-
-                mBuffer->setRange(0, mBuffer->size() - offset);
+                trimFront(mBuffer, offset);
 
                 int64_t timeUs = fetchTimestamp(offset);
                 if (timeUs < 0LL) {
@@ -2560,9 +2532,9 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitMPEG4Video() {
                     sp<ABuffer> accessUnit = new ABuffer(offset);
                     memcpy(accessUnit->data(), data, offset);
 
-                    memmove(data, &data[offset], size - offset);
+                    trimFront(mBuffer, offset);
+                    data = mBuffer->data();
                     size -= offset;
-                    mBuffer->setRange(0, size);
 
                     int64_t timeUs = fetchTimestamp(offset);
                     if (timeUs < 0LL) {
@@ -2598,10 +2570,10 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitMPEG4Video() {
 
         if (discard) {
             (void)fetchTimestamp(offset);
-            memmove(data, &data[offset], size - offset);
+            trimFront(mBuffer, offset);
+            data = mBuffer->data();
             size -= offset;
             offset = 0;
-            mBuffer->setRange(0, size);
         } else {
             offset += chunkSize;
         }
@@ -27,6 +27,7 @@
 #include <utils/KeyedVector.h>
 #include <utils/Vector.h>
 #include <utils/RefBase.h>
+#include <memory>
 #include <vector>
 
 namespace android {
@@ -69,6 +70,10 @@ struct ATSParser : public RefBase {
         TS_TIMESTAMPS_ARE_ABSOLUTE = 1,
         // Video PES packets contain exactly one (aligned) access unit.
         ALIGNED_VIDEO_DATA         = 2,
+        // Packets fed through feedTSPackets() are grouped by program and the
+        // elementary streams of different programs are parsed concurrently.
+        // Packets fed one at a time through feedTSPacket() are not affected.
+        PARALLEL_DEMUX             = 4,
     };
 
     enum SourceType {
@@ -122,6 +127,13 @@ struct ATSParser : public RefBase {
     status_t feedTSPacket(
             const void *data, size_t size, SyncEvent *event = NULL);
 
+    // Feed a run of TS packets, |size| being a multiple of the TS packet size.
+    // This is equivalent to calling feedTSPacket() without an event for each
+    // packet, except that with PARALLEL_DEMUX the PES payload is parsed on
+    // worker threads before this returns. Packets following one that fails to
+    // parse are still fed; the first error encountered is returned.
+    status_t feedTSPackets(const void *data, size_t size);
+
     void signalDiscontinuity(
             DiscontinuityType type, const sp<AMessage> &extra);
 
@@ -192,6 +204,8 @@ private:
     struct Stream;
     struct PSISection;
     struct CasManager;
+    struct PendingPacket;
+    struct DemuxWorkers;
     struct CADescriptor {
         CADescriptor() : mPID(0), mSystemID(-1) {}
         unsigned mPID;
@@ -223,6 +237,12 @@ private:
 
     size_t mNumTSPacketsParsed;
 
+    // Set while feedTSPackets() runs with PARALLEL_DEMUX: elementary stream
+    // packets are queued on their program rather than parsed in place.
+    bool mDeferStreamPackets;
+    status_t mDeferredErr;
+    std::unique_ptr<DemuxWorkers> mDemuxWorkers;
+
     sp<AMessage> mSampleAesKeyItem;
 
     void parseProgramAssociationTable(ABitReader *br);
@@ -253,6 +273,11 @@ private:
 
     void updatePCR(unsigned PID, uint64_t PCR, uint64_t byteOffsetFromStart);
 
+    // Parse the elementary stream packets queued on each program, running
+    // programs concurrently. Must be called before anything that can change
+    // the set of programs or streams (PAT/PMT) or their CAS sessions (ECM).
+    void drainPendingPackets();
+
     uint64_t mPCR[2];
     uint64_t mPCRBytes[2];
     int64_t mSystemTimeUs[2];
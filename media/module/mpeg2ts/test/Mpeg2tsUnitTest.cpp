@@ -19,15 +19,23 @@
 
 #include <utils/Log.h>
 
+#include <inttypes.h>
 #include <stdint.h>
 #include <sys/stat.h>
 
+#include <chrono>
+#include <map>
+#include <vector>
+
 #include <datasource/FileSource.h>
 #include <media/stagefright/MediaDefs.h>
+#include <media/stagefright/MediaErrors.h>
 #include <media/stagefright/MetaDataBase.h>
+#include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/AUtils.h>
 #include <mpeg2ts/AnotherPacketSource.h>
 #include <mpeg2ts/ATSParser.h>
+#include <mpeg2ts/ESQueue.h>
 
 #include "Mpeg2tsUnitTestEnvironment.h"
 
@@ -39,6 +47,12 @@ constexpr uint8_t kTSSyncByte = 0x47;
 constexpr uint8_t kVideoPresent = 0x01;
 constexpr uint8_t kAudioPresent = 0x02;
 constexpr uint8_t kMetaDataPresent = 0x04;
+constexpr size_t kBulkFeedPackets = 1024;
+// MPEG-1 Layer III, 128 kbps, 44.1 kHz, no padding: 417 byte frames
+constexpr uint8_t kMPEGAudioHeader[] = {0xFF, 0xFB, 0x90, 0x64};
+constexpr size_t kMPEGAudioFrameSize = 417;
+constexpr size_t kFramesPerPES = 8;
+constexpr size_t kNumPES = 1000;
 
 static Mpeg2tsUnitTestEnvironment *gEnv = nullptr;
 
@@ -216,6 +230,267 @@ TEST_P(Mpeg2tsUnitTest, MediaInfoTest) {
     }
 }
 
+// Feeds the clip once packet by packet and once in bulk with PARALLEL_DEMUX,
+// checks both produce the same access units and reports the throughput.
+TEST_P(Mpeg2tsUnitTest, BulkFeedTest) {
+    static const ATSParser::SourceType mediaType[] = {ATSParser::VIDEO, ATSParser::AUDIO,
+                                                      ATSParser::META};
+
+    std::vector<uint8_t> data(mTotalPackets * kTSPacketSize);
+    ssize_t numBytesRead = mSource->readAt(0, data.data(), data.size());
+    ASSERT_EQ(numBytesRead, (ssize_t)data.size()) << "Unable to read the input clip";
+
+    sp<ATSParser> serialParser = new ATSParser();
+    auto start = std::chrono::steady_clock::now();
+    for (size_t offset = 0; offset < data.size(); offset += kTSPacketSize) {
+        status_t err = serialParser->feedTSPacket(data.data() + offset, kTSPacketSize);
+        ASSERT_EQ(err, (status_t)OK) << "Unable to feed TS packet!";
+    }
+    std::chrono::duration<double> serialTime = std::chrono::steady_clock::now() - start;
+
+    sp<ATSParser> bulkParser = new ATSParser(ATSParser::PARALLEL_DEMUX);
+    start = std::chrono::steady_clock::now();
+    for (size_t offset = 0; offset < data.size(); offset += kBulkFeedPackets * kTSPacketSize) {
+        size_t size = std::min(kBulkFeedPackets * kTSPacketSize, data.size() - offset);
+        status_t err = bulkParser->feedTSPackets(data.data() + offset, size);
+        ASSERT_EQ(err, (status_t)OK) << "Unable to feed TS packets!";
+    }
+    std::chrono::duration<double> bulkTime = std::chrono::steady_clock::now() - start;
+
+    for (ATSParser::SourceType type : mediaType) {
+        ASSERT_EQ(serialParser->hasSource(type), bulkParser->hasSource(type))
+                << "Source mismatch for media type: " << type;
+        sp<AnotherPacketSource> serialSource = serialParser->getSource(type);
+        sp<AnotherPacketSource> bulkSource = bulkParser->getSource(type);
+        ASSERT_EQ(serialSource == nullptr, bulkSource == nullptr)
+                << "Source mismatch for media type: " << type;
+        if (serialSource == nullptr) continue;
+
+        status_t finalResult;
+        ASSERT_EQ(serialSource->getAvailableBufferCount(&finalResult),
+                  bulkSource->getAvailableBufferCount(&finalResult))
+                << "Access unit count mismatch for media type: " << type;
+    }
+
+    ALOGI("%" PRIu64 " packets: %.0f packets/sec serial, %.0f packets/sec bulk", mTotalPackets,
+          mTotalPackets / serialTime.count(), mTotalPackets / bulkTime.count());
+}
+
+// MPEG-2 CRC of a PSI section
+static uint32_t sectionCRC32(const uint8_t *data, size_t size) {
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < size; ++i) {
+        crc ^= (uint32_t)data[i] << 24;
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc & 0x80000000) ? (crc << 1) ^ 0x04C11DB7 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+// Builds a transport stream with several programs, one elementary stream each
+class MultiProgramTSBuilder {
+  public:
+    struct Program {
+        uint16_t programNumber;
+        uint16_t pmtPID;
+        uint16_t esPID;
+        uint8_t streamType;
+    };
+
+    explicit MultiProgramTSBuilder(const std::vector<Program> &programs)
+        : mPrograms(programs) {}
+
+    void addPSI() {
+        std::vector<uint8_t> pat = {0x00, 0xB0, 0x00, 0x00, 0x01, 0xC1, 0x00, 0x00};
+        for (const Program &program : mPrograms) {
+            pat.push_back(program.programNumber >> 8);
+            pat.push_back(program.programNumber & 0xFF);
+            pat.push_back(0xE0 | (program.pmtPID >> 8));
+            pat.push_back(program.pmtPID & 0xFF);
+        }
+        addSection(0x0000, pat);
+
+        for (const Program &program : mPrograms) {
+            std::vector<uint8_t> pmt = {
+                    0x02, 0xB0, 0x00,
+                    (uint8_t)(program.programNumber >> 8), (uint8_t)(program.programNumber & 0xFF),
+                    0xC1, 0x00, 0x00,
+                    (uint8_t)(0xE0 | (program.esPID >> 8)), (uint8_t)(program.esPID & 0xFF),
+                    0xF0, 0x00,
+                    program.streamType,
+                    (uint8_t)(0xE0 | (program.esPID >> 8)), (uint8_t)(program.esPID & 0xFF),
+                    0xF0, 0x00};
+            addSection(program.pmtPID, pmt);
+        }
+    }
+
+    void addPES(uint16_t pid, uint8_t streamId, uint64_t pts, const std::vector<uint8_t> &payload) {
+        std::vector<uint8_t> pes = {0x00, 0x00, 0x01, streamId,
+                                    (uint8_t)((payload.size() + 8) >> 8),
+                                    (uint8_t)((payload.size() + 8) & 0xFF),
+                                    0x80, 0x80, 0x05,
+                                    (uint8_t)(0x21 | ((pts >> 29) & 0x0E)),
+                                    (uint8_t)(pts >> 22),
+                                    (uint8_t)(0x01 | ((pts >> 14) & 0xFE)),
+                                    (uint8_t)(pts >> 7),
+                                    (uint8_t)(0x01 | ((pts << 1) & 0xFE))};
+        pes.insert(pes.end(), payload.begin(), payload.end());
+        addPayload(pid, pes);
+    }
+
+    const std::vector<uint8_t> &data() const { return mData; }
+
+  private:
+    std::vector<Program> mPrograms;
+    std::map<uint16_t, uint8_t> mContinuityCounters;
+    std::vector<uint8_t> mData;
+
+    void addSection(uint16_t pid, std::vector<uint8_t> section) {
+        size_t sectionLength = section.size() - 3 + 4;
+        section[1] |= sectionLength >> 8;
+        section[2] = sectionLength & 0xFF;
+        uint32_t crc = sectionCRC32(section.data(), section.size());
+        for (int shift = 24; shift >= 0; shift -= 8) {
+            section.push_back(crc >> shift);
+        }
+        section.insert(section.begin(), 0x00);  // pointer_field
+        addPayload(pid, section);
+    }
+
+    // Splits |payload| into packets, the last one padded with adaptation field stuffing
+    void addPayload(uint16_t pid, const std::vector<uint8_t> &payload) {
+        for (size_t offset = 0; offset < payload.size();) {
+            size_t size = std::min(payload.size() - offset, kTSPacketSize - 4);
+            size_t stuffing = kTSPacketSize - 4 - size;
+            uint8_t &continuityCounter = mContinuityCounters[pid];
+            mData.push_back(kTSSyncByte);
+            mData.push_back((offset == 0 ? 0x40 : 0x00) | (pid >> 8));
+            mData.push_back(pid & 0xFF);
+            mData.push_back((stuffing > 0 ? 0x30 : 0x10) | continuityCounter);
+            continuityCounter = (continuityCounter + 1) & 0x0F;
+            if (stuffing > 0) {
+                mData.push_back(stuffing - 1);  // adaptation_field_length
+                if (stuffing > 1) {
+                    mData.push_back(0x00);  // no adaptation field flags
+                    mData.insert(mData.end(), stuffing - 2, 0xFF);
+                }
+            }
+            mData.insert(mData.end(), payload.begin() + offset, payload.begin() + offset + size);
+            offset += size;
+        }
+    }
+};
+
+// Dequeues every access unit of |type| from both parsers and compares them
+static void expectSameAccessUnits(ATSParser *serialParser, ATSParser *bulkParser,
+                                  ATSParser::SourceType type, size_t *count) {
+    sp<AnotherPacketSource> serialSource = serialParser->getSource(type);
+    sp<AnotherPacketSource> bulkSource = bulkParser->getSource(type);
+    ASSERT_NE(serialSource, nullptr) << "No source for media type: " << type;
+    ASSERT_NE(bulkSource, nullptr) << "No bulk source for media type: " << type;
+
+    *count = 0;
+    status_t finalResult;
+    while (serialSource->hasBufferAvailable(&finalResult)) {
+        ASSERT_TRUE(bulkSource->hasBufferAvailable(&finalResult))
+                << "Bulk parser is missing access unit " << *count << " of type " << type;
+        sp<ABuffer> serialUnit, bulkUnit;
+        ASSERT_EQ(serialSource->dequeueAccessUnit(&serialUnit), (status_t)OK);
+        ASSERT_EQ(bulkSource->dequeueAccessUnit(&bulkUnit), (status_t)OK);
+        ASSERT_EQ(serialUnit->size(), bulkUnit->size()) << "Access unit " << *count;
+        ASSERT_EQ(memcmp(serialUnit->data(), bulkUnit->data(), serialUnit->size()), 0)
+                << "Access unit " << *count << " of type " << type << " differs";
+        int64_t serialTimeUs = -1, bulkTimeUs = -1;
+        serialUnit->meta()->findInt64("timeUs", &serialTimeUs);
+        bulkUnit->meta()->findInt64("timeUs", &bulkTimeUs);
+        ASSERT_EQ(serialTimeUs, bulkTimeUs) << "Access unit " << *count << " timestamp";
+        ++*count;
+    }
+    ASSERT_FALSE(bulkSource->hasBufferAvailable(&finalResult))
+            << "Bulk parser has extra access units of type " << type;
+}
+
+// Feeds a stream with an audio program and a timed metadata program, so that
+// PARALLEL_DEMUX drains the programs on separate threads, and checks that every
+// access unit matches the ones from per-packet feeding.
+TEST(ATSParserTest, ParallelDemuxMultiProgram) {
+    constexpr uint16_t kAudioPID = 0x101;
+    constexpr uint16_t kMetaPID = 0x201;
+    constexpr size_t kNumProgramPES = 200;
+    constexpr size_t kPSIInterval = 50;
+    constexpr uint64_t kPESDuration90kHz = 90000 * kFramesPerPES * 1152 / 44100;
+
+    MultiProgramTSBuilder builder({{1, 0x100, kAudioPID, ATSParser::STREAMTYPE_MPEG1_AUDIO},
+                                   {2, 0x200, kMetaPID, ATSParser::STREAMTYPE_METADATA}});
+    std::vector<uint8_t> audio(kFramesPerPES * kMPEGAudioFrameSize, 0);
+    for (size_t i = 0; i < kFramesPerPES; ++i) {
+        memcpy(audio.data() + i * kMPEGAudioFrameSize, kMPEGAudioHeader, sizeof(kMPEGAudioHeader));
+    }
+    for (size_t i = 0; i < kNumProgramPES; ++i) {
+        if (i % kPSIInterval == 0) {
+            builder.addPSI();
+        }
+        uint64_t pts = 90000 + i * kPESDuration90kHz;
+        builder.addPES(kAudioPID, 0xC0, pts, audio);
+        std::vector<uint8_t> meta(100 + i % 150, (uint8_t)i);
+        builder.addPES(kMetaPID, 0xBD, pts, meta);
+    }
+    const std::vector<uint8_t> &data = builder.data();
+
+    sp<ATSParser> serialParser = new ATSParser();
+    for (size_t offset = 0; offset < data.size(); offset += kTSPacketSize) {
+        status_t err = serialParser->feedTSPacket(data.data() + offset, kTSPacketSize);
+        ASSERT_EQ(err, (status_t)OK) << "Unable to feed TS packet!";
+    }
+    serialParser->signalEOS(ERROR_END_OF_STREAM);
+
+    sp<ATSParser> bulkParser = new ATSParser(ATSParser::PARALLEL_DEMUX);
+    for (size_t offset = 0; offset < data.size(); offset += kBulkFeedPackets * kTSPacketSize) {
+        size_t size = std::min(kBulkFeedPackets * kTSPacketSize, data.size() - offset);
+        status_t err = bulkParser->feedTSPackets(data.data() + offset, size);
+        ASSERT_EQ(err, (status_t)OK) << "Unable to feed TS packets!";
+    }
+    bulkParser->signalEOS(ERROR_END_OF_STREAM);
+
+    size_t audioCount, metaCount;
+    ASSERT_NO_FATAL_FAILURE(expectSameAccessUnits(serialParser.get(), bulkParser.get(),
+                                                  ATSParser::AUDIO, &audioCount));
+    ASSERT_NO_FATAL_FAILURE(expectSameAccessUnits(serialParser.get(), bulkParser.get(),
+                                                  ATSParser::META, &metaCount));
+    ASSERT_GT(audioCount, 0u) << "No audio access units";
+    ASSERT_GT(metaCount, 0u) << "No metadata access units";
+}
+
+// Queues a large backlog of access units and dequeues all of them, which used
+// to move the remaining backlog to the front of the buffer after every unit.
+TEST(ElementaryStreamQueueTest, DequeueLargeBacklog) {
+    std::vector<uint8_t> pes(kFramesPerPES * kMPEGAudioFrameSize, 0);
+    for (size_t i = 0; i < kFramesPerPES; ++i) {
+        memcpy(pes.data() + i * kMPEGAudioFrameSize, kMPEGAudioHeader, sizeof(kMPEGAudioHeader));
+    }
+
+    ElementaryStreamQueue queue(ElementaryStreamQueue::MPEG_AUDIO);
+    for (size_t i = 0; i < kNumPES; ++i) {
+        status_t err = queue.appendData(pes.data(), pes.size(), i * 1000);
+        ASSERT_EQ(err, (status_t)OK) << "Unable to append PES payload " << i;
+    }
+
+    size_t numAccessUnits = 0;
+    auto start = std::chrono::steady_clock::now();
+    sp<ABuffer> accessUnit;
+    while ((accessUnit = queue.dequeueAccessUnit()) != nullptr) {
+        ASSERT_EQ(accessUnit->size(), kMPEGAudioFrameSize) << "Wrong access unit size";
+        ASSERT_EQ(memcmp(accessUnit->data(), kMPEGAudioHeader, sizeof(kMPEGAudioHeader)), 0)
+                << "Access unit " << numAccessUnits << " does not start with a frame header";
+        ++numAccessUnits;
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    ASSERT_EQ(numAccessUnits, kFramesPerPES * kNumPES) << "Not all access units were dequeued";
+    ALOGI("dequeued %zu access units in %.3f ms", numAccessUnits, elapsed.count() * 1000);
+}
+
 INSTANTIATE_TEST_SUITE_P(
         infoTest, Mpeg2tsUnitTest,
         ::testing::Values(make_tuple("crowd_1920x1080_25fps_6700kbps_h264.ts", 0x01, 1),
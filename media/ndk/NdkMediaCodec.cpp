@@ -18,6 +18,7 @@
 #include <inttypes.h>
 #include <mutex>
 #include <set>
+#include <vector>
 
 //#define LOG_NDEBUG 0
 #define LOG_TAG "NdkMediaCodec"
@@ -765,6 +766,81 @@ ssize_t AMediaCodec_dequeueOutputBuffer(AMediaCodec *mData,
     return translate_error(ret);
 }
 
+EXPORT
+media_status_t AMediaCodec_queueInputBuffers(AMediaCodec *mData,
+        const AMediaCodecBatchBufferInfo *buffers, size_t count, size_t *numQueued) {
+    if (buffers == NULL && count > 0) {
+        return AMEDIA_ERROR_INVALID_PARAMETER;
+    }
+    std::vector<MediaCodec::BatchBufferInfo> infos(count);
+    for (size_t i = 0; i < count; ++i) {
+        const AMediaCodecBufferInfo &info = buffers[i].info;
+        if (info.offset < 0 || info.size < 0) {
+            return AMEDIA_ERROR_INVALID_PARAMETER;
+        }
+        infos[i].mIndex = buffers[i].index;
+        infos[i].mOffset = info.offset;
+        infos[i].mSize = info.size;
+        infos[i].mPresentationTimeUs = info.presentationTimeUs;
+        infos[i].mFlags = info.flags;
+    }
+
+    AString errorMsg;
+    size_t queued;
+    status_t ret = mData->mCodec->queueInputBuffers(infos.data(), count, &queued, &errorMsg);
+    if (numQueued != NULL) {
+        *numQueued = queued;
+    }
+    return translate_error(ret);
+}
+
+EXPORT
+ssize_t AMediaCodec_dequeueInputBuffers(AMediaCodec *mData,
+        size_t *indices, size_t maxCount, int64_t timeoutUs) {
+    if (indices == NULL || maxCount == 0) {
+        return AMEDIA_ERROR_INVALID_PARAMETER;
+    }
+    size_t count;
+    status_t ret = mData->mCodec->dequeueInputBuffers(indices, maxCount, &count, timeoutUs);
+    requestActivityNotification(mData);
+    if (ret == OK) {
+        return count;
+    }
+    return translate_error(ret);
+}
+
+EXPORT
+ssize_t AMediaCodec_dequeueOutputBuffers(AMediaCodec *mData,
+        AMediaCodecBatchBufferInfo *buffers, size_t maxCount, int64_t timeoutUs) {
+    if (buffers == NULL || maxCount == 0) {
+        return AMEDIA_ERROR_INVALID_PARAMETER;
+    }
+    std::vector<MediaCodec::BatchBufferInfo> infos(maxCount);
+    size_t count;
+    status_t ret = mData->mCodec->dequeueOutputBuffers(infos.data(), maxCount, &count, timeoutUs);
+    requestActivityNotification(mData);
+    switch (ret) {
+        case OK:
+            for (size_t i = 0; i < count; ++i) {
+                buffers[i].index = infos[i].mIndex;
+                buffers[i].info.offset = infos[i].mOffset;
+                buffers[i].info.size = infos[i].mSize;
+                buffers[i].info.flags = infos[i].mFlags;
+                buffers[i].info.presentationTimeUs = infos[i].mPresentationTimeUs;
+            }
+            return count;
+        case -EAGAIN:
+            return AMEDIACODEC_INFO_TRY_AGAIN_LATER;
+        case android::INFO_FORMAT_CHANGED:
+            return AMEDIACODEC_INFO_OUTPUT_FORMAT_CHANGED;
+        case INFO_OUTPUT_BUFFERS_CHANGED:
+            return AMEDIACODEC_INFO_OUTPUT_BUFFERS_CHANGED;
+        default:
+            break;
+    }
+    return translate_error(ret);
+}
+
 EXPORT
 AMediaFormat* AMediaCodec_getOutputFormat(AMediaCodec *mData) {
     sp<AMessage> format;
@@ -61,6 +61,16 @@ struct AMediaCodecBufferInfo {
     uint32_t flags;
 };
 typedef struct AMediaCodecBufferInfo AMediaCodecBufferInfo;
+
+/**
+ * Describes one buffer of AMediaCodec_queueInputBuffers() and
+ * AMediaCodec_dequeueOutputBuffers().
+ */
+struct AMediaCodecBatchBufferInfo {
+    size_t index;
+    AMediaCodecBufferInfo info;
+};
+typedef struct AMediaCodecBatchBufferInfo AMediaCodecBatchBufferInfo;
 typedef struct AMediaCodecCryptoInfo AMediaCodecCryptoInfo;
 
 
@@ -534,6 +544,56 @@ media_status_t AMediaCodec_setOnFrameRenderedCallback(
         AMediaCodecOnFrameRendered callback,
         void *userdata) __INTRODUCED_IN(__ANDROID_API_T__);
 
+/**
+ * Send several buffers to the codec for processing, in order, with a single
+ * call into the codec. This has the same effect as calling
+ * AMediaCodec_queueInputBuffer() for each buffer, but avoids most of the
+ * per-call overhead, which matters for codecs with small frames such as
+ * audio codecs.
+ *
+ * Queueing stops at the first buffer that fails. If numQueued is not NULL, it
+ * is set to the number of buffers queued.
+ *
+ * Available since API level 35.
+ */
+media_status_t AMediaCodec_queueInputBuffers(
+        AMediaCodec*,
+        const AMediaCodecBatchBufferInfo *buffers,
+        size_t count,
+        size_t *numQueued) __INTRODUCED_IN(35);
+
+/**
+ * Get the indices of up to maxCount available input buffers.
+ * If no buffer is available, waits up to timeoutUs for the first one.
+ *
+ * Returns the number of indices written to indices, or a negative
+ * AMEDIACODEC_INFO_* or error code.
+ *
+ * Available since API level 35.
+ */
+ssize_t AMediaCodec_dequeueInputBuffers(
+        AMediaCodec*,
+        size_t *indices,
+        size_t maxCount,
+        int64_t timeoutUs) __INTRODUCED_IN(35);
+
+/**
+ * Get up to maxCount buffers of processed data.
+ * If no buffer is available, waits up to timeoutUs for the first one.
+ *
+ * Returns the number of buffers written to buffers, or a negative
+ * AMEDIACODEC_INFO_* or error code. An output format change is returned as
+ * AMEDIACODEC_INFO_OUTPUT_FORMAT_CHANGED by the call after the one that
+ * returned the buffers preceding it.
+ *
+ * Available since API level 35.
+ */
+ssize_t AMediaCodec_dequeueOutputBuffers(
+        AMediaCodec*,
+        AMediaCodecBatchBufferInfo *buffers,
+        size_t maxCount,
+        int64_t timeoutUs) __INTRODUCED_IN(35);
+
 /**
  * Release the crypto if applicable.
  *
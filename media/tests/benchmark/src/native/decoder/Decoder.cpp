@@ -51,44 +51,56 @@ void Decoder::onInputAvailable(AMediaCodec *mediaCodec, int32_t bufIdx) {
             return;
         }
 
-        size_t bufSize;
-        uint8_t *buf = AMediaCodec_getInputBuffer(mCodec, bufIdx, &bufSize);
-        if (!buf) {
-            mErrorCode = AMEDIA_ERROR_IO;
-            mSignalledError = true;
-            mDecoderDoneCondition.notify_one();
-            return;
-        }
-
-        ssize_t bytesRead = 0;
-        uint32_t flag = 0;
-        int64_t presentationTimeUs = 0;
-        tie(bytesRead, flag, presentationTimeUs) =
-                readSampleData(mInputBuffer, mOffset, mFrameMetaData, buf, mNumInputFrame, bufSize);
-        if (flag == AMEDIA_ERROR_MALFORMED) {
-            mErrorCode = (media_status_t)flag;
-            mSignalledError = true;
-            mDecoderDoneCondition.notify_one();
-            return;
-        }
-
-        if (flag == AMEDIACODEC_BUFFER_FLAG_END_OF_STREAM) mSawInputEOS = true;
-        ALOGV("%s bytesRead : %zd presentationTimeUs : %" PRId64 " mSawInputEOS : %s", __FUNCTION__,
-              bytesRead, presentationTimeUs, mSawInputEOS ? "TRUE" : "FALSE");
+        AMediaCodecBufferInfo info;
+        if (!fillInputBuffer(bufIdx, &info)) return;
 
         media_status_t status = AMediaCodec_queueInputBuffer(mCodec, bufIdx, 0 /* offset */,
-                                                             bytesRead, presentationTimeUs, flag);
+                                                             info.size, info.presentationTimeUs,
+                                                             info.flags);
         if (AMEDIA_OK != status) {
             mErrorCode = status;
             mSignalledError = true;
             mDecoderDoneCondition.notify_one();
             return;
         }
-        mStats->addFrameSize(bytesRead);
+        mStats->addFrameSize(info.size);
         mNumInputFrame++;
     }
 }
 
+bool Decoder::fillInputBuffer(int32_t bufIdx, AMediaCodecBufferInfo *info) {
+    size_t bufSize;
+    uint8_t *buf = AMediaCodec_getInputBuffer(mCodec, bufIdx, &bufSize);
+    if (!buf) {
+        mErrorCode = AMEDIA_ERROR_IO;
+        mSignalledError = true;
+        mDecoderDoneCondition.notify_one();
+        return false;
+    }
+
+    ssize_t bytesRead = 0;
+    uint32_t flag = 0;
+    int64_t presentationTimeUs = 0;
+    tie(bytesRead, flag, presentationTimeUs) =
+            readSampleData(mInputBuffer, mOffset, mFrameMetaData, buf, mNumInputFrame, bufSize);
+    if (flag == AMEDIA_ERROR_MALFORMED) {
+        mErrorCode = (media_status_t)flag;
+        mSignalledError = true;
+        mDecoderDoneCondition.notify_one();
+        return false;
+    }
+
+    if (flag == AMEDIACODEC_BUFFER_FLAG_END_OF_STREAM) mSawInputEOS = true;
+    ALOGV("%s bytesRead : %zd presentationTimeUs : %" PRId64 " mSawInputEOS : %s", __FUNCTION__,
+          bytesRead, presentationTimeUs, mSawInputEOS ? "TRUE" : "FALSE");
+
+    info->offset = 0;
+    info->size = bytesRead;
+    info->presentationTimeUs = presentationTimeUs;
+    info->flags = flag;
+    return true;
+}
+
 void Decoder::onOutputAvailable(AMediaCodec *mediaCodec, int32_t bufIdx,
                                 AMediaCodecBufferInfo *bufferInfo) {
     ALOGV("In %s", __func__);
@@ -111,6 +123,7 @@ void Decoder::onOutputAvailable(AMediaCodec *mediaCodec, int32_t bufIdx,
 
         AMediaCodec_releaseOutputBuffer(mCodec, bufIdx, false);
         mSawOutputEOS = (0 != (bufferInfo->flags & AMEDIACODEC_BUFFER_FLAG_END_OF_STREAM));
+        mOutputSizes.push_back(bufferInfo->size);
         mNumOutputFrame++;
         ALOGV("%s index : %d  mSawOutputEOS : %s count : %u", __FUNCTION__, bufIdx,
               mSawOutputEOS ? "TRUE" : "FALSE", mNumOutputFrame);
@@ -156,6 +169,7 @@ int32_t Decoder::decode(uint8_t *inputBuffer, vector<AMediaCodecBufferInfo> &fra
     mFrameMetaData = frameInfo;
     mOffset = 0;
     mOutFp = outFp;
+    mOutputSizes.clear();
 
     const char *mime = nullptr;
     AMediaFormat_getString(mFormat, AMEDIAFORMAT_KEY_MIME, &mime);
@@ -179,7 +193,10 @@ int32_t Decoder::decode(uint8_t *inputBuffer, vector<AMediaCodecBufferInfo> &fra
     mStats->setInitTime(timeTaken);
 
     mStats->setStartTime();
-    if (!asyncMode) {
+    if (!asyncMode && mBatchMode) {
+        int32_t status = decodeBatched();
+        if (status != AMEDIA_OK) return status;
+    } else if (!asyncMode) {
         while (!mSawOutputEOS && !mSignalledError) {
             /* Queue input data */
             if (!mSawInputEOS) {
@@ -229,6 +246,86 @@ int32_t Decoder::decode(uint8_t *inputBuffer, vector<AMediaCodecBufferInfo> &fra
     return AMEDIA_OK;
 }
 
+int32_t Decoder::decodeBatched() {
+    ALOGV("In %s", __func__);
+    constexpr size_t kMaxBatchSize = 16;
+    size_t inIndices[kMaxBatchSize];
+    AMediaCodecBatchBufferInfo inputs[kMaxBatchSize];
+    AMediaCodecBatchBufferInfo outputs[kMaxBatchSize];
+
+    while (!mSawOutputEOS && !mSignalledError) {
+        /* Queue input data */
+        if (!mSawInputEOS) {
+            // No more buffers than the frames left and the EOS buffer
+            size_t maxInputs = min(kMaxBatchSize, mFrameMetaData.size() - mNumInputFrame + 1);
+            ssize_t numIn = AMediaCodec_dequeueInputBuffers(mCodec, inIndices, maxInputs,
+                                                            kQueueDequeueTimeoutUs);
+            if (numIn < 0 && numIn != AMEDIACODEC_INFO_TRY_AGAIN_LATER) {
+                ALOGE("AMediaCodec_dequeueInputBuffers returned error %zd\n", numIn);
+                mErrorCode = (media_status_t)numIn;
+                return mErrorCode;
+            }
+            size_t numInputs = 0;
+            bool filled = true;
+            for (ssize_t i = 0; i < numIn && !mSawInputEOS; i++) {
+                mStats->addInputTime();
+                inputs[numInputs].index = inIndices[i];
+                if (!fillInputBuffer(inIndices[i], &inputs[numInputs].info)) {
+                    filled = false;
+                    break;
+                }
+                mStats->addFrameSize(inputs[numInputs].info.size);
+                mNumInputFrame++;
+                numInputs++;
+            }
+            // Buffers that weren't filled go back to the codec empty, ahead of the EOS buffer
+            // so that nothing is queued after it.
+            size_t numUnused = numIn > 0 ? numIn - numInputs : 0;
+            if (numUnused > 0) {
+                size_t eosInputs = mSawInputEOS ? 1 : 0;
+                memmove(&inputs[numInputs - eosInputs + numUnused],
+                        &inputs[numInputs - eosInputs], eosInputs * sizeof(inputs[0]));
+                for (size_t i = 0; i < numUnused; i++) {
+                    AMediaCodecBatchBufferInfo &unused = inputs[numInputs - eosInputs + i];
+                    unused.index = inIndices[numInputs + i];
+                    unused.info = {0 /* offset */, 0 /* size */, 0 /* pts */, 0 /* flags */};
+                }
+                numInputs += numUnused;
+            }
+            if (numInputs > 0) {
+                media_status_t status =
+                        AMediaCodec_queueInputBuffers(mCodec, inputs, numInputs, nullptr);
+                if (AMEDIA_OK != status) {
+                    ALOGE("AMediaCodec_queueInputBuffers failed %d\n", status);
+                    mErrorCode = status;
+                    return mErrorCode;
+                }
+            }
+            if (!filled) return mErrorCode;
+        }
+
+        /* Dequeue output data */
+        ssize_t numOut = AMediaCodec_dequeueOutputBuffers(mCodec, outputs, kMaxBatchSize,
+                                                          kQueueDequeueTimeoutUs);
+        if (numOut == AMEDIACODEC_INFO_OUTPUT_FORMAT_CHANGED) {
+            mFormat = AMediaCodec_getOutputFormat(mCodec);
+            const char *s = AMediaFormat_toString(mFormat);
+            ALOGI("Output format: %s\n", s);
+        } else if (numOut > 0) {
+            for (ssize_t i = 0; i < numOut; i++) {
+                mStats->addOutputTime();
+                onOutputAvailable(mCodec, outputs[i].index, &outputs[i].info);
+            }
+        } else if (!(numOut == AMEDIACODEC_INFO_TRY_AGAIN_LATER ||
+                     numOut == AMEDIACODEC_INFO_OUTPUT_BUFFERS_CHANGED)) {
+            ALOGE("AMediaCodec_dequeueOutputBuffers returned error %zd\n", numOut);
+            mErrorCode = (media_status_t)numOut;
+            return mErrorCode;
+        }
+    }
+    return AMEDIA_OK;
+}
+
 void Decoder::deInitCodec() {
     if (mFormat) {
         AMediaFormat_delete(mFormat);
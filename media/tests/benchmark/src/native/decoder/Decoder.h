@@ -39,6 +39,7 @@ class Decoder : public CallBackHandle {
           mSawOutputEOS(false),
           mSignalledError(false),
           mErrorCode(AMEDIA_OK),
+          mBatchMode(false),
           mInputBuffer(nullptr),
           mOutFp(nullptr) {
         mExtractor = new Extractor();
@@ -59,6 +60,15 @@ class Decoder : public CallBackHandle {
 
     AMediaFormat *getFormat();
 
+    // In synchronous mode, queue and dequeue buffers with the batched
+    // AMediaCodec calls instead of one call per buffer
+    void setBatchMode(bool batchMode) { mBatchMode = batchMode; }
+
+    int32_t getNumOutputFrames() const { return mNumOutputFrame; }
+
+    // Sizes of the output buffers of the last decode() call, in output order
+    const vector<int32_t> &getOutputSizes() const { return mOutputSizes; }
+
     // Async callback APIs
     void onInputAvailable(AMediaCodec *codec, int32_t index) override;
 
@@ -77,6 +87,11 @@ class Decoder : public CallBackHandle {
                         string statsFile = "");
 
   private:
+    // Fills the input buffer at bufIdx with the next frame. Returns false on error.
+    bool fillInputBuffer(int32_t bufIdx, AMediaCodecBufferInfo *info);
+
+    int32_t decodeBatched();
+
     AMediaCodec *mCodec;
     AMediaFormat *mFormat;
 
@@ -89,10 +104,12 @@ class Decoder : public CallBackHandle {
     bool mSawOutputEOS;
     bool mSignalledError;
     media_status_t mErrorCode;
+    bool mBatchMode;
 
     int32_t mOffset;
     uint8_t *mInputBuffer;
     vector<AMediaCodecBufferInfo> mFrameMetaData;
+    vector<int32_t> mOutputSizes;
     FILE *mOutFp;
 
     /* Asynchronous locks */
@@ -255,6 +255,10 @@ status_t CameraService::enumerateProviders() {
 
         if (nullptr == mCameraProviderManager.get()) {
             mCameraProviderManager = new CameraProviderManager();
+            if (property_get_bool("ro.camera.enableCharacteristicsCache", false)) {
+                mCameraProviderManager->setCharacteristicsCacheDir(
+                        CameraProviderManager::kCharacteristicsCacheDir);
+            }
             res = mCameraProviderManager->initialize(this);
             if (res != OK) {
                 ALOGE("%s: Unable to initialize camera provider manager: %s (%d)",
@@ -155,6 +155,9 @@ private:
 
     // Map of all input frames pending further processing.
     std::unordered_map<int64_t, InputFrame> mPendingInputFrames;
+
+    // Depth and confidence map buffers, kept between captures.
+    DepthPhotoBuffers mDepthPhotoBuffers;
 };
 
 }; //namespace camera3
@@ -71,6 +71,7 @@ HeicCompositeStream::HeicCompositeStream(sp<CameraDeviceBase> device,
         mCodecOutputCounter(0),
         mQuality(-1),
         mGridTimestampUs(0),
+        mNextTileCodec(0),
         mStatusId(StatusTracker::NO_STATUS_ID) {
 }
 
@@ -164,7 +165,7 @@ status_t HeicCompositeStream::createInternalStreams(const std::vector<sp<Surface
     }
 
     if (!mUseGrid) {
-        res = mCodec->createInputSurface(&producer);
+        res = mCodecs[0].codec->createInputSurface(&producer);
         if (res != OK) {
             ALOGE("%s: Failed to create input surface for Heic codec: %s (%d)",
                     __FUNCTION__, strerror(-res), res);
@@ -178,7 +179,7 @@ status_t HeicCompositeStream::createInternalStreams(const std::vector<sp<Surface
     }
     mMainImageSurface = new Surface(producer);
 
-    res = mCodec->start();
+    res = startCodecs();
     if (res != OK) {
         ALOGE("%s: Failed to start codec: %s (%d)", __FUNCTION__,
                 strerror(-res), res);
@@ -275,7 +276,10 @@ void HeicCompositeStream::onBufferReleased(const BufferInfo& bufferInfo) {
 
     if (bufferInfo.mStreamId == mMainImageStreamId) {
         mMainImageFrameNumbers.push(bufferInfo.mFrameNumber);
-        mCodecOutputBufferFrameNumbers.push(bufferInfo.mFrameNumber);
+        if (!mUseGrid) {
+            // Tiles encoded from YUV are looked up by their grid timestamp
+            mCodecOutputBufferFrameNumbers.push(bufferInfo.mFrameNumber);
+        }
         ALOGV("%s: [%" PRId64 "]: Adding main image frame number (%zu frame numbers in total)",
                 __FUNCTION__, bufferInfo.mFrameNumber, mMainImageFrameNumbers.size());
     } else if (bufferInfo.mStreamId == mAppSegmentStreamId) {
@@ -403,9 +407,16 @@ void HeicCompositeStream::onHeicOutputFrameAvailable(
         const CodecOutputBufferInfo& outputBufferInfo) {
     Mutex::Autolock l(mMutex);
 
-    ALOGV("%s: index %d, offset %d, size %d, time %" PRId64 ", flags 0x%x",
-            __FUNCTION__, outputBufferInfo.index, outputBufferInfo.offset,
-            outputBufferInfo.size, outputBufferInfo.timeUs, outputBufferInfo.flags);
+    ALOGV("%s: codec %zu, index %d, offset %d, size %d, time %" PRId64 ", flags 0x%x",
+            __FUNCTION__, outputBufferInfo.codecIndex, outputBufferInfo.index,
+            outputBufferInfo.offset, outputBufferInfo.size, outputBufferInfo.timeUs,
+            outputBufferInfo.flags);
+
+    if (outputBufferInfo.codecIndex >= mCodecs.size()) {
+        ALOGE("%s: Invalid codec index %zu", __FUNCTION__, outputBufferInfo.codecIndex);
+        return;
+    }
+    const sp<MediaCodec>& codec = mCodecs[outputBufferInfo.codecIndex].codec;
 
     if (!mErrorState) {
         if ((outputBufferInfo.size > 0) &&
@@ -415,26 +426,30 @@ void HeicCompositeStream::onHeicOutputFrameAvailable(
         } else {
             ALOGV("%s: Releasing output buffer: size %d flags: 0x%x ", __FUNCTION__,
                 outputBufferInfo.size, outputBufferInfo.flags);
-            mCodec->releaseOutputBuffer(outputBufferInfo.index);
+            codec->releaseOutputBuffer(outputBufferInfo.index);
         }
     } else {
-        mCodec->releaseOutputBuffer(outputBufferInfo.index);
+        codec->releaseOutputBuffer(outputBufferInfo.index);
     }
 }
 
-void HeicCompositeStream::onHeicInputFrameAvailable(int32_t index) {
+void HeicCompositeStream::onHeicInputFrameAvailable(size_t codecIndex, int32_t index) {
     Mutex::Autolock l(mMutex);
 
     if (!mUseGrid) {
         ALOGE("%s: Codec YUV input mode must only be used for Hevc tiling mode", __FUNCTION__);
         return;
     }
+    if (codecIndex >= mCodecs.size()) {
+        ALOGE("%s: Invalid codec index %zu", __FUNCTION__, codecIndex);
+        return;
+    }
 
-    mCodecInputBuffers.push_back(index);
+    mCodecs[codecIndex].inputBuffers.push_back(index);
     mInputReadyCondition.signal();
 }
 
-void HeicCompositeStream::onHeicFormatChanged(sp<AMessage>& newFormat) {
+void HeicCompositeStream::onHeicFormatChanged(size_t codecIndex, sp<AMessage>& newFormat) {
     if (newFormat == nullptr) {
         ALOGE("%s: newFormat must not be null!", __FUNCTION__);
         return;
@@ -476,6 +491,23 @@ void HeicCompositeStream::onHeicFormatChanged(sp<AMessage>& newFormat) {
     }
     newFormat->setInt32(KEY_IS_DEFAULT, 1 /*isPrimary*/);
 
+    // All tiles of an image are muxed with the parameter sets of one codec, so
+    // those of the other codecs must match.
+    if (codecIndex >= mCodecs.size()) {
+        ALOGE("%s: Invalid codec index %zu", __FUNCTION__, codecIndex);
+        return;
+    }
+    for (size_t i = 0; i < mCodecs.size(); i++) {
+        if (i != codecIndex && mCodecs[i].active && mCodecs[i].format != nullptr &&
+                !hasSameCodecConfig(mCodecs[i].format, newFormat)) {
+            ALOGW("%s: Codec %zu parameter sets differ from codec %zu's", __FUNCTION__,
+                    codecIndex, i);
+            retireCodecLocked(codecIndex);
+            return;
+        }
+    }
+    mCodecs[codecIndex].format = newFormat;
+
     int32_t gridRows, gridCols;
     if (newFormat->findInt32(KEY_GRID_ROWS, &gridRows) &&
             newFormat->findInt32(KEY_GRID_COLUMNS, &gridCols)) {
@@ -490,6 +522,20 @@ void HeicCompositeStream::onHeicFormatChanged(sp<AMessage>& newFormat) {
     mInputReadyCondition.signal();
 }
 
+bool HeicCompositeStream::hasSameCodecConfig(const sp<AMessage>& format,
+        const sp<AMessage>& other) {
+    sp<ABuffer> csd, otherCsd;
+    for (const char *key : {"csd-0", "csd-1", "csd-2"}) {
+        // Parameter sets not known yet for either codec can't differ
+        if (format->findBuffer(key, &csd) && other->findBuffer(key, &otherCsd) &&
+                (csd->size() != otherCsd->size() ||
+                memcmp(csd->data(), otherCsd->data(), csd->size()) != 0)) {
+            return false;
+        }
+    }
+    return true;
+}
+
 void HeicCompositeStream::onHeicCodecError() {
     Mutex::Autolock l(mMutex);
     mErrorState = true;
@@ -719,24 +765,50 @@ void HeicCompositeStream::compilePendingInputLocked() {
 
     while (!mCodecOutputBuffers.empty()) {
         auto it = mCodecOutputBuffers.begin();
-        // Assume encoder input to output is FIFO, use a queue to look up
-        // frameNumber when handling codec outputs.
         int64_t bufferFrameNumber = -1;
-        if (mCodecOutputBufferFrameNumbers.empty()) {
+        if (mUseGrid) {
+            // Tiles may come out of the codecs in any order, look them up by
+            // their grid timestamp.
+            auto tile = mCodecTiles.find(it->timeUs);
+            if (tile == mCodecTiles.end()) {
+                ALOGE("%s: Failed to find tile for codec output buffer (timeUs %" PRId64 ")!",
+                        __FUNCTION__, it->timeUs);
+                mCodecs[it->codecIndex].codec->releaseOutputBuffer(it->index);
+                mCodecOutputBuffers.erase(it);
+                continue;
+            }
+            bufferFrameNumber = tile->second.frameNumber;
+            it->tileIndex = tile->second.tileIndex;
+            mCodecTiles.erase(tile);
+        } else if (mCodecOutputBufferFrameNumbers.empty()) {
             ALOGV("%s: Failed to find buffer frameNumber for codec output buffer!", __FUNCTION__);
             break;
         } else {
+            // Assume encoder input to output is FIFO, use a queue to look up
+            // frameNumber when handling codec outputs.
             // Direct mapping between camera frame number and codec timestamp (in us).
             bufferFrameNumber = mCodecOutputBufferFrameNumbers.front();
+            it->tileIndex = mCodecOutputCounter;
             mCodecOutputCounter++;
             if (mCodecOutputCounter == mNumOutputTiles) {
                 mCodecOutputBufferFrameNumbers.pop();
                 mCodecOutputCounter = 0;
             }
+        }
 
-            mPendingInputFrames[bufferFrameNumber].codecOutputBuffers.push_back(*it);
-            ALOGV("%s: [%" PRId64 "]: Pushing codecOutputBuffers (frameNumber %" PRId64 ")",
-                    __FUNCTION__, bufferFrameNumber, it->timeUs);
+        auto frame = mPendingInputFrames.find(bufferFrameNumber);
+        if (mUseGrid && (frame == mPendingInputFrames.end() || frame->second.error)) {
+            // The tiles of a failed image can still be in flight
+            mCodecs[it->codecIndex].codec->releaseOutputBuffer(it->index);
+        } else {
+            auto& codecOutputBuffers = mPendingInputFrames[bufferFrameNumber].codecOutputBuffers;
+            codecOutputBuffers.insert(std::upper_bound(codecOutputBuffers.begin(),
+                    codecOutputBuffers.end(), it->tileIndex,
+                    [](size_t tileIndex, const CodecOutputBufferInfo& info) {
+                        return tileIndex < info.tileIndex;
+                    }), *it);
+            ALOGV("%s: [%" PRId64 "]: Pushing codecOutputBuffers (frameNumber %" PRId64
+                    ", tile %zu)", __FUNCTION__, bufferFrameNumber, it->timeUs, it->tileIndex);
         }
         mCodecOutputBuffers.erase(it);
     }
@@ -784,21 +856,24 @@ void HeicCompositeStream::compilePendingInputLocked() {
         it = mExifErrorFrameNumbers.erase(it);
     }
 
-    // Distribute codec input buffers to be filled out from YUV output
-    for (auto it = mPendingInputFrames.begin();
-            it != mPendingInputFrames.end() && mCodecInputBuffers.size() > 0; it++) {
+    // Distribute codec input buffers to be filled out from YUV output. The
+    // tiles of an image are spread over the codecs, in turn.
+    for (auto it = mPendingInputFrames.begin(); it != mPendingInputFrames.end(); it++) {
         InputFrame& inputFrame(it->second);
         if (inputFrame.codecInputCounter < mGridRows * mGridCols) {
             // Available input tiles that are required for the current input
             // image.
-            size_t newInputTiles = std::min(mCodecInputBuffers.size(),
-                    mGridRows * mGridCols - inputFrame.codecInputCounter);
-            for (size_t i = 0; i < newInputTiles; i++) {
-                CodecInputBufferInfo inputInfo =
-                        { mCodecInputBuffers[0], mGridTimestampUs++, inputFrame.codecInputCounter };
+            size_t codecIndex;
+            while (inputFrame.codecInputCounter < mGridRows * mGridCols &&
+                    getNextTileCodecLocked(&codecIndex)) {
+                std::vector<int32_t>& inputBuffers = mCodecs[codecIndex].inputBuffers;
+                CodecInputBufferInfo inputInfo = { inputBuffers[0], mGridTimestampUs++,
+                        inputFrame.codecInputCounter, codecIndex };
                 inputFrame.codecInputBuffers.push_back(inputInfo);
+                mCodecTiles[inputInfo.timeUs] =
+                        { it->first, inputInfo.tileIndex, inputInfo.codecIndex };
 
-                mCodecInputBuffers.erase(mCodecInputBuffers.begin());
+                inputBuffers.erase(inputBuffers.begin());
                 inputFrame.codecInputCounter++;
             }
             break;
@@ -806,6 +881,34 @@ void HeicCompositeStream::compilePendingInputLocked() {
     }
 }
 
+bool HeicCompositeStream::getNextTileCodecLocked(size_t *codecIndex /*out*/) {
+    for (size_t i = 0; i < mCodecs.size(); i++) {
+        size_t index = (mNextTileCodec + i) % mCodecs.size();
+        if (mCodecs[index].active && !mCodecs[index].inputBuffers.empty()) {
+            *codecIndex = index;
+            mNextTileCodec = index + 1;
+            return true;
+        }
+    }
+    return false;
+}
+
+void HeicCompositeStream::retireCodecLocked(size_t codecIndex) {
+    mCodecs[codecIndex].active = false;
+
+    for (const auto& tile : mCodecTiles) {
+        if (tile.second.codecIndex == codecIndex) {
+            mErrorFrameNumbers.emplace(tile.second.frameNumber);
+        }
+    }
+    mInputReadyCondition.signal();
+}
+
+bool HeicCompositeStream::isNextCodecOutputReady(const InputFrame &inputFrame) {
+    return !inputFrame.codecOutputBuffers.empty() &&
+            inputFrame.codecOutputBuffers.front().tileIndex == inputFrame.codecOutputCounter;
+}
+
 bool HeicCompositeStream::getNextReadyInputLocked(int64_t *frameNumber /*out*/) {
     if (frameNumber == nullptr) {
         return false;
@@ -824,7 +927,7 @@ bool HeicCompositeStream::getNextReadyInputLocked(int64_t *frameNumber /*out*/)
                 (it.second.appSegmentBuffer.data != nullptr || it.second.exifError) &&
                 !it.second.appSegmentWritten && it.second.result != nullptr &&
                 it.second.muxer != nullptr;
-        bool codecOutputReady = !it.second.codecOutputBuffers.empty();
+        bool codecOutputReady = isNextCodecOutputReady(it.second);
         bool codecInputReady = (it.second.yuvBuffer.data != nullptr) &&
                 (!it.second.codecInputBuffers.empty());
         bool hasOutputBuffer = it.second.muxer != nullptr ||
@@ -865,7 +968,7 @@ status_t HeicCompositeStream::processInputFrame(int64_t frameNumber,
             (inputFrame.appSegmentBuffer.data != nullptr || inputFrame.exifError) &&
             !inputFrame.appSegmentWritten && inputFrame.result != nullptr &&
             inputFrame.muxer != nullptr;
-    bool codecOutputReady = inputFrame.codecOutputBuffers.size() > 0;
+    bool codecOutputReady = isNextCodecOutputReady(inputFrame);
     bool codecInputReady = inputFrame.yuvBuffer.data != nullptr &&
             !inputFrame.codecInputBuffers.empty();
     bool hasOutputBuffer = inputFrame.muxer != nullptr ||
@@ -912,8 +1015,8 @@ status_t HeicCompositeStream::processInputFrame(int64_t frameNumber,
         }
     }
 
-    // Write media codec bitstream buffers to muxer.
-    while (!inputFrame.codecOutputBuffers.empty()) {
+    // Write media codec bitstream buffers to muxer, in tile order.
+    while (isNextCodecOutputReady(inputFrame)) {
         res = processOneCodecOutputFrame(frameNumber, inputFrame);
         if (res != OK) {
             ALOGE("%s: Failed to process codec output frame: %s (%d)", __FUNCTION__,
@@ -1072,9 +1175,11 @@ status_t HeicCompositeStream::processAppSegment(int64_t frameNumber, InputFrame
 }
 
 status_t HeicCompositeStream::processCodecInputFrame(InputFrame &inputFrame) {
-    for (auto& inputBuffer : inputFrame.codecInputBuffers) {
+    while (!inputFrame.codecInputBuffers.empty()) {
+        const CodecInputBufferInfo& inputBuffer = inputFrame.codecInputBuffers.front();
+        const sp<MediaCodec>& codec = mCodecs[inputBuffer.codecIndex].codec;
         sp<MediaCodecBuffer> buffer;
-        auto res = mCodec->getInputBuffer(inputBuffer.index, &buffer);
+        auto res = codec->getInputBuffer(inputBuffer.index, &buffer);
         if (res != OK) {
             ALOGE("%s: Error getting codec input buffer: %s (%d)", __FUNCTION__,
                     strerror(-res), res);
@@ -1091,8 +1196,8 @@ status_t HeicCompositeStream::processCodecInputFrame(InputFrame &inputFrame) {
         size_t height = (tileY == static_cast<size_t>(mGridRows) - 1) ?
                 mOutputHeight - tileY * mGridHeight : mGridHeight;
         ALOGV("%s: inputBuffer tileIndex [%zu, %zu], top %zu, left %zu, width %zu, height %zu,"
-                " timeUs %" PRId64, __FUNCTION__, tileX, tileY, top, left, width, height,
-                inputBuffer.timeUs);
+                " timeUs %" PRId64 ", codec %zu", __FUNCTION__, tileX, tileY, top, left, width,
+                height, inputBuffer.timeUs, inputBuffer.codecIndex);
 
         res = copyOneYuvTile(buffer, inputFrame.yuvBuffer, top, left, width, height);
         if (res != OK) {
@@ -1101,24 +1206,25 @@ status_t HeicCompositeStream::processCodecInputFrame(InputFrame &inputFrame) {
             return res;
         }
 
-        res = mCodec->queueInputBuffer(inputBuffer.index, 0, buffer->capacity(),
+        res = codec->queueInputBuffer(inputBuffer.index, 0, buffer->capacity(),
                 inputBuffer.timeUs, 0, nullptr /*errorDetailMsg*/);
         if (res != OK) {
             ALOGE("%s: Failed to queueInputBuffer to Codec: %s (%d)",
                     __FUNCTION__, strerror(-res), res);
             return res;
         }
+        inputFrame.codecInputBuffers.erase(inputFrame.codecInputBuffers.begin());
     }
 
-    inputFrame.codecInputBuffers.clear();
     return OK;
 }
 
 status_t HeicCompositeStream::processOneCodecOutputFrame(int64_t frameNumber,
         InputFrame &inputFrame) {
     auto it = inputFrame.codecOutputBuffers.begin();
+    const sp<MediaCodec>& codec = mCodecs[it->codecIndex].codec;
     sp<MediaCodecBuffer> buffer;
-    status_t res = mCodec->getOutputBuffer(it->index, &buffer);
+    status_t res = codec->getOutputBuffer(it->index, &buffer);
     if (res != OK) {
         ALOGE("%s: Error getting Heic codec output buffer at index %d: %s (%d)",
                 __FUNCTION__, it->index, strerror(-res), res);
@@ -1139,17 +1245,17 @@ status_t HeicCompositeStream::processOneCodecOutputFrame(int64_t frameNumber,
         return res;
     }
 
-    mCodec->releaseOutputBuffer(it->index);
+    codec->releaseOutputBuffer(it->index);
     if (inputFrame.pendingOutputTiles == 0) {
         ALOGW("%s: Codec generated more tiles than expected!", __FUNCTION__);
     } else {
         inputFrame.pendingOutputTiles--;
     }
-
-    inputFrame.codecOutputBuffers.erase(inputFrame.codecOutputBuffers.begin());
+    inputFrame.codecOutputCounter++;
 
     ALOGV("%s: [%" PRId64 "]: Output buffer index %d",
         __FUNCTION__, frameNumber, it->index);
+    inputFrame.codecOutputBuffers.erase(inputFrame.codecOutputBuffers.begin());
     return OK;
 }
 
@@ -1231,7 +1337,7 @@ void HeicCompositeStream::releaseInputFrameLocked(int64_t frameNumber,
     while (!inputFrame->codecOutputBuffers.empty()) {
         auto it = inputFrame->codecOutputBuffers.begin();
         ALOGV("%s: releaseOutputBuffer index %d", __FUNCTION__, it->index);
-        mCodec->releaseOutputBuffer(it->index);
+        mCodecs[it->codecIndex].codec->releaseOutputBuffer(it->index);
         inputFrame->codecOutputBuffers.erase(it);
     }
 
@@ -1241,8 +1347,11 @@ void HeicCompositeStream::releaseInputFrameLocked(int64_t frameNumber,
         mYuvBufferAcquired = false;
     }
 
+    // Give the input buffers not queued back to their codecs
     while (!inputFrame->codecInputBuffers.empty()) {
         auto it = inputFrame->codecInputBuffers.begin();
+        mCodecs[it->codecIndex].inputBuffers.push_back(it->index);
+        mCodecTiles.erase(it->timeUs);
         inputFrame->codecInputBuffers.erase(it);
     }
 
@@ -1323,17 +1432,6 @@ status_t HeicCompositeStream::initializeCodec(uint32_t width, uint32_t height,
         return NO_INIT;
     }
 
-    // Create HEIC/HEVC codec.
-    if (mUseHeic) {
-        mCodec = MediaCodec::CreateByType(mCodecLooper, desiredMime, true /*encoder*/);
-    } else {
-        mCodec = MediaCodec::CreateByComponentName(mCodecLooper, hevcName);
-    }
-    if (mCodec == nullptr) {
-        ALOGE("%s: Failed to create codec for %s", __FUNCTION__, desiredMime);
-        return NO_INIT;
-    }
-
     // Create Looper and handler for Codec callback.
     mCodecCallbackHandler = new CodecCallbackHandler(this);
     if (mCodecCallbackHandler == nullptr) {
@@ -1353,14 +1451,6 @@ status_t HeicCompositeStream::initializeCodec(uint32_t width, uint32_t height,
     }
     mCallbackLooper->registerHandler(mCodecCallbackHandler);
 
-    mAsyncNotify = new AMessage(kWhatCallbackNotify, mCodecCallbackHandler);
-    res = mCodec->setCallback(mAsyncNotify);
-    if (res != OK) {
-        ALOGE("%s: Failed to set MediaCodec callback: %s (%d)", __FUNCTION__,
-                strerror(-res), res);
-        return res;
-    }
-
     // Create output format and configure the Codec.
     sp<AMessage> outputFormat = new AMessage();
     outputFormat->setString(KEY_MIME, desiredMime);
@@ -1399,13 +1489,58 @@ status_t HeicCompositeStream::initializeCodec(uint32_t width, uint32_t height,
     // This only serves as a hint to encoder when encoding is not real-time.
     outputFormat->setInt32(KEY_OPERATING_RATE, useGrid ? kGridOpRate : kNoGridOpRate);
 
-    res = mCodec->configure(outputFormat, nullptr /*nativeWindow*/,
-            nullptr /*crypto*/, CONFIGURE_FLAG_ENCODE);
-    if (res != OK) {
-        ALOGE("%s: Failed to configure codec: %s (%d)", __FUNCTION__,
-                strerror(-res), res);
-        return res;
+    // Encode tiles in parallel with as many codec instances as the encoder
+    // allows.
+    size_t codecCount = 1;
+    if (useGrid) {
+        codecCount = HeicEncoderInfoManager::getInstance().getHevcTileCodecCount(
+                gridRows * gridCols);
+    }
+
+    // Create HEIC/HEVC codecs.
+    for (size_t i = 0; i < codecCount; i++) {
+        CodecInstance codec;
+        if (mUseHeic) {
+            codec.codec = MediaCodec::CreateByType(mCodecLooper, desiredMime, true /*encoder*/);
+        } else {
+            codec.codec = MediaCodec::CreateByComponentName(mCodecLooper, hevcName);
+        }
+        if (codec.codec == nullptr) {
+            if (i > 0) {
+                ALOGW("%s: Failed to create codec %zu, using %zu instances", __FUNCTION__,
+                        i, i);
+                break;
+            }
+            ALOGE("%s: Failed to create codec for %s", __FUNCTION__, desiredMime);
+            return NO_INIT;
+        }
+
+        codec.asyncNotify = new AMessage(kWhatCallbackNotify, mCodecCallbackHandler);
+        codec.asyncNotify->setSize("codecIndex", i);
+        res = codec.codec->setCallback(codec.asyncNotify);
+        if (res != OK) {
+            ALOGE("%s: Failed to set MediaCodec callback: %s (%d)", __FUNCTION__,
+                    strerror(-res), res);
+            codec.codec->release();
+            return res;
+        }
+
+        res = codec.codec->configure(outputFormat, nullptr /*nativeWindow*/,
+                nullptr /*crypto*/, CONFIGURE_FLAG_ENCODE);
+        if (res != OK) {
+            codec.codec->release();
+            if (i > 0) {
+                ALOGW("%s: Failed to configure codec %zu, using %zu instances: %s (%d)",
+                        __FUNCTION__, i, i, strerror(-res), res);
+                break;
+            }
+            ALOGE("%s: Failed to configure codec: %s (%d)", __FUNCTION__,
+                    strerror(-res), res);
+            return res;
+        }
+        mCodecs.push_back(std::move(codec));
     }
+    ALOGV("%s: Using %zu codec instances", __FUNCTION__, mCodecs.size());
 
     mGridWidth = gridWidth;
     mGridHeight = gridHeight;
@@ -1422,12 +1557,31 @@ status_t HeicCompositeStream::initializeCodec(uint32_t width, uint32_t height,
     return OK;
 }
 
+status_t HeicCompositeStream::startCodecs() {
+    for (size_t i = 0; i < mCodecs.size(); i++) {
+        status_t res = mCodecs[i].codec->start();
+        if (res != OK) {
+            if (i > 0) {
+                ALOGW("%s: Failed to start codec %zu, using %zu instances: %s (%d)",
+                        __FUNCTION__, i, i, strerror(-res), res);
+                Mutex::Autolock l(mMutex);
+                for (size_t j = i; j < mCodecs.size(); j++) {
+                    mCodecs[j].codec->release();
+                }
+                mCodecs.resize(i);
+                break;
+            }
+            return res;
+        }
+    }
+    return OK;
+}
+
 void HeicCompositeStream::deinitCodec() {
     ALOGV("%s", __FUNCTION__);
-    if (mCodec != nullptr) {
-        mCodec->stop();
-        mCodec->release();
-        mCodec.clear();
+    for (auto& codec : mCodecs) {
+        codec.codec->stop();
+        codec.codec->release();
     }
 
     if (mCodecLooper != nullptr) {
@@ -1440,7 +1594,8 @@ void HeicCompositeStream::deinitCodec() {
         mCallbackLooper.clear();
     }
 
-    mAsyncNotify.clear();
+    mCodecs.clear();
+    mCodecTiles.clear();
     mFormat.clear();
 }
 
@@ -1673,11 +1828,16 @@ void HeicCompositeStream::updateCodecQualityLocked(int32_t quality) {
     if (quality != mQuality) {
         sp<AMessage> qualityParams = new AMessage;
         qualityParams->setInt32(PARAMETER_KEY_VIDEO_BITRATE, quality);
-        status_t res = mCodec->setParameters(qualityParams);
-        if (res != OK) {
-            ALOGE("%s: Failed to set codec quality: %s (%d)",
-                    __FUNCTION__, strerror(-res), res);
-        } else {
+        status_t res = OK;
+        for (const auto& codec : mCodecs) {
+            res = codec.codec->setParameters(qualityParams);
+            if (res != OK) {
+                ALOGE("%s: Failed to set codec quality: %s (%d)",
+                        __FUNCTION__, strerror(-res), res);
+                break;
+            }
+        }
+        if (res == OK) {
             mQuality = quality;
         }
     }
@@ -1839,7 +1999,10 @@ void HeicCompositeStream::CodecCallbackHandler::onMessageReceived(const sp<AMess
                  break;
              }
 
-             ALOGV("kWhatCallbackNotify: cbID = %d", cbID);
+             size_t codecIndex = 0;
+             msg->findSize("codecIndex", &codecIndex);
+
+             ALOGV("kWhatCallbackNotify: cbID = %d, codecIndex = %zu", cbID, codecIndex);
 
              switch (cbID) {
                  case MediaCodec::CB_INPUT_AVAILABLE: {
@@ -1848,7 +2011,7 @@ void HeicCompositeStream::CodecCallbackHandler::onMessageReceived(const sp<AMess
                          ALOGE("CB_INPUT_AVAILABLE: index is expected.");
                          break;
                      }
-                     parent->onHeicInputFrameAvailable(index);
+                     parent->onHeicInputFrameAvailable(codecIndex, index);
                      break;
                  }
 
@@ -1885,7 +2048,9 @@ void HeicCompositeStream::CodecCallbackHandler::onMessageReceived(const sp<AMess
                          (int32_t)offset,
                          (int32_t)size,
                          timeUs,
-                         (uint32_t)flags};
+                         (uint32_t)flags,
+                         codecIndex,
+                         0 /*tileIndex*/};
 
                      parent->onHeicOutputFrameAvailable(bufferInfo);
                      break;
@@ -1903,7 +2068,7 @@ void HeicCompositeStream::CodecCallbackHandler::onMessageReceived(const sp<AMess
                      if (format != nullptr) {
                          formatCopy = format->dup();
                      }
-                     parent->onHeicFormatChanged(formatCopy);
+                     parent->onHeicFormatChanged(codecIndex, formatCopy);
                      break;
                  }
 
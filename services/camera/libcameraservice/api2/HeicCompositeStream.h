@@ -89,6 +89,8 @@ protected:
     void onRequestError(const CaptureResultExtras& resultExtras) override;
 
 private:
+    friend class HeicCompositeStreamTest;
+
     //
     // HEIC/HEVC Codec related structures, utility functions, and callbacks
     //
@@ -98,12 +100,35 @@ private:
         int32_t size;
         int64_t timeUs;
         uint32_t flags;
+        size_t codecIndex;
+        size_t tileIndex;
     };
 
     struct CodecInputBufferInfo {
         int32_t index;
         int64_t timeUs;
         size_t tileIndex;
+        size_t codecIndex;
+    };
+
+    // Tile encoded by a codec, looked up by the codec timestamp (for HEVC YUV tiling only)
+    struct CodecTileInfo {
+        int64_t frameNumber;
+        size_t tileIndex;
+        size_t codecIndex;
+    };
+
+    // A codec instance. For HEVC YUV tiling, the tiles of an image are spread
+    // over several instances to be encoded in parallel. Otherwise there is only
+    // one.
+    struct CodecInstance {
+        sp<MediaCodec>    codec;
+        sp<AMessage>      asyncNotify;
+        sp<AMessage>      format;
+        // Whether new tiles can be given to the codec
+        bool              active = true;
+        // Codec input buffers ready to be filled out (for HEVC YUV tiling only)
+        std::vector<int32_t> inputBuffers;
     };
 
     class CodecCallbackHandler : public AHandler {
@@ -121,10 +146,9 @@ private:
     };
 
     bool              mUseHeic;
-    sp<MediaCodec>    mCodec;
+    std::vector<CodecInstance> mCodecs;
     sp<ALooper>       mCodecLooper, mCallbackLooper;
     sp<CodecCallbackHandler> mCodecCallbackHandler;
-    sp<AMessage>      mAsyncNotify;
     sp<AMessage>      mFormat;
     size_t            mNumOutputTiles;
 
@@ -139,14 +163,24 @@ private:
     static const int32_t kGridOpRate = 120;
 
     void onHeicOutputFrameAvailable(const CodecOutputBufferInfo& bufferInfo);
-    void onHeicInputFrameAvailable(int32_t index);  // Only called for YUV input mode.
-    void onHeicFormatChanged(sp<AMessage>& newFormat);
+    // Only called for YUV input mode.
+    void onHeicInputFrameAvailable(size_t codecIndex, int32_t index);
+    void onHeicFormatChanged(size_t codecIndex, sp<AMessage>& newFormat);
     void onHeicCodecError();
+    // Whether the parameter sets of two codec output formats match
+    static bool hasSameCodecConfig(const sp<AMessage>& format, const sp<AMessage>& other);
 
     status_t initializeCodec(uint32_t width, uint32_t height,
             const sp<CameraDeviceBase>& cameraDevice);
+    status_t startCodecs();
     void deinitCodec();
 
+    // Stop giving tiles to a codec whose tiles can't go in the same image as
+    // the other codecs', and fail the images it's encoding tiles of.
+    void retireCodecLocked(size_t codecIndex);
+    // Pick the next codec to give a tile to, in turn
+    bool getNextTileCodecLocked(size_t *codecIndex /*out*/);
+
     //
     // Composite stream related structures, utility functions and callbacks.
     //
@@ -155,6 +189,7 @@ private:
         int32_t                   quality;
 
         CpuConsumer::LockedBuffer          appSegmentBuffer;
+        // Sorted by tile index
         std::vector<CodecOutputBufferInfo> codecOutputBuffers;
         std::unique_ptr<CameraMetadata>    result;
 
@@ -177,13 +212,17 @@ private:
         bool                      appSegmentWritten;
         size_t                    pendingOutputTiles;
         size_t                    codecInputCounter;
+        size_t                    codecOutputCounter; // Tiles written to the muxer
 
         InputFrame() : orientation(0), quality(kDefaultJpegQuality), error(false),
                        exifError(false), timestamp(-1), requestId(-1), fenceFd(-1),
                        fileFd(-1), trackIndex(-1), anb(nullptr), appSegmentWritten(false),
-                       pendingOutputTiles(0), codecInputCounter(0) { }
+                       pendingOutputTiles(0), codecInputCounter(0), codecOutputCounter(0) { }
     };
 
+    // Whether the next tile to write to the muxer is encoded
+    static bool isNextCodecOutputReady(const InputFrame &inputFrame);
+
     void compilePendingInputLocked();
     // Find first complete and valid frame with smallest frame number
     bool getNextReadyInputLocked(int64_t *frameNumber /*out*/);
@@ -267,11 +306,12 @@ private:
 
     // Keep all incoming Yuv buffer pending tiling and encoding (for HEVC YUV tiling only)
     std::vector<int64_t> mInputYuvBuffers;
-    // Keep all codec input buffers ready to be filled out (for HEVC YUV tiling only)
-    std::vector<int32_t> mCodecInputBuffers;
-
     // Artificial strictly incremental YUV grid timestamp to make encoder happy.
     int64_t mGridTimestampUs;
+    // Tiles given to the codecs and not encoded yet, by grid timestamp
+    std::map<int64_t, CodecTileInfo> mCodecTiles;
+    // Codec to try first for the next tile
+    size_t mNextTileCodec;
 
     // Indexed by frame number. In most common use case, entries are accessed in order.
     std::map<int64_t, InputFrame> mPendingInputFrames;
@@ -17,6 +17,7 @@
 #define LOG_TAG "HeicEncoderInfoManager"
 //#define LOG_NDEBUG 0
 
+#include <algorithm>
 #include <cstdint>
 #include <regex>
 
@@ -39,6 +40,8 @@ HeicEncoderInfoManager::HeicEncoderInfoManager() :
         mMaxSizeHeic(INT32_MAX, INT32_MAX),
         mHasHEVC(false),
         mHasHEIC(false),
+        mHevcMaxInstances(1),
+        mMaxTileCodecs(1),
         mDisableGrid(false) {
     if (initialize() == OK) {
         mIsInited = true;
@@ -109,8 +112,15 @@ bool HeicEncoderInfoManager::isSizeSupported(int32_t width, int32_t height, bool
     return true;
 }
 
+size_t HeicEncoderInfoManager::getHevcTileCodecCount(size_t tileCount) const {
+    int32_t codecCount = std::max(1,
+            std::min(mMaxTileCodecs, mHevcMaxInstances / kTileCodecInstanceShare));
+    return std::max<size_t>(1, std::min<size_t>(codecCount, tileCount));
+}
+
 status_t HeicEncoderInfoManager::initialize() {
     mDisableGrid = property_get_bool("camera.heic.disable_grid", false);
+    mMaxTileCodecs = property_get_int32("camera.heic.max_tile_codecs", kDefaultMaxTileCodecs);
     sp<IMediaCodecList> codecsList = MediaCodecList::getInstance();
     if (codecsList == nullptr) {
         // No media codec available.
@@ -332,6 +342,14 @@ bool HeicEncoderInfoManager::getHevcCodecDetails(
             continue; // move on to next encoder
         }
 
+        // The limit is optional
+        AString maxInstances;
+        if (details->findString("max-concurrent-instances", &maxInstances)) {
+            mHevcMaxInstances = std::max(1, atoi(maxInstances.c_str()));
+        }
+        ALOGV("%s: [%s] max concurrent instances %d", __FUNCTION__, info->getCodecName(),
+                mHevcMaxInstances);
+
         // Found: save name, size, frame rate
         mHevcName = info->getCodecName();
         mMinSizeHevc = minSizeHevc;
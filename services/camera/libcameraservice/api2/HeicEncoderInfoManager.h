@@ -38,10 +38,19 @@ public:
     bool isSizeSupported(int32_t width, int32_t height,
             bool* useHeic, bool* useGrid, int64_t* stall, AString* hevcName) const;
 
+    // Number of instances of the HEVC codec that can encode the grid tiles of
+    // one image in parallel
+    size_t getHevcTileCodecCount(size_t tileCount) const;
+
     // kGridWidth and kGridHeight should be 2^n
     static const auto kGridWidth = 512;
     static const auto kGridHeight = 512;
 private:
+    // Codec instances used for one image at most, and the share of the instances
+    // the HEVC codec supports left to other clients, such as a video recording
+    static const int32_t kDefaultMaxTileCodecs = 4;
+    static const int32_t kTileCodecInstanceShare = 2;
+
     struct SizePairHash {
         std::size_t operator () (const std::pair<int32_t,int32_t> &p) const {
             return p.first * 31 + p.second;
@@ -69,6 +78,8 @@ private:
     std::pair<int32_t, int32_t> mMinSizeHevc, mMaxSizeHevc;
     bool mHasHEVC, mHasHEIC;
     AString mHevcName;
+    int32_t mHevcMaxInstances;
+    int32_t mMaxTileCodecs;
     FrameRateMaps mHeicFrameRateMaps, mHevcFrameRateMaps;
     bool mDisableGrid;
 
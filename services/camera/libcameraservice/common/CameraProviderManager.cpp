@@ -25,6 +25,7 @@
 #include <aidl/android/hardware/camera/device/ICameraDevice.h>
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>
 #include "common/DepthPhotoProcessor.h"
 #include "hidl/HidlProviderInfo.h"
@@ -64,6 +65,7 @@ const std::string kExternalProviderName = "external/0";
 const float CameraProviderManager::kDepthARTolerance = .1f;
 const bool CameraProviderManager::kFrameworkJpegRDisabled =
         property_get_bool("ro.camera.disableJpegR", false);
+const char *CameraProviderManager::kCharacteristicsCacheDir = "/data/misc/cameraserver";
 
 CameraProviderManager::HidlServiceInteractionProxyImpl
 CameraProviderManager::sHidlServiceInteractionProxy{};
@@ -164,18 +166,30 @@ status_t CameraProviderManager::initialize(wp<CameraProviderManager::StatusListe
     }
     mListener = listener;
     mDeviceState = 0;
+    nsecs_t startTime = systemTime();
     auto res = tryToInitAndAddHidlProvidersLocked(hidlProxy);
     if (res != OK) {
         // Logging done in called function;
         return res;
     }
+    nsecs_t hidlDoneTime = systemTime();
     res = tryToAddAidlProvidersLocked();
 
     IPCThreadState::self()->flushCommands();
 
+    nsecs_t doneTime = systemTime();
+    ALOGI("%s: Camera providers initialized in %" PRId64 " ms (HIDL %" PRId64 " ms, AIDL %"
+            PRId64 " ms)", __FUNCTION__, ns2ms(doneTime - startTime),
+            ns2ms(hidlDoneTime - startTime), ns2ms(doneTime - hidlDoneTime));
+
     return res;
 }
 
+void CameraProviderManager::setCharacteristicsCacheDir(const std::string &dir) {
+    std::lock_guard<std::mutex> lock(mInterfaceMutex);
+    mCharacteristicsCacheDir = dir;
+}
+
 std::pair<int, int> CameraProviderManager::getCameraCount() const {
     std::lock_guard<std::mutex> lock(mInterfaceMutex);
     int systemCameraCount = 0;
@@ -207,7 +221,13 @@ std::vector<std::string> CameraProviderManager::getCameraDeviceIds(std::unordere
     std::lock_guard<std::mutex> lock(mInterfaceMutex);
     std::vector<std::string> deviceIds;
     for (auto& provider : mProviders) {
-        for (auto& id : provider->mUniqueCameraIds) {
+        // Devices of several versions may share an id, which is listed once
+        std::unordered_set<std::string> providerIds;
+        for (auto& deviceInfo : provider->mDevices) {
+            const std::string& id = deviceInfo->mId;
+            if (provider->mUniqueCameraIds.count(id) == 0 || !providerIds.insert(id).second) {
+                continue;
+            }
             deviceIds.push_back(id);
             if (unavailablePhysicalIds != nullptr &&
                     provider->mUnavailablePhysicalCameras.count(id) > 0) {
@@ -867,18 +887,22 @@ status_t CameraProviderManager::dump(int fd, const Vector<String16>& args) {
 
 void CameraProviderManager::ProviderInfo::initializeProviderInfoCommon(
         const std::vector<std::string> &devices) {
-    for (auto& device : devices) {
-        std::string id;
-        status_t res = addDevice(device, CameraDeviceStatus::PRESENT, &id);
-        if (res != OK) {
-            ALOGE("%s: Unable to enumerate camera device '%s': %s (%d)",
-                    __FUNCTION__, device.c_str(), strerror(-res), res);
-            continue;
-        }
+    nsecs_t devicesStartTime = systemTime();
+    addInitialDevices(devices);
+    nsecs_t doneTime = systemTime();
+
+    size_t cachedCount = 0;
+    if (mCharacteristicsCache != nullptr) {
+        cachedCount = mCharacteristicsCache->getHitCount();
+        mCharacteristicsCache->save();
+        mCharacteristicsCache.reset();
     }
 
-    ALOGI("Camera provider %s ready with %zu camera devices",
-            mProviderName.c_str(), mDevices.size());
+    ALOGI("Camera provider %s ready with %zu camera devices in %" PRId64 " ms (setup %" PRId64
+            " ms, devices %" PRId64 " ms, %zu with cached characteristics)",
+            mProviderName.c_str(), mDevices.size(), ns2ms(doneTime - mInitStartTime),
+            ns2ms(devicesStartTime - mInitStartTime), ns2ms(doneTime - devicesStartTime),
+            cachedCount);
 
     // Process cached status callbacks
     {
@@ -2106,10 +2130,94 @@ status_t CameraProviderManager::ProviderInfo::addDevice(
     ALOGI("Enumerating new camera device: %s", name.c_str());
 
     uint16_t major, minor;
-    std::string type, id;
+    std::string id;
+    status_t res = checkNewDevice(name, &id, &major, &minor);
+    if (res != OK) {
+        return res;
+    }
+
+    std::unique_ptr<DeviceInfo> deviceInfo = initializeDeviceInfo(name, mProviderTagid, id, minor);
+    if (deviceInfo == nullptr) return BAD_VALUE;
+    addDeviceInfo(std::move(deviceInfo), initialStatus);
+
+    if (parsedId != nullptr) {
+        *parsedId = id;
+    }
+    return OK;
+}
+
+void CameraProviderManager::ProviderInfo::addInitialDevices(
+        const std::vector<std::string> &devices) {
+    struct NewDevice {
+        std::string name, id;
+        uint16_t majorVersion, minorVersion;
+        std::unique_ptr<DeviceInfo> deviceInfo;
+    };
+    std::vector<NewDevice> newDevices;
+    for (auto& device : devices) {
+        ALOGI("Enumerating new camera device: %s", device.c_str());
+        NewDevice newDevice;
+        newDevice.name = device;
+        status_t res = checkNewDevice(device, &newDevice.id, &newDevice.majorVersion,
+                &newDevice.minorVersion);
+        if (res != OK) {
+            ALOGE("%s: Unable to enumerate camera device '%s': %s (%d)",
+                    __FUNCTION__, device.c_str(), strerror(-res), res);
+            continue;
+        }
+        // None of the list is added yet, so checkNewDevice() can't see the earlier
+        // entries; the first device of an id and major version wins.
+        auto duplicate = std::find_if(newDevices.begin(), newDevices.end(),
+                [&newDevice](const NewDevice& other) {
+                    return other.id == newDevice.id &&
+                            other.majorVersion == newDevice.majorVersion;
+                });
+        if (duplicate != newDevices.end()) {
+            ALOGE("%s: Device %s: ID %s is already in use for device major version %d",
+                    __FUNCTION__, device.c_str(), newDevice.id.c_str(), newDevice.majorVersion);
+            continue;
+        }
+        newDevices.push_back(std::move(newDevice));
+    }
+
+    // Each device takes several HAL calls and the characteristics fixups, and doesn't depend
+    // on the others. The pool threads and this one take the next device until none is left.
+    std::atomic<size_t> nextDevice = 0;
+    auto initializeDevices = [&]() {
+        for (size_t i = nextDevice++; i < newDevices.size(); i = nextDevice++) {
+            NewDevice &newDevice = newDevices[i];
+            newDevice.deviceInfo = initializeDeviceInfo(newDevice.name, mProviderTagid,
+                    newDevice.id, newDevice.minorVersion);
+        }
+    };
+    size_t threadCount = std::min(newDevices.size(), kMaxDeviceInitThreads);
+    std::vector<std::future<void>> threads;
+    for (size_t i = 1; i < threadCount; i++) {
+        threads.push_back(std::async(std::launch::async, initializeDevices));
+    }
+    initializeDevices();
+    for (auto& thread : threads) {
+        thread.wait();
+    }
+
+    // Added in the order the provider listed them
+    for (auto& newDevice : newDevices) {
+        if (newDevice.deviceInfo == nullptr) {
+            ALOGE("%s: Unable to enumerate camera device '%s': %s (%d)",
+                    __FUNCTION__, newDevice.name.c_str(), strerror(-BAD_VALUE), BAD_VALUE);
+            continue;
+        }
+        addDeviceInfo(std::move(newDevice.deviceInfo), CameraDeviceStatus::PRESENT);
+    }
+}
+
+status_t CameraProviderManager::ProviderInfo::checkNewDevice(const std::string& name,
+        /*out*/ std::string* id, /*out*/ uint16_t* majorVersion, /*out*/ uint16_t* minorVersion) {
+    uint16_t major, minor;
+    std::string type;
     IPCTransport transport = getIPCTransport();
 
-    status_t res = parseDeviceName(name, &major, &minor, &type, &id);
+    status_t res = parseDeviceName(name, &major, &minor, &type, id);
     if (res != OK) {
         return res;
     }
@@ -2119,13 +2227,12 @@ status_t CameraProviderManager::ProviderInfo::addDevice(
                 type.c_str(), mType.c_str());
         return BAD_VALUE;
     }
-    if (mManager->isValidDeviceLocked(id, major, transport)) {
+    if (mManager->isValidDeviceLocked(*id, major, transport)) {
         ALOGE("%s: Device %s: ID %s is already in use for device major version %d", __FUNCTION__,
-                name.c_str(), id.c_str(), major);
+                name.c_str(), id->c_str(), major);
         return BAD_VALUE;
     }
 
-    std::unique_ptr<DeviceInfo> deviceInfo;
     switch (transport) {
         case IPCTransport::HIDL:
             switch (major) {
@@ -2149,8 +2256,14 @@ status_t CameraProviderManager::ProviderInfo::addDevice(
             return BAD_VALUE;
     }
 
-    deviceInfo = initializeDeviceInfo(name, mProviderTagid, id, minor);
-    if (deviceInfo == nullptr) return BAD_VALUE;
+    *majorVersion = major;
+    *minorVersion = minor;
+    return OK;
+}
+
+status_t CameraProviderManager::ProviderInfo::addDeviceInfo(
+        std::unique_ptr<DeviceInfo> deviceInfo, CameraDeviceStatus initialStatus) {
+    std::string id = deviceInfo->mId;
     deviceInfo->notifyDeviceStateChange(getDeviceState());
     deviceInfo->mStatus = initialStatus;
     bool isAPI1Compatible = deviceInfo->isAPI1Compatible();
@@ -2166,11 +2279,50 @@ status_t CameraProviderManager::ProviderInfo::addDevice(
             mUniqueAPI1CompatibleCameraIds.push_back(id);
         }
     }
+    return OK;
+}
 
-    if (parsedId != nullptr) {
-        *parsedId = id;
+void CameraProviderManager::ProviderInfo::initializeCharacteristicsCache(
+        const std::string &providerVersion) {
+    // External devices can change behind the same device name
+    if (mManager->mCharacteristicsCacheDir.empty() || mType == "external") {
+        return;
     }
-    return OK;
+
+    // A vendor update may change the characteristics without changing the HAL interface
+    char fingerprint[PROPERTY_VALUE_MAX];
+    property_get("ro.vendor.build.fingerprint", fingerprint, "");
+    std::string fileName = "characteristics_" + mProviderName;
+    std::replace(fileName.begin(), fileName.end(), '/', '_');
+
+    mCharacteristicsCache = std::make_unique<CharacteristicsCache>(
+            mManager->mCharacteristicsCacheDir + "/" + fileName,
+            providerVersion + " " + fingerprint);
+    mCharacteristicsCache->load();
+}
+
+bool CameraProviderManager::ProviderInfo::getCachedCharacteristics(
+        const std::string &deviceName, CameraMetadata *characteristics /*out*/) {
+    if (mCharacteristicsCache == nullptr) {
+        return false;
+    }
+    camera_metadata_t *buffer = mCharacteristicsCache->get(deviceName);
+    if (buffer == nullptr) {
+        return false;
+    }
+    set_camera_metadata_vendor_id(buffer, mProviderTagid);
+    characteristics->acquire(buffer);
+    return true;
+}
+
+void CameraProviderManager::ProviderInfo::cacheCharacteristics(
+        const std::string &deviceName, const CameraMetadata &characteristics) {
+    if (mCharacteristicsCache == nullptr) {
+        return;
+    }
+    const camera_metadata_t *buffer = characteristics.getAndLock();
+    mCharacteristicsCache->put(deviceName, buffer);
+    characteristics.unlock(buffer);
 }
 
 void CameraProviderManager::ProviderInfo::removeDevice(std::string id) {
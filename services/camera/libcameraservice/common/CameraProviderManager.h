@@ -30,7 +30,9 @@
 #include <camera/CameraBase.h>
 #include <utils/Condition.h>
 #include <utils/Errors.h>
+#include <utils/Timers.h>
 #include <android/hardware/ICameraService.h>
+#include <utils/CharacteristicsCache.h>
 #include <utils/IPCTransport.h>
 #include <utils/SessionConfigurationUtils.h>
 #include <aidl/android/hardware/camera/provider/ICameraProvider.h>
@@ -210,6 +212,13 @@ public:
     status_t initialize(wp<StatusListener> listener,
             HidlServiceInteractionProxy *hidlProxy = &sHidlServiceInteractionProxy);
 
+    /**
+     * Keep the camera characteristics of internal providers' devices in files in the given
+     * directory, and read them from there instead of querying the HAL again when the
+     * provider is initialized next. Must be called before initialize().
+     */
+    void setCharacteristicsCacheDir(const std::string &dir);
+
     status_t getCameraIdIPCTransport(const std::string &id,
             IPCTransport *providerTransport) const;
 
@@ -220,6 +229,7 @@ public:
     std::pair<int, int> getCameraCount() const;
 
     /**
+     * The ids of each provider are in the order the provider listed them.
      * Upon the function return, if unavailablePhysicalIds is not nullptr, it
      * will contain all of the unavailable physical camera Ids represented in
      * the form of:
@@ -417,6 +427,7 @@ public:
 
     static const float kDepthARTolerance;
     static const bool kFrameworkJpegRDisabled;
+    static const char *kCharacteristicsCacheDir;
 private:
     // All private members, unless otherwise noted, expect mInterfaceMutex to be locked before use
     mutable std::mutex mInterfaceMutex;
@@ -427,6 +438,12 @@ private:
     // Current overall Android device physical status
     int64_t mDeviceState;
 
+    // Directory of the characteristics caches, none if empty
+    std::string mCharacteristicsCacheDir;
+
+    // Maximum number of threads initializing the devices of a provider
+    static const size_t kMaxDeviceInitThreads = 4;
+
     // mProviderLifecycleLock is locked during onRegistration and removeProvider
     mutable std::mutex mProviderLifecycleLock;
 
@@ -495,6 +512,15 @@ private:
         status_t dump(int fd, const Vector<String16>& args) const;
 
         void initializeProviderInfoCommon(const std::vector<std::string> &devices);
+
+        /**
+         * Camera characteristics of a device as cached by an earlier initialization of the
+         * provider. Returns false if they need to be queried from the HAL.
+         */
+        bool getCachedCharacteristics(const std::string &deviceName,
+                CameraMetadata *characteristics /*out*/);
+        void cacheCharacteristics(const std::string &deviceName,
+                const CameraMetadata &characteristics);
         /**
          * Setup vendor tags for this provider
          */
@@ -734,6 +760,16 @@ private:
                     physicalCameraId(physicalId), status(s) {}
         };
 
+        // Start of the provider initialization, for the startup timings
+        nsecs_t mInitStartTime = 0;
+
+        // Characteristics cache, only present while the provider is being initialized
+        std::unique_ptr<CharacteristicsCache> mCharacteristicsCache;
+
+        // Open the characteristics cache of the provider, if caches are enabled. The
+        // version must identify the provider HAL interface.
+        void initializeCharacteristicsCache(const std::string &providerVersion);
+
         // Lock to synchronize between initialize() and camera status callbacks
         std::mutex mInitLock;
         bool mInitialized = false;
@@ -764,6 +800,17 @@ private:
                 const std::string& name, CameraDeviceStatus initialStatus,
                 /*out*/ std::string* parsedId);
 
+        // Add the devices listed by the provider at initialization, initializing up to
+        // kMaxDeviceInitThreads of them at the same time
+        void addInitialDevices(const std::vector<std::string> &devices);
+
+        // Parse the device name and check that a device of that version can be added
+        status_t checkNewDevice(const std::string& name, /*out*/ std::string* id,
+                /*out*/ uint16_t* majorVersion, /*out*/ uint16_t* minorVersion);
+
+        status_t addDeviceInfo(std::unique_ptr<DeviceInfo> deviceInfo,
+                CameraDeviceStatus initialStatus);
+
         void cameraDeviceStatusChangeInternal(const std::string& cameraDeviceName,
                 CameraDeviceStatus newStatus);
 
@@ -21,6 +21,7 @@
 
 #include "DepthPhotoProcessor.h"
 
+#include <algorithm>
 #include <dynamic_depth/camera.h>
 #include <dynamic_depth/cameras.h>
 #include <dynamic_depth/container.h>
@@ -35,7 +36,11 @@
 #include <libexif/exif-data.h>
 #include <libexif/exif-system.h>
 #include <math.h>
-#include <sstream>
+#include <future>
+#include <istream>
+#include <ostream>
+#include <streambuf>
+#include <string.h>
 #include <utils/Errors.h>
 #include <utils/ExifUtils.h>
 #include <utils/Log.h>
@@ -79,6 +84,74 @@ namespace camera3 {
 // near/far values and impact the range inverse coding.
 static const float CONFIDENCE_THRESHOLD = .15f;
 
+// Stream buffer reading from memory owned by the caller
+class InputMemoryBuffer : public std::streambuf {
+public:
+    InputMemoryBuffer(const char *data, size_t size) {
+        char *begin = const_cast<char*> (data);
+        setg(begin, begin, begin + size);
+    }
+
+protected:
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+            std::ios_base::openmode which) override {
+        if ((which & std::ios_base::in) == 0) {
+            return pos_type(off_type(-1));
+        }
+        char *base = (dir == std::ios_base::beg) ? eback() :
+                (dir == std::ios_base::cur) ? gptr() : egptr();
+        if ((off < eback() - base) || (off > egptr() - base)) {
+            return pos_type(off_type(-1));
+        }
+        setg(eback(), base + off, egptr());
+        return pos_type(gptr() - eback());
+    }
+
+    pos_type seekpos(pos_type pos, std::ios_base::openmode which) override {
+        return seekoff(off_type(pos), std::ios_base::beg, which);
+    }
+};
+
+// Stream buffer writing to memory owned by the caller. Whatever doesn't fit is dropped
+// but counted, so that the size needed can be reported.
+class OutputMemoryBuffer : public std::streambuf {
+public:
+    OutputMemoryBuffer(char *data, size_t size) : mDroppedSize(0) {
+        setp(data, data + size);
+    }
+
+    size_t size() const { return (pptr() - pbase()) + mDroppedSize; }
+
+protected:
+    int_type overflow(int_type ch) override {
+        if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+            mDroppedSize++;
+        }
+        return traits_type::not_eof(ch);
+    }
+
+    std::streamsize xsputn(const char *s, std::streamsize count) override {
+        size_t written = std::min<size_t>(count, epptr() - pptr());
+        memcpy(pptr(), s, written);
+        // pbump() takes an int, output buffers are well within range
+        pbump(static_cast<int> (written));
+        mDroppedSize += count - written;
+        return count;
+    }
+
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+            std::ios_base::openmode which) override {
+        // Only telling the position is supported
+        if ((off != 0) || (dir != std::ios_base::cur) || ((which & std::ios_base::out) == 0)) {
+            return pos_type(off_type(-1));
+        }
+        return pos_type(size());
+    }
+
+private:
+    size_t mDroppedSize;
+};
+
 ExifOrientation getExifOrientation(const unsigned char *jpegBuffer, size_t jpegBufferSize) {
     if ((jpegBuffer == nullptr) || (jpegBufferSize == 0)) {
         return ExifOrientation::ORIENTATION_UNDEFINED;
@@ -114,6 +187,13 @@ ExifOrientation getExifOrientation(const unsigned char *jpegBuffer, size_t jpegB
     return ret;
 }
 
+// Upper bound of the size of a grayscale JPEG: two bytes for each pixel of the image
+// padded to whole 8x8 blocks, plus room for the tables and the EXIF orientation.
+size_t getMaxGrayscaleJpegSize(size_t width, size_t height) {
+    static const size_t kJpegHeaderSize = 4096;
+    return ((width + 7) & ~7) * ((height + 7) & ~7) * 2 + kJpegHeaderSize;
+}
+
 status_t encodeGrayscaleJpeg(size_t width, size_t height, uint8_t *in, void *out,
         const size_t maxOutSize, uint8_t jpegQuality, ExifOrientation exifOrientation,
         size_t &actualSize) {
@@ -336,13 +416,16 @@ bool rotateAndUnpack(DepthPhotoInputFrame inputFrame, std::vector<float> *points
 }
 
 std::unique_ptr<dynamic_depth::DepthMap> processDepthMapFrame(DepthPhotoInputFrame inputFrame,
-        ExifOrientation exifOrientation, std::vector<std::unique_ptr<Item>> *items /*out*/,
-        bool *switchDimensions /*out*/) {
-    if ((items == nullptr) || (switchDimensions == nullptr)) {
+        ExifOrientation exifOrientation, DepthPhotoBuffers *buffers,
+        std::vector<std::unique_ptr<Item>> *items /*out*/, bool *switchDimensions /*out*/) {
+    if ((buffers == nullptr) || (items == nullptr) || (switchDimensions == nullptr)) {
         return nullptr;
     }
 
-    std::vector<float> points, confidence;
+    std::vector<float> &points = buffers->mPoints;
+    std::vector<float> &confidence = buffers->mConfidence;
+    points.clear();
+    confidence.clear();
 
     size_t pointCount = inputFrame.mDepthMapWidth * inputFrame.mDepthMapHeight;
     points.reserve(pointCount);
@@ -371,56 +454,81 @@ std::unique_ptr<dynamic_depth::DepthMap> processDepthMapFrame(DepthPhotoInputFra
         return nullptr;
     }
 
-    std::vector<uint8_t> pointsQuantized, confidenceQuantized;
-    pointsQuantized.reserve(pointCount); confidenceQuantized.reserve(pointCount);
-    auto pointIt = points.begin();
-    auto confidenceIt = confidence.begin();
-    while ((pointIt != points.end()) && (confidenceIt != confidence.end())) {
-        auto point = *pointIt;
-        if ((*confidenceIt) < CONFIDENCE_THRESHOLD) {
+    // The maps are much smaller than the main image, so the buffers are sized after
+    // them instead of the maximum JPEG size of the stream. Only grown, so that the
+    // encoders don't write into freshly cleared memory each time.
+    size_t maxJpegSize = std::min(inputFrame.mMaxJpegSize,
+            getMaxGrayscaleJpegSize(width, height));
+    if (buffers->mDepthJpeg.size() < maxJpegSize) {
+        buffers->mDepthJpeg.resize(maxJpegSize);
+    }
+    if (buffers->mConfidenceJpeg.size() < maxJpegSize) {
+        buffers->mConfidenceJpeg.resize(maxJpegSize);
+    }
+
+    // The confidence map doesn't depend on the depth range, quantize and compress it
+    // while the depth map is being done.
+    size_t confidenceJpegSize = 0;
+    std::future<status_t> confidenceRet = std::async(std::launch::async, [&]() {
+        std::vector<uint8_t> &confidenceQuantized = buffers->mConfidenceQuantized;
+        confidenceQuantized.resize(confidence.size());
+        for (size_t i = 0; i < confidence.size(); i++) {
+            confidenceQuantized[i] = floorf(confidence[i] * 255.0f);
+        }
+        return encodeGrayscaleJpeg(width, height, confidenceQuantized.data(),
+                buffers->mConfidenceJpeg.data(), maxJpegSize,
+                inputFrame.mJpegQuality, exifOrientation, confidenceJpegSize);
+    });
+
+    std::vector<uint8_t> &pointsQuantized = buffers->mPointsQuantized;
+    pointsQuantized.resize(points.size());
+    for (size_t i = 0; i < points.size(); i++) {
+        auto point = points[i];
+        if (confidence[i] < CONFIDENCE_THRESHOLD) {
             point = std::clamp(point, near, far);
         }
-        pointsQuantized.push_back(floorf(((far * (point - near)) /
-                (point * (far - near))) * 255.0f));
-        confidenceQuantized.push_back(floorf(*confidenceIt * 255.0f));
-        confidenceIt++; pointIt++;
+        pointsQuantized[i] = floorf(((far * (point - near)) / (point * (far - near))) * 255.0f);
     }
 
-    DepthMapParams depthParams(DepthFormat::kRangeInverse, near, far, DepthUnits::kMeters,
-            "android/depthmap");
-    depthParams.confidence_uri = "android/confidencemap";
-    depthParams.mime = "image/jpeg";
-    depthParams.depth_image_data.resize(inputFrame.mMaxJpegSize);
-    depthParams.confidence_data.resize(inputFrame.mMaxJpegSize);
-    size_t actualJpegSize;
+    size_t depthJpegSize;
     auto ret = encodeGrayscaleJpeg(width, height, pointsQuantized.data(),
-            depthParams.depth_image_data.data(), inputFrame.mMaxJpegSize,
-            inputFrame.mJpegQuality, exifOrientation, actualJpegSize);
+            buffers->mDepthJpeg.data(), maxJpegSize, inputFrame.mJpegQuality,
+            exifOrientation, depthJpegSize);
+    auto confidenceRes = confidenceRet.get();
     if (ret != NO_ERROR) {
         ALOGE("%s: Depth map compression failed!", __FUNCTION__);
         return nullptr;
     }
-    depthParams.depth_image_data.resize(actualJpegSize);
-
-    ret = encodeGrayscaleJpeg(width, height, confidenceQuantized.data(),
-            depthParams.confidence_data.data(), inputFrame.mMaxJpegSize,
-            inputFrame.mJpegQuality, exifOrientation, actualJpegSize);
-    if (ret != NO_ERROR) {
+    if (confidenceRes != NO_ERROR) {
         ALOGE("%s: Confidence map compression failed!", __FUNCTION__);
         return nullptr;
     }
-    depthParams.confidence_data.resize(actualJpegSize);
+
+    DepthMapParams depthParams(DepthFormat::kRangeInverse, near, far, DepthUnits::kMeters,
+            "android/depthmap");
+    depthParams.confidence_uri = "android/confidencemap";
+    depthParams.mime = "image/jpeg";
+    depthParams.depth_image_data.assign(
+            reinterpret_cast<const char*> (buffers->mDepthJpeg.data()), depthJpegSize);
+    depthParams.confidence_data.assign(
+            reinterpret_cast<const char*> (buffers->mConfidenceJpeg.data()), confidenceJpegSize);
 
     return DepthMap::FromData(depthParams, items);
 }
 
 int processDepthPhotoFrame(DepthPhotoInputFrame inputFrame, size_t depthPhotoBufferSize,
-        void* depthPhotoBuffer /*out*/, size_t* depthPhotoActualSize /*out*/) {
+        void* depthPhotoBuffer /*out*/, size_t* depthPhotoActualSize /*out*/,
+        DepthPhotoBuffers* buffers) {
     if ((inputFrame.mMainJpegBuffer == nullptr) || (inputFrame.mDepthMapBuffer == nullptr) ||
             (depthPhotoBuffer == nullptr) || (depthPhotoActualSize == nullptr)) {
         return BAD_VALUE;
     }
 
+    DepthPhotoBuffers localBuffers;
+    if (buffers == nullptr) {
+        buffers = &localBuffers;
+    }
+
     std::vector<std::unique_ptr<Item>> items;
     std::vector<std::unique_ptr<Camera>> cameraList;
     auto image = Image::FromDataForPrimaryImage("image/jpeg", &items);
@@ -434,7 +542,7 @@ int processDepthPhotoFrame(DepthPhotoInputFrame inputFrame, size_t depthPhotoBuf
             reinterpret_cast<const unsigned char*> (inputFrame.mMainJpegBuffer),
             inputFrame.mMainJpegSize);
     bool switchDimensions;
-    cameraParams->depth_map = processDepthMapFrame(inputFrame, exifOrientation, &items,
+    cameraParams->depth_map = processDepthMapFrame(inputFrame, exifOrientation, buffers, &items,
             &switchDimensions);
     if (cameraParams->depth_map == nullptr) {
         ALOGE("%s: Depth map processing failed!", __FUNCTION__);
@@ -495,23 +603,24 @@ int processDepthPhotoFrame(DepthPhotoInputFrame inputFrame, size_t depthPhotoBuf
         return BAD_VALUE;
     }
 
-    std::istringstream inputJpegStream(
-            std::string(inputFrame.mMainJpegBuffer, inputFrame.mMainJpegSize));
-    std::ostringstream outputJpegStream;
+    // The main image is read and the depth photo written in place, without copies
+    InputMemoryBuffer inputJpegBuffer(inputFrame.mMainJpegBuffer, inputFrame.mMainJpegSize);
+    OutputMemoryBuffer outputJpegBuffer(static_cast<char*> (depthPhotoBuffer),
+            depthPhotoBufferSize);
+    std::istream inputJpegStream(&inputJpegBuffer);
+    std::ostream outputJpegStream(&outputJpegBuffer);
     if (!WriteImageAndMetadataAndContainer(&inputJpegStream, device.get(), &outputJpegStream)) {
         ALOGE("%s: Failed writing depth output", __FUNCTION__);
         return BAD_VALUE;
     }
 
-    *depthPhotoActualSize = static_cast<size_t> (outputJpegStream.tellp());
+    *depthPhotoActualSize = outputJpegBuffer.size();
     if (*depthPhotoActualSize > depthPhotoBufferSize) {
         ALOGE("%s: Depth photo output buffer not sufficient, needed %zu actual %zu", __FUNCTION__,
                 *depthPhotoActualSize, depthPhotoBufferSize);
         return NO_MEMORY;
     }
 
-    memcpy(depthPhotoBuffer, outputJpegStream.str().c_str(), *depthPhotoActualSize);
-
     return 0;
 }
 
@@ -20,6 +20,8 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include <vector>
+
 namespace android {
 namespace camera3 {
 
@@ -64,9 +66,19 @@ struct DepthPhotoInputFrame {
             mOrientation(DepthPhotoOrientation::DEPTH_ORIENTATION_0_DEGREES) {}
 };
 
+// Intermediate buffers of the depth and confidence maps. Passing the same instance for
+// every capture avoids allocating and clearing them each time; they only ever grow, and
+// are sized after the depth map rather than the main image.
+// An instance must not be used by two captures at the same time.
+struct DepthPhotoBuffers {
+    std::vector<float>   mPoints, mConfidence;
+    std::vector<uint8_t> mPointsQuantized, mConfidenceQuantized;
+    std::vector<uint8_t> mDepthJpeg, mConfidenceJpeg;
+};
+
 int processDepthPhotoFrame(DepthPhotoInputFrame /*inputFrame*/,
         size_t /*depthPhotoBufferSize*/, void* /*depthPhotoBuffer out*/,
-        size_t* /*depthPhotoActualSize out*/);
+        size_t* /*depthPhotoActualSize out*/, DepthPhotoBuffers* /*buffers*/ = nullptr);
 
 }; // namespace camera3
 }; // namespace android
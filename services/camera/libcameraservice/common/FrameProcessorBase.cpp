@@ -137,6 +137,8 @@ void FrameProcessorBase::processNewFrames(const sp<FrameProducer> &device) {
     status_t res;
     ATRACE_CALL();
     CaptureResult result;
+    // Frame processing looks up many tags of each result
+    result.mMetadata.setTagIndexEnabled(true);
 
     ALOGV("%s: Camera %s: Process new frames", __FUNCTION__, device->getId().string());
 
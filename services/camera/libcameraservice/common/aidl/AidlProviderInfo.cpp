@@ -99,6 +99,7 @@ AidlProviderInfo::AidlProviderInfo(
 status_t AidlProviderInfo::initializeAidlProvider(
         std::shared_ptr<ICameraProvider>& interface, int64_t currentDeviceState) {
 
+    mInitStartTime = systemTime();
     status_t res = parseProviderName(mProviderName, &mType, &mId);
     if (res != OK) {
         ALOGE("%s: Invalid provider name, ignoring", __FUNCTION__);
@@ -178,6 +179,12 @@ status_t AidlProviderInfo::initializeAidlProvider(
 
     mIsRemote = interface->isRemote();
 
+    int32_t interfaceVersion = 0;
+    std::string interfaceHash;
+    interface->getInterfaceVersion(&interfaceVersion);
+    interface->getInterfaceHash(&interfaceHash);
+    initializeCharacteristicsCache(std::string(ICameraProvider::descriptor) + " " +
+            std::to_string(interfaceVersion) + " " + interfaceHash);
     initializeProviderInfoCommon(devices);
     return OK;
 }
@@ -450,25 +457,29 @@ AidlProviderInfo::AidlDeviceInfo3::AidlDeviceInfo3(
         DeviceInfo3(name, tagId, id, minorVersion, resourceCost, parentProvider, publicCameraIds) {
 
     // Get camera characteristics and initialize flash unit availability
-    aidl::android::hardware::camera::device::CameraMetadata chars;
-    ::ndk::ScopedAStatus status = interface->getCameraCharacteristics(&chars);
-    std::vector<uint8_t> &metadata = chars.metadata;
-    camera_metadata_t *buffer = reinterpret_cast<camera_metadata_t*>(metadata.data());
-    size_t expectedSize = metadata.size();
-    int resV = validate_camera_metadata_structure(buffer, &expectedSize);
-    if (resV == OK || resV == CAMERA_METADATA_VALIDATION_SHIFTED) {
-        set_camera_metadata_vendor_id(buffer, mProviderTagid);
-        mCameraCharacteristics = buffer;
-    } else {
-        ALOGE("%s: Malformed camera metadata received from HAL", __FUNCTION__);
-        return;
-    }
+    ::ndk::ScopedAStatus status;
+    if (!parentProvider->getCachedCharacteristics(name, &mCameraCharacteristics)) {
+        aidl::android::hardware::camera::device::CameraMetadata chars;
+        status = interface->getCameraCharacteristics(&chars);
+        std::vector<uint8_t> &metadata = chars.metadata;
+        camera_metadata_t *buffer = reinterpret_cast<camera_metadata_t*>(metadata.data());
+        size_t expectedSize = metadata.size();
+        int resV = validate_camera_metadata_structure(buffer, &expectedSize);
+        if (resV == OK || resV == CAMERA_METADATA_VALIDATION_SHIFTED) {
+            set_camera_metadata_vendor_id(buffer, mProviderTagid);
+            mCameraCharacteristics = buffer;
+        } else {
+            ALOGE("%s: Malformed camera metadata received from HAL", __FUNCTION__);
+            return;
+        }
 
-    if (!status.isOk()) {
-        ALOGE("%s: Transaction error getting camera characteristics for device %s"
-                " to check for a flash unit: %s", __FUNCTION__, id.c_str(),
-                status.getMessage());
-        return;
+        if (!status.isOk()) {
+            ALOGE("%s: Transaction error getting camera characteristics for device %s"
+                    " to check for a flash unit: %s", __FUNCTION__, id.c_str(),
+                    status.getMessage());
+            return;
+        }
+        parentProvider->cacheCharacteristics(name, mCameraCharacteristics);
     }
 
     if (mCameraCharacteristics.exists(ANDROID_INFO_DEVICE_STATE_ORIENTATIONS)) {
@@ -116,6 +116,7 @@ const char* statusToString(const Status& s) {
 status_t HidlProviderInfo::initializeHidlProvider(
         sp<provider::V2_4::ICameraProvider>& interface,
         int64_t currentDeviceState) {
+    mInitStartTime = systemTime();
     status_t res = parseProviderName(mProviderName, &mType, &mId);
     if (res != OK) {
         ALOGE("%s: Invalid provider name, ignoring", __FUNCTION__);
@@ -251,6 +252,9 @@ status_t HidlProviderInfo::initializeHidlProvider(
 
     mIsRemote = interface->isRemote();
 
+    initializeCharacteristicsCache(
+            std::string(provider::V2_4::ICameraProvider::descriptor) + " 2." +
+            std::to_string(mMinorVersion));
     initializeProviderInfoCommon(devices);
 
     return OK;
@@ -564,33 +568,36 @@ HidlProviderInfo::HidlDeviceInfo3::HidlDeviceInfo3(
     // Get camera characteristics and initialize flash unit availability
     Status status;
     hardware::Return<void> ret;
-    ret = interface->getCameraCharacteristics([&status, this](Status s,
-                    device::V3_2::CameraMetadata metadata) {
-                status = s;
-                if (s == Status::OK) {
-                    camera_metadata_t *buffer =
-                            reinterpret_cast<camera_metadata_t*>(metadata.data());
-                    size_t expectedSize = metadata.size();
-                    int res = validate_camera_metadata_structure(buffer, &expectedSize);
-                    if (res == OK || res == CAMERA_METADATA_VALIDATION_SHIFTED) {
-                        set_camera_metadata_vendor_id(buffer, mProviderTagid);
-                        mCameraCharacteristics = buffer;
-                    } else {
-                        ALOGE("%s: Malformed camera metadata received from HAL", __FUNCTION__);
-                        status = Status::INTERNAL_ERROR;
+    if (!parentProvider->getCachedCharacteristics(name, &mCameraCharacteristics)) {
+        ret = interface->getCameraCharacteristics([&status, this](Status s,
+                        device::V3_2::CameraMetadata metadata) {
+                    status = s;
+                    if (s == Status::OK) {
+                        camera_metadata_t *buffer =
+                                reinterpret_cast<camera_metadata_t*>(metadata.data());
+                        size_t expectedSize = metadata.size();
+                        int res = validate_camera_metadata_structure(buffer, &expectedSize);
+                        if (res == OK || res == CAMERA_METADATA_VALIDATION_SHIFTED) {
+                            set_camera_metadata_vendor_id(buffer, mProviderTagid);
+                            mCameraCharacteristics = buffer;
+                        } else {
+                            ALOGE("%s: Malformed camera metadata received from HAL", __FUNCTION__);
+                            status = Status::INTERNAL_ERROR;
+                        }
                     }
-                }
-            });
-    if (!ret.isOk()) {
-        ALOGE("%s: Transaction error getting camera characteristics for device %s"
-                " to check for a flash unit: %s", __FUNCTION__, id.c_str(),
-                ret.description().c_str());
-        return;
-    }
-    if (status != Status::OK) {
-        ALOGE("%s: Unable to get camera characteristics for device %s: %s (%d)",
-                __FUNCTION__, id.c_str(), statusToString(status), status);
-        return;
+                });
+        if (!ret.isOk()) {
+            ALOGE("%s: Transaction error getting camera characteristics for device %s"
+                    " to check for a flash unit: %s", __FUNCTION__, id.c_str(),
+                    ret.description().c_str());
+            return;
+        }
+        if (status != Status::OK) {
+            ALOGE("%s: Unable to get camera characteristics for device %s: %s (%d)",
+                    __FUNCTION__, id.c_str(), statusToString(status), status);
+            return;
+        }
+        parentProvider->cacheCharacteristics(name, mCameraCharacteristics);
     }
 
     if (mCameraCharacteristics.exists(ANDROID_INFO_DEVICE_STATE_ORIENTATIONS)) {
@@ -614,8 +614,7 @@ status_t Camera3Device::dump(int fd, [[maybe_unused]] const Vector<String16> &ar
     write(fd, lines.string(), lines.size());
 
     if (mRequestThread != NULL) {
-        mRequestThread->dumpCaptureRequestLatency(fd,
-                "    ProcessCaptureRequest latency histogram:");
+        mRequestThread->dumpCaptureRequestLatency(fd);
     }
 
     {
@@ -3090,6 +3089,8 @@ Camera3Device::RequestThread::RequestThread(wp<Camera3Device> parent,
         mPrepareVideoStream(false),
         mConstrainedMode(false),
         mRequestLatency(kRequestLatencyBinSize),
+        mRequestWaitLatency(kRequestStageLatencyBinSize),
+        mRequestPrepareLatency(kRequestStageLatencyBinSize),
         mSessionParamKeys(sessionParamKeys),
         mLatestSessionParams(sessionParamKeys.size()),
         mUseHalBufManager(useHalBufManager),
@@ -3353,6 +3354,10 @@ void Camera3Device::RequestThread::requestExit() {
     mDoPauseSignal.signal();
     mRequestSignal.signal();
 
+    mRequestWaitLatency.log("Request wait latency histogram");
+    mRequestWaitLatency.reset();
+    mRequestPrepareLatency.log("Request prepare latency histogram");
+    mRequestPrepareLatency.reset();
     mRequestLatency.log("ProcessCaptureRequest latency histogram");
     mRequestLatency.reset();
 }
@@ -3502,14 +3507,20 @@ void Camera3Device::RequestThread::updateNextRequest(NextRequest& nextRequest) {
     if (halRequest.settings != NULL) { // Don't update if they were unchanged
         Mutex::Autolock al(mLatestRequestMutex);
 
-        camera_metadata_t* cloned = clone_camera_metadata(halRequest.settings);
-        mLatestRequest.acquire(cloned);
+        // Repeating requests mostly change a few tags at a time, such as the zoom ratio
+        // during a pinch, so only copy the entries that changed since the last settings.
+        mLatestRequest.updateFrom(halRequest.settings);
 
-        mLatestPhysicalRequest.clear();
+        for (auto it = mLatestPhysicalRequest.begin(); it != mLatestPhysicalRequest.end();) {
+            bool requested = false;
+            for (uint32_t i = 0; i < halRequest.num_physcam_settings && !requested; i++) {
+                requested = it->first == halRequest.physcam_id[i];
+            }
+            it = requested ? std::next(it) : mLatestPhysicalRequest.erase(it);
+        }
         for (uint32_t i = 0; i < halRequest.num_physcam_settings; i++) {
-            cloned = clone_camera_metadata(halRequest.physcam_settings[i]);
-            mLatestPhysicalRequest.emplace(halRequest.physcam_id[i],
-                    CameraMetadata(cloned));
+            mLatestPhysicalRequest[halRequest.physcam_id[i]].updateFrom(
+                    halRequest.physcam_settings[i]);
         }
 
         sp<Camera3Device> parent = mParent.promote();
@@ -3605,10 +3616,12 @@ bool Camera3Device::RequestThread::threadLoop() {
     }
 
     // Wait for the next batch of requests.
+    nsecs_t tWaitStart = systemTime(SYSTEM_TIME_MONOTONIC);
     waitForNextRequestBatch();
     if (mNextRequests.size() == 0) {
         return true;
     }
+    mRequestWaitLatency.add(tWaitStart, systemTime(SYSTEM_TIME_MONOTONIC));
 
     // Get the latest request ID, if any
     int latestRequestId;
@@ -3668,7 +3681,9 @@ bool Camera3Device::RequestThread::threadLoop() {
     }
 
     // Prepare a batch of HAL requests and output buffers.
+    nsecs_t tPrepareStart = systemTime(SYSTEM_TIME_MONOTONIC);
     res = prepareHalRequests();
+    mRequestPrepareLatency.add(tPrepareStart, systemTime(SYSTEM_TIME_MONOTONIC));
     if (res == TIMED_OUT) {
         // Not a fatal error if getting output buffers time out.
         cleanUpFailedRequests(/*sendRequestError*/ true);
@@ -3753,6 +3768,45 @@ status_t Camera3Device::removeFwkOnlyRegionKeys(CameraMetadata *request) {
 status_t Camera3Device::RequestThread::prepareHalRequests() {
     ATRACE_CALL();
 
+    // Prepare video buffers for high speed recording on the first video request, before
+    // any buffer of the video stream is handed out.
+    for (size_t i = 0; i < mNextRequests.size() && mPrepareVideoStream; i++) {
+        for (const auto& outputStream : mNextRequests[i].captureRequest->mOutputStreams) {
+            if (!outputStream->isVideoStream()) {
+                continue;
+            }
+            // Only try to prepare video stream on the first video request.
+            mPrepareVideoStream = false;
+
+            status_t res = outputStream->startPrepare(
+                    Camera3StreamInterface::ALLOCATE_PIPELINE_MAX, false /*blockRequest*/);
+            while (res == NOT_ENOUGH_DATA) {
+                res = outputStream->prepareNextBuffer();
+            }
+            if (res != OK) {
+                ALOGW("%s: Preparing video buffers for high speed failed: %s (%d)",
+                    __FUNCTION__, strerror(-res), res);
+                outputStream->cancelPrepare();
+            }
+            break;
+        }
+    }
+
+    // With the HAL buffer manager, the HAL requests the buffers itself
+    if (!mUseHalBufManager) {
+        sp<Camera3Device> parent = mParent.promote();
+        if (parent == NULL) {
+            // Should not happen, and nowhere to send errors to, so just log it
+            CLOGE("RequestThread: Parent is gone");
+            return INVALID_OPERATION;
+        }
+        status_t res = getOutputBuffers(kBaseGetBufferWait +
+                parent->getExpectedInFlightDuration());
+        if (res != OK) {
+            return res;
+        }
+    }
+
     bool batchedRequest = mNextRequests[0].captureRequest->mBatchSize > 1;
     for (size_t i = 0; i < mNextRequests.size(); i++) {
         auto& nextRequest = mNextRequests.editItemAt(i);
@@ -3978,8 +4032,10 @@ status_t Camera3Device::RequestThread::prepareHalRequests() {
             halRequest->input_buffer = NULL;
         }
 
-        outputBuffers->insertAt(camera_stream_buffer_t(), 0,
-                captureRequest->mOutputStreams.size());
+        if (mUseHalBufManager) {
+            outputBuffers->insertAt(camera_stream_buffer_t(), 0,
+                    captureRequest->mOutputStreams.size());
+        }
         halRequest->output_buffers = outputBuffers->array();
         std::set<std::set<String8>> requestedPhysicalCameras;
 
@@ -3989,7 +4045,6 @@ status_t Camera3Device::RequestThread::prepareHalRequests() {
             CLOGE("RequestThread: Parent is gone");
             return INVALID_OPERATION;
         }
-        nsecs_t waitDuration = kBaseGetBufferWait + parent->getExpectedInFlightDuration();
 
         SurfaceMap uniqueSurfaceIdMap;
         for (size_t j = 0; j < captureRequest->mOutputStreams.size(); j++) {
@@ -3997,23 +4052,6 @@ status_t Camera3Device::RequestThread::prepareHalRequests() {
                     captureRequest->mOutputStreams.editItemAt(j);
             int streamId = outputStream->getId();
 
-            // Prepare video buffers for high speed recording on the first video request.
-            if (mPrepareVideoStream && outputStream->isVideoStream()) {
-                // Only try to prepare video stream on the first video request.
-                mPrepareVideoStream = false;
-
-                res = outputStream->startPrepare(Camera3StreamInterface::ALLOCATE_PIPELINE_MAX,
-                        false /*blockRequest*/);
-                while (res == NOT_ENOUGH_DATA) {
-                    res = outputStream->prepareNextBuffer();
-                }
-                if (res != OK) {
-                    ALOGW("%s: Preparing video buffers for high speed failed: %s (%d)",
-                        __FUNCTION__, strerror(-res), res);
-                    outputStream->cancelPrepare();
-                }
-            }
-
             std::vector<size_t> uniqueSurfaceIds;
             res = outputStream->getUniqueSurfaceIds(
                     captureRequest->mOutputSurfaces[streamId],
@@ -4044,20 +4082,8 @@ status_t Camera3Device::RequestThread::prepareHalRequests() {
                 // 'prepare' after this request reaches CameraHal and before the respective
                 // buffers are requested.
                 outputStream->markUnpreparable();
-            } else {
-                res = outputStream->getBuffer(&outputBuffers->editItemAt(j),
-                        waitDuration,
-                        captureRequest->mOutputSurfaces[streamId]);
-                if (res != OK) {
-                    // Can't get output buffer from gralloc queue - this could be due to
-                    // abandoned queue or other consumer misbehavior, so not a fatal
-                    // error
-                    ALOGV("RequestThread: Can't get output buffer, skipping request:"
-                            " %s (%d)", strerror(-res), res);
-
-                    return TIMED_OUT;
-                }
             }
+            // Otherwise the buffer was gotten by getOutputBuffers()
 
             {
                 sp<Camera3Device> parent = mParent.promote();
@@ -4152,6 +4178,52 @@ status_t Camera3Device::RequestThread::prepareHalRequests() {
     return OK;
 }
 
+status_t Camera3Device::RequestThread::getOutputBuffers(nsecs_t waitDuration) {
+    ATRACE_CALL();
+
+    // The buffers to get from each stream, for all requests of the batch, with the streams
+    // in the order they are first requested in
+    std::vector<std::pair<sp<Camera3OutputStreamInterface>,
+            std::vector<Camera3StreamInterface::OutstandingBuffer>>> streamBuffers;
+    for (size_t i = 0; i < mNextRequests.size(); i++) {
+        auto& nextRequest = mNextRequests.editItemAt(i);
+        sp<CaptureRequest> captureRequest = nextRequest.captureRequest;
+        Vector<camera_stream_buffer_t>* outputBuffers = &nextRequest.outputBuffers;
+
+        outputBuffers->insertAt(camera_stream_buffer_t(), 0,
+                captureRequest->mOutputStreams.size());
+        for (size_t j = 0; j < captureRequest->mOutputStreams.size(); j++) {
+            sp<Camera3OutputStreamInterface> outputStream =
+                    captureRequest->mOutputStreams.editItemAt(j);
+            auto it = std::find_if(streamBuffers.begin(), streamBuffers.end(),
+                    [&outputStream](const auto& s) { return s.first == outputStream; });
+            if (it == streamBuffers.end()) {
+                it = streamBuffers.emplace(streamBuffers.end(), outputStream,
+                        std::vector<Camera3StreamInterface::OutstandingBuffer>());
+            }
+            it->second.push_back({&outputBuffers->editItemAt(j),
+                    captureRequest->mOutputSurfaces[outputStream->getId()]});
+        }
+    }
+
+    // One pass per stream: a single stream lock and buffer limit check, and one dequeue
+    // for the buffers of a batch when the stream can
+    for (auto& [outputStream, buffers] : streamBuffers) {
+        status_t res = outputStream->getBuffers(&buffers, waitDuration);
+        if (res != OK) {
+            // Can't get output buffers from gralloc queue - this could be due to
+            // abandoned queue or other consumer misbehavior, so not a fatal
+            // error
+            ALOGV("RequestThread: Can't get %zu output buffers for stream %d, skipping"
+                    " request: %s (%d)", buffers.size(), outputStream->getId(),
+                    strerror(-res), res);
+            return TIMED_OUT;
+        }
+    }
+
+    return OK;
+}
+
 CameraMetadata Camera3Device::RequestThread::getLatestRequest() const {
     ATRACE_CALL();
     Mutex::Autolock al(mLatestRequestMutex);
@@ -4388,7 +4460,12 @@ void Camera3Device::RequestThread::cleanUpFailedRequests(bool sendRequestError)
 
         // No output buffer can be returned when using HAL buffer manager
         if (!mUseHalBufManager) {
-            for (size_t i = 0; i < halRequest->num_output_buffers; i++) {
+            // The buffers are gotten for all requests of the batch before the HAL requests
+            // are prepared, so return any buffer that was gotten.
+            for (size_t i = 0; i < outputBuffers->size(); i++) {
+                if ((*outputBuffers)[i].buffer == nullptr) {
+                    continue;
+                }
                 //Buffers that failed processing could still have
                 //valid acquire fence.
                 int acquireFence = (*outputBuffers)[i].acquire_fence;
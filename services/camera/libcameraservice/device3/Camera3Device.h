@@ -968,9 +968,12 @@ class Camera3Device :
          */
         bool isOutputSurfacePending(int streamId, size_t surfaceId);
 
-        // dump processCaptureRequest latency
-        void dumpCaptureRequestLatency(int fd, const char* name) {
-            mRequestLatency.dump(fd, name);
+        // dump latency of the request thread stages: waiting for requests, preparing them
+        // and processCaptureRequest
+        void dumpCaptureRequestLatency(int fd) {
+            mRequestWaitLatency.dump(fd, "    Request wait latency histogram:");
+            mRequestPrepareLatency.dump(fd, "    Request prepare latency histogram:");
+            mRequestLatency.dump(fd, "    ProcessCaptureRequest latency histogram:");
         }
 
         void signalPipelineDrain(const std::vector<int>& streamIds);
@@ -1048,6 +1051,11 @@ class Camera3Device :
         // request batch.
         status_t prepareHalRequests();
 
+        // Get the output buffers of all requests in mNextRequests, with one call per stream
+        // for the buffers of all the requests of the batch. Return TIMED_OUT if getting any
+        // output buffer failed. Buffers already gotten are returned by cleanUpFailedRequests.
+        status_t getOutputBuffers(nsecs_t waitDuration);
+
         // Return buffers, etc, for requests in mNextRequests that couldn't be fully constructed and
         // send request errors if sendRequestError is true. The buffers will be returned in the
         // ERROR state to mark them as not having valid data. mNextRequests will be cleared.
@@ -1170,6 +1178,11 @@ class Camera3Device :
 
         static const int32_t kRequestLatencyBinSize = 40; // in ms
         CameraLatencyHistogram mRequestLatency;
+        // Waiting for the next batch of requests, when there is one, and preparing it,
+        // output buffers included
+        static const int32_t kRequestStageLatencyBinSize = 5; // in ms
+        CameraLatencyHistogram mRequestWaitLatency;
+        CameraLatencyHistogram mRequestPrepareLatency;
 
         Vector<int32_t>    mSessionParamKeys;
         CameraMetadata     mLatestSessionParams;
@@ -1303,6 +1316,8 @@ class Camera3Device :
     std::list<CaptureResult>    mResultQueue;
     std::condition_variable  mResultSignal;
     wp<NotificationListener> mListener;
+    // Buffers result metadata is assembled in
+    camera3::ResultMetadataPool mResultMetadataPool;
 
     /**** End scope for mOutputLock ****/
 
@@ -192,6 +192,8 @@ class Camera3OfflineSession :
     std::mutex mOutputLock;
     std::list<CaptureResult> mResultQueue;
     std::condition_variable mResultSignal;
+    // Buffers result metadata is assembled in
+    camera3::ResultMetadataPool mResultMetadataPool;
     // the last completed frame number of regular requests
     int64_t mLastCompletedRegularFrameNumber;
     // the last completed frame number of reprocess requests
@@ -241,10 +241,10 @@ status_t Camera3OutputStream::getBuffersLocked(std::vector<OutstandingBuffer>* o
         return res;
     }
 
-    if (mUseBufferManager) {
-        ALOGE("%s: stream %d is managed by buffer manager and does not support batch operation",
-                __FUNCTION__, mId);
-        return INVALID_OPERATION;
+    // Buffers from the buffer manager are attached one at a time, and batched
+    // streams already dequeue buffers in batches.
+    if (mUseBufferManager || mBatchSize.load() > 1 || outBuffers->size() == 1) {
+        return Camera3Stream::getBuffersLocked(outBuffers);
     }
 
     sp<Surface> consumer = mConsumer;
@@ -30,6 +30,7 @@
     "%s: " fmt, __FUNCTION__,                         \
     ##__VA_ARGS__)
 
+#include <algorithm>
 #include <inttypes.h>
 
 #include <utils/Log.h>
@@ -186,6 +187,83 @@ void correctMeteringRegions(camera_metadata_t *meta) {
     }
 }
 
+ResultMetadataPool::~ResultMetadataPool() {
+    for (camera_metadata_t *buffer : mFreeBuffers) {
+        free_camera_metadata(buffer);
+    }
+}
+
+camera_metadata_t* ResultMetadataPool::acquire(size_t entryCapacity, size_t dataCapacity) {
+    while (!mFreeBuffers.empty()) {
+        camera_metadata_t *buffer = mFreeBuffers.back();
+        mFreeBuffers.pop_back();
+        size_t bufferEntryCapacity = get_camera_metadata_entry_capacity(buffer);
+        size_t bufferDataCapacity = get_camera_metadata_data_capacity(buffer);
+        if (bufferEntryCapacity >= entryCapacity && bufferDataCapacity >= dataCapacity) {
+            // Reinitialize as an empty buffer of the same capacity
+            return place_camera_metadata(buffer, get_camera_metadata_size(buffer),
+                    bufferEntryCapacity, bufferDataCapacity);
+        }
+        // Too small; replace it with one large enough for both
+        entryCapacity = std::max(entryCapacity, bufferEntryCapacity);
+        dataCapacity = std::max(dataCapacity, bufferDataCapacity);
+        free_camera_metadata(buffer);
+    }
+    return allocate_camera_metadata(entryCapacity, dataCapacity);
+}
+
+void ResultMetadataPool::release(camera_metadata_t* buffer) {
+    if (buffer == nullptr) return;
+    if (mFreeBuffers.size() >= kMaxFreeBuffers) {
+        free_camera_metadata(buffer);
+        return;
+    }
+    mFreeBuffers.push_back(buffer);
+}
+
+// Room left in assembled result metadata for the tags the fixups add
+// (autoframing, zoom ratio, frame count, request id), so they do not regrow it.
+static constexpr size_t kResultExtraEntries = 8;
+static constexpr size_t kResultExtraData = 64;
+
+status_t ResultMetadataPool::assemble(const camera_metadata_t *metadata,
+        const CameraMetadata *partials, CameraMetadata *result) {
+    size_t entryCapacity = get_camera_metadata_entry_count(metadata) + kResultExtraEntries;
+    size_t dataCapacity = get_camera_metadata_data_count(metadata) + kResultExtraData;
+    if (partials != nullptr) {
+        const camera_metadata_t *partialBuffer = partials->getAndLock();
+        entryCapacity += get_camera_metadata_entry_count(partialBuffer);
+        dataCapacity += get_camera_metadata_data_count(partialBuffer);
+        partials->unlock(partialBuffer);
+    }
+
+    camera_metadata_t *buffer = acquire(entryCapacity, dataCapacity);
+    if (buffer == nullptr) {
+        return NO_MEMORY;
+    }
+    result->acquire(buffer);
+    // The mappers, the fixups and the tag monitor all look up tags in it
+    result->setTagIndexEnabled(true);
+
+    status_t res = result->append(metadata);
+    if (res == OK && partials != nullptr) {
+        res = result->append(*partials);
+    }
+    return res;
+}
+
+CaptureResult& ResultMetadataPool::queueResult(CaptureResult *result,
+        std::list<CaptureResult> *queue) {
+    CaptureResult& queuedResult = *queue->emplace(queue->end());
+    queuedResult.mResultExtras = result->mResultExtras;
+    const camera_metadata_t *assembled = result->mMetadata.getAndLock();
+    queuedResult.mMetadata = assembled;
+    result->mMetadata.unlock(assembled);
+    queuedResult.mPhysicalMetadatas = std::move(result->mPhysicalMetadatas);
+    release(result->mMetadata.release());
+    return queuedResult;
+}
+
 void insertResultLocked(CaptureOutputStates& states, CaptureResult *result, uint32_t frameNumber) {
     if (result == nullptr) return;
 
@@ -215,14 +293,14 @@ void insertResultLocked(CaptureOutputStates& states, CaptureResult *result, uint
         physicalMetadata.mPhysicalCameraMetadata.unlock(pmeta);
     }
 
-    // Valid result, insert into queue
-    std::list<CaptureResult>::iterator queuedResult =
-            states.resultQueue.insert(states.resultQueue.end(), CaptureResult(*result));
+    // Valid result, queue a compact copy of it and recycle the buffer it was assembled in
+    const CaptureResult& queuedResult =
+            states.resultMetadataPool.queueResult(result, &states.resultQueue);
     ALOGV("%s: result requestId = %" PRId32 ", frameNumber = %" PRId64
            ", burstId = %" PRId32, __FUNCTION__,
-           queuedResult->mResultExtras.requestId,
-           queuedResult->mResultExtras.frameNumber,
-           queuedResult->mResultExtras.burstId);
+           queuedResult.mResultExtras.requestId,
+           queuedResult.mResultExtras.frameNumber,
+           queuedResult.mResultExtras.burstId);
 
     states.resultSignal.notify_one();
 }
@@ -236,10 +314,15 @@ void sendPartialCaptureResult(CaptureOutputStates& states,
 
     CaptureResult captureResult;
     captureResult.mResultExtras = resultExtras;
-    captureResult.mMetadata = partialResult;
+    status_t res = states.resultMetadataPool.assemble(partialResult, /*partials*/nullptr,
+            &captureResult.mMetadata);
+    if (res != OK) {
+        SET_ERR("Failed to assemble partial result metadata: %s (%d)", strerror(-res), res);
+        return;
+    }
 
     // Fix up result metadata for monochrome camera.
-    status_t res = fixupMonochromeTags(states, states.deviceInfo, captureResult.mMetadata);
+    res = fixupMonochromeTags(states, states.deviceInfo, captureResult.mMetadata);
     if (res != OK) {
         SET_ERR("Failed to override result metadata: %s (%d)", strerror(-res), res);
         return;
@@ -271,20 +354,22 @@ void sendPartialCaptureResult(CaptureOutputStates& states,
     // Send partial result
     if (captureResult.mMetadata.entryCount() > 0) {
         insertResultLocked(states, &captureResult, frameNumber);
+    } else {
+        states.resultMetadataPool.release(captureResult.mMetadata.release());
     }
 }
 
 void sendCaptureResult(
         CaptureOutputStates& states,
-        CameraMetadata &pendingMetadata,
+        const camera_metadata_t *pendingMetadata,
         CaptureResultExtras &resultExtras,
         CameraMetadata &collectedPartialResult,
         uint32_t frameNumber,
         bool reprocess, bool zslStillCapture, bool rotateAndCropAuto,
         const std::set<std::string>& cameraIdsWithZoom,
-        const std::vector<PhysicalCaptureResultInfo>& physicalMetadatas) {
+        std::vector<PhysicalCaptureResultInfo>&& physicalMetadatas) {
     ATRACE_CALL();
-    if (pendingMetadata.isEmpty())
+    if (pendingMetadata == nullptr || get_camera_metadata_entry_count(pendingMetadata) == 0)
         return;
 
     std::lock_guard<std::mutex> l(states.outputLock);
@@ -318,12 +403,16 @@ void sendCaptureResult(
 
     CaptureResult captureResult;
     captureResult.mResultExtras = resultExtras;
-    captureResult.mMetadata = pendingMetadata;
-    captureResult.mPhysicalMetadatas = physicalMetadatas;
+    captureResult.mPhysicalMetadatas = std::move(physicalMetadatas);
 
     // Append any previous partials to form a complete result
-    if (states.usePartialResult && !collectedPartialResult.isEmpty()) {
-        captureResult.mMetadata.append(collectedPartialResult);
+    bool appendPartials = states.usePartialResult && !collectedPartialResult.isEmpty();
+    status_t res = states.resultMetadataPool.assemble(pendingMetadata,
+            appendPartials ? &collectedPartialResult : nullptr, &captureResult.mMetadata);
+    if (res != OK) {
+        SET_ERR("Failed to assemble result metadata for frame %d: %s (%d)",
+                frameNumber, strerror(-res), res);
+        return;
     }
 
     captureResult.mMetadata.sort();
@@ -347,8 +436,16 @@ void sendCaptureResult(
         }
     }
 
+    // The tag monitor records the physical metadata as sent by the HAL
+    std::unordered_map<std::string, CameraMetadata> monitoredPhysicalMetadata;
+    if (states.tagMonitor.isMonitoringEnabled()) {
+        for (auto& m : captureResult.mPhysicalMetadatas) {
+            monitoredPhysicalMetadata.emplace(String8(m.mPhysicalCameraId).string(),
+                    CameraMetadata(m.mPhysicalCameraMetadata));
+        }
+    }
+
     // Fix up some result metadata to account for HAL-level distortion correction
-    status_t res = OK;
     auto iter = states.distortionMappers.find(states.cameraId.c_str());
     if (iter != states.distortionMappers.end()) {
         res = iter->second.correctCaptureResult(&captureResult.mMetadata);
@@ -391,6 +488,15 @@ void sendCaptureResult(
                 strerror(-res), res);
         return;
     }
+
+    // Fix up result metadata for monochrome camera.
+    res = fixupMonochromeTags(states, states.deviceInfo, captureResult.mMetadata);
+    if (res != OK) {
+        SET_ERR("Failed to override result metadata: %s (%d)", strerror(-res), res);
+        return;
+    }
+
+    // Apply the same fixups to each physical camera's metadata in a single pass
     for (auto& physicalMetadata : captureResult.mPhysicalMetadatas) {
         res = fixupAutoframingTags(physicalMetadata.mPhysicalCameraMetadata);
         if (res != OK) {
@@ -398,9 +504,7 @@ void sendCaptureResult(
                     strerror(-res), res);
             return;
         }
-    }
 
-    for (auto& physicalMetadata : captureResult.mPhysicalMetadatas) {
         String8 cameraId8(physicalMetadata.mPhysicalCameraId);
         auto mapper = states.distortionMappers.find(cameraId8.c_str());
         if (mapper != states.distortionMappers.end()) {
@@ -421,16 +525,7 @@ void sendCaptureResult(
                     "frame %d: %s(%d)", cameraId8.c_str(), frameNumber, strerror(-res), res);
             return;
         }
-    }
 
-    // Fix up result metadata for monochrome camera.
-    res = fixupMonochromeTags(states, states.deviceInfo, captureResult.mMetadata);
-    if (res != OK) {
-        SET_ERR("Failed to override result metadata: %s (%d)", strerror(-res), res);
-        return;
-    }
-    for (auto& physicalMetadata : captureResult.mPhysicalMetadatas) {
-        String8 cameraId8(physicalMetadata.mPhysicalCameraId);
         res = fixupMonochromeTags(states,
                 states.physicalDeviceInfoMap.at(cameraId8.c_str()),
                 physicalMetadata.mPhysicalCameraMetadata);
@@ -440,11 +535,6 @@ void sendCaptureResult(
         }
     }
 
-    std::unordered_map<std::string, CameraMetadata> monitoredPhysicalMetadata;
-    for (auto& m : physicalMetadatas) {
-        monitoredPhysicalMetadata.emplace(String8(m.mPhysicalCameraId).string(),
-                CameraMetadata(m.mPhysicalCameraMetadata));
-    }
     states.tagMonitor.monitorMetadata(TagMonitor::RESULT,
             frameNumber, sensorTimestamp, captureResult.mMetadata,
             monitoredPhysicalMetadata);
@@ -541,13 +631,15 @@ bool erasePhysicalCameraIdSet(
 }
 
 const std::set<std::string>& getCameraIdsWithZoomLocked(
-        const InFlightRequestMap& inflightMap, const CameraMetadata& metadata,
+        const InFlightRequestMap& inflightMap, const camera_metadata_t* metadata,
         const std::set<std::string>& cameraIdsWithZoom) {
-    camera_metadata_ro_entry overrideEntry =
-            metadata.find(ANDROID_CONTROL_SETTINGS_OVERRIDE);
-    camera_metadata_ro_entry frameNumberEntry =
-            metadata.find(ANDROID_CONTROL_SETTINGS_OVERRIDING_FRAME_NUMBER);
-    if (overrideEntry.count != 1
+    camera_metadata_ro_entry overrideEntry;
+    camera_metadata_ro_entry frameNumberEntry;
+    if (find_camera_metadata_ro_entry(metadata,
+                ANDROID_CONTROL_SETTINGS_OVERRIDE, &overrideEntry) != OK
+            || find_camera_metadata_ro_entry(metadata,
+                ANDROID_CONTROL_SETTINGS_OVERRIDING_FRAME_NUMBER, &frameNumberEntry) != OK
+            || overrideEntry.count != 1
             || overrideEntry.data.i32[0] != ANDROID_CONTROL_SETTINGS_OVERRIDE_ZOOM
             || frameNumberEntry.count != 1) {
         // No valid overriding frame number, skip
@@ -775,15 +867,13 @@ void processCaptureResult(CaptureOutputStates& states, const camera_capture_resu
                 request.pendingMetadata = result->result;
                 request.collectedPartialResult = collectedPartialResult;
             } else if (request.hasCallback) {
-                CameraMetadata metadata;
-                metadata = result->result;
                 auto cameraIdsWithZoom = getCameraIdsWithZoomLocked(
-                        states.inflightMap, metadata, request.cameraIdsWithZoom);
-                sendCaptureResult(states, metadata, request.resultExtras,
+                        states.inflightMap, result->result, request.cameraIdsWithZoom);
+                sendCaptureResult(states, result->result, request.resultExtras,
                     collectedPartialResult, frameNumber,
                     hasInputBufferInRequest, request.zslCapture && request.stillCapture,
                     request.rotateAndCropAuto, cameraIdsWithZoom,
-                    request.physicalMetadatas);
+                    std::move(request.physicalMetadatas));
             }
         }
         removeInFlightRequestIfReadyLocked(states, idx);
@@ -1009,13 +1099,15 @@ void notifyShutter(CaptureOutputStates& states, const camera_shutter_msg_t &msg)
                     states.listener->notifyShutter(r.resultExtras, msg.timestamp);
                 }
                 // send pending result and buffers
+                const camera_metadata_t *pendingMetadata = r.pendingMetadata.getAndLock();
                 const auto& cameraIdsWithZoom = getCameraIdsWithZoomLocked(
-                        inflightMap, r.pendingMetadata, r.cameraIdsWithZoom);
+                        inflightMap, pendingMetadata, r.cameraIdsWithZoom);
                 sendCaptureResult(states,
-                    r.pendingMetadata, r.resultExtras,
+                    pendingMetadata, r.resultExtras,
                     r.collectedPartialResult, msg.frame_number,
                     r.hasInputBuffer, r.zslCapture && r.stillCapture,
-                    r.rotateAndCropAuto, cameraIdsWithZoom, r.physicalMetadatas);
+                    r.rotateAndCropAuto, cameraIdsWithZoom, std::move(r.physicalMetadatas));
+                r.pendingMetadata.unlock(pendingMetadata);
             }
             returnAndRemovePendingOutputBuffers(
                     states.useHalBufManager, states.listener, r, states.sessionStatsBuilder);
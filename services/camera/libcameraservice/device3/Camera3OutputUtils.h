@@ -17,6 +17,7 @@
 #ifndef ANDROID_SERVERS_CAMERA3_OUTPUT_UTILS_H
 #define ANDROID_SERVERS_CAMERA3_OUTPUT_UTILS_H
 
+#include <list>
 #include <memory>
 #include <mutex>
 
@@ -68,6 +69,38 @@ namespace camera3 {
             sp<NotificationListener> listener, // Only needed when outputSurfaces is not empty
             InFlightRequest& request, SessionStatsBuilder& sessionStatsBuilder);
 
+    // Recycles the buffers capture result metadata is assembled and fixed up in, before a
+    // compact copy of it is queued for the client. Buffers keep the capacity of the largest
+    // result seen, so steady-state result assembly does not reallocate.
+    // Not thread-safe; only used with the output lock held.
+    class ResultMetadataPool {
+      public:
+        ResultMetadataPool() = default;
+        ~ResultMetadataPool();
+
+        ResultMetadataPool(const ResultMetadataPool&) = delete;
+        ResultMetadataPool& operator=(const ResultMetadataPool&) = delete;
+
+        // Get an empty metadata buffer with room for at least the given entries and data
+        camera_metadata_t* acquire(size_t entryCapacity, size_t dataCapacity);
+
+        // Return a buffer for reuse; it need not come from acquire()
+        void release(camera_metadata_t* buffer);
+
+        // Assemble |metadata|, plus |partials| if not null, into a buffer from the pool that
+        // |result| then holds. The buffer has room left for the tags the result fixups add.
+        status_t assemble(const camera_metadata_t* metadata, const CameraMetadata* partials,
+                CameraMetadata* result);
+
+        // Queue a compact copy of |result| at the end of |queue|, moving its physical
+        // metadata, and take back the buffer its metadata was assembled in
+        CaptureResult& queueResult(CaptureResult* result, std::list<CaptureResult>* queue);
+
+      private:
+        static constexpr size_t kMaxFreeBuffers = 2;
+        std::vector<camera_metadata_t*> mFreeBuffers;
+    };
+
     // Camera3Device/Camera3OfflineSession internal states used in notify/processCaptureResult
     // callbacks
     struct CaptureOutputStates {
@@ -109,6 +142,7 @@ namespace camera3 {
         bool& isFixedFps;
         bool overrideToPortrait;
         std::string &activePhysicalId;
+        ResultMetadataPool& resultMetadataPool; // guarded by outputLock
     };
 
     void processCaptureResult(CaptureOutputStates& states, const camera_capture_result *result);
@@ -119,6 +119,19 @@ status_t Camera3SharedOutputStream::notifyBufferReleased(ANativeWindowBuffer *an
     return res;
 }
 
+void Camera3SharedOutputStream::dump(int fd, const Vector<String16> &args) const {
+    Camera3OutputStream::dump(fd, args);
+
+    sp<Camera3StreamSplitter> splitter;
+    {
+        Mutex::Autolock l(mLock);
+        splitter = mStreamSplitter;
+    }
+    if (splitter != nullptr) {
+        splitter->dump(fd);
+    }
+}
+
 bool Camera3SharedOutputStream::isConsumerConfigurationDeferred(size_t surface_id) const {
     Mutex::Autolock l(mLock);
     if (surface_id >= kMaxOutputs) {
@@ -191,6 +204,10 @@ status_t Camera3SharedOutputStream::getBufferLocked(camera_stream_buffer *buffer
     return OK;
 }
 
+status_t Camera3SharedOutputStream::getBuffersLocked(std::vector<OutstandingBuffer>* buffers) {
+    return Camera3Stream::getBuffersLocked(buffers);
+}
+
 status_t Camera3SharedOutputStream::queueBufferToConsumer(sp<ANativeWindow>& consumer,
             ANativeWindowBuffer* buffer, int anwReleaseFence,
             const std::vector<size_t>& uniqueSurfaceIds) {
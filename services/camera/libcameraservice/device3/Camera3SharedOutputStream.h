@@ -51,6 +51,8 @@ public:
 
     virtual ~Camera3SharedOutputStream();
 
+    virtual void dump(int fd, const Vector<String16> &args) const;
+
     virtual status_t notifyBufferReleased(ANativeWindowBuffer *buffer);
 
     virtual bool isConsumerConfigurationDeferred(size_t surface_id) const;
@@ -127,6 +129,9 @@ private:
     virtual status_t getBufferLocked(camera_stream_buffer *buffer,
             const std::vector<size_t>& surface_ids);
 
+    // Each buffer is attached to the splitter for its own surfaces
+    virtual status_t getBuffersLocked(std::vector<OutstandingBuffer>* buffers) override;
+
     virtual status_t queueBufferToConsumer(sp<ANativeWindow>& consumer,
             ANativeWindowBuffer* buffer, int anwReleaseFence,
             const std::vector<size_t>& uniqueSurfaceIds);
@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+#include <unistd.h>
 #include <vector>
 #include "system/window.h"
 #define LOG_TAG "Camera3-Stream"
@@ -967,9 +968,30 @@ status_t Camera3Stream::getBufferLocked(camera_stream_buffer *,
     return INVALID_OPERATION;
 }
 
-status_t Camera3Stream::getBuffersLocked(std::vector<OutstandingBuffer>*) {
-    ALOGE("%s: This type of stream does not support output", __FUNCTION__);
-    return INVALID_OPERATION;
+status_t Camera3Stream::getBuffersLocked(std::vector<OutstandingBuffer>* buffers) {
+    // One buffer at a time, for the streams that can't get several at once
+    for (size_t i = 0; i < buffers->size(); i++) {
+        OutstandingBuffer& outstandingBuffer = buffers->at(i);
+        status_t res = getBufferLocked(outstandingBuffer.outBuffer,
+                outstandingBuffer.surface_ids);
+        if (res != OK) {
+            // Give back the buffers already gotten, so that no buffer is handed
+            // out on error
+            for (size_t j = 0; j < i; j++) {
+                camera_stream_buffer* buffer = buffers->at(j).outBuffer;
+                if (buffer->acquire_fence >= 0) {
+                    close(buffer->acquire_fence);
+                    buffer->acquire_fence = -1;
+                }
+                buffer->status = CAMERA_BUFFER_STATUS_ERROR;
+                returnBufferLocked(*buffer, /*timestamp*/0, /*readoutTimestamp*/0,
+                        /*transform*/-1, buffers->at(j).surface_ids);
+                buffer->buffer = nullptr;
+            }
+            return res;
+        }
+    }
+    return OK;
 }
 
 status_t Camera3Stream::returnBufferLocked(const camera_stream_buffer &,
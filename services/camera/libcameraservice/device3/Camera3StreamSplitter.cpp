@@ -143,6 +143,7 @@ void Camera3StreamSplitter::disconnect() {
     mOutputSurfaces.clear();
     mOutputSlots.clear();
     mConsumerBufferCount.clear();
+    mOutputStats.clear();
 
     if (mConsumer.get() != nullptr) {
         mConsumer->consumerDisconnect();
@@ -261,6 +262,22 @@ status_t Camera3StreamSplitter::addOutputLocked(size_t surfaceId, const sp<Surfa
         return res;
     }
 
+    // Preview outputs going to the display drop frames instead of holding back
+    // the other outputs when their consumer falls behind. In async mode, queued
+    // buffers get replaced, and attachBuffer returns WOULD_BLOCK instead of
+    // waiting for the consumer. GPU only consumers may need every frame, so they
+    // keep blocking.
+    DropPolicy dropPolicy = DropPolicy::BLOCK;
+    if ((usage & GRALLOC_USAGE_HW_COMPOSER) && !(usage & GRALLOC_USAGE_HW_VIDEO_ENCODER)) {
+        res = gbp->setAsyncMode(true);
+        if (res == OK) {
+            dropPolicy = DropPolicy::DROP_OLDEST;
+        } else {
+            SP_LOGW("%s: Failed to enable async mode for surfaceId %zu: %s (%d)",
+                    __FUNCTION__, surfaceId, strerror(-res), res);
+        }
+    }
+
     // Add new entry into mOutputs
     mOutputs[surfaceId] = gbp;
     mOutputSurfaces[surfaceId] = outputQueue;
@@ -271,6 +288,8 @@ status_t Camera3StreamSplitter::addOutputLocked(size_t surfaceId, const sp<Surfa
     }
     mNotifiers[gbp] = listener;
     mOutputSlots[gbp] = std::make_unique<OutputSlots>(totalBufferCount);
+    mOutputStats.erase(surfaceId);
+    mOutputStats[surfaceId].dropPolicy = dropPolicy;
 
     mMaxConsumerBuffers += maxConsumerBuffers;
     return NO_ERROR;
@@ -343,6 +362,7 @@ status_t Camera3StreamSplitter::removeOutputLocked(size_t surfaceId) {
     mNotifiers[gbp] = nullptr;
     mMaxConsumerBuffers -= mConsumerBufferCount[surfaceId];
     mConsumerBufferCount[surfaceId] = 0;
+    mOutputStats.erase(surfaceId);
 
     return res;
 }
@@ -402,6 +422,10 @@ status_t Camera3StreamSplitter::outputBufferLocked(const sp<IGraphicBufferProduc
     // queue, no onBufferReleased is called by the buffer queue.
     // Proactively trigger the callback to avoid buffer loss.
     if (queueOutput.bufferReplaced) {
+        auto stats = mOutputStats.find(surfaceId);
+        if (stats != mOutputStats.end()) {
+            stats->second.replacedCount++;
+        }
         onBufferReplacedLocked(output, surfaceId);
     }
 
@@ -453,9 +477,32 @@ status_t Camera3StreamSplitter::attachBufferToOutputs(ANativeWindowBuffer* anb,
         //queue, because attachBuffer could block in case of a slow consumer. If
         //we block while holding the lock, onFrameAvailable and onBufferReleased
         //will block as well because they need to acquire the same lock.
+        nsecs_t attachStart = systemTime();
         mMutex.unlock();
         res = gbp->attachBuffer(&slot, gb);
         mMutex.lock();
+        nsecs_t attachEnd = systemTime();
+
+        auto stats = mOutputStats.find(surface_id);
+        if (stats != mOutputStats.end()) {
+            OutputStats& outputStats = stats->second;
+            if (res == WOULD_BLOCK && outputStats.dropPolicy == DropPolicy::DROP_OLDEST) {
+                // The consumer holds all of its buffers, skip this frame for
+                // the output rather than wait.
+                SP_LOGV("%s: Dropping buffer %p for output %p", __FUNCTION__, gb.get(),
+                        gbp.get());
+                tracker->decrementReferenceCountLocked(surface_id);
+                outputStats.droppedCount++;
+                res = OK;
+                continue;
+            }
+            if (res == OK) {
+                outputStats.attachLatency.add(attachStart, attachEnd);
+                outputStats.maxAttachLatency = std::max(outputStats.maxAttachLatency,
+                        attachEnd - attachStart);
+                outputStats.attachedCount++;
+            }
+        }
         if (res != OK) {
             SP_LOGE("%s: Cannot attachBuffer from GraphicBufferProducer %p: %s (%d)",
                     __FUNCTION__, gbp.get(), strerror(-res), res);
@@ -535,6 +582,13 @@ void Camera3StreamSplitter::onFrameAvailable(const BufferItem& /*item*/) {
 
     // Attach and queue the buffer to each of the outputs
     BufferTracker& tracker = *(mBuffers[bufferId]);
+    if (tracker.requestedSurfaces().empty()) {
+        // Every output dropped this buffer when it was attached
+        SP_LOGV("%s: No output for buffer %" PRId64, __FUNCTION__, bufferId);
+        returnInputBufferLocked(bufferId);
+        mOnFrameAvailableRes.store(OK);
+        return;
+    }
 
     SP_LOGV("%s: BufferTracker for buffer %" PRId64 ", number of requests %zu",
            __FUNCTION__, bufferItem.mGraphicBuffer->getId(), tracker.requestedSurfaces().size());
@@ -575,6 +629,12 @@ void Camera3StreamSplitter::decrementBufRefCountLocked(uint64_t id, size_t surfa
         return;
     }
 
+    returnInputBufferLocked(id);
+}
+
+void Camera3StreamSplitter::returnInputBufferLocked(uint64_t id) {
+    ATRACE_CALL();
+
     // We no longer need to track the buffer now that it is being returned to the
     // input. Note that this should happen before we unlock the mutex and call
     // releaseBuffer, to avoid the case where the same bufferId is acquired in
@@ -756,6 +816,26 @@ void Camera3StreamSplitter::onAbandonedLocked() {
     SP_LOGV("One of my outputs has abandoned me");
 }
 
+void Camera3StreamSplitter::dump(int fd) {
+    Mutex::Autolock lock(mMutex);
+
+    String8 lines;
+    lines.appendFormat("      Splitter %s: %zu acquired input buffers\n", mConsumerName.string(),
+            mAcquiredInputBuffers);
+    write(fd, lines.string(), lines.size());
+
+    for (const auto& it : mOutputStats) {
+        const OutputStats& stats = it.second;
+        lines = String8::format("        Surface %d (%s): %" PRIu64 " attached, %" PRIu64
+                " dropped, %" PRIu64 " replaced, max attach latency %" PRId64 " us\n",
+                it.first, stats.dropPolicy == DropPolicy::DROP_OLDEST ? "drop oldest" : "block",
+                stats.attachedCount, stats.droppedCount, stats.replacedCount,
+                ns2us(stats.maxAttachLatency));
+        write(fd, lines.string(), lines.size());
+        stats.attachLatency.dump(fd, "          AttachBuffer latency histogram:");
+    }
+}
+
 int Camera3StreamSplitter::getSlotForOutputLocked(const sp<IGraphicBufferProducer>& gbp,
         const sp<GraphicBuffer>& gb) {
     auto& outputSlots = *mOutputSlots[gbp];
@@ -30,6 +30,8 @@
 #include <utils/StrongPointer.h>
 #include <utils/Timers.h>
 
+#include "utils/LatencyHistogram.h"
+
 #define SP_LOGV(x, ...) ALOGV("[%s] " x, mConsumerName.string(), ##__VA_ARGS__)
 #define SP_LOGI(x, ...) ALOGI("[%s] " x, mConsumerName.string(), ##__VA_ARGS__)
 #define SP_LOGW(x, ...) ALOGW("[%s] " x, mConsumerName.string(), ##__VA_ARGS__)
@@ -94,6 +96,9 @@ public:
     // Disconnect the buffer queue from output surfaces.
     void disconnect();
 
+    // Dump the buffer flow statistics of each output.
+    void dump(int fd);
+
 private:
     // From IConsumerListener
     //
@@ -146,6 +151,9 @@ private:
     // 0, return the buffer back to the input BufferQueue.
     void decrementBufRefCountLocked(uint64_t id, size_t surfaceId);
 
+    // Stop tracking the buffer and return it back to the input BufferQueue.
+    void returnInputBufferLocked(uint64_t id);
+
     // Check for and handle any output surface dequeue errors.
     void handleOutputDequeueStatusLocked(status_t res, int slot);
 
@@ -228,6 +236,32 @@ private:
     int getSlotForOutputLocked(const sp<IGraphicBufferProducer>& gbp,
             const sp<GraphicBuffer>& gb);
 
+    static const int32_t kAttachLatencyBinSizeMs = 1;
+
+    // How an output behaves when its consumer holds all of its buffers
+    enum class DropPolicy {
+        // Block the attach until the consumer releases a buffer, holding back
+        // the other outputs.
+        BLOCK,
+        // Replace the oldest buffer the consumer has not acquired yet, or skip
+        // the frame for this output if there is none.
+        DROP_OLDEST,
+    };
+
+    // Buffer flow statistics of one output
+    struct OutputStats {
+        OutputStats() : attachLatency(kAttachLatencyBinSizeMs) {}
+
+        DropPolicy dropPolicy = DropPolicy::BLOCK;
+        CameraLatencyHistogram attachLatency;
+        nsecs_t maxAttachLatency = 0;
+        uint64_t attachedCount = 0;
+        // Frames skipped because no buffer could be attached
+        uint64_t droppedCount = 0;
+        // Queued buffers replaced before the consumer acquired them
+        uint64_t replacedCount = 0;
+    };
+
     // Sum of max consumer buffers for all outputs
     size_t mMaxConsumerBuffers = 0;
     size_t mMaxHalBuffers = 0;
@@ -261,6 +295,9 @@ private:
     //Map surface ids -> consumer buffer count
     std::unordered_map<int, size_t > mConsumerBufferCount;
 
+    //Map surface ids -> output statistics
+    std::unordered_map<int, OutputStats> mOutputStats;
+
     // Map of GraphicBuffer IDs (GraphicBuffer::getId()) to buffer tracking
     // objects (which are mostly for counting how many outputs have released the
     // buffer, but also contain merged release fences).
@@ -287,7 +324,7 @@ private:
     std::atomic<status_t> mOnFrameAvailableRes{0};
 
     // Currently acquired input buffers
-    size_t mAcquiredInputBuffers;
+    size_t mAcquiredInputBuffers = 0;
 
     String8 mConsumerName;
 
@@ -278,7 +278,8 @@ status_t DistortionMapper::mapRawToCorrected(int32_t *coordPairs, int coordCount
     }
 
     for (int i = 0; i < coordCount * 2; i += 2) {
-        const GridQuad *quad = findEnclosingQuad(coordPairs + i, mapperInfo->mDistortedGrid);
+        const GridQuad *quad = findEnclosingQuad(coordPairs + i, mapperInfo->mDistortedGrid,
+                mapperInfo->mDistortedGridIndex);
         if (quad == nullptr) {
             ALOGE("Raw to corrected mapping failure: No quad found for (%d, %d)",
                     *(coordPairs + i), *(coordPairs + i + 1));
@@ -487,48 +488,174 @@ status_t DistortionMapper::buildGrids(DistortionMapperInfo *mapperInfo) {
             if (res != OK) return res;
         }
     }
+    buildGridIndex(mapperInfo->mDistortedGrid, kGridIndexSize, &mapperInfo->mDistortedGridIndex);
 
     mapperInfo->mValidGrids = true;
     return OK;
 }
 
+// Cross product of edge P1->P2 and line P1->P; negative if P is to the right of the edge
+static inline float edgeSide(float x, float y, float x1, float y1, float x2, float y2) {
+    return (x - x1) * (y2 - y1) - (y - y1) * (x2 - x1);
+}
+
+static bool isPointInQuad(float x, float y, const DistortionMapper::GridQuad& quad) {
+    const float &x1 = quad.coords[0];
+    const float &y1 = quad.coords[1];
+    const float &x2 = quad.coords[2];
+    const float &y2 = quad.coords[3];
+    const float &x3 = quad.coords[4];
+    const float &y3 = quad.coords[5];
+    const float &x4 = quad.coords[6];
+    const float &y4 = quad.coords[7];
+
+    // Point-in-quad test:
+
+    // Quad has corners P1-P4; if P is within the quad, then it is on the same side of all the
+    // edges (or on top of one of the edges or corners), traversed in a consistent direction.
+    // This means that the cross product of edge En = Pn->P(n+1 mod 4) and line Ep = Pn->P must
+    // have the same sign (or be zero) for all edges.
+    // For clockwise traversal, the sign should be negative or zero for Ep x En, indicating that
+    // En is to the left of Ep, or overlapping.
+    if (edgeSide(x, y, x1, y1, x2, y2) > 0) return false;
+    if (edgeSide(x, y, x2, y2, x3, y3) > 0) return false;
+    if (edgeSide(x, y, x3, y3, x4, y4) > 0) return false;
+    if (edgeSide(x, y, x4, y4, x1, y1) > 0) return false;
+    return true;
+}
+
+// Whether all corners are on the inner side of every edge. Only then is the region accepted by
+// isPointInQuad() the quad itself, and so within the quad's bounding box.
+static bool isConvexClockwiseQuad(const DistortionMapper::GridQuad& quad) {
+    for (size_t edge = 0; edge < 4; edge++) {
+        const float *p1 = &quad.coords[edge * 2];
+        const float *p2 = &quad.coords[((edge + 1) % 4) * 2];
+        for (size_t corner = 0; corner < 4; corner++) {
+            const float *p = &quad.coords[corner * 2];
+            if (edgeSide(p[0], p[1], p1[0], p1[1], p2[0], p2[1]) > 0) return false;
+        }
+    }
+    return true;
+}
+
+static inline size_t gridIndexCell(float v, float min, float invCellSize, size_t cellCount) {
+    return std::min(cellCount - 1, static_cast<size_t>((v - min) * invCellSize));
+}
+
 const DistortionMapper::GridQuad* DistortionMapper::findEnclosingQuad(
         const int32_t pt[2], const std::vector<GridQuad>& grid) {
     const float x = pt[0];
     const float y = pt[1];
 
     for (const GridQuad& quad : grid) {
-        const float &x1 = quad.coords[0];
-        const float &y1 = quad.coords[1];
-        const float &x2 = quad.coords[2];
-        const float &y2 = quad.coords[3];
-        const float &x3 = quad.coords[4];
-        const float &y3 = quad.coords[5];
-        const float &x4 = quad.coords[6];
-        const float &y4 = quad.coords[7];
-
-        // Point-in-quad test:
-
-        // Quad has corners P1-P4; if P is within the quad, then it is on the same side of all the
-        // edges (or on top of one of the edges or corners), traversed in a consistent direction.
-        // This means that the cross product of edge En = Pn->P(n+1 mod 4) and line Ep = Pn->P must
-        // have the same sign (or be zero) for all edges.
-        // For clockwise traversal, the sign should be negative or zero for Ep x En, indicating that
-        // En is to the left of Ep, or overlapping.
-        float s1 = (x - x1) * (y2 - y1) - (y - y1) * (x2 - x1);
-        if (s1 > 0) continue;
-        float s2 = (x - x2) * (y3 - y2) - (y - y2) * (x3 - x2);
-        if (s2 > 0) continue;
-        float s3 = (x - x3) * (y4 - y3) - (y - y3) * (x4 - x3);
-        if (s3 > 0) continue;
-        float s4 = (x - x4) * (y1 - y4) - (y - y4) * (x1 - x4);
-        if (s4 > 0) continue;
-
-        return &quad;
+        if (isPointInQuad(x, y, quad)) {
+            return &quad;
+        }
+    }
+    return nullptr;
+}
+
+const DistortionMapper::GridQuad* DistortionMapper::findEnclosingQuad(
+        const int32_t pt[2], const std::vector<GridQuad>& grid, const GridIndex& index) {
+    if (index.mCellCount == 0) {
+        return findEnclosingQuad(pt, grid);
+    }
+
+    const float x = pt[0];
+    const float y = pt[1];
+    if (x < index.mMinX || x > index.mMaxX || y < index.mMinY || y > index.mMaxY) {
+        return nullptr;
+    }
+
+    size_t cell = gridIndexCell(y, index.mMinY, index.mInvCellHeight, index.mCellCount) *
+            index.mCellCount +
+            gridIndexCell(x, index.mMinX, index.mInvCellWidth, index.mCellCount);
+    for (uint32_t i = index.mCellStart[cell]; i < index.mCellStart[cell + 1]; i++) {
+        const GridQuad& quad = grid[index.mQuads[i]];
+        if (isPointInQuad(x, y, quad)) {
+            return &quad;
+        }
     }
     return nullptr;
 }
 
+void DistortionMapper::buildGridIndex(const std::vector<GridQuad>& grid, size_t cellCount,
+        GridIndex *index) {
+    // Bounding boxes are padded so that rounding in the point-in-quad test can't accept a
+    // point just outside of them
+    constexpr float kBoundsPadding = 1.f;
+
+    index->mCellCount = 0;
+    index->mCellStart.clear();
+    index->mQuads.clear();
+    if (grid.empty() || grid.size() > UINT16_MAX || cellCount == 0) return;
+
+    float minX = grid[0].coords[0], maxX = minX;
+    float minY = grid[0].coords[1], maxY = minY;
+    for (const GridQuad& quad : grid) {
+        // A folded quad can contain points outside of its bounding box; leave the grid to the
+        // exhaustive search
+        if (!isConvexClockwiseQuad(quad)) {
+            ALOGV("%s: grid has a non-convex quad, not indexing", __FUNCTION__);
+            return;
+        }
+        for (size_t i = 0; i < 8; i += 2) {
+            minX = std::min(minX, quad.coords[i]);
+            maxX = std::max(maxX, quad.coords[i]);
+            minY = std::min(minY, quad.coords[i + 1]);
+            maxY = std::max(maxY, quad.coords[i + 1]);
+        }
+    }
+    index->mMinX = minX - kBoundsPadding;
+    index->mMaxX = maxX + kBoundsPadding;
+    index->mMinY = minY - kBoundsPadding;
+    index->mMaxY = maxY + kBoundsPadding;
+    index->mInvCellWidth = cellCount / (index->mMaxX - index->mMinX);
+    index->mInvCellHeight = cellCount / (index->mMaxY - index->mMinY);
+
+    // Cell ranges covered by each quad's padded bounding box
+    auto cellRange = [&](const GridQuad& quad, size_t *x0, size_t *x1, size_t *y0, size_t *y1) {
+        float qMinX = quad.coords[0], qMaxX = qMinX;
+        float qMinY = quad.coords[1], qMaxY = qMinY;
+        for (size_t i = 2; i < 8; i += 2) {
+            qMinX = std::min(qMinX, quad.coords[i]);
+            qMaxX = std::max(qMaxX, quad.coords[i]);
+            qMinY = std::min(qMinY, quad.coords[i + 1]);
+            qMaxY = std::max(qMaxY, quad.coords[i + 1]);
+        }
+        *x0 = gridIndexCell(qMinX - kBoundsPadding, index->mMinX, index->mInvCellWidth, cellCount);
+        *x1 = gridIndexCell(qMaxX + kBoundsPadding, index->mMinX, index->mInvCellWidth, cellCount);
+        *y0 = gridIndexCell(qMinY - kBoundsPadding, index->mMinY, index->mInvCellHeight, cellCount);
+        *y1 = gridIndexCell(qMaxY + kBoundsPadding, index->mMinY, index->mInvCellHeight, cellCount);
+    };
+
+    // Count the quads of each cell, then fill the cells in grid order
+    index->mCellStart.assign(cellCount * cellCount + 1, 0);
+    size_t x0, x1, y0, y1;
+    for (const GridQuad& quad : grid) {
+        cellRange(quad, &x0, &x1, &y0, &y1);
+        for (size_t cy = y0; cy <= y1; cy++) {
+            for (size_t cx = x0; cx <= x1; cx++) {
+                index->mCellStart[cy * cellCount + cx + 1]++;
+            }
+        }
+    }
+    for (size_t cell = 0; cell < cellCount * cellCount; cell++) {
+        index->mCellStart[cell + 1] += index->mCellStart[cell];
+    }
+    index->mQuads.resize(index->mCellStart.back());
+    std::vector<uint32_t> fill(index->mCellStart.begin(), index->mCellStart.end() - 1);
+    for (size_t q = 0; q < grid.size(); q++) {
+        cellRange(grid[q], &x0, &x1, &y0, &y1);
+        for (size_t cy = y0; cy <= y1; cy++) {
+            for (size_t cx = x0; cx <= x1; cx++) {
+                index->mQuads[fill[cy * cellCount + cx]++] = static_cast<uint16_t>(q);
+            }
+        }
+    }
+    index->mCellCount = cellCount;
+}
+
 float DistortionMapper::calculateUorV(const int32_t pt[2], const GridQuad& quad, bool calculateU) {
     const float x = pt[0];
     const float y = pt[1];
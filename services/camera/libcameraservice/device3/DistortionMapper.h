@@ -20,6 +20,7 @@
 #include <utils/Errors.h>
 #include <array>
 #include <mutex>
+#include <vector>
 
 #include "camera/CameraMetadata.h"
 #include "device3/CoordinateMapper.h"
@@ -135,6 +136,19 @@ class DistortionMapper : public CoordinateMapper {
         std::array<float, 8> coords;
     };
 
+    // Uniform bucket index over a grid of quads. Each cell lists, in grid order, the quads whose
+    // bounding box overlaps the cell, so a point is only tested against the quads of its cell.
+    struct GridIndex {
+        float mMinX = 0, mMinY = 0;
+        float mMaxX = -1, mMaxY = -1;
+        float mInvCellWidth = 0, mInvCellHeight = 0;
+        // Cells in each dimension; 0 if the index is unusable and the grid must be searched
+        size_t mCellCount = 0;
+        // Quads of cell c are mQuads[mCellStart[c]] to mQuads[mCellStart[c + 1] - 1]
+        std::vector<uint32_t> mCellStart;
+        std::vector<uint16_t> mQuads;
+    };
+
     struct DistortionMapperInfo {
         bool mValidMapping = false;
         bool mValidGrids = false;
@@ -155,12 +169,22 @@ class DistortionMapper : public CoordinateMapper {
 
         std::vector<GridQuad> mCorrectedGrid;
         std::vector<GridQuad> mDistortedGrid;
+        GridIndex mDistortedGridIndex;
     };
 
     // Find which grid quad encloses the point; returns null if none do
     static const GridQuad* findEnclosingQuad(
             const int32_t pt[2], const std::vector<GridQuad>& grid);
 
+    // Same as above, only testing the quads listed in the grid index for the point's cell.
+    // Returns the same quad as the exhaustive search.
+    static const GridQuad* findEnclosingQuad(
+            const int32_t pt[2], const std::vector<GridQuad>& grid, const GridIndex& index);
+
+    // Build the bucket index for a grid, with cellCount x cellCount cells
+    static void buildGridIndex(const std::vector<GridQuad>& grid, size_t cellCount,
+            GridIndex *index);
+
     // Calculate 'horizontal' interpolation coordinate for the point and the quad
     // Assumes the point P is within the quad Q.
     // Given quad with points P1-P4, and edges E12-E41, and considering the edge segments as
@@ -184,6 +208,8 @@ class DistortionMapper : public CoordinateMapper {
 
     // Number of quads in each dimension of the mapping grids
     constexpr static size_t kGridSize = 15;
+    // Number of grid index cells in each dimension; about one distorted quad per cell
+    constexpr static size_t kGridIndexSize = kGridSize;
     // Margin to expand the grid by to ensure it doesn't clip the domain
     constexpr static float kGridMargin = 0.05f;
     // Fuzziness for float inequality tests
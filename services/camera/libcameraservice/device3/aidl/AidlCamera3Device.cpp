@@ -380,7 +380,7 @@ status_t AidlCamera3Device::initialize(sp<CameraProviderManager> manager,
         mDistortionMappers, mZoomRatioMappers, mRotateAndCropMappers,
         mTagMonitor, mInputStream, mOutputStreams, mSessionStatsBuilder, listener, *this,
         *this, *(mInterface), mLegacyClient, mMinExpectedDuration, mIsFixedFps,
-        mOverrideToPortrait, mActivePhysicalId}, mResultMetadataQueue
+        mOverrideToPortrait, mActivePhysicalId, mResultMetadataPool}, mResultMetadataQueue
     };
 
     for (const auto& result : results) {
@@ -422,7 +422,7 @@ status_t AidlCamera3Device::initialize(sp<CameraProviderManager> manager,
         mDistortionMappers, mZoomRatioMappers, mRotateAndCropMappers,
         mTagMonitor, mInputStream, mOutputStreams, mSessionStatsBuilder, listener, *this,
         *this, *(mInterface), mLegacyClient, mMinExpectedDuration, mIsFixedFps,
-        mOverrideToPortrait, mActivePhysicalId}, mResultMetadataQueue
+        mOverrideToPortrait, mActivePhysicalId, mResultMetadataPool}, mResultMetadataQueue
     };
     for (const auto& msg : msgs) {
         camera3::notify(states, msg);
@@ -382,7 +382,7 @@ hardware::Return<void> HidlCamera3Device::processCaptureResult_3_4(
         mDistortionMappers, mZoomRatioMappers, mRotateAndCropMappers,
         mTagMonitor, mInputStream, mOutputStreams, mSessionStatsBuilder, listener, *this, *this,
         *mInterface, mLegacyClient, mMinExpectedDuration, mIsFixedFps, mOverrideToPortrait,
-        mActivePhysicalId}, mResultMetadataQueue
+        mActivePhysicalId, mResultMetadataPool}, mResultMetadataQueue
     };
 
     //HidlCaptureOutputStates hidlStates {
@@ -445,7 +445,7 @@ hardware::Return<void> HidlCamera3Device::processCaptureResult(
         mDistortionMappers, mZoomRatioMappers, mRotateAndCropMappers,
         mTagMonitor, mInputStream, mOutputStreams, mSessionStatsBuilder, listener, *this, *this,
         *mInterface, mLegacyClient, mMinExpectedDuration, mIsFixedFps, mOverrideToPortrait,
-        mActivePhysicalId}, mResultMetadataQueue
+        mActivePhysicalId, mResultMetadataPool}, mResultMetadataQueue
     };
 
     for (const auto& result : results) {
@@ -493,7 +493,7 @@ hardware::Return<void> HidlCamera3Device::notifyHelper(
         mDistortionMappers, mZoomRatioMappers, mRotateAndCropMappers,
         mTagMonitor, mInputStream, mOutputStreams, mSessionStatsBuilder, listener, *this, *this,
         *mInterface, mLegacyClient, mMinExpectedDuration, mIsFixedFps, mOverrideToPortrait,
-        mActivePhysicalId}, mResultMetadataQueue
+        mActivePhysicalId, mResultMetadataPool}, mResultMetadataQueue
     };
     for (const auto& msg : msgs) {
         camera3::notify(states, msg);
@@ -0,0 +1,219 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_NDEBUG 0
+#define LOG_TAG "Camera3OutputStreamTest"
+
+#include <gtest/gtest.h>
+
+#include <set>
+#include <vector>
+
+#include <gui/BufferItemConsumer.h>
+#include <gui/BufferQueue.h>
+#include <gui/Surface.h>
+#include <hardware/gralloc.h>
+#include <system/camera_metadata.h>
+
+#include "../device3/Camera3OutputStream.h"
+
+using namespace android;
+using namespace android::camera3;
+
+constexpr uint32_t kWidth = 64;
+constexpr uint32_t kHeight = 64;
+constexpr int kFormat = HAL_PIXEL_FORMAT_RGBA_8888;
+constexpr uint32_t kMaxBuffers = 4;
+constexpr nsecs_t kWaitBufferTimeout = 1000000000LL; // 1 sec
+
+// Gets its buffers one at a time, as the streams that can't dequeue several at
+// once do, and fails to get the buffer of call mFailAt
+class OneAtATimeOutputStream : public Camera3OutputStream {
+  public:
+    OneAtATimeOutputStream(int id, sp<Surface> consumer) :
+            Camera3OutputStream(id, consumer, kWidth, kHeight, kFormat, HAL_DATASPACE_UNKNOWN,
+                    CAMERA_STREAM_ROTATION_0, /*timestampOffset*/0, String8(),
+                    {ANDROID_SENSOR_PIXEL_MODE_DEFAULT}, IPCTransport::HIDL) {}
+
+    size_t mFailAt = SIZE_MAX;
+    size_t mGetBufferCalls = 0;
+
+  private:
+    status_t getBufferLocked(camera_stream_buffer *buffer,
+            const std::vector<size_t>&) override {
+        if (mGetBufferCalls++ == mFailAt) {
+            return TIMED_OUT;
+        }
+        ANativeWindowBuffer* anb;
+        int fenceFd = -1;
+        status_t res = getBufferLockedCommon(&anb, &fenceFd);
+        if (res != OK) {
+            return res;
+        }
+        handoutBufferLocked(*buffer, &(anb->handle), /*acquireFence*/fenceFd,
+                /*releaseFence*/-1, CAMERA_BUFFER_STATUS_OK, /*output*/true);
+        return OK;
+    }
+
+    status_t getBuffersLocked(std::vector<OutstandingBuffer>* buffers) override {
+        return Camera3Stream::getBuffersLocked(buffers);
+    }
+};
+
+class Camera3OutputStreamTest : public ::testing::Test {
+  protected:
+    void TearDown() override {
+        if (mStream != nullptr) {
+            mStream->disconnect();
+        }
+    }
+
+    sp<Surface> createConsumer() {
+        sp<IGraphicBufferProducer> producer;
+        sp<IGraphicBufferConsumer> consumer;
+        BufferQueue::createBufferQueue(&producer, &consumer);
+        mConsumer = new BufferItemConsumer(consumer, GRALLOC_USAGE_SW_READ_OFTEN,
+                /*bufferCount*/ 1);
+        return new Surface(producer);
+    }
+
+    void configure(const sp<Camera3OutputStream>& stream) {
+        mStream = stream;
+        camera_stream* halStream = mStream->startConfiguration();
+        ASSERT_NE(nullptr, halStream);
+        halStream->max_buffers = kMaxBuffers;
+        ASSERT_EQ(OK, mStream->finishConfiguration());
+    }
+
+    void createStream() {
+        ASSERT_NO_FATAL_FAILURE(configure(new Camera3OutputStream(/*id*/0, createConsumer(),
+                kWidth, kHeight, kFormat, HAL_DATASPACE_UNKNOWN, CAMERA_STREAM_ROTATION_0,
+                /*timestampOffset*/0, String8(), {ANDROID_SENSOR_PIXEL_MODE_DEFAULT},
+                IPCTransport::HIDL)));
+    }
+
+    // Get count buffers with one getBuffers() call, as the request thread does
+    // for the requests of a batch
+    status_t getBuffers(size_t count) {
+        mBuffers.assign(count, camera_stream_buffer_t());
+        std::vector<Camera3StreamInterface::OutstandingBuffer> outstandingBuffers;
+        for (auto& buffer : mBuffers) {
+            outstandingBuffers.push_back({&buffer, /*surface_ids*/{}});
+        }
+        return mStream->getBuffers(&outstandingBuffers, kWaitBufferTimeout);
+    }
+
+    void returnBuffers(camera_buffer_status_t status) {
+        nsecs_t timestamp = systemTime();
+        for (auto& buffer : mBuffers) {
+            buffer.status = status;
+            buffer.release_fence = -1;
+            ASSERT_EQ(OK, mStream->returnBuffer(buffer, timestamp, timestamp,
+                    /*timestampIncreasing*/true));
+            timestamp++;
+        }
+        mBuffers.clear();
+    }
+
+    sp<BufferItemConsumer> mConsumer;
+    sp<Camera3OutputStream> mStream;
+    std::vector<camera_stream_buffer_t> mBuffers;
+};
+
+TEST_F(Camera3OutputStreamTest, GetBuffersOfBatchAtOnce) {
+    ASSERT_NO_FATAL_FAILURE(createStream());
+
+    ASSERT_EQ(OK, getBuffers(kMaxBuffers));
+    EXPECT_EQ(kMaxBuffers, mStream->getOutstandingBuffersCount());
+    std::set<buffer_handle_t> handles;
+    for (const auto& buffer : mBuffers) {
+        ASSERT_NE(nullptr, buffer.buffer);
+        EXPECT_EQ(CAMERA_BUFFER_STATUS_OK, buffer.status);
+        EXPECT_EQ(mStream->asHalStream(), buffer.stream);
+        handles.insert(*buffer.buffer);
+    }
+    EXPECT_EQ(kMaxBuffers, handles.size());
+
+    // Buffers returned with OK status are queued to the consumer
+    ASSERT_NO_FATAL_FAILURE(returnBuffers(CAMERA_BUFFER_STATUS_OK));
+    EXPECT_EQ(0u, mStream->getOutstandingBuffersCount());
+    BufferItem item;
+    ASSERT_EQ(OK, mConsumer->acquireBuffer(&item, /*presentWhen*/ 0));
+    EXPECT_EQ(OK, mConsumer->releaseBuffer(item));
+}
+
+TEST_F(Camera3OutputStreamTest, GetBuffersAgainOnceReturned) {
+    ASSERT_NO_FATAL_FAILURE(createStream());
+
+    for (int i = 0; i < 3; i++) {
+        ASSERT_EQ(OK, getBuffers(kMaxBuffers));
+        EXPECT_EQ(kMaxBuffers, mStream->getOutstandingBuffersCount());
+        ASSERT_NO_FATAL_FAILURE(returnBuffers(CAMERA_BUFFER_STATUS_ERROR));
+        EXPECT_EQ(0u, mStream->getOutstandingBuffersCount());
+    }
+    EXPECT_FALSE(mStream->hasOutstandingBuffers());
+}
+
+TEST_F(Camera3OutputStreamTest, GetBuffersOneAtATime) {
+    sp<OneAtATimeOutputStream> stream = new OneAtATimeOutputStream(/*id*/0, createConsumer());
+    ASSERT_NO_FATAL_FAILURE(configure(stream));
+
+    ASSERT_EQ(OK, getBuffers(kMaxBuffers));
+    EXPECT_EQ(kMaxBuffers, stream->mGetBufferCalls);
+    EXPECT_EQ(kMaxBuffers, stream->getOutstandingBuffersCount());
+    for (const auto& buffer : mBuffers) {
+        EXPECT_NE(nullptr, buffer.buffer);
+    }
+    ASSERT_NO_FATAL_FAILURE(returnBuffers(CAMERA_BUFFER_STATUS_ERROR));
+}
+
+TEST_F(Camera3OutputStreamTest, FailedGetBuffersReturnsBuffersGotten) {
+    sp<OneAtATimeOutputStream> stream = new OneAtATimeOutputStream(/*id*/0, createConsumer());
+    ASSERT_NO_FATAL_FAILURE(configure(stream));
+
+    const size_t kFailAt = 2;
+    stream->mFailAt = kFailAt;
+    EXPECT_EQ(TIMED_OUT, getBuffers(kMaxBuffers));
+    EXPECT_EQ(kFailAt + 1, stream->mGetBufferCalls);
+
+    // Nothing is left handed out, and the buffers gotten before the failure
+    // were taken back from the caller
+    EXPECT_EQ(0u, stream->getOutstandingBuffersCount());
+    EXPECT_FALSE(stream->hasOutstandingBuffers());
+    for (const auto& buffer : mBuffers) {
+        EXPECT_EQ(nullptr, buffer.buffer);
+        EXPECT_EQ(-1, buffer.acquire_fence);
+    }
+
+    // The returned buffers never reach the consumer, and can be gotten again
+    BufferItem item;
+    EXPECT_EQ(IGraphicBufferConsumer::NO_BUFFER_AVAILABLE,
+            mConsumer->acquireBuffer(&item, /*presentWhen*/ 0));
+    stream->mFailAt = SIZE_MAX;
+    ASSERT_EQ(OK, getBuffers(kMaxBuffers));
+    EXPECT_EQ(kMaxBuffers, stream->getOutstandingBuffersCount());
+    ASSERT_NO_FATAL_FAILURE(returnBuffers(CAMERA_BUFFER_STATUS_ERROR));
+}
+
+TEST_F(Camera3OutputStreamTest, FailedFirstGetBufferHandsOutNothing) {
+    sp<OneAtATimeOutputStream> stream = new OneAtATimeOutputStream(/*id*/0, createConsumer());
+    ASSERT_NO_FATAL_FAILURE(configure(stream));
+
+    stream->mFailAt = 0;
+    EXPECT_EQ(TIMED_OUT, getBuffers(kMaxBuffers));
+    EXPECT_EQ(1u, stream->mGetBufferCalls);
+    EXPECT_EQ(0u, stream->getOutstandingBuffersCount());
+}
@@ -0,0 +1,266 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_NDEBUG 0
+#define LOG_TAG "Camera3StreamSplitterTest"
+
+#include <gtest/gtest.h>
+
+#include <cinttypes>
+#include <cstdint>
+#include <map>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <android-base/file.h>
+#include <gui/BufferItemConsumer.h>
+#include <gui/BufferQueue.h>
+#include <gui/Surface.h>
+#include <hardware/gralloc.h>
+#include <system/camera_metadata.h>
+#include <ui/GraphicBuffer.h>
+
+#include "../device3/Camera3StreamSplitter.h"
+
+using namespace android;
+
+constexpr uint32_t kWidth = 64;
+constexpr uint32_t kHeight = 64;
+constexpr PixelFormat kFormat = PIXEL_FORMAT_RGBA_8888;
+constexpr size_t kMaxHalBuffers = 8;
+constexpr uint64_t kProducerUsage = GRALLOC_USAGE_SW_WRITE_OFTEN;
+// Union of the consumer usages of all outputs, as the shared output stream sets it
+constexpr uint64_t kConsumerUsage = GRALLOC_USAGE_HW_COMPOSER | GRALLOC_USAGE_HW_TEXTURE;
+
+constexpr size_t kPreviewSurface = 0;
+constexpr size_t kTextureSurface = 1;
+
+// Statistics of one output as printed by Camera3StreamSplitter::dump()
+struct DumpedOutputStats {
+    std::string policy;
+    uint64_t attached = 0;
+    uint64_t dropped = 0;
+    uint64_t replaced = 0;
+};
+
+class Camera3StreamSplitterTest : public ::testing::Test {
+  protected:
+    struct Output {
+        sp<Surface> surface;
+        sp<BufferItemConsumer> consumer;
+    };
+
+    void TearDown() override {
+        if (mInput != nullptr) {
+            native_window_api_disconnect(mInput.get(), NATIVE_WINDOW_API_CAMERA);
+        }
+        if (mSplitter != nullptr) {
+            mSplitter->disconnect();
+        }
+    }
+
+    // An output whose consumer never acquires buffers unless the test does. It is
+    // kept until the splitter is disconnected.
+    Output createOutput(uint64_t consumerUsage) {
+        sp<IGraphicBufferProducer> producer;
+        sp<IGraphicBufferConsumer> consumer;
+        BufferQueue::createBufferQueue(&producer, &consumer);
+        Output output;
+        output.consumer = new BufferItemConsumer(consumer, consumerUsage, /*bufferCount*/ 1);
+        output.surface = new Surface(producer);
+        mOutputs.push_back(output);
+        return output;
+    }
+
+    void connect(const std::unordered_map<size_t, sp<Surface>> &surfaces) {
+        mSplitter = new Camera3StreamSplitter();
+        ASSERT_EQ(OK, mSplitter->connect(surfaces, kConsumerUsage, kProducerUsage,
+                kMaxHalBuffers, kWidth, kHeight, kFormat, &mInput,
+                ANDROID_REQUEST_AVAILABLE_DYNAMIC_RANGE_PROFILES_MAP_STANDARD));
+        ASSERT_EQ(OK, native_window_api_connect(mInput.get(), NATIVE_WINDOW_API_CAMERA));
+        ASSERT_EQ(OK, native_window_set_buffers_dimensions(mInput.get(), kWidth, kHeight));
+        ASSERT_EQ(OK, native_window_set_buffers_format(mInput.get(), kFormat));
+        ASSERT_EQ(OK, native_window_set_usage(mInput.get(), kProducerUsage | kConsumerUsage));
+    }
+
+    // Attach standalone buffers to an output until all of its slots are taken
+    void fillOutput(size_t surfaceId) {
+        for (int i = 0; i < BufferQueue::NUM_BUFFER_SLOTS; i++) {
+            sp<GraphicBuffer> buffer = new GraphicBuffer(kWidth, kHeight, kFormat,
+                    /*layerCount*/ 1, kProducerUsage | kConsumerUsage, LOG_TAG);
+            ASSERT_EQ(OK, buffer->initCheck());
+            ASSERT_EQ(OK, mSplitter->attachBufferToOutputs(buffer->getNativeBuffer(),
+                    {surfaceId}));
+            mStandaloneBuffers.push_back(buffer);
+        }
+    }
+
+    // Send one frame from the input to the given outputs, the way the shared
+    // output stream does
+    void sendFrame(const std::vector<size_t> &surfaceIds) {
+        ANativeWindowBuffer *anb = nullptr;
+        ASSERT_EQ(OK, native_window_dequeue_buffer_and_wait(mInput.get(), &anb));
+        ASSERT_EQ(OK, mSplitter->attachBufferToOutputs(anb, surfaceIds));
+        ASSERT_EQ(OK, mInput->queueBuffer(mInput.get(), anb, /*fenceFd*/ -1));
+        ASSERT_EQ(OK, mSplitter->getOnFrameAvailableResult());
+    }
+
+    std::map<int, DumpedOutputStats> dumpStats(size_t *acquiredInputBuffers) {
+        TemporaryFile dumpFile;
+        mSplitter->dump(dumpFile.fd);
+        std::string dump;
+        EXPECT_TRUE(base::ReadFileToString(dumpFile.path, &dump));
+
+        std::map<int, DumpedOutputStats> stats;
+        std::istringstream lines(dump);
+        std::string line;
+        while (std::getline(lines, line)) {
+            size_t acquired;
+            if (sscanf(line.c_str(), " Splitter %*[^:]: %zu acquired", &acquired) == 1) {
+                *acquiredInputBuffers = acquired;
+                continue;
+            }
+            int surfaceId;
+            char policy[32];
+            DumpedOutputStats output;
+            if (sscanf(line.c_str(), " Surface %d (%31[^)]): %" SCNu64 " attached, %" SCNu64
+                    " dropped, %" SCNu64 " replaced", &surfaceId, policy, &output.attached,
+                    &output.dropped, &output.replaced) == 5) {
+                output.policy = policy;
+                stats[surfaceId] = output;
+            }
+        }
+        return stats;
+    }
+
+    sp<Camera3StreamSplitter> mSplitter;
+    sp<Surface> mInput;
+    std::vector<Output> mOutputs;
+    std::vector<sp<GraphicBuffer>> mStandaloneBuffers;
+};
+
+TEST_F(Camera3StreamSplitterTest, OnlyPreviewOutputsDropFrames) {
+    Output preview = createOutput(GRALLOC_USAGE_HW_COMPOSER | GRALLOC_USAGE_HW_TEXTURE);
+    Output texture = createOutput(GRALLOC_USAGE_HW_TEXTURE);
+    Output encoder = createOutput(GRALLOC_USAGE_HW_COMPOSER | GRALLOC_USAGE_HW_VIDEO_ENCODER);
+    ASSERT_NO_FATAL_FAILURE(connect({{0, preview.surface}, {1, texture.surface},
+            {2, encoder.surface}}));
+
+    size_t acquired;
+    std::map<int, DumpedOutputStats> stats = dumpStats(&acquired);
+    ASSERT_EQ(3u, stats.size());
+    EXPECT_EQ("drop oldest", stats[0].policy);
+    EXPECT_EQ("block", stats[1].policy);
+    EXPECT_EQ("block", stats[2].policy);
+}
+
+TEST_F(Camera3StreamSplitterTest, FullPreviewOutputSkipsFrame) {
+    Output preview = createOutput(GRALLOC_USAGE_HW_COMPOSER);
+    ASSERT_NO_FATAL_FAILURE(connect({{kPreviewSurface, preview.surface}}));
+    ASSERT_NO_FATAL_FAILURE(fillOutput(kPreviewSurface));
+
+    // Attaching to the full output would block, so the frame is skipped instead
+    sp<GraphicBuffer> buffer = new GraphicBuffer(kWidth, kHeight, kFormat, /*layerCount*/ 1,
+            kProducerUsage | kConsumerUsage, LOG_TAG);
+    ASSERT_EQ(OK, buffer->initCheck());
+    EXPECT_EQ(OK, mSplitter->attachBufferToOutputs(buffer->getNativeBuffer(),
+            {kPreviewSurface}));
+
+    size_t acquired;
+    std::map<int, DumpedOutputStats> stats = dumpStats(&acquired);
+    ASSERT_EQ(1u, stats.size());
+    EXPECT_EQ((uint64_t)BufferQueue::NUM_BUFFER_SLOTS, stats[kPreviewSurface].attached);
+    EXPECT_EQ(1u, stats[kPreviewSurface].dropped);
+    EXPECT_EQ(0u, stats[kPreviewSurface].replaced);
+}
+
+TEST_F(Camera3StreamSplitterTest, FrameDroppedByAllOutputsReturnsToInput) {
+    Output preview = createOutput(GRALLOC_USAGE_HW_COMPOSER);
+    ASSERT_NO_FATAL_FAILURE(connect({{kPreviewSurface, preview.surface}}));
+    ASSERT_NO_FATAL_FAILURE(fillOutput(kPreviewSurface));
+
+    ASSERT_NO_FATAL_FAILURE(sendFrame({kPreviewSurface}));
+
+    // The input buffer is released right away, and no frame reaches the output
+    size_t acquired = SIZE_MAX;
+    std::map<int, DumpedOutputStats> stats = dumpStats(&acquired);
+    EXPECT_EQ(0u, acquired);
+    EXPECT_EQ(1u, stats[kPreviewSurface].dropped);
+    BufferItem item;
+    EXPECT_EQ(IGraphicBufferConsumer::NO_BUFFER_AVAILABLE,
+            preview.consumer->acquireBuffer(&item, /*presentWhen*/ 0));
+
+    // The released buffer can be dequeued for the next frame
+    ASSERT_NO_FATAL_FAILURE(sendFrame({kPreviewSurface}));
+    stats = dumpStats(&acquired);
+    EXPECT_EQ(0u, acquired);
+    EXPECT_EQ(2u, stats[kPreviewSurface].dropped);
+}
+
+TEST_F(Camera3StreamSplitterTest, FullPreviewOutputDoesNotHoldBackOthers) {
+    Output preview = createOutput(GRALLOC_USAGE_HW_COMPOSER);
+    Output texture = createOutput(GRALLOC_USAGE_HW_TEXTURE);
+    ASSERT_NO_FATAL_FAILURE(connect({{kPreviewSurface, preview.surface},
+            {kTextureSurface, texture.surface}}));
+    ASSERT_NO_FATAL_FAILURE(fillOutput(kPreviewSurface));
+
+    ASSERT_NO_FATAL_FAILURE(sendFrame({kPreviewSurface, kTextureSurface}));
+
+    size_t acquired = SIZE_MAX;
+    std::map<int, DumpedOutputStats> stats = dumpStats(&acquired);
+    EXPECT_EQ(1u, acquired);
+    EXPECT_EQ(1u, stats[kPreviewSurface].dropped);
+    EXPECT_EQ(0u, stats[kTextureSurface].dropped);
+    EXPECT_EQ(1u, stats[kTextureSurface].attached);
+
+    BufferItem item;
+    EXPECT_EQ(IGraphicBufferConsumer::NO_BUFFER_AVAILABLE,
+            preview.consumer->acquireBuffer(&item, /*presentWhen*/ 0));
+    ASSERT_EQ(OK, texture.consumer->acquireBuffer(&item, /*presentWhen*/ 0));
+
+    // Once the only output that got the frame releases it, it returns to the input
+    ASSERT_EQ(OK, texture.consumer->releaseBuffer(item));
+    stats = dumpStats(&acquired);
+    EXPECT_EQ(0u, acquired);
+}
+
+TEST_F(Camera3StreamSplitterTest, PreviewOutputReplacesPendingFrame) {
+    Output preview = createOutput(GRALLOC_USAGE_HW_COMPOSER);
+    ASSERT_NO_FATAL_FAILURE(connect({{kPreviewSurface, preview.surface}}));
+
+    const size_t kFrames = 3;
+    for (size_t i = 0; i < kFrames; i++) {
+        ASSERT_NO_FATAL_FAILURE(sendFrame({kPreviewSurface}));
+    }
+
+    // Each frame replaced the one before it, which went back to the input
+    size_t acquired = SIZE_MAX;
+    std::map<int, DumpedOutputStats> stats = dumpStats(&acquired);
+    EXPECT_EQ(1u, acquired);
+    EXPECT_EQ(0u, stats[kPreviewSurface].dropped);
+    EXPECT_EQ(kFrames - 1, stats[kPreviewSurface].replaced);
+
+    // Only the latest frame is left for the consumer
+    BufferItem item;
+    ASSERT_EQ(OK, preview.consumer->acquireBuffer(&item, /*presentWhen*/ 0));
+    EXPECT_EQ(OK, preview.consumer->releaseBuffer(item));
+    EXPECT_EQ(IGraphicBufferConsumer::NO_BUFFER_AVAILABLE,
+            preview.consumer->acquireBuffer(&item, /*presentWhen*/ 0));
+    stats = dumpStats(&acquired);
+    EXPECT_EQ(0u, acquired);
+}
@@ -0,0 +1,175 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <camera/CameraMetadata.h>
+
+using namespace android;
+
+// Tags the result path looks up in every capture result: Camera3Device's mappers and
+// fixups, FrameProcessor and the default tag monitor set.
+static const uint32_t kHotTags[] = {
+    ANDROID_SENSOR_TIMESTAMP,
+    ANDROID_CONTROL_AE_REGIONS,
+    ANDROID_CONTROL_AF_REGIONS,
+    ANDROID_CONTROL_AWB_REGIONS,
+    ANDROID_CONTROL_AE_STATE,
+    ANDROID_CONTROL_AF_STATE,
+    ANDROID_CONTROL_AWB_STATE,
+    ANDROID_CONTROL_ZOOM_RATIO,
+    ANDROID_SCALER_CROP_REGION,
+    ANDROID_STATISTICS_FACE_DETECT_MODE,
+    ANDROID_STATISTICS_FACE_RECTANGLES,
+    ANDROID_STATISTICS_FACE_LANDMARKS,
+    ANDROID_LENS_STATE,
+    ANDROID_LENS_FOCAL_LENGTH,
+    ANDROID_LENS_FOCUS_DISTANCE,
+    ANDROID_SENSOR_EXPOSURE_TIME,
+    ANDROID_SENSOR_SENSITIVITY,
+    ANDROID_SENSOR_FRAME_DURATION,
+};
+
+// Tags looked up that HALs usually leave out of results
+static const uint32_t kAbsentTags[] = {
+    ANDROID_CONTROL_SETTINGS_OVERRIDE,
+    ANDROID_CONTROL_AUTOFRAMING,
+    ANDROID_DISTORTION_CORRECTION_MODE,
+    ANDROID_SCALER_ROTATE_AND_CROP,
+};
+
+// Capture result with the hot tags and other tags up to entryCount entries
+static CameraMetadata makeResult(size_t entryCount, bool sorted) {
+    std::vector<uint32_t> tags(std::begin(kHotTags), std::end(kHotTags));
+    for (uint32_t section = 0; section < ANDROID_SECTION_COUNT; section++) {
+        for (uint32_t tag = section << 16; get_camera_metadata_tag_type(tag) != -1; tag++) {
+            if (std::find(std::begin(kAbsentTags), std::end(kAbsentTags), tag) ==
+                    std::end(kAbsentTags) && std::find(tags.begin(), tags.end(), tag) ==
+                    tags.end()) {
+                tags.push_back(tag);
+            }
+        }
+    }
+    tags.resize(std::min(tags.size(), entryCount));
+
+    // HALs fill results in no particular order
+    std::reverse(tags.begin(), tags.end());
+    CameraMetadata result(tags.size(), tags.size() * 32);
+    const uint8_t data[64] = {};
+    for (uint32_t tag : tags) {
+        camera_metadata_ro_entry entry;
+        entry.tag = tag;
+        entry.type = get_camera_metadata_tag_type(tag);
+        entry.count = 4;
+        entry.data.u8 = data;
+        result.update(entry);
+    }
+    if (sorted) {
+        result.sort();
+    }
+    return result;
+}
+
+static void lookupTags(const CameraMetadata &result) {
+    for (uint32_t tag : kHotTags) {
+        benchmark::DoNotOptimize(result.find(tag));
+    }
+    for (uint32_t tag : kAbsentTags) {
+        benchmark::DoNotOptimize(result.find(tag));
+    }
+}
+
+// Lookups in a result with or without the tag index, sorted or not
+static void BM_Find(benchmark::State& state) {
+    const bool indexed = state.range(0);
+    CameraMetadata result = makeResult(state.range(2), /*sorted*/state.range(1));
+    result.setTagIndexEnabled(indexed);
+
+    for (auto _ : state) {
+        lookupTags(result);
+    }
+    state.counters["lookups/s"] = benchmark::Counter(
+            (double)state.iterations() * (std::size(kHotTags) + std::size(kAbsentTags)),
+            benchmark::Counter::kIsRate);
+}
+
+// The pattern of sendCaptureResult() and the frame processor on one result: sort it,
+// look up the tags the mappers use, add the tags the fixups add, then look up the
+// tags again. The index is built once per result.
+static void BM_ResultMetadata(benchmark::State& state) {
+    const bool indexed = state.range(0);
+    const CameraMetadata halResult = makeResult(state.range(1), /*sorted*/false);
+    const int32_t frameNumber = 1;
+    const float zoomRatio = 1.f;
+    const uint8_t autoframing = ANDROID_CONTROL_AUTOFRAMING_OFF;
+
+    for (auto _ : state) {
+        CameraMetadata result(halResult);
+        result.setTagIndexEnabled(indexed);
+        result.sort();
+        lookupTags(result);
+        result.update(ANDROID_CONTROL_AUTOFRAMING, &autoframing, 1);
+        result.update(ANDROID_CONTROL_ZOOM_RATIO, &zoomRatio, 1);
+        result.update(ANDROID_REQUEST_FRAME_COUNT, &frameNumber, 1);
+        result.update(ANDROID_REQUEST_ID, &frameNumber, 1);
+        lookupTags(result);
+        benchmark::ClobberMemory();
+    }
+    state.counters["results/s"] = benchmark::Counter(
+            (double)state.iterations(), benchmark::Counter::kIsRate);
+}
+
+// Keeping the latest settings sent to the HAL while the zoom ratio and crop region of a
+// repeating request change every frame, as during a pinch: a copy of the whole
+// settings, or of the entries that changed only.
+static void BM_LatestRequest(benchmark::State& state) {
+    const bool delta = state.range(0);
+    CameraMetadata settings = makeResult(state.range(1), /*sorted*/true);
+    CameraMetadata latest(settings);
+    float zoomRatio = 1.f;
+    int32_t cropRegion[4] = {0, 0, 4000, 3000};
+
+    for (auto _ : state) {
+        zoomRatio += 0.01f;
+        cropRegion[0]++;
+        settings.update(ANDROID_CONTROL_ZOOM_RATIO, &zoomRatio, 1);
+        settings.update(ANDROID_SCALER_CROP_REGION, cropRegion, 4);
+
+        const camera_metadata_t *buffer = settings.getAndLock();
+        if (delta) {
+            latest.updateFrom(buffer);
+        } else {
+            latest.acquire(clone_camera_metadata(buffer));
+        }
+        settings.unlock(buffer);
+        benchmark::ClobberMemory();
+    }
+    state.counters["frames/s"] = benchmark::Counter(
+            (double)state.iterations(), benchmark::Counter::kIsRate);
+}
+
+BENCHMARK(BM_Find)
+        ->ArgNames({"indexed", "sorted", "entries"})
+        ->ArgsProduct({{0, 1}, {0, 1}, {32, 128}});
+BENCHMARK(BM_ResultMetadata)
+        ->ArgNames({"indexed", "entries"})
+        ->ArgsProduct({{0, 1}, {32, 128}});
+BENCHMARK(BM_LatestRequest)
+        ->ArgNames({"delta", "entries"})
+        ->ArgsProduct({{0, 1}, {32, 128}});
@@ -22,9 +22,11 @@
 #include <android/hidl/manager/1.0/IServiceNotification.h>
 #include <android/hardware/camera/device/3.2/ICameraDeviceCallback.h>
 #include <android/hardware/camera/device/3.2/ICameraDeviceSession.h>
+#include <android-base/file.h>
 #include <camera_metadata_hidden.h>
 #include <hidl/HidlBinderSupport.h>
 #include <gtest/gtest.h>
+#include <atomic>
 #include <utility>
 
 using namespace android;
@@ -43,6 +45,8 @@ using android::hardware::camera::provider::V2_5::DeviceState;
 struct TestDeviceInterface : public device::V3_2::ICameraDevice {
     std::vector<hardware::hidl_string> mDeviceNames;
     android::hardware::hidl_vec<uint8_t> mCharacteristics;
+    // Devices may be initialized concurrently
+    std::atomic<int> mGetCharacteristicsCount = 0;
 
     TestDeviceInterface(std::vector<hardware::hidl_string> deviceNames,
             android::hardware::hidl_vec<uint8_t> chars) :
@@ -67,6 +71,7 @@ struct TestDeviceInterface : public device::V3_2::ICameraDevice {
             const hardware::hidl_vec<uint8_t>& cameraCharacteristics)>;
     hardware::Return<void> getCameraCharacteristics(
             getCameraCharacteristics_cb _hidl_cb) override {
+        mGetCharacteristicsCount++;
         _hidl_cb(Status::OK, mCharacteristics);
         return hardware::Void();
     }
@@ -713,3 +718,114 @@ TEST(CameraProviderManagerTest, PhysicalCameraAvailabilityCallbackRaceTest) {
     ASSERT_TRUE(unavailablePhysicalIds.count("0") > 0 && unavailablePhysicalIds["0"].count("2") > 0)
         << "Unavailable physical camera Ids not set properly.";
 }
+
+// Test that all devices of a provider are added when there are more of them than
+// device initialization threads, in the order the provider listed them.
+TEST(CameraProviderManagerTest, ParallelDeviceInitTest) {
+    // Not sorted, so that the order the ids come back in is the listed one
+    std::vector<std::string> ids;
+    std::vector<hardware::hidl_string> deviceNames;
+    for (int i = 0; i < 10; i++) {
+        ids.push_back(std::to_string(i * 7 % 10));
+        deviceNames.push_back("device@3.2/test/" + ids.back());
+    }
+    hardware::hidl_vec<common::V1_0::VendorTagSection> vendorSection;
+
+    sp<CameraProviderManager> providerManager = new CameraProviderManager();
+    sp<TestStatusListener> statusListener = new TestStatusListener();
+    TestInteractionProxy serviceProxy;
+    sp<TestICameraProvider> provider = new TestICameraProvider(deviceNames,
+            vendorSection);
+    serviceProxy.setProvider(provider);
+
+    status_t res = providerManager->initialize(statusListener, &serviceProxy);
+    ASSERT_EQ(res, OK) << "Unable to initialize provider manager";
+
+    auto deviceInterface = static_cast<TestDeviceInterface*>(provider->mDeviceInterface.get());
+    EXPECT_EQ(deviceInterface->mGetCharacteristicsCount, static_cast<int>(deviceNames.size()))
+            << "Characteristics of every device expected to be queried once";
+
+    std::unordered_map<std::string, std::set<std::string>> unavailablePhysicalIds;
+    auto cameraIds = providerManager->getCameraDeviceIds(&unavailablePhysicalIds);
+    EXPECT_EQ(cameraIds, ids) << "Camera devices expected in the order they were listed";
+}
+
+// Test that a device listed again with the same id and major version is rejected,
+// even though the devices of the list are initialized before any of them is added.
+TEST(CameraProviderManagerTest, DuplicateInitialDeviceTest) {
+    std::vector<hardware::hidl_string> deviceNames;
+    deviceNames.push_back("device@3.2/test/0");
+    deviceNames.push_back("device@3.2/test/1");
+    deviceNames.push_back("device@3.3/test/0");
+    deviceNames.push_back("device@3.2/test/1");
+    hardware::hidl_vec<common::V1_0::VendorTagSection> vendorSection;
+
+    sp<CameraProviderManager> providerManager = new CameraProviderManager();
+    sp<TestStatusListener> statusListener = new TestStatusListener();
+    TestInteractionProxy serviceProxy;
+    sp<TestICameraProvider> provider = new TestICameraProvider(deviceNames,
+            vendorSection);
+    serviceProxy.setProvider(provider);
+
+    status_t res = providerManager->initialize(statusListener, &serviceProxy);
+    ASSERT_EQ(res, OK) << "Unable to initialize provider manager";
+
+    auto deviceInterface = static_cast<TestDeviceInterface*>(provider->mDeviceInterface.get());
+    EXPECT_EQ(deviceInterface->mGetCharacteristicsCount, 2)
+            << "Duplicate devices expected not to be queried";
+
+    std::vector<std::string> expectedIds = {"0", "1"};
+    EXPECT_EQ(providerManager->getCameraDeviceIds(), expectedIds);
+    hardware::hidl_version version;
+    IPCTransport transport;
+    ASSERT_EQ(providerManager->getHighestSupportedVersion("0", &version, &transport), OK);
+    EXPECT_EQ(version.get_minor(), 2) << "First listed device of an id expected to be kept";
+}
+
+// Test that a restarted provider manager uses the characteristics cached by the
+// previous one instead of querying the HAL again.
+TEST(CameraProviderManagerTest, CharacteristicsCacheTest) {
+    std::vector<hardware::hidl_string> deviceNames;
+    deviceNames.push_back("device@3.2/test/0");
+    deviceNames.push_back("device@3.2/test/1");
+    hardware::hidl_vec<common::V1_0::VendorTagSection> vendorSection;
+    TemporaryDir cacheDir;
+
+    android::hardware::hidl_vec<uint8_t> chars;
+    CameraMetadata meta;
+    uint8_t facing = ANDROID_LENS_FACING_FRONT;
+    meta.update(ANDROID_LENS_FACING, &facing, 1);
+    camera_metadata_t* metaBuffer = const_cast<camera_metadata_t*>(meta.getAndLock());
+    chars.setToExternal(reinterpret_cast<uint8_t*>(metaBuffer),
+            get_camera_metadata_size(metaBuffer));
+
+    sp<TestICameraProvider> provider = new TestICameraProvider(deviceNames,
+            vendorSection, chars);
+    auto deviceInterface = static_cast<TestDeviceInterface*>(provider->mDeviceInterface.get());
+
+    // Cold start, then warm start with the cache written by the first manager
+    for (int i = 0; i < 2; i++) {
+        sp<CameraProviderManager> providerManager = new CameraProviderManager();
+        providerManager->setCharacteristicsCacheDir(cacheDir.path);
+        sp<TestStatusListener> statusListener = new TestStatusListener();
+        TestInteractionProxy serviceProxy;
+        serviceProxy.setProvider(provider);
+
+        status_t res = providerManager->initialize(statusListener, &serviceProxy);
+        ASSERT_EQ(res, OK) << "Unable to initialize provider manager";
+        EXPECT_EQ(deviceInterface->mGetCharacteristicsCount,
+                static_cast<int>(deviceNames.size()))
+                << "Characteristics expected to be queried on the first start only";
+
+        for (const char *id : {"0", "1"}) {
+            CameraMetadata info;
+            res = providerManager->getCameraCharacteristics(id, /*overrideForPerfClass*/false,
+                    &info, /*overrideToPortrait*/false);
+            ASSERT_EQ(res, OK) << "Unable to get characteristics of camera " << id;
+            camera_metadata_entry entry = info.find(ANDROID_LENS_FACING);
+            ASSERT_EQ(entry.count, 1u);
+            EXPECT_EQ(entry.data.u8[0], facing);
+        }
+    }
+    meta.unlock(metaBuffer);
+}
@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "../common/DepthPhotoProcessor.h"
+#include "NV12Compressor.h"
+
+using namespace android;
+using namespace android::camera3;
+
+static const size_t kDepthWidth = 640;
+static const size_t kDepthHeight = 480;
+static const int kJpegQuality = 95;
+
+// Main image with smooth content, so that its size is close to a real capture's
+static std::vector<unsigned char> generateMainJpeg(size_t width, size_t height) {
+    std::vector<uint8_t> nv12(width * height * 3 / 2);
+    for (size_t y = 0; y < height; y++) {
+        for (size_t x = 0; x < width; x++) {
+            nv12[y * width + x] = (x + y) * 255 / (width + height);
+        }
+    }
+    std::fill(nv12.begin() + width * height, nv12.end(), 0x80);
+
+    NV12Compressor jpegCompressor;
+    if (!jpegCompressor.compressWithExifOrientation(nv12.data(), width, height, kJpegQuality,
+            ExifOrientation::ORIENTATION_0_DEGREES)) {
+        return {};
+    }
+    return jpegCompressor.getCompressedData();
+}
+
+// Depth16 map of a slanted plane with noise, all levels of confidence
+static std::vector<uint16_t> generateDepth16() {
+    std::vector<uint16_t> depth16(kDepthWidth * kDepthHeight);
+    std::default_random_engine gen(1234);
+    std::uniform_int_distribution<int> noiseDist(-20, 20);
+    std::uniform_int_distribution<int> confidenceDist(0, 7);
+    for (size_t y = 0; y < kDepthHeight; y++) {
+        for (size_t x = 0; x < kDepthWidth; x++) {
+            int range = 500 + (x + y) * 4 + noiseDist(gen);
+            depth16[y * kDepthWidth + x] = (confidenceDist(gen) << 13) | (range & 0x1FFF);
+        }
+    }
+    return depth16;
+}
+
+// Composition of one depth photo as DepthCompositeStream does it, with the intermediate
+// buffers kept between captures or allocated for each.
+static void BM_ProcessDepthPhoto(benchmark::State& state) {
+    const bool reuseBuffers = state.range(0);
+    const size_t width = state.range(1);
+    const size_t height = state.range(2);
+    std::vector<unsigned char> mainJpeg = generateMainJpeg(width, height);
+    std::vector<uint16_t> depth16 = generateDepth16();
+    if (mainJpeg.empty()) {
+        state.SkipWithError("Failed to compress the main image");
+        return;
+    }
+
+    DepthPhotoInputFrame inputFrame;
+    inputFrame.mMainJpegBuffer = reinterpret_cast<const char*> (mainJpeg.data());
+    inputFrame.mMainJpegSize = mainJpeg.size();
+    inputFrame.mMainJpegWidth = width;
+    inputFrame.mMainJpegHeight = height;
+    inputFrame.mDepthMapBuffer = depth16.data();
+    inputFrame.mDepthMapWidth = inputFrame.mDepthMapStride = kDepthWidth;
+    inputFrame.mDepthMapHeight = kDepthHeight;
+    inputFrame.mJpegQuality = kJpegQuality;
+    // As large as the camera's JPEG buffers for the main image size
+    inputFrame.mMaxJpegSize = width * height * 3 / 2;
+
+    DepthPhotoBuffers buffers;
+    std::vector<uint8_t> depthPhotoBuffer(inputFrame.mMaxJpegSize * 3);
+    size_t depthPhotoSize = 0;
+    for (auto _ : state) {
+        if (processDepthPhotoFrame(inputFrame, depthPhotoBuffer.size(), depthPhotoBuffer.data(),
+                &depthPhotoSize, reuseBuffers ? &buffers : nullptr) != 0) {
+            state.SkipWithError("Depth photo processing failed");
+            break;
+        }
+    }
+    state.counters["bytes"] = depthPhotoSize;
+}
+
+BENCHMARK(BM_ProcessDepthPhoto)
+        ->ArgNames({"reuse", "width", "height"})
+        ->ArgsProduct({{0, 1}, {640}, {480}})
+        ->ArgsProduct({{0, 1}, {4032}, {3024}})
+        ->Unit(benchmark::kMillisecond)
+        ->UseRealTime();
@@ -17,6 +17,7 @@
 #define LOG_NDEBUG 0
 #define LOG_TAG "DepthProcessorTest"
 
+#include <algorithm>
 #include <array>
 #include <random>
 
@@ -317,3 +318,55 @@ TEST(DepthProcessorTest, TestDephtPhotoPhysicalRotation) {
         ASSERT_EQ(confidenceMapHeight, expectedHeight);
     }
 }
+
+TEST(DepthProcessorTest, ReusedBuffers) {
+    int jpegQuality = 95;
+
+    std::vector<uint8_t> colorJpegBuffer;
+    generateColorJpegBuffer(jpegQuality, ExifOrientation::ORIENTATION_0_DEGREES,
+            /*includeExif*/ true, /*switchDimensions*/ false, &colorJpegBuffer);
+
+    std::array<uint16_t, kTestBufferDepthSize> depth16Buffer;
+    generateDepth16Buffer(&depth16Buffer);
+
+    DepthPhotoInputFrame inputFrame;
+    inputFrame.mMainJpegBuffer = reinterpret_cast<const char*> (colorJpegBuffer.data());
+    inputFrame.mMainJpegSize = colorJpegBuffer.size();
+    // Worst case both depth and confidence maps have the same size as the main color image.
+    inputFrame.mMaxJpegSize = inputFrame.mMainJpegSize * 3;
+    inputFrame.mMainJpegWidth = kTestBufferWidth;
+    inputFrame.mMainJpegHeight = kTestBufferHeight;
+    inputFrame.mJpegQuality = jpegQuality;
+    inputFrame.mDepthMapBuffer = depth16Buffer.data();
+    inputFrame.mDepthMapWidth = inputFrame.mDepthMapStride = kTestBufferWidth;
+    inputFrame.mDepthMapHeight = kTestBufferHeight;
+
+    // Buffers carried over from captures of other orientations must not change the result
+    DepthPhotoBuffers buffers;
+    DepthPhotoOrientation depthOrientations[] = {
+            DepthPhotoOrientation::DEPTH_ORIENTATION_90_DEGREES,
+            DepthPhotoOrientation::DEPTH_ORIENTATION_0_DEGREES,
+            DepthPhotoOrientation::DEPTH_ORIENTATION_270_DEGREES,
+            DepthPhotoOrientation::DEPTH_ORIENTATION_180_DEGREES };
+    for (auto depthOrientation : depthOrientations) {
+        inputFrame.mOrientation = depthOrientation;
+
+        std::vector<uint8_t> expectedBuffer(inputFrame.mMaxJpegSize);
+        size_t expectedSize = 0;
+        ASSERT_EQ(processDepthPhotoFrame(inputFrame, expectedBuffer.size(),
+                    expectedBuffer.data(), &expectedSize), 0);
+
+        std::vector<uint8_t> depthPhotoBuffer(inputFrame.mMaxJpegSize);
+        size_t actualDepthPhotoSize = 0;
+        ASSERT_EQ(processDepthPhotoFrame(inputFrame, depthPhotoBuffer.size(),
+                    depthPhotoBuffer.data(), &actualDepthPhotoSize, &buffers), 0);
+        ASSERT_EQ(expectedSize, actualDepthPhotoSize);
+        ASSERT_TRUE(std::equal(expectedBuffer.begin(), expectedBuffer.begin() + expectedSize,
+                depthPhotoBuffer.begin()));
+
+        // The size needed is reported when the output buffer is too small
+        ASSERT_EQ(processDepthPhotoFrame(inputFrame, expectedSize - 1, depthPhotoBuffer.data(),
+                    &actualDepthPhotoSize, &buffers), NO_MEMORY);
+        ASSERT_EQ(expectedSize, actualDepthPhotoSize);
+    }
+}
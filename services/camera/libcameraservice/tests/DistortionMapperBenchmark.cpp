@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "../device3/DistortionMapper.h"
+
+using namespace android;
+using namespace android::camera3;
+using DistortionMapperInfo = DistortionMapper::DistortionMapperInfo;
+
+// Realistic calibration, see DistortionMapperTest
+static int32_t kActiveArray[] = {0, 8, 3278, 2450};
+static int32_t kPreCorrActiveArray[] = {0, 0, 3280, 2464};
+static float kDistortion[] = {0.06875723, -0.13922249, 0.02818312, -0.00032781, -0.00025431};
+static float kIntrinsics[] = {1812.5f, 1812.5f, 1645.59533691f, 1229.23229980f, 0.f};
+
+static constexpr int64_t kFrameDurationNs = 1000000000 / 60;
+
+static void setupMapper(DistortionMapper *m) {
+    CameraMetadata deviceInfo;
+    deviceInfo.update(ANDROID_SENSOR_INFO_PRE_CORRECTION_ACTIVE_ARRAY_SIZE,
+            kPreCorrActiveArray, 4);
+    deviceInfo.update(ANDROID_SENSOR_INFO_ACTIVE_ARRAY_SIZE, kActiveArray, 4);
+    deviceInfo.update(ANDROID_LENS_INTRINSIC_CALIBRATION, kIntrinsics, 5);
+    deviceInfo.update(ANDROID_LENS_DISTORTION, kDistortion, 5);
+    m->setupStaticInfo(deviceInfo);
+
+    // Build the grids
+    int32_t coords[2] = {kPreCorrActiveArray[2] / 2, kPreCorrActiveArray[3] / 2};
+    m->mapRawToCorrected(coords, 1, m->getMapperInfo(), /*clamp*/true, /*simple*/false);
+}
+
+// Random points of the pre-correction array that the distorted grid covers
+static std::vector<int32_t> randomPoints(const DistortionMapperInfo *mapperInfo, size_t count) {
+    std::default_random_engine gen(1234);
+    std::uniform_int_distribution<int> x_dist(0, kPreCorrActiveArray[2] - 1);
+    std::uniform_int_distribution<int> y_dist(0, kPreCorrActiveArray[3] - 1);
+    std::vector<int32_t> points;
+    while (points.size() < count * 2) {
+        int32_t pt[2] = {x_dist(gen), y_dist(gen)};
+        if (DistortionMapper::findEnclosingQuad(pt, mapperInfo->mDistortedGrid) != nullptr) {
+            points.insert(points.end(), pt, pt + 2);
+        }
+    }
+    return points;
+}
+
+// Enclosing quad lookup alone, searching the whole grid or only the indexed cell
+static void BM_FindEnclosingQuad(benchmark::State& state) {
+    const bool indexed = state.range(0);
+    DistortionMapper m;
+    setupMapper(&m);
+    const DistortionMapperInfo *mapperInfo = m.getMapperInfo();
+    const std::vector<int32_t> points = randomPoints(mapperInfo, 1024);
+
+    for (auto _ : state) {
+        for (size_t i = 0; i < points.size(); i += 2) {
+            const DistortionMapper::GridQuad *quad = indexed ?
+                    DistortionMapper::findEnclosingQuad(&points[i], mapperInfo->mDistortedGrid,
+                            mapperInfo->mDistortedGridIndex) :
+                    DistortionMapper::findEnclosingQuad(&points[i], mapperInfo->mDistortedGrid);
+            benchmark::DoNotOptimize(quad);
+        }
+    }
+    state.counters["points/s"] = benchmark::Counter(
+            (double)state.iterations() * points.size() / 2, benchmark::Counter::kIsRate);
+}
+
+// Raw to corrected mapping with the full distortion model
+static void BM_MapRawToCorrected(benchmark::State& state) {
+    DistortionMapper m;
+    setupMapper(&m);
+    DistortionMapperInfo *mapperInfo = m.getMapperInfo();
+    const std::vector<int32_t> points = randomPoints(mapperInfo, 1024);
+    std::vector<int32_t> coords(points.size());
+
+    for (auto _ : state) {
+        coords = points;
+        m.mapRawToCorrected(coords.data(), coords.size() / 2, mapperInfo, /*clamp*/true,
+                /*simple*/false);
+        benchmark::ClobberMemory();
+    }
+    state.counters["points/s"] = benchmark::Counter(
+            (double)state.iterations() * points.size() / 2, benchmark::Counter::kIsRate);
+}
+
+// Coordinates of one capture result: 3 metering regions and, per face, a rectangle and
+// 3 landmarks, mapped as in correctCaptureResult() with the full distortion model.
+// Reports the share of a 60 fps frame interval spent on them.
+static void BM_CaptureResult(benchmark::State& state) {
+    const size_t faceCount = state.range(0);
+    DistortionMapper m;
+    setupMapper(&m);
+    DistortionMapperInfo *mapperInfo = m.getMapperInfo();
+    const std::vector<int32_t> regions = randomPoints(mapperInfo, 3 * 2);
+    const std::vector<int32_t> faceRects = randomPoints(mapperInfo, faceCount * 2);
+    const std::vector<int32_t> landmarks = randomPoints(mapperInfo, faceCount * 3);
+    std::vector<int32_t> coords;
+
+    auto start = std::chrono::steady_clock::now();
+    for (auto _ : state) {
+        coords = regions;
+        for (size_t j = 0; j < coords.size(); j += 4) {
+            m.mapRawToCorrected(coords.data() + j, 2, mapperInfo, /*clamp*/true,
+                    /*simple*/false);
+        }
+        coords = faceRects;
+        m.mapRawToCorrected(coords.data(), coords.size() / 2, mapperInfo, /*clamp*/false,
+                /*simple*/false);
+        coords = landmarks;
+        m.mapRawToCorrected(coords.data(), coords.size() / 2, mapperInfo, /*clamp*/false,
+                /*simple*/false);
+        benchmark::ClobberMemory();
+    }
+    std::chrono::nanoseconds elapsed = std::chrono::steady_clock::now() - start;
+    state.counters["frameBudget%"] =
+            100. * elapsed.count() / state.iterations() / kFrameDurationNs;
+}
+
+BENCHMARK(BM_FindEnclosingQuad)->ArgName("indexed")->Arg(0)->Arg(1);
+BENCHMARK(BM_MapRawToCorrected);
+BENCHMARK(BM_CaptureResult)->ArgName("faces")->Arg(0)->Arg(1)->Arg(10);
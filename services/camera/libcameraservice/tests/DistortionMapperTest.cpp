@@ -379,3 +379,58 @@ TEST(DistortionMapperTest, CompareToOpenCV) {
                 << expCoords[i] << ", " << expCoords[i + 1] << ")";
     }
 }
+
+// The grid index must find the same quad as searching the whole grid
+void GridIndexTest(float distortion[5], float intrinsics[5],
+        int32_t activeArray[4], int32_t preCorrectionActiveArray[4]) {
+    DistortionMapper m;
+    setupTestMapper(&m, distortion, intrinsics, activeArray, preCorrectionActiveArray);
+
+    // Build the grids
+    DistortionMapperInfo *mapperInfo = m.getMapperInfo();
+    int32_t coords[2] = {activeArray[2] / 2, activeArray[3] / 2};
+    ASSERT_EQ(m.mapRawToCorrected(coords, 1, mapperInfo, /*clamp*/false, /*simple*/false), OK);
+
+    const auto &grid = mapperInfo->mDistortedGrid;
+    const auto &index = mapperInfo->mDistortedGridIndex;
+    ASSERT_NE(index.mCellCount, 0u);
+
+    std::default_random_engine gen(1234);
+    // Cover some margin outside of the pre-correction array as well
+    std::uniform_int_distribution<int> x_dist(-preCorrectionActiveArray[2] / 4,
+            preCorrectionActiveArray[2] * 5 / 4);
+    std::uniform_int_distribution<int> y_dist(-preCorrectionActiveArray[3] / 4,
+            preCorrectionActiveArray[3] * 5 / 4);
+    for (size_t i = 0; i < 100000; i++) {
+        int32_t pt[2] = {x_dist(gen), y_dist(gen)};
+        ASSERT_EQ(DistortionMapper::findEnclosingQuad(pt, grid),
+                DistortionMapper::findEnclosingQuad(pt, grid, index))
+                << "(" << pt[0] << ", " << pt[1] << ")";
+    }
+
+    // Grid corners sit on the boundary of several quads
+    for (const auto &quad : grid) {
+        for (size_t i = 0; i < 8; i += 2) {
+            int32_t pt[2] = {static_cast<int32_t>(std::round(quad.coords[i])),
+                    static_cast<int32_t>(std::round(quad.coords[i + 1]))};
+            ASSERT_EQ(DistortionMapper::findEnclosingQuad(pt, grid),
+                    DistortionMapper::findEnclosingQuad(pt, grid, index))
+                    << "(" << pt[0] << ", " << pt[1] << ")";
+        }
+    }
+}
+
+TEST(DistortionMapperTest, GridIndex) {
+    int32_t activeArray[] = {0, 8, 3278, 2450};
+    int32_t preCorrectionActiveArray[] = {0, 0, 3280, 2464};
+    float distortion[] = {0.06875723, -0.13922249, 0.02818312, -0.00032781, -0.00025431};
+    float intrinsics[] = {1812.50000000, 1812.50000000, 1645.59533691, 1229.23229980, 0.00000000};
+    GridIndexTest(distortion, intrinsics, activeArray, preCorrectionActiveArray);
+
+    GridIndexTest(identityDistortion, testICal, testActiveArray, testPreCorrActiveArray);
+}
+
+TEST(DistortionMapperTest, GridIndexLargeTransform) {
+    float bigDistortion[] = {0.1, -0.003, 0.004, 0.02, 0.01};
+    GridIndexTest(bigDistortion, testICal, testActiveArray, testPreCorrActiveArray);
+}
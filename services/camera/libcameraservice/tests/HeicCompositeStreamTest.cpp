@@ -0,0 +1,300 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_NDEBUG 0
+#define LOG_TAG "HeicCompositeStreamTest"
+
+#include <gtest/gtest.h>
+
+#include <string.h>
+
+#include <vector>
+
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/MediaCodecConstants.h>
+
+#include "../api2/HeicCompositeStream.h"
+
+namespace android {
+namespace camera3 {
+
+// Drives the tile bookkeeping of HEVC YUV tiling with codec instances that
+// have no MediaCodec behind them. None of the paths below call into the codecs.
+class HeicCompositeStreamTest : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        mStream = new HeicCompositeStream(nullptr /*device*/, nullptr /*cb*/);
+    }
+
+    void TearDown() override {
+        // Keep deinitCodec() from stopping the stand-in codecs
+        mStream->mCodecs.clear();
+        mStream.clear();
+    }
+
+    void setUpGrid(size_t gridRows, size_t gridCols, size_t codecCount) {
+        mStream->mUseGrid = true;
+        mStream->mGridRows = gridRows;
+        mStream->mGridCols = gridCols;
+        mStream->mOutputWidth = gridCols * mStream->mGridWidth;
+        mStream->mOutputHeight = gridRows * mStream->mGridHeight;
+        mStream->mCodecs.resize(codecCount);
+    }
+
+    void addPendingFrame(int64_t frameNumber) {
+        mStream->mPendingInputFrames[frameNumber];
+    }
+
+    void addCodecInputBuffers(size_t codecIndex, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            mStream->onHeicInputFrameAvailable(codecIndex, mNextInputBufferIndex++);
+        }
+    }
+
+    // Gives free codec input buffers tiles of the first frame that still needs
+    // some, among other things
+    void compilePendingInput() {
+        Mutex::Autolock l(mStream->mMutex);
+        mStream->compilePendingInputLocked();
+    }
+
+    // The codec and grid timestamp the stream picked for a tile of a frame
+    void findTile(int64_t frameNumber, size_t tileIndex, size_t *codecIndex, int64_t *timeUs) {
+        for (const auto& tile : mStream->mCodecTiles) {
+            if (tile.second.frameNumber == frameNumber && tile.second.tileIndex == tileIndex) {
+                *codecIndex = tile.second.codecIndex;
+                *timeUs = tile.first;
+                return;
+            }
+        }
+        FAIL() << "No tile " << tileIndex << " for frame " << frameNumber;
+    }
+
+    // Deliver the encoded tile as the codec callback does
+    void encodeTile(int64_t frameNumber, size_t tileIndex) {
+        size_t codecIndex;
+        int64_t timeUs;
+        ASSERT_NO_FATAL_FAILURE(findTile(frameNumber, tileIndex, &codecIndex, &timeUs));
+        HeicCompositeStream::CodecOutputBufferInfo bufferInfo = { mNextOutputBufferIndex++,
+                0 /*offset*/, 1024 /*size*/, timeUs, 0 /*flags*/, codecIndex, 0 /*tileIndex*/ };
+        mStream->onHeicOutputFrameAvailable(bufferInfo);
+        compilePendingInput();
+    }
+
+    HeicCompositeStream::InputFrame& pendingFrame(int64_t frameNumber) {
+        return mStream->mPendingInputFrames[frameNumber];
+    }
+
+    std::vector<size_t> outputTileIndices(int64_t frameNumber) {
+        std::vector<size_t> tileIndices;
+        for (const auto& info : pendingFrame(frameNumber).codecOutputBuffers) {
+            tileIndices.push_back(info.tileIndex);
+        }
+        return tileIndices;
+    }
+
+    bool isNextCodecOutputReady(int64_t frameNumber) {
+        return HeicCompositeStream::isNextCodecOutputReady(pendingFrame(frameNumber));
+    }
+
+    // Take the next tile off the frame, as processOneCodecOutputFrame() does
+    // once it is written to the muxer
+    void writeNextTile(int64_t frameNumber) {
+        HeicCompositeStream::InputFrame& inputFrame = pendingFrame(frameNumber);
+        ASSERT_TRUE(HeicCompositeStream::isNextCodecOutputReady(inputFrame));
+        inputFrame.codecOutputBuffers.erase(inputFrame.codecOutputBuffers.begin());
+        inputFrame.codecOutputCounter++;
+    }
+
+    static sp<AMessage> createFormat(const std::vector<uint8_t>& csd) {
+        sp<AMessage> format = new AMessage();
+        format->setString(KEY_MIME, MIMETYPE_VIDEO_HEVC);
+        sp<ABuffer> csdBuffer = new ABuffer(csd.size());
+        memcpy(csdBuffer->data(), csd.data(), csd.size());
+        format->setBuffer("csd-0", csdBuffer);
+        return format;
+    }
+
+    void changeFormat(size_t codecIndex, const std::vector<uint8_t>& csd) {
+        sp<AMessage> format = createFormat(csd);
+        mStream->onHeicFormatChanged(codecIndex, format);
+    }
+
+    bool isCodecActive(size_t codecIndex) {
+        return mStream->mCodecs[codecIndex].active;
+    }
+
+    bool isFrameFailed(int64_t frameNumber) {
+        return pendingFrame(frameNumber).error;
+    }
+
+    size_t numTilesInFlight() {
+        return mStream->mCodecTiles.size();
+    }
+
+    size_t numOutputTiles() {
+        return mStream->mNumOutputTiles;
+    }
+
+    sp<HeicCompositeStream> mStream;
+    int32_t mNextInputBufferIndex = 0;
+    int32_t mNextOutputBufferIndex = 0;
+};
+
+TEST_F(HeicCompositeStreamTest, TilesAreGivenToCodecsInTurn) {
+    setUpGrid(2 /*gridRows*/, 3 /*gridCols*/, 2 /*codecCount*/);
+    addPendingFrame(1);
+    addCodecInputBuffers(0, 3);
+    addCodecInputBuffers(1, 3);
+    compilePendingInput();
+
+    EXPECT_EQ(6u, pendingFrame(1).codecInputCounter);
+    for (size_t tileIndex = 0; tileIndex < 6; tileIndex++) {
+        size_t codecIndex;
+        int64_t timeUs;
+        ASSERT_NO_FATAL_FAILURE(findTile(1, tileIndex, &codecIndex, &timeUs));
+        EXPECT_EQ(tileIndex % 2, codecIndex);
+        EXPECT_EQ(tileIndex, (size_t)timeUs);
+    }
+}
+
+TEST_F(HeicCompositeStreamTest, OutOfOrderTilesAreWrittenInTileOrder) {
+    setUpGrid(2 /*gridRows*/, 2 /*gridCols*/, 2 /*codecCount*/);
+    addPendingFrame(1);
+    addCodecInputBuffers(0, 2);
+    addCodecInputBuffers(1, 2);
+    compilePendingInput();
+
+    // Both codecs put out their tiles last to first, the second codec before
+    // the first
+    ASSERT_NO_FATAL_FAILURE(encodeTile(1, 3));
+    ASSERT_NO_FATAL_FAILURE(encodeTile(1, 1));
+    EXPECT_EQ(std::vector<size_t>({1, 3}), outputTileIndices(1));
+    EXPECT_FALSE(isNextCodecOutputReady(1));
+
+    ASSERT_NO_FATAL_FAILURE(encodeTile(1, 2));
+    EXPECT_EQ(std::vector<size_t>({1, 2, 3}), outputTileIndices(1));
+    EXPECT_FALSE(isNextCodecOutputReady(1));
+
+    ASSERT_NO_FATAL_FAILURE(encodeTile(1, 0));
+    EXPECT_EQ(std::vector<size_t>({0, 1, 2, 3}), outputTileIndices(1));
+    for (size_t tileIndex = 0; tileIndex < 4; tileIndex++) {
+        ASSERT_NO_FATAL_FAILURE(writeNextTile(1));
+    }
+    EXPECT_FALSE(isNextCodecOutputReady(1));
+    EXPECT_EQ(0u, numTilesInFlight());
+}
+
+TEST_F(HeicCompositeStreamTest, TilesOfFramesAreKeptApart) {
+    setUpGrid(1 /*gridRows*/, 2 /*gridCols*/, 2 /*codecCount*/);
+    addPendingFrame(1);
+    addPendingFrame(2);
+    addCodecInputBuffers(0, 2);
+    addCodecInputBuffers(1, 2);
+    // Each pass only gives tiles of one frame
+    compilePendingInput();
+    compilePendingInput();
+
+    // The next frame's first tile can come out before this frame's last one
+    ASSERT_NO_FATAL_FAILURE(encodeTile(2, 0));
+    ASSERT_NO_FATAL_FAILURE(encodeTile(1, 1));
+    EXPECT_FALSE(isNextCodecOutputReady(1));
+    EXPECT_TRUE(isNextCodecOutputReady(2));
+
+    ASSERT_NO_FATAL_FAILURE(encodeTile(1, 0));
+    EXPECT_EQ(std::vector<size_t>({0, 1}), outputTileIndices(1));
+    EXPECT_EQ(std::vector<size_t>({0}), outputTileIndices(2));
+    ASSERT_NO_FATAL_FAILURE(writeNextTile(1));
+    ASSERT_NO_FATAL_FAILURE(writeNextTile(1));
+    ASSERT_NO_FATAL_FAILURE(writeNextTile(2));
+    EXPECT_FALSE(isNextCodecOutputReady(2));
+}
+
+TEST_F(HeicCompositeStreamTest, CodecWithSameParameterSetsStaysActive) {
+    setUpGrid(2 /*gridRows*/, 2 /*gridCols*/, 2 /*codecCount*/);
+    addPendingFrame(1);
+    addCodecInputBuffers(0, 2);
+    addCodecInputBuffers(1, 2);
+    compilePendingInput();
+
+    changeFormat(0, {0x40, 0x01, 0x0c});
+    changeFormat(1, {0x40, 0x01, 0x0c});
+    compilePendingInput();
+
+    EXPECT_TRUE(isCodecActive(0));
+    EXPECT_TRUE(isCodecActive(1));
+    EXPECT_FALSE(isFrameFailed(1));
+    EXPECT_EQ(4u, numOutputTiles());
+}
+
+TEST_F(HeicCompositeStreamTest, CodecWithDifferentParameterSetsIsRetired) {
+    setUpGrid(2 /*gridRows*/, 2 /*gridCols*/, 2 /*codecCount*/);
+    addPendingFrame(1);
+    addCodecInputBuffers(0, 2);
+    addCodecInputBuffers(1, 2);
+    compilePendingInput();
+    // The first codec's tiles are done before the second codec's format is known
+    ASSERT_NO_FATAL_FAILURE(encodeTile(1, 0));
+    ASSERT_NO_FATAL_FAILURE(encodeTile(1, 2));
+
+    changeFormat(0, {0x40, 0x01, 0x0c});
+    changeFormat(1, {0x40, 0x01, 0x0c, 0x01});
+    compilePendingInput();
+
+    // The frame the retired codec had tiles of fails
+    EXPECT_TRUE(isCodecActive(0));
+    EXPECT_FALSE(isCodecActive(1));
+    EXPECT_TRUE(isFrameFailed(1));
+
+    // The next frame only goes to the remaining codec, even though the retired
+    // one has free input buffers
+    addPendingFrame(2);
+    addCodecInputBuffers(1, 2);
+    addCodecInputBuffers(0, 4);
+    compilePendingInput();
+    EXPECT_EQ(4u, pendingFrame(2).codecInputCounter);
+    for (size_t tileIndex = 0; tileIndex < 4; tileIndex++) {
+        size_t codecIndex;
+        int64_t timeUs;
+        ASSERT_NO_FATAL_FAILURE(findTile(2, tileIndex, &codecIndex, &timeUs));
+        EXPECT_EQ(0u, codecIndex);
+    }
+    EXPECT_FALSE(isFrameFailed(2));
+}
+
+TEST_F(HeicCompositeStreamTest, RetiredCodecOnlyFailsFramesItHasTilesOf) {
+    setUpGrid(1 /*gridRows*/, 2 /*gridCols*/, 3 /*codecCount*/);
+    addPendingFrame(1);
+    addPendingFrame(2);
+    // Frame 1 goes to codecs 0 and 1, frame 2 to codecs 2 and 0
+    addCodecInputBuffers(0, 2);
+    addCodecInputBuffers(1, 1);
+    addCodecInputBuffers(2, 1);
+    compilePendingInput();
+    compilePendingInput();
+
+    changeFormat(0, {0x40, 0x01});
+    changeFormat(2, {0x42, 0x01});
+    compilePendingInput();
+
+    EXPECT_FALSE(isCodecActive(2));
+    EXPECT_FALSE(isFrameFailed(1));
+    EXPECT_TRUE(isFrameFailed(2));
+}
+
+} // namespace camera3
+} // namespace android
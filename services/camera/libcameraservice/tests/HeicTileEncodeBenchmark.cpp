@@ -0,0 +1,161 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <string.h>
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include <media/MediaCodecBuffer.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/MediaCodec.h>
+#include <media/stagefright/MediaCodecConstants.h>
+#include <media/stagefright/MediaErrors.h>
+
+#include "../api2/HeicEncoderInfoManager.h"
+
+using namespace android;
+
+// Software encoder, so that the numbers don't depend on the device's hardware
+static const char kSoftwareHevcEncoder[] = "c2.android.hevc.encoder";
+static const int64_t kTimeoutUs = 1000000;
+
+static const int32_t kTileWidth = HeicEncoderInfoManager::kGridWidth;
+static const int32_t kTileHeight = HeicEncoderInfoManager::kGridHeight;
+
+struct TileCodec {
+    sp<ALooper> looper;
+    sp<MediaCodec> codec;
+    int64_t timeUs = 0;
+};
+
+// Configured as in HeicCompositeStream::initializeCodec() for YUV tiling
+static bool createTileCodec(TileCodec *tileCodec) {
+    tileCodec->looper = new ALooper();
+    tileCodec->looper->setName("HeicTileEncodeBenchmark");
+    if (tileCodec->looper->start() != OK) {
+        return false;
+    }
+    tileCodec->codec = MediaCodec::CreateByComponentName(tileCodec->looper,
+            kSoftwareHevcEncoder);
+    if (tileCodec->codec == nullptr) {
+        return false;
+    }
+
+    sp<AMessage> format = new AMessage();
+    format->setString(KEY_MIME, MIMETYPE_VIDEO_HEVC);
+    format->setInt32(KEY_WIDTH, kTileWidth);
+    format->setInt32(KEY_HEIGHT, kTileHeight);
+    format->setInt32(KEY_COLOR_FORMAT, COLOR_FormatYUV420Flexible);
+    format->setInt32(KEY_BITRATE_MODE, BITRATE_MODE_CQ);
+    format->setInt32(KEY_QUALITY, 95);
+    format->setInt32(KEY_FRAME_RATE, 120);
+    format->setInt32(KEY_I_FRAME_INTERVAL, 0);
+    return tileCodec->codec->configure(format, nullptr /*nativeWindow*/, nullptr /*crypto*/,
+            CONFIGURE_FLAG_ENCODE) == OK && tileCodec->codec->start() == OK;
+}
+
+// Encode tileCount tiles of a flat gray image, and wait for all of them
+static bool encodeTiles(TileCodec *tileCodec, size_t tileCount) {
+    const sp<MediaCodec>& codec = tileCodec->codec;
+    size_t queued = 0, encoded = 0;
+    while (encoded < tileCount) {
+        size_t index;
+        sp<MediaCodecBuffer> buffer;
+        if (queued < tileCount && codec->dequeueInputBuffer(&index) == OK) {
+            if (codec->getInputBuffer(index, &buffer) != OK) {
+                return false;
+            }
+            memset(buffer->base(), 0x80, buffer->capacity());
+            if (codec->queueInputBuffer(index, 0, buffer->capacity(), tileCodec->timeUs++,
+                    0 /*flags*/) != OK) {
+                return false;
+            }
+            queued++;
+        }
+
+        size_t offset, size;
+        int64_t timeUs;
+        uint32_t flags;
+        status_t res = codec->dequeueOutputBuffer(&index, &offset, &size, &timeUs, &flags,
+                queued < tileCount ? 0 : kTimeoutUs);
+        if (res == OK) {
+            codec->releaseOutputBuffer(index);
+            if ((flags & BUFFER_FLAG_CODEC_CONFIG) == 0) {
+                encoded++;
+            }
+        } else if (res != -EAGAIN && res != INFO_FORMAT_CHANGED &&
+                res != INFO_OUTPUT_BUFFERS_CHANGED) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Shot to shot latency of the grid tiles of one image, with the tiles spread
+// over codecCount instances as HeicCompositeStream does.
+static void BM_EncodeGrid(benchmark::State& state) {
+    const size_t codecCount = state.range(0);
+    const size_t gridCols = (state.range(1) + kTileWidth - 1) / kTileWidth;
+    const size_t gridRows = (state.range(2) + kTileHeight - 1) / kTileHeight;
+    const size_t tileCount = gridCols * gridRows;
+
+    std::vector<TileCodec> codecs(codecCount);
+    for (auto& tileCodec : codecs) {
+        if (!createTileCodec(&tileCodec)) {
+            state.SkipWithError("Failed to create HEVC encoder");
+            return;
+        }
+    }
+
+    for (auto _ : state) {
+        std::vector<std::thread> threads;
+        std::vector<char> succeeded(codecCount);
+        for (size_t i = 0; i < codecCount; i++) {
+            // Tiles are given to the codecs in turn
+            size_t codecTiles = tileCount / codecCount + (i < tileCount % codecCount ? 1 : 0);
+            threads.emplace_back([&, i, codecTiles]() {
+                succeeded[i] = encodeTiles(&codecs[i], codecTiles);
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        if (std::find(succeeded.begin(), succeeded.end(), false) != succeeded.end()) {
+            state.SkipWithError("Failed to encode tiles");
+            break;
+        }
+    }
+    state.counters["tiles"] = tileCount;
+
+    for (auto& tileCodec : codecs) {
+        tileCodec.codec->stop();
+        tileCodec.codec->release();
+        tileCodec.looper->stop();
+    }
+}
+
+BENCHMARK(BM_EncodeGrid)
+        ->ArgNames({"codecs", "width", "height"})
+        ->ArgsProduct({{1, 2, 4}, {4032}, {3024}})
+        ->Args({1, 8160, 6120})
+        ->Args({4, 8160, 6120})
+        ->Unit(benchmark::kMillisecond)
+        ->UseRealTime();
@@ -0,0 +1,199 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_NDEBUG 0
+#define LOG_TAG "ResultMetadataPoolTest"
+
+#include <gtest/gtest.h>
+
+#include <list>
+
+#include <camera/CameraMetadata.h>
+#include <system/camera_metadata.h>
+
+#include "../device3/Camera3OutputUtils.h"
+
+using namespace android;
+using namespace android::camera3;
+
+constexpr int64_t kTimestamp = 123456789;
+constexpr int32_t kFrameNumber = 42;
+constexpr int32_t kRequestId = 7;
+constexpr uint8_t kAeMode = ANDROID_CONTROL_AE_MODE_ON;
+constexpr uint8_t kAfState = ANDROID_CONTROL_AF_STATE_FOCUSED_LOCKED;
+
+// A HAL result with a timestamp and an AE mode
+static CameraMetadata makeResult() {
+    CameraMetadata metadata;
+    metadata.update(ANDROID_SENSOR_TIMESTAMP, &kTimestamp, 1);
+    metadata.update(ANDROID_CONTROL_AE_MODE, &kAeMode, 1);
+    return metadata;
+}
+
+// The buffer |metadata| holds, for checking which buffer it was assembled in
+static const camera_metadata_t* bufferOf(const CameraMetadata& metadata) {
+    const camera_metadata_t *buffer = metadata.getAndLock();
+    metadata.unlock(buffer);
+    return buffer;
+}
+
+TEST(ResultMetadataPoolTest, AcquireReturnsEmptyBufferOfCapacity) {
+    ResultMetadataPool pool;
+    camera_metadata_t *buffer = pool.acquire(/*entryCapacity*/4, /*dataCapacity*/64);
+    ASSERT_NE(nullptr, buffer);
+    EXPECT_GE(get_camera_metadata_entry_capacity(buffer), 4u);
+    EXPECT_GE(get_camera_metadata_data_capacity(buffer), 64u);
+    EXPECT_EQ(0u, get_camera_metadata_entry_count(buffer));
+    pool.release(buffer);
+}
+
+TEST(ResultMetadataPoolTest, ReleasedBufferIsReusedEmpty) {
+    ResultMetadataPool pool;
+    camera_metadata_t *buffer = pool.acquire(4, 64);
+    ASSERT_NE(nullptr, buffer);
+    ASSERT_EQ(OK, add_camera_metadata_entry(buffer, ANDROID_SENSOR_TIMESTAMP, &kTimestamp, 1));
+    pool.release(buffer);
+
+    // A smaller request is served from the released buffer, with its old entries gone
+    camera_metadata_t *reused = pool.acquire(2, 16);
+    EXPECT_EQ(buffer, reused);
+    EXPECT_EQ(0u, get_camera_metadata_entry_count(reused));
+    EXPECT_GE(get_camera_metadata_entry_capacity(reused), 4u);
+    pool.release(reused);
+}
+
+TEST(ResultMetadataPoolTest, GrowsToLargestCapacitySeen) {
+    ResultMetadataPool pool;
+    pool.release(pool.acquire(2, 16));
+
+    // Too small for this request; it is replaced by a large enough buffer
+    camera_metadata_t *grown = pool.acquire(10, 200);
+    ASSERT_NE(nullptr, grown);
+    EXPECT_GE(get_camera_metadata_entry_capacity(grown), 10u);
+    EXPECT_GE(get_camera_metadata_data_capacity(grown), 200u);
+    pool.release(grown);
+
+    // Smaller results keep reusing the grown buffer rather than shrinking it
+    camera_metadata_t *reused = pool.acquire(2, 16);
+    EXPECT_EQ(grown, reused);
+    EXPECT_GE(get_camera_metadata_entry_capacity(reused), 10u);
+    EXPECT_GE(get_camera_metadata_data_capacity(reused), 200u);
+    pool.release(reused);
+}
+
+TEST(ResultMetadataPoolTest, ReleaseNullIsIgnored) {
+    ResultMetadataPool pool;
+    pool.release(nullptr);
+    camera_metadata_t *buffer = pool.acquire(1, 8);
+    EXPECT_NE(nullptr, buffer);
+    pool.release(buffer);
+}
+
+TEST(ResultMetadataPoolTest, AssembleLeavesRoomForFixups) {
+    ResultMetadataPool pool;
+    CameraMetadata halResult = makeResult();
+    CameraMetadata assembled;
+    ASSERT_EQ(OK, pool.assemble(bufferOf(halResult), /*partials*/nullptr, &assembled));
+    EXPECT_EQ(halResult.entryCount(), assembled.entryCount());
+    const camera_metadata_t *buffer = bufferOf(assembled);
+
+    // The tags insertResultLocked() adds do not reallocate the buffer
+    ASSERT_EQ(OK, assembled.update(ANDROID_REQUEST_FRAME_COUNT, &kFrameNumber, 1));
+    ASSERT_EQ(OK, assembled.update(ANDROID_REQUEST_ID, &kRequestId, 1));
+    EXPECT_EQ(buffer, bufferOf(assembled));
+
+    pool.release(assembled.release());
+}
+
+TEST(ResultMetadataPoolTest, AssembleMergesPartials) {
+    ResultMetadataPool pool;
+    CameraMetadata halResult = makeResult();
+    CameraMetadata partials;
+    float focusDistance = 1.5f;
+    partials.update(ANDROID_LENS_FOCUS_DISTANCE, &focusDistance, 1);
+    partials.update(ANDROID_CONTROL_AF_STATE, &kAfState, 1);
+
+    CameraMetadata assembled;
+    ASSERT_EQ(OK, pool.assemble(bufferOf(halResult), &partials, &assembled));
+    EXPECT_EQ(halResult.entryCount() + partials.entryCount(), assembled.entryCount());
+
+    camera_metadata_entry entry = assembled.find(ANDROID_SENSOR_TIMESTAMP);
+    ASSERT_EQ(1u, entry.count);
+    EXPECT_EQ(kTimestamp, entry.data.i64[0]);
+    entry = assembled.find(ANDROID_CONTROL_AE_MODE);
+    ASSERT_EQ(1u, entry.count);
+    EXPECT_EQ(kAeMode, entry.data.u8[0]);
+    entry = assembled.find(ANDROID_LENS_FOCUS_DISTANCE);
+    ASSERT_EQ(1u, entry.count);
+    EXPECT_EQ(focusDistance, entry.data.f[0]);
+    entry = assembled.find(ANDROID_CONTROL_AF_STATE);
+    ASSERT_EQ(1u, entry.count);
+    EXPECT_EQ(kAfState, entry.data.u8[0]);
+
+    // The partials are copied, not consumed
+    EXPECT_EQ(2u, partials.entryCount());
+
+    pool.release(assembled.release());
+}
+
+TEST(ResultMetadataPoolTest, AssembleUsesPooledBuffer) {
+    ResultMetadataPool pool;
+    camera_metadata_t *pooled = pool.acquire(32, 512);
+    ASSERT_NE(nullptr, pooled);
+    pool.release(pooled);
+
+    CameraMetadata halResult = makeResult();
+    CameraMetadata assembled;
+    ASSERT_EQ(OK, pool.assemble(bufferOf(halResult), /*partials*/nullptr, &assembled));
+    EXPECT_EQ(pooled, bufferOf(assembled));
+    pool.release(assembled.release());
+}
+
+TEST(ResultMetadataPoolTest, QueueResultClonesThenRecycles) {
+    ResultMetadataPool pool;
+    CameraMetadata halResult = makeResult();
+    CaptureResult result;
+    result.mResultExtras.requestId = kRequestId;
+    result.mResultExtras.frameNumber = kFrameNumber;
+    ASSERT_EQ(OK, pool.assemble(bufferOf(halResult), /*partials*/nullptr, &result.mMetadata));
+    result.mPhysicalMetadatas.emplace_back(String16("2"), makeResult());
+    const camera_metadata_t *assembledBuffer = bufferOf(result.mMetadata);
+
+    std::list<CaptureResult> queue;
+    CaptureResult& queued = pool.queueResult(&result, &queue);
+    ASSERT_EQ(1u, queue.size());
+    EXPECT_EQ(&queue.back(), &queued);
+
+    // The client gets its own compact copy with the same contents
+    EXPECT_NE(assembledBuffer, bufferOf(queued.mMetadata));
+    EXPECT_EQ(halResult.entryCount(), queued.mMetadata.entryCount());
+    camera_metadata_entry entry = queued.mMetadata.find(ANDROID_SENSOR_TIMESTAMP);
+    ASSERT_EQ(1u, entry.count);
+    EXPECT_EQ(kTimestamp, entry.data.i64[0]);
+    EXPECT_EQ(kRequestId, queued.mResultExtras.requestId);
+    EXPECT_EQ(kFrameNumber, queued.mResultExtras.frameNumber);
+
+    // The physical metadata is moved to the copy
+    ASSERT_EQ(1u, queued.mPhysicalMetadatas.size());
+    EXPECT_EQ(String16("2"), queued.mPhysicalMetadatas[0].mPhysicalCameraId);
+    EXPECT_TRUE(result.mPhysicalMetadatas.empty());
+
+    // The assembled buffer is back in the pool for the next result
+    EXPECT_TRUE(result.mMetadata.isEmpty());
+    camera_metadata_t *reused = pool.acquire(1, 8);
+    EXPECT_EQ(assembledBuffer, reused);
+    pool.release(reused);
+}
@@ -0,0 +1,308 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_NDEBUG 0
+#define LOG_TAG "TagMonitorTest"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cinttypes>
+#include <cstdlib>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "../utils/TagMonitor.h"
+
+using namespace android;
+
+// Events kept in the log of each source
+constexpr size_t kLogEvents = 100;
+// Words of event values kept in the log of each source
+constexpr size_t kLogDataWords = 1000;
+// Number of camera ids a log can name, including the logical camera's
+constexpr size_t kLogCameraIds = 16;
+
+struct ParsedEvent {
+    uint32_t frameNumber = 0;
+    bool request = false;
+    // Empty for the logical camera
+    std::string cameraId;
+    std::vector<double> values;
+    bool truncated = false;
+};
+
+// Parse an event as formatted by TagMonitor::getLatestMonitoredTagEvents()
+static ParsedEvent parseEvent(const std::string &eventString) {
+    ParsedEvent event;
+    int64_t timestamp;
+    int consumed = 0;
+    EXPECT_EQ(2, sscanf(eventString.c_str(), "f%" SCNu32 ":%" SCNd64 "ns:%n",
+            &event.frameNumber, &timestamp, &consumed)) << eventString;
+
+    size_t idStart = eventString.find_first_not_of(' ', consumed);
+    size_t idEnd = eventString.find(' ', idStart);
+    std::string token = eventString.substr(idStart, idEnd - idStart);
+    // The source label directly follows the id, which is empty for the logical camera
+    if (token.rfind("REQ:", 0) != 0 && token.rfind("RES:", 0) != 0) {
+        event.cameraId = token;
+    }
+    event.request = eventString.find("REQ:") != std::string::npos;
+    event.truncated = eventString.find("(truncated)") != std::string::npos;
+
+    for (size_t open = eventString.find('['); open != std::string::npos;
+            open = eventString.find('[', open + 1)) {
+        const char *pos = eventString.c_str() + open + 1;
+        while (*pos != ']' && *pos != '\0') {
+            char *end;
+            double value = strtod(pos, &end);
+            if (end == pos) break;
+            event.values.push_back(value);
+            pos = end;
+            while (*pos == ' ') pos++;
+        }
+    }
+    return event;
+}
+
+class TagMonitorTest : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        mMonitor.parseTagsToMonitor(
+                String8("android.sensor.exposureTime,android.tonemap.curveRed"));
+        ASSERT_TRUE(mMonitor.isMonitoringEnabled());
+    }
+
+    static CameraMetadata exposure(int64_t exposureTime) {
+        CameraMetadata metadata;
+        metadata.update(ANDROID_SENSOR_EXPOSURE_TIME, &exposureTime, 1);
+        return metadata;
+    }
+
+    // A curve of |count| points, all set to |value|
+    static CameraMetadata curve(float value, size_t count) {
+        CameraMetadata metadata;
+        std::vector<float> points(count, value);
+        metadata.update(ANDROID_TONEMAP_CURVE_RED, points.data(), points.size());
+        return metadata;
+    }
+
+    void monitor(TagMonitor::eventSource source, int64_t frameNumber,
+            const CameraMetadata &metadata,
+            const std::unordered_map<std::string, CameraMetadata> &physicalMetadata = {}) {
+        mMonitor.monitorMetadata(source, frameNumber, frameNumber + 1, metadata,
+                physicalMetadata);
+    }
+
+    std::vector<ParsedEvent> latestEvents() {
+        std::vector<std::string> eventStrings;
+        mMonitor.getLatestMonitoredTagEvents(eventStrings);
+        std::vector<ParsedEvent> events;
+        for (const std::string &eventString : eventStrings) {
+            events.push_back(parseEvent(eventString));
+        }
+        return events;
+    }
+
+    TagMonitor mMonitor;
+};
+
+TEST_F(TagMonitorTest, EventRingKeepsLatestEvents) {
+    const int64_t kFrames = 2 * kLogEvents + 50;
+    for (int64_t frame = 0; frame < kFrames; frame++) {
+        monitor(TagMonitor::RESULT, frame, exposure(frame));
+    }
+
+    std::vector<ParsedEvent> events = latestEvents();
+    ASSERT_EQ(kLogEvents, events.size());
+    for (size_t i = 0; i < events.size(); i++) {
+        int64_t frame = kFrames - 1 - i;
+        EXPECT_EQ(frame, events[i].frameNumber);
+        EXPECT_FALSE(events[i].request);
+        ASSERT_EQ(1u, events[i].values.size());
+        EXPECT_EQ(frame, events[i].values[0]);
+    }
+}
+
+TEST_F(TagMonitorTest, DataRingKeepsLatestValues) {
+    // 40 floats take 20 words, so only the values of the latest 50 events fit
+    const size_t kPoints = 40;
+    const size_t kEventsWithValues = kLogDataWords / (kPoints * sizeof(float) / sizeof(uint64_t));
+    const int64_t kFrames = kLogEvents;
+    for (int64_t frame = 0; frame < kFrames; frame++) {
+        monitor(TagMonitor::RESULT, frame, curve(frame, kPoints));
+    }
+
+    std::vector<ParsedEvent> events = latestEvents();
+    ASSERT_EQ(kEventsWithValues, events.size());
+    for (size_t i = 0; i < events.size(); i++) {
+        int64_t frame = kFrames - 1 - i;
+        EXPECT_EQ(frame, events[i].frameNumber);
+        ASSERT_EQ(kPoints, events[i].values.size());
+        for (double value : events[i].values) {
+            EXPECT_EQ(frame, value);
+        }
+    }
+}
+
+TEST_F(TagMonitorTest, OversizedValueIsTruncated) {
+    const size_t kPoints = kLogDataWords;
+    std::vector<float> points(kPoints);
+    for (size_t i = 0; i < kPoints; i++) {
+        points[i] = i;
+    }
+    CameraMetadata metadata;
+    metadata.update(ANDROID_TONEMAP_CURVE_RED, points.data(), points.size());
+    monitor(TagMonitor::RESULT, 0, metadata);
+    monitor(TagMonitor::RESULT, 1, curve(1, 2));
+
+    std::vector<ParsedEvent> events = latestEvents();
+    ASSERT_EQ(2u, events.size());
+    EXPECT_EQ(1u, events[0].frameNumber);
+    EXPECT_FALSE(events[0].truncated);
+
+    // Values are capped at a quarter of the data ring
+    const ParsedEvent &oversized = events[1];
+    EXPECT_EQ(0u, oversized.frameNumber);
+    EXPECT_TRUE(oversized.truncated);
+    const size_t kMaxPoints = kLogDataWords * sizeof(uint64_t) / 4 / sizeof(float);
+    ASSERT_EQ(kMaxPoints, oversized.values.size());
+    for (size_t i = 0; i < oversized.values.size(); i++) {
+        EXPECT_EQ(i, oversized.values[i]);
+    }
+}
+
+TEST_F(TagMonitorTest, CameraIdsBeyondLimitAreUnknown) {
+    const size_t kPhysicalCameras = kLogCameraIds + 4;
+    std::unordered_map<std::string, CameraMetadata> physicalMetadata;
+    for (size_t i = 0; i < kPhysicalCameras; i++) {
+        physicalMetadata.emplace(std::to_string(i), exposure(i));
+    }
+    monitor(TagMonitor::RESULT, 0, exposure(-1), physicalMetadata);
+
+    std::vector<ParsedEvent> events = latestEvents();
+    ASSERT_EQ(kPhysicalCameras + 1, events.size());
+    size_t logical = 0;
+    size_t unknown = 0;
+    std::set<std::string> named;
+    for (const ParsedEvent &event : events) {
+        ASSERT_EQ(1u, event.values.size());
+        if (event.cameraId.empty()) {
+            logical++;
+            EXPECT_EQ(-1, event.values[0]);
+        } else if (event.cameraId == "?") {
+            unknown++;
+        } else {
+            // A named event keeps the value of its camera
+            EXPECT_EQ(std::stod(event.cameraId), event.values[0]);
+            EXPECT_TRUE(named.insert(event.cameraId).second);
+        }
+    }
+    // The logical camera takes one of the ids
+    EXPECT_EQ(1u, logical);
+    EXPECT_EQ(kLogCameraIds - 1, named.size());
+    EXPECT_EQ(kPhysicalCameras - (kLogCameraIds - 1), unknown);
+}
+
+TEST_F(TagMonitorTest, DumpMergesSourcesInOrder) {
+    const int64_t kFrames = 10;
+    for (int64_t frame = 0; frame < kFrames; frame++) {
+        monitor(TagMonitor::REQUEST, frame, exposure(2 * frame));
+        monitor(TagMonitor::RESULT, frame, exposure(2 * frame + 1));
+    }
+
+    std::vector<ParsedEvent> events = latestEvents();
+    ASSERT_EQ(2u * kFrames, events.size());
+    for (size_t i = 0; i < events.size(); i++) {
+        int64_t frame = kFrames - 1 - i / 2;
+        bool request = (i % 2) == 1;
+        EXPECT_EQ(frame, events[i].frameNumber) << i;
+        EXPECT_EQ(request, events[i].request) << i;
+        ASSERT_EQ(1u, events[i].values.size());
+        EXPECT_EQ(request ? 2 * frame : 2 * frame + 1, events[i].values[0]);
+    }
+}
+
+TEST_F(TagMonitorTest, DumpKeepsLatestEventsOfBothSources) {
+    const size_t kRequests = kLogEvents + 20;
+    const size_t kResults = 10;
+    for (size_t frame = 0; frame < kRequests; frame++) {
+        monitor(TagMonitor::REQUEST, frame, exposure(frame));
+    }
+    for (size_t frame = 0; frame < kResults; frame++) {
+        monitor(TagMonitor::RESULT, frame, exposure(frame));
+    }
+
+    // The results were logged last, so they come first
+    std::vector<ParsedEvent> events = latestEvents();
+    ASSERT_EQ(kLogEvents, events.size());
+    for (size_t i = 0; i < events.size(); i++) {
+        bool request = i >= kResults;
+        size_t frame = request ? kRequests - 1 - (i - kResults) : kResults - 1 - i;
+        EXPECT_EQ(request, events[i].request) << i;
+        EXPECT_EQ(frame, events[i].frameNumber) << i;
+    }
+}
+
+// Values of 1 to 32 words, so that events and values wrap at different points
+static size_t pointsOfFrame(uint32_t frameNumber) {
+    return 2 * (frameNumber % 32 + 1);
+}
+
+static void checkConsistentEvents(const std::vector<ParsedEvent> &events) {
+    ASSERT_LE(events.size(), kLogEvents);
+    for (size_t i = 0; i < events.size(); i++) {
+        const ParsedEvent &event = events[i];
+        if (i > 0) {
+            ASSERT_LT(event.frameNumber, events[i - 1].frameNumber);
+        }
+        // A torn event would mix the frame number or value of another event
+        ASSERT_EQ(pointsOfFrame(event.frameNumber), event.values.size()) << event.frameNumber;
+        for (double value : event.values) {
+            ASSERT_EQ(event.frameNumber, value);
+        }
+    }
+}
+
+TEST_F(TagMonitorTest, ConcurrentReadsSeeWholeEvents) {
+    const int64_t kFrames = 20000;
+    std::atomic<bool> done(false);
+    std::thread writer([&]() {
+        for (int64_t frame = 0; frame < kFrames; frame++) {
+            monitor(TagMonitor::RESULT, frame, curve(frame, pointsOfFrame(frame)));
+        }
+        done = true;
+    });
+
+    size_t reads = 0;
+    bool lastRead = false;
+    while (!lastRead && !HasFatalFailure()) {
+        lastRead = done;
+        checkConsistentEvents(latestEvents());
+        reads++;
+    }
+    writer.join();
+    ASSERT_FALSE(HasFatalFailure());
+    EXPECT_GT(reads, 0u);
+
+    // Once the writer is done, the latest event is readable
+    std::vector<ParsedEvent> events = latestEvents();
+    ASSERT_FALSE(events.empty());
+    EXPECT_EQ(kFrames - 1, events[0].frameNumber);
+}
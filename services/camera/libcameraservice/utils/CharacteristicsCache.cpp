@@ -0,0 +1,202 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "CameraCharacteristicsCache"
+//#define LOG_NDEBUG 0
+
+#include "CharacteristicsCache.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <android-base/file.h>
+#include <utils/Log.h>
+
+namespace android {
+
+namespace {
+const uint32_t kMagic = 0x52484343; // "CCHR"
+const uint32_t kFileVersion = 1;
+
+void appendU32(std::string *out, uint32_t value) {
+    out->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void appendBytes(std::string *out, const void *data, size_t size) {
+    appendU32(out, size);
+    out->append(reinterpret_cast<const char*>(data), size);
+}
+
+// Reads from the file contents with bounds checks
+struct Reader {
+    const std::string &mData;
+    size_t mOffset = 0;
+
+    bool readU32(uint32_t *value) {
+        if (mData.size() - mOffset < sizeof(*value)) return false;
+        memcpy(value, mData.data() + mOffset, sizeof(*value));
+        mOffset += sizeof(*value);
+        return true;
+    }
+
+    bool readBytes(const char **data, size_t *size) {
+        uint32_t length;
+        if (!readU32(&length) || mData.size() - mOffset < length) return false;
+        *data = mData.data() + mOffset;
+        *size = length;
+        mOffset += length;
+        return true;
+    }
+};
+} // anonymous namespace
+
+CharacteristicsCache::CharacteristicsCache(const std::string &path, const std::string &key) :
+        mPath(path),
+        mKey(key),
+        mChanged(false),
+        mHitCount(0) {
+}
+
+status_t CharacteristicsCache::load() {
+    std::lock_guard<std::mutex> lock(mLock);
+    mEntries.clear();
+
+    std::string contents;
+    if (!base::ReadFileToString(mPath, &contents)) {
+        ALOGV("%s: No characteristics cache at %s: %s", __FUNCTION__, mPath.c_str(),
+                strerror(errno));
+        return NAME_NOT_FOUND;
+    }
+
+    Reader reader{contents};
+    uint32_t magic, version, count;
+    const char *key;
+    size_t keySize;
+    if (!reader.readU32(&magic) || magic != kMagic || !reader.readU32(&version) ||
+            version != kFileVersion || !reader.readBytes(&key, &keySize)) {
+        ALOGW("%s: Ignoring malformed characteristics cache %s", __FUNCTION__, mPath.c_str());
+        return BAD_VALUE;
+    }
+    if (mKey.compare(0, std::string::npos, key, keySize) != 0) {
+        ALOGI("%s: Characteristics cache %s is out of date", __FUNCTION__, mPath.c_str());
+        return NAME_NOT_FOUND;
+    }
+
+    if (!reader.readU32(&count)) {
+        ALOGW("%s: Ignoring malformed characteristics cache %s", __FUNCTION__, mPath.c_str());
+        return BAD_VALUE;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        const char *name, *data;
+        size_t nameSize, dataSize;
+        if (!reader.readBytes(&name, &nameSize) || !reader.readBytes(&data, &dataSize)) {
+            ALOGW("%s: Ignoring truncated characteristics cache %s", __FUNCTION__,
+                    mPath.c_str());
+            mEntries.clear();
+            return BAD_VALUE;
+        }
+
+        // Copied first, the metadata structure must be aligned
+        std::vector<uint8_t> metadata(data, data + dataSize);
+        size_t expectedSize = metadata.size();
+        int res = validate_camera_metadata_structure(
+                reinterpret_cast<const camera_metadata_t*>(metadata.data()), &expectedSize);
+        if (res != OK && res != CAMERA_METADATA_VALIDATION_SHIFTED) {
+            ALOGW("%s: Ignoring characteristics cache %s with malformed metadata", __FUNCTION__,
+                    mPath.c_str());
+            mEntries.clear();
+            return BAD_VALUE;
+        }
+        mEntries.emplace(std::string(name, nameSize), std::move(metadata));
+    }
+
+    ALOGV("%s: Loaded characteristics of %zu devices from %s", __FUNCTION__, mEntries.size(),
+            mPath.c_str());
+    return OK;
+}
+
+status_t CharacteristicsCache::save() {
+    std::lock_guard<std::mutex> lock(mLock);
+    if (!mChanged) {
+        return OK;
+    }
+
+    std::string contents;
+    appendU32(&contents, kMagic);
+    appendU32(&contents, kFileVersion);
+    appendBytes(&contents, mKey.data(), mKey.size());
+    appendU32(&contents, mEntries.size());
+    for (const auto &entry : mEntries) {
+        appendBytes(&contents, entry.first.data(), entry.first.size());
+        appendBytes(&contents, entry.second.data(), entry.second.size());
+    }
+
+    // Written next to the cache and renamed, so that a crash can't leave it incomplete
+    std::string tmpPath = mPath + ".tmp";
+    if (!base::WriteStringToFile(contents, tmpPath)) {
+        ALOGE("%s: Unable to write characteristics cache %s: %s", __FUNCTION__,
+                tmpPath.c_str(), strerror(errno));
+        return UNKNOWN_ERROR;
+    }
+    if (rename(tmpPath.c_str(), mPath.c_str()) != 0) {
+        ALOGE("%s: Unable to rename characteristics cache to %s: %s", __FUNCTION__,
+                mPath.c_str(), strerror(errno));
+        unlink(tmpPath.c_str());
+        return UNKNOWN_ERROR;
+    }
+
+    mChanged = false;
+    return OK;
+}
+
+camera_metadata_t* CharacteristicsCache::get(const std::string &deviceName) {
+    std::lock_guard<std::mutex> lock(mLock);
+    auto entry = mEntries.find(deviceName);
+    if (entry == mEntries.end()) {
+        return nullptr;
+    }
+
+    mHitCount++;
+    return clone_camera_metadata(
+            reinterpret_cast<const camera_metadata_t*>(entry->second.data()));
+}
+
+void CharacteristicsCache::put(const std::string &deviceName,
+        const camera_metadata_t *characteristics) {
+    if (characteristics == nullptr) {
+        return;
+    }
+
+    size_t size = get_camera_metadata_compact_size(characteristics);
+    std::vector<uint8_t> metadata(size);
+    if (copy_camera_metadata(metadata.data(), size, characteristics) == nullptr) {
+        ALOGE("%s: Unable to copy characteristics of %s", __FUNCTION__, deviceName.c_str());
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mLock);
+    mEntries[deviceName] = std::move(metadata);
+    mChanged = true;
+}
+
+size_t CharacteristicsCache::getHitCount() const {
+    std::lock_guard<std::mutex> lock(mLock);
+    return mHitCount;
+}
+
+}; // namespace android
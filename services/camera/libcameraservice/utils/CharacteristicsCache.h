@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_SERVERS_CAMERA_CHARACTERISTICS_CACHE_H_
+#define ANDROID_SERVERS_CAMERA_CHARACTERISTICS_CACHE_H_
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <system/camera_metadata.h>
+#include <utils/Errors.h>
+
+namespace android {
+
+/**
+ * Camera characteristics of the devices of one camera provider, as received from the HAL.
+ *
+ * They are saved to a file, so that a restarted camera server doesn't need to query them
+ * again. The file is only used if it was written with the same key, which must change
+ * whenever the HAL may report different characteristics.
+ */
+class CharacteristicsCache {
+public:
+    CharacteristicsCache(const std::string &path, const std::string &key);
+
+    // Read the characteristics from the file, if it was written with the same key
+    status_t load();
+
+    // Write the file, if characteristics were added since it was loaded
+    status_t save();
+
+    // Copy of the characteristics of the device, or nullptr if they aren't cached.
+    // The caller owns the returned buffer.
+    camera_metadata_t* get(const std::string &deviceName);
+
+    void put(const std::string &deviceName, const camera_metadata_t *characteristics);
+
+    size_t getHitCount() const;
+
+private:
+    const std::string mPath;
+    const std::string mKey;
+
+    mutable std::mutex mLock;
+    std::map<std::string, std::vector<uint8_t>> mEntries;
+    bool mChanged;
+    size_t mHitCount;
+}; // class CharacteristicsCache
+
+}; // namespace android
+
+#endif // ANDROID_SERVERS_CAMERA_CHARACTERISTICS_CACHE_H_
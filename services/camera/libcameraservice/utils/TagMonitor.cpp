@@ -20,6 +20,7 @@
 
 #include "TagMonitor.h"
 
+#include <algorithm>
 #include <inttypes.h>
 #include <utils/Log.h>
 #include <camera/VendorTagDescriptor.h>
@@ -30,19 +31,31 @@ namespace android {
 
 TagMonitor::TagMonitor():
         mMonitoringEnabled(false),
-        mMonitoringEvents(kMaxMonitorEvents),
+        mEventSequence(0),
         mVendorTagId(CAMERA_METADATA_INVALID_VENDOR_ID)
 {}
 
 TagMonitor::TagMonitor(const TagMonitor& other):
         mMonitoringEnabled(other.mMonitoringEnabled.load()),
-        mMonitoredTagList(other.mMonitoredTagList),
-        mLastMonitoredRequestValues(other.mLastMonitoredRequestValues),
-        mLastMonitoredResultValues(other.mLastMonitoredResultValues),
-        mLastMonitoredPhysicalRequestKeys(other.mLastMonitoredPhysicalRequestKeys),
-        mLastMonitoredPhysicalResultKeys(other.mLastMonitoredPhysicalResultKeys),
-        mMonitoringEvents(other.mMonitoringEvents),
-        mVendorTagId(other.mVendorTagId) {}
+        mMonitoredTags(other.mMonitoredTags),
+        mEventSequence(other.mEventSequence.load()),
+        mVendorTagId(other.mVendorTagId) {
+    for (size_t i = 0; i < std::size(mSources); i++) {
+        SourceState &state = mSources[i];
+        const SourceState &otherState = other.mSources[i];
+        state.lastValues = otherState.lastValues;
+        state.lastInputStreamId = otherState.lastInputStreamId;
+        state.lastStreamIds = otherState.lastStreamIds;
+
+        std::vector<EventLog::Event> events;
+        otherState.log.read(&events);
+        for (auto event = events.rbegin(); event != events.rend(); event++) {
+            state.log.append(event->sequence, event->kind, event->frameNumber,
+                    event->timestamp, event->cameraId, event->tag, event->type,
+                    event->data.data(), event->data.size());
+        }
+    }
+}
 
 const String16 TagMonitor::kMonitorOption = String16("-m");
 
@@ -58,6 +71,8 @@ const char* TagMonitor::k3aTags =
 
 void TagMonitor::parseTagsToMonitor(String8 tagNames) {
     std::lock_guard<std::mutex> lock(mMonitorMutex);
+    std::lock_guard<std::mutex> requestLock(mSources[REQUEST].mutex);
+    std::lock_guard<std::mutex> resultLock(mSources[RESULT].mutex);
 
     // Expand shorthands
     ssize_t idx = tagNames.find("3a");
@@ -91,10 +106,11 @@ void TagMonitor::parseTagsToMonitor(String8 tagNames) {
             ALOGW("%s: Unknown tag %s, ignoring", __FUNCTION__, nextTagName);
         } else {
             if (!gotTag) {
-                mMonitoredTagList.clear();
+                mMonitoredTags.clear();
                 gotTag = true;
             }
-            mMonitoredTagList.push_back(tag);
+            int type = get_local_camera_metadata_tag_type_vendor_id(tag, mVendorTagId);
+            mMonitoredTags.push_back({tag, static_cast<uint8_t>(type)});
         }
         nextTagName = strtok_r(nullptr, ", ", &savePtr);
     }
@@ -102,19 +118,26 @@ void TagMonitor::parseTagsToMonitor(String8 tagNames) {
     tagNames.unlockBuffer();
 
     if (gotTag) {
-        // Got at least one new tag
+        // Got at least one new tag; last values are per monitored tag
+        resetSourcesLocked();
         mMonitoringEnabled = true;
     }
 }
 
 void TagMonitor::disableMonitoring() {
+    std::lock_guard<std::mutex> lock(mMonitorMutex);
+    std::lock_guard<std::mutex> requestLock(mSources[REQUEST].mutex);
+    std::lock_guard<std::mutex> resultLock(mSources[RESULT].mutex);
     mMonitoringEnabled = false;
-    mLastMonitoredRequestValues.clear();
-    mLastMonitoredResultValues.clear();
-    mLastMonitoredPhysicalRequestKeys.clear();
-    mLastMonitoredPhysicalResultKeys.clear();
-    mLastStreamIds.clear();
-    mLastInputStreamId = -1;
+    resetSourcesLocked();
+}
+
+void TagMonitor::resetSourcesLocked() {
+    for (SourceState &state : mSources) {
+        state.lastValues.clear();
+        state.lastStreamIds.clear();
+        state.lastInputStreamId = -1;
+    }
 }
 
 void TagMonitor::monitorMetadata(eventSource source, int64_t frameNumber, nsecs_t timestamp,
@@ -124,111 +147,88 @@ void TagMonitor::monitorMetadata(eventSource source, int64_t frameNumber, nsecs_
         int32_t inputStreamId) {
     if (!mMonitoringEnabled) return;
 
-    std::lock_guard<std::mutex> lock(mMonitorMutex);
+    SourceState &state = mSources[source];
+    std::lock_guard<std::mutex> lock(state.mutex);
 
     if (timestamp == 0) {
         timestamp = systemTime(SYSTEM_TIME_BOOTTIME);
     }
-    std::unordered_set<int32_t> outputStreamIds;
-    for (size_t i = 0; i < numOutputBuffers; i++) {
-        const camera3::camera_stream_buffer_t *src = outputBuffers + i;
-        int32_t streamId = camera3::Camera3Stream::cast(src->stream)->getId();
-        outputStreamIds.emplace(streamId);
+
+    // Monitor when the stream ids change, this helps visually see what
+    // monitored metadata values are for capture requests with different
+    // stream ids.
+    if (source == REQUEST) {
+        state.streamIds.clear();
+        for (size_t i = 0; i < numOutputBuffers; i++) {
+            const camera3::camera_stream_buffer_t *src = outputBuffers + i;
+            state.streamIds.push_back(camera3::Camera3Stream::cast(src->stream)->getId());
+        }
+        std::sort(state.streamIds.begin(), state.streamIds.end());
+        state.streamIds.erase(std::unique(state.streamIds.begin(), state.streamIds.end()),
+                state.streamIds.end());
+
+        if (inputStreamId != state.lastInputStreamId) {
+            state.log.append(mEventSequence++, EventLog::INPUT_STREAM, frameNumber, timestamp,
+                    std::string(), 0, TYPE_INT32, &inputStreamId, sizeof(inputStreamId));
+            state.lastInputStreamId = inputStreamId;
+        }
+        if (state.streamIds != state.lastStreamIds) {
+            state.log.append(mEventSequence++, EventLog::OUTPUT_STREAMS, frameNumber, timestamp,
+                    std::string(), 0, TYPE_INT32, state.streamIds.data(),
+                    state.streamIds.size() * sizeof(int32_t));
+            state.lastStreamIds = state.streamIds;
+        }
     }
+
     std::string emptyId;
-    for (auto tag : mMonitoredTagList) {
-        monitorSingleMetadata(source, frameNumber, timestamp, emptyId, tag, metadata,
-                outputStreamIds, inputStreamId);
+    for (size_t i = 0; i < mMonitoredTags.size(); i++) {
+        monitorSingleMetadata(state, frameNumber, timestamp, emptyId, i, metadata);
 
         for (auto& m : physicalMetadata) {
-            monitorSingleMetadata(source, frameNumber, timestamp, m.first, tag, m.second,
-                    outputStreamIds, inputStreamId);
+            monitorSingleMetadata(state, frameNumber, timestamp, m.first, i, m.second);
         }
     }
 }
 
-void TagMonitor::monitorSingleMetadata(eventSource source, int64_t frameNumber, nsecs_t timestamp,
-        const std::string& cameraId, uint32_t tag, const CameraMetadata& metadata,
-        const std::unordered_set<int32_t> &outputStreamIds, int32_t inputStreamId) {
+void TagMonitor::monitorSingleMetadata(SourceState &state, int64_t frameNumber,
+        nsecs_t timestamp, const std::string& cameraId, size_t tagIndex,
+        const CameraMetadata& metadata) {
+    const MonitoredTag &monitoredTag = mMonitoredTags[tagIndex];
+    uint32_t tag = monitoredTag.tag;
 
-    CameraMetadata &lastValues = (source == REQUEST) ?
-            (cameraId.empty() ? mLastMonitoredRequestValues :
-                    mLastMonitoredPhysicalRequestKeys[cameraId]) :
-            (cameraId.empty() ? mLastMonitoredResultValues :
-                    mLastMonitoredPhysicalResultKeys[cameraId]);
-
-    camera_metadata_ro_entry entry = metadata.find(tag);
-    if (lastValues.isEmpty()) {
-        lastValues = CameraMetadata(mMonitoredTagList.size());
-        const camera_metadata_t *metaBuffer =
-                lastValues.getAndLock();
-        set_camera_metadata_vendor_id(
-                const_cast<camera_metadata_t *> (metaBuffer), mVendorTagId);
-        lastValues.unlock(metaBuffer);
+    std::vector<LastValue> &lastValues = state.lastValues[cameraId];
+    if (lastValues.size() != mMonitoredTags.size()) {
+        lastValues.resize(mMonitoredTags.size());
     }
+    LastValue &lastValue = lastValues[tagIndex];
 
-    camera_metadata_entry lastEntry = lastValues.find(tag);
-
-    // Monitor when the stream ids change, this helps visually see what
-    // monitored metadata values are for capture requests with different
-    // stream ids.
-    if (source == REQUEST) {
-        if (inputStreamId != mLastInputStreamId) {
-            mMonitoringEvents.emplace(source, frameNumber, timestamp, camera_metadata_ro_entry_t{},
-                                      cameraId, std::unordered_set<int>(), inputStreamId);
-            mLastInputStreamId = inputStreamId;
-        }
-
-        if (outputStreamIds != mLastStreamIds) {
-            mMonitoringEvents.emplace(source, frameNumber, timestamp, camera_metadata_ro_entry_t{},
-                                      cameraId, outputStreamIds, -1);
-            mLastStreamIds = outputStreamIds;
-        }
-    }
+    camera_metadata_ro_entry entry = metadata.find(tag);
     if (entry.count > 0) {
-        bool isDifferent = false;
-        if (lastEntry.count > 0) {
-            // Have a last value, compare to see if changed
-            if (lastEntry.type == entry.type &&
-                    lastEntry.count == entry.count) {
-                // Same type and count, compare values
-                size_t bytesPerValue = camera_metadata_type_size[lastEntry.type];
-                size_t entryBytes = bytesPerValue * lastEntry.count;
-                int cmp = memcmp(entry.data.u8, lastEntry.data.u8, entryBytes);
-                if (cmp != 0) {
-                    isDifferent = true;
-                }
-            } else {
-                // Count or type has changed
-                isDifferent = true;
-            }
-        } else {
-            // No last entry, so always consider to be different
-            isDifferent = true;
+        size_t entryBytes = camera_metadata_type_size[entry.type] * entry.count;
+        // Without a last value, always consider to be different
+        if (lastValue.present && lastValue.type == entry.type &&
+                lastValue.data.size() == entryBytes &&
+                memcmp(entry.data.u8, lastValue.data.data(), entryBytes) == 0) {
+            return;
         }
 
-        if (isDifferent) {
-            ALOGV("%s: Tag %s changed", __FUNCTION__,
-                  get_local_camera_metadata_tag_name_vendor_id(
-                          tag, mVendorTagId));
-            lastValues.update(entry);
-            mMonitoringEvents.emplace(source, frameNumber, timestamp, entry, cameraId,
-                                      std::unordered_set<int>(), -1);
-        }
-    } else if (lastEntry.count > 0) {
+        ALOGV("%s: Tag %s changed", __FUNCTION__,
+              get_local_camera_metadata_tag_name_vendor_id(
+                      tag, mVendorTagId));
+        lastValue.present = true;
+        lastValue.type = entry.type;
+        lastValue.data.assign(entry.data.u8, entry.data.u8 + entryBytes);
+        state.log.append(mEventSequence++, EventLog::TAG_CHANGED, frameNumber, timestamp,
+                cameraId, tag, entry.type, entry.data.u8, entryBytes);
+    } else if (lastValue.present) {
         // Value has been removed
         ALOGV("%s: Tag %s removed", __FUNCTION__,
               get_local_camera_metadata_tag_name_vendor_id(
                       tag, mVendorTagId));
-        lastValues.erase(tag);
-        entry.tag = tag;
-        entry.type = get_local_camera_metadata_tag_type_vendor_id(tag,
-                mVendorTagId);
-        entry.count = 0;
-        mLastInputStreamId = inputStreamId;
-        mLastStreamIds = outputStreamIds;
-        mMonitoringEvents.emplace(source, frameNumber, timestamp, entry, cameraId,
-                                  std::unordered_set<int>(), -1);
+        lastValue.present = false;
+        lastValue.data.clear();
+        state.log.append(mEventSequence++, EventLog::TAG_REMOVED, frameNumber, timestamp,
+                cameraId, tag, monitoredTag.type, nullptr, 0);
     }
 }
 
@@ -237,7 +237,8 @@ void TagMonitor::dumpMonitoredMetadata(int fd) {
 
     if (mMonitoringEnabled) {
         dprintf(fd, "     Tag monitoring enabled for tags:\n");
-        for (uint32_t tag : mMonitoredTagList) {
+        for (const MonitoredTag &monitoredTag : mMonitoredTags) {
+            uint32_t tag = monitoredTag.tag;
             dprintf(fd, "        %s.%s\n",
                     get_local_camera_metadata_section_name_vendor_id(tag,
                             mVendorTagId),
@@ -248,12 +249,11 @@ void TagMonitor::dumpMonitoredMetadata(int fd) {
         dprintf(fd, "     Tag monitoring disabled (enable with -m <name1,..,nameN>)\n");
     }
 
-    if (mMonitoringEvents.size() == 0) { return; }
-
-    dprintf(fd, "     Monitored tag event log:\n");
-
     std::vector<std::string> eventStrs;
     dumpMonitoredTagEventsToVectorLocked(eventStrs);
+    if (eventStrs.empty()) { return; }
+
+    dprintf(fd, "     Monitored tag event log:\n");
     for (const std::string &eventStr : eventStrs) {
         dprintf(fd, "        %s", eventStr.c_str());
     }
@@ -265,28 +265,47 @@ void TagMonitor::getLatestMonitoredTagEvents(std::vector<std::string> &out) {
 }
 
 void TagMonitor::dumpMonitoredTagEventsToVectorLocked(std::vector<std::string> &vec) {
-    if (mMonitoringEvents.size() == 0) { return; }
+    // Merge the logs of both sources, most recent first
+    std::vector<EventLog::Event> requestEvents, resultEvents;
+    mSources[REQUEST].log.read(&requestEvents);
+    mSources[RESULT].log.read(&resultEvents);
+    auto requestEvent = requestEvents.begin();
+    auto resultEvent = resultEvents.begin();
+
+    for (int i = 0; i < kMaxMonitorEvents; i++) {
+        eventSource source;
+        if (requestEvent != requestEvents.end() && (resultEvent == resultEvents.end() ||
+                requestEvent->sequence > resultEvent->sequence)) {
+            source = REQUEST;
+        } else if (resultEvent != resultEvents.end()) {
+            source = RESULT;
+        } else {
+            break;
+        }
+        const EventLog::Event &event = (source == REQUEST) ? *requestEvent++ : *resultEvent++;
 
-    for (const auto& event : mMonitoringEvents) {
-        int indentation = (event.source == REQUEST) ? 15 : 30;
+        int indentation = (source == REQUEST) ? 15 : 30;
         String8 eventString = String8::format("f%d:%" PRId64 "ns:%*s%*s",
                 event.frameNumber, event.timestamp,
                 2, event.cameraId.c_str(),
                 indentation,
-                event.source == REQUEST ? "REQ:" : "RES:");
+                source == REQUEST ? "REQ:" : "RES:");
 
-        if (!event.outputStreamIds.empty()) {
+        const int32_t *streamIds = reinterpret_cast<const int32_t*>(event.data.data());
+        size_t streamIdCount = event.data.size() / sizeof(int32_t);
+        if (event.kind == EventLog::OUTPUT_STREAMS) {
             eventString += " output stream ids:";
-            for (const auto& id : event.outputStreamIds) {
-                eventString.appendFormat(" %d", id);
+            for (size_t j = 0; j < streamIdCount; j++) {
+                eventString.appendFormat(" %d", streamIds[j]);
             }
             eventString += "\n";
             vec.emplace_back(eventString.string());
             continue;
         }
 
-        if (event.inputStreamId != -1) {
-            eventString.appendFormat(" input stream id: %d\n", event.inputStreamId);
+        if (event.kind == EventLog::INPUT_STREAM) {
+            eventString.appendFormat(" input stream id: %d\n",
+                    streamIdCount > 0 ? streamIds[0] : -1);
             vec.emplace_back(eventString.string());
             continue;
         }
@@ -296,12 +315,15 @@ void TagMonitor::dumpMonitoredTagEventsToVectorLocked(std::vector<std::string> &
                 get_local_camera_metadata_section_name_vendor_id(event.tag, mVendorTagId),
                 get_local_camera_metadata_tag_name_vendor_id(event.tag, mVendorTagId));
 
-        if (event.newData.empty()) {
+        if (event.kind == EventLog::TAG_REMOVED) {
             eventString += " (Removed)\n";
         } else {
             eventString += getEventDataString(
-                    event.newData.data(), event.tag, event.type,
-                    event.newData.size() / camera_metadata_type_size[event.type], indentation + 18);
+                    event.data.data(), event.tag, event.type,
+                    event.data.size() / camera_metadata_type_size[event.type], indentation + 18);
+            if (event.truncated) {
+                eventString.appendFormat("%*s(truncated)\n", indentation + 22, "");
+            }
         }
         vec.emplace_back(eventString.string());
     }
@@ -386,22 +408,118 @@ String8 TagMonitor::getEventDataString(const uint8_t* data_ptr, uint32_t tag, in
     return returnStr;
 }
 
-template<typename T>
-TagMonitor::MonitorEvent::MonitorEvent(eventSource src, uint32_t frameNumber, nsecs_t timestamp,
-        const T &value, const std::string& cameraId,
-        const std::unordered_set<int32_t> &outputStreamIds,
-        int32_t inputStreamId) :
-        source(src),
-        frameNumber(frameNumber),
-        timestamp(timestamp),
-        cameraId(cameraId),
-        tag(value.tag),
-        type(value.type),
-        newData(value.data.u8, value.data.u8 + camera_metadata_type_size[value.type] * value.count),
-        outputStreamIds(outputStreamIds),
-        inputStreamId(inputStreamId) {}
-
-TagMonitor::MonitorEvent::~MonitorEvent() {
+TagMonitor::EventLog::EventLog() :
+        mEventHead(0),
+        mDataHead(0),
+        mCameraIdCount(0) {
+    for (Slot &slot : mSlots) {
+        slot.seq.store(0, std::memory_order_relaxed);
+    }
+}
+
+size_t TagMonitor::EventLog::cameraIndexLocked(const std::string& cameraId) {
+    size_t count = mCameraIdCount.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < count; i++) {
+        if (mCameraIds[i] == cameraId) return i;
+    }
+    if (count == kMaxCameraIds) {
+        return kMaxCameraIds;
+    }
+    mCameraIds[count] = cameraId;
+    mCameraIdCount.store(count + 1, std::memory_order_release);
+    return count;
+}
+
+void TagMonitor::EventLog::append(uint64_t sequence, Kind kind, uint32_t frameNumber,
+        nsecs_t timestamp, const std::string& cameraId, uint32_t tag, uint8_t type,
+        const void *data, size_t dataSize) {
+    bool truncated = dataSize > kMaxDataSize;
+    if (truncated) {
+        dataSize = kMaxDataSize - kMaxDataSize % camera_metadata_type_size[type];
+    }
+    size_t cameraIndex = cameraIndexLocked(cameraId);
+
+    // Claim the data words first, so that readers of the events whose values
+    // they held see that these are gone
+    uint64_t dataStart = mDataHead.load(std::memory_order_relaxed);
+    size_t dataWords = (dataSize + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+    mDataHead.store(dataStart + dataWords, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    const uint8_t *bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < dataWords; i++) {
+        uint64_t word = 0;
+        memcpy(&word, bytes + i * sizeof(uint64_t),
+                std::min(sizeof(uint64_t), dataSize - i * sizeof(uint64_t)));
+        mData[(dataStart + i) % kDataWords].store(word, std::memory_order_relaxed);
+    }
+
+    uint64_t eventIndex = mEventHead.load(std::memory_order_relaxed);
+    Slot &slot = mSlots[eventIndex % kMaxEvents];
+    uint32_t seq = slot.seq.load(std::memory_order_relaxed);
+    slot.seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.words[0].store(eventIndex, std::memory_order_relaxed);
+    slot.words[1].store(sequence, std::memory_order_relaxed);
+    slot.words[2].store(static_cast<uint64_t>(tag) << 32 | frameNumber,
+            std::memory_order_relaxed);
+    slot.words[3].store(timestamp, std::memory_order_relaxed);
+    slot.words[4].store(dataStart, std::memory_order_relaxed);
+    slot.words[5].store(static_cast<uint64_t>(dataSize) |
+            static_cast<uint64_t>(kind) << 32 | static_cast<uint64_t>(type) << 40 |
+            static_cast<uint64_t>(cameraIndex) << 48 | static_cast<uint64_t>(truncated) << 56,
+            std::memory_order_relaxed);
+    slot.seq.store(seq + 2, std::memory_order_release);
+    mEventHead.store(eventIndex + 1, std::memory_order_release);
+}
+
+void TagMonitor::EventLog::read(std::vector<Event> *events) const {
+    uint64_t eventHead = mEventHead.load(std::memory_order_acquire);
+    uint64_t eventCount = std::min<uint64_t>(eventHead, kMaxEvents);
+    events->reserve(events->size() + eventCount);
+
+    std::vector<uint64_t> dataWords;
+    for (uint64_t eventIndex = eventHead; eventIndex-- > eventHead - eventCount; ) {
+        const Slot &slot = mSlots[eventIndex % kMaxEvents];
+        uint32_t seq = slot.seq.load(std::memory_order_acquire);
+        uint64_t words[kSlotWords];
+        for (size_t i = 0; i < kSlotWords; i++) {
+            words[i] = slot.words[i].load(std::memory_order_relaxed);
+        }
+        uint64_t dataStart = words[4];
+        size_t dataSize = words[5] & 0xFFFFFFFF;
+        if ((seq & 1) != 0 || words[0] != eventIndex || dataSize > kMaxDataSize) {
+            // Being overwritten by a newer event
+            continue;
+        }
+        dataWords.resize((dataSize + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+        for (size_t i = 0; i < dataWords.size(); i++) {
+            dataWords[i] = mData[(dataStart + i) % kDataWords].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.seq.load(std::memory_order_relaxed) != seq ||
+                mDataHead.load(std::memory_order_relaxed) - dataStart > kDataWords) {
+            // The event or its value was overwritten while being read
+            continue;
+        }
+
+        Event event;
+        event.sequence = words[1];
+        event.tag = words[2] >> 32;
+        event.frameNumber = words[2] & 0xFFFFFFFF;
+        event.timestamp = words[3];
+        event.kind = static_cast<Kind>((words[5] >> 32) & 0xFF);
+        event.type = (words[5] >> 40) & 0xFF;
+        size_t cameraIndex = (words[5] >> 48) & 0xFF;
+        event.truncated = (words[5] >> 56) & 1;
+        if (cameraIndex < mCameraIdCount.load(std::memory_order_acquire)) {
+            event.cameraId = mCameraIds[cameraIndex];
+        } else {
+            event.cameraId = "?";
+        }
+        const uint8_t *bytes = reinterpret_cast<const uint8_t*>(dataWords.data());
+        event.data.assign(bytes, bytes + dataSize);
+        events->push_back(std::move(event));
+    }
 }
 
 } // namespace android
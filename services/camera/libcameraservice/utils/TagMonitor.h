@@ -20,13 +20,13 @@
 #include <vector>
 #include <atomic>
 #include <mutex>
+#include <string>
 #include <unordered_map>
 
 #include <utils/RefBase.h>
 #include <utils/String8.h>
 #include <utils/Timers.h>
 
-#include <media/RingBuffer.h>
 #include <system/camera_metadata.h>
 #include <system/camera_vendor_tags.h>
 #include <camera/CameraMetadata.h>
@@ -64,6 +64,9 @@ class TagMonitor {
     // Disable monitoring; does not clear the event log
     void disableMonitoring();
 
+    // Whether monitorMetadata() records anything
+    bool isMonitoringEnabled() const { return mMonitoringEnabled; }
+
     // Scan through the metadata and update the monitoring information
     void monitorMetadata(eventSource source, int64_t frameNumber,
             nsecs_t timestamp, const CameraMetadata& metadata,
@@ -88,56 +91,115 @@ class TagMonitor {
     static String8 getEventDataString(const uint8_t* data_ptr, uint32_t tag, int type, int count,
                                       int indentation);
 
-    void monitorSingleMetadata(TagMonitor::eventSource source, int64_t frameNumber,
-            nsecs_t timestamp, const std::string& cameraId, uint32_t tag,
-            const CameraMetadata& metadata, const std::unordered_set<int32_t> &outputStreamIds,
-            int32_t inputStreamId);
+    // A monitored tag and its type
+    struct MonitoredTag {
+        uint32_t tag;
+        uint8_t type;
+    };
 
-    std::atomic<bool> mMonitoringEnabled;
-    std::mutex mMonitorMutex;
+    // Latest-seen value of a monitored tag
+    struct LastValue {
+        bool present = false;
+        uint8_t type = 0;
+        std::vector<uint8_t> data;
+    };
 
-    // Current tags to monitor and record changes to
-    std::vector<uint32_t> mMonitoredTagList;
+    /**
+     * Log of the latest events of one source. Events keep the raw bytes of the
+     * new value and are only formatted when dumped. Memory is bounded, and
+     * appending neither allocates nor waits for readers: one thread appends at
+     * a time, while any thread may read the log concurrently.
+     */
+    class EventLog {
+      public:
+        enum Kind : uint8_t {
+            TAG_CHANGED,
+            TAG_REMOVED,
+            OUTPUT_STREAMS, // data holds the output stream ids, as int32_t
+            INPUT_STREAM,   // data holds the input stream id, as int32_t
+        };
+
+        struct Event {
+            uint64_t sequence; // order among the events of all logs
+            Kind kind;
+            uint32_t frameNumber;
+            nsecs_t timestamp;
+            std::string cameraId;
+            uint32_t tag;
+            uint8_t type;
+            bool truncated;
+            std::vector<uint8_t> data;
+        };
+
+        EventLog();
+
+        // Append an event, copying at most kMaxDataSize bytes of data
+        void append(uint64_t sequence, Kind kind, uint32_t frameNumber, nsecs_t timestamp,
+                const std::string& cameraId, uint32_t tag, uint8_t type,
+                const void *data, size_t dataSize);
+
+        // Read the events still in the log, most recent first
+        void read(std::vector<Event> *events) const;
+
+        // Room for the values of kMaxEvents events of 80 bytes
+        static constexpr size_t kMaxEvents = 100;
+        static constexpr size_t kDataWords = 1000;
+        static constexpr size_t kMaxDataSize = kDataWords * sizeof(uint64_t) / 4;
+
+      private:
+        static constexpr size_t kMaxCameraIds = 16;
+        static constexpr size_t kSlotWords = 6;
+
+        // An event, written between two updates of seq; seq is odd while it is written
+        struct Slot {
+            std::atomic<uint32_t> seq;
+            std::atomic<uint64_t> words[kSlotWords];
+        };
+
+        size_t cameraIndexLocked(const std::string& cameraId);
+
+        Slot mSlots[kMaxEvents];
+        // Event values, as a ring of words; each event takes a whole number of them
+        std::atomic<uint64_t> mData[kDataWords];
+        // Total events and data words appended
+        std::atomic<uint64_t> mEventHead;
+        std::atomic<uint64_t> mDataHead;
+        // Camera ids are only added, and published by the count
+        std::string mCameraIds[kMaxCameraIds];
+        std::atomic<size_t> mCameraIdCount;
+    };
 
-    // Latest-seen values of tracked tags
-    CameraMetadata mLastMonitoredRequestValues;
-    CameraMetadata mLastMonitoredResultValues;
+    // Monitoring state of one event source, used by the thread monitoring it
+    struct SourceState {
+        // Only contended when the monitored tags change
+        std::mutex mutex;
+        // Latest-seen values of the monitored tags, by camera id; the logical
+        // camera's id is empty
+        std::unordered_map<std::string, std::vector<LastValue>> lastValues;
+        int32_t lastInputStreamId = -1;
+        std::vector<int32_t> lastStreamIds;
+        std::vector<int32_t> streamIds;
+        EventLog log;
+    };
 
-    std::unordered_map<std::string, CameraMetadata> mLastMonitoredPhysicalRequestKeys;
-    std::unordered_map<std::string, CameraMetadata> mLastMonitoredPhysicalResultKeys;
+    void monitorSingleMetadata(SourceState &state, int64_t frameNumber, nsecs_t timestamp,
+            const std::string& cameraId, size_t tagIndex, const CameraMetadata& metadata);
 
-    int32_t mLastInputStreamId = -1;
-    std::unordered_set<int32_t> mLastStreamIds;
+    void resetSourcesLocked();
 
-    /**
-     * A monitoring event
-     * Stores a new metadata field value and the timestamp at which it changed.
-     * Copies the source metadata value array and frees it on destruct.
-     */
-    struct MonitorEvent {
-        template<typename T>
-        MonitorEvent(eventSource src, uint32_t frameNumber, nsecs_t timestamp,
-                const T &newValue, const std::string& cameraId,
-                const std::unordered_set<int32_t> &outputStreamIds, int32_t inputStreamId);
-        ~MonitorEvent();
-
-        eventSource source;
-        uint32_t frameNumber;
-        nsecs_t timestamp;
-        std::string cameraId;
-        uint32_t tag;
-        uint8_t type;
-        std::vector<uint8_t> newData;
-        // NOTE: We want to print changes to outputStreamIds and inputStreamId in their own lines.
-        // So any MonitorEvent where these fields are not the default value will have garbage
-        // values for all fields other than source, frameNumber, timestamp, and cameraId.
-        std::unordered_set<int32_t> outputStreamIds;
-        int32_t inputStreamId = -1;
-    };
+    std::atomic<bool> mMonitoringEnabled;
+    // Guards mMonitoredTags with the mutexes of both sources, taken in that order
+    std::mutex mMonitorMutex;
+
+    // Current tags to monitor and record changes to
+    std::vector<MonitoredTag> mMonitoredTags;
+
+    // Indexed by eventSource
+    SourceState mSources[2];
+    std::atomic<uint64_t> mEventSequence;
 
-    // A ring buffer for tracking the last kMaxMonitorEvents metadata changes
+    // Number of events dumped, across sources
     static const int kMaxMonitorEvents = 100;
-    RingBuffer<MonitorEvent> mMonitoringEvents;
 
     // 3A fields to use with the "3a" option
     static const char *k3aTags;